@@ -388,30 +388,30 @@ static bool do_get_finfo(const char *path, bool has_fxinfo,
 	return true;
 }
 
-void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
+void get_finfo_host(const char *path, uint8 *finfo, uint8 *fxinfo, bool is_dir)
 {
 	// Set default finder info
-	Mac_memset(finfo, 0, SIZEOF_FInfo);
+	memset(finfo, 0, SIZEOF_FInfo);
 	if (fxinfo)
-		Mac_memset(fxinfo, 0, SIZEOF_FXInfo);
-	WriteMacInt16(finfo + fdFlags, DEFAULT_FINDER_FLAGS);
-	WriteMacInt32(finfo + fdLocation, (uint32)-1);
+		memset(fxinfo, 0, SIZEOF_FXInfo);
+	finfo_put16(finfo + fdFlags, DEFAULT_FINDER_FLAGS);
+	finfo_put32(finfo + fdLocation, (uint32)-1);
 
 	// Merge emulated and native Finder info
 	FinderInfo emu_finfo, emu_fxinfo;
 	FinderInfo nat_finfo, nat_fxinfo;
 	if (do_get_finfo(path, fxinfo, emu_finfo, emu_fxinfo, nat_finfo, nat_fxinfo)) {
 		if (!is_dir) {
-			finfo_merge(Mac2HostAddr(finfo), emu_finfo, nat_finfo, kNativeFInfoMask);
+			finfo_merge(finfo, emu_finfo, nat_finfo, kNativeFInfoMask);
 			if (fxinfo)
-				finfo_merge(Mac2HostAddr(fxinfo), emu_fxinfo, nat_fxinfo, kNativeFXInfoMask);
-			if (ReadMacInt32(finfo + fdType) != 0 && ReadMacInt32(finfo + fdCreator) != 0)
+				finfo_merge(fxinfo, emu_fxinfo, nat_fxinfo, kNativeFXInfoMask);
+			if (finfo_get32(finfo + fdType) != 0 && finfo_get32(finfo + fdCreator) != 0)
 				return;
 		}
 		else {
-			finfo_merge(Mac2HostAddr(finfo), emu_finfo, nat_finfo, kNativeDInfoMask);
+			finfo_merge(finfo, emu_finfo, nat_finfo, kNativeDInfoMask);
 			if (fxinfo)
-				finfo_merge(Mac2HostAddr(fxinfo), emu_fxinfo, nat_fxinfo, kNativeDXInfoMask);
+				finfo_merge(fxinfo, emu_fxinfo, nat_fxinfo, kNativeDXInfoMask);
 			return;
 		}
 	}
@@ -424,14 +424,23 @@ void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
 			if (path_len < ext_len)
 				continue;
 			if (!strcmp(path + path_len - ext_len, e2t_translation[i].ext)) {
-				WriteMacInt32(finfo + fdType, e2t_translation[i].type);
-				WriteMacInt32(finfo + fdCreator, e2t_translation[i].creator);
+				finfo_put32(finfo + fdType, e2t_translation[i].type);
+				finfo_put32(finfo + fdCreator, e2t_translation[i].creator);
 				break;
 			}
 		}
 	}
 }
 
+void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
+{
+	uint8 host_finfo[SIZEOF_FInfo], host_fxinfo[SIZEOF_FXInfo];
+	get_finfo_host(path, host_finfo, fxinfo ? host_fxinfo : NULL, is_dir);
+	Host2Mac_memcpy(finfo, host_finfo, SIZEOF_FInfo);
+	if (fxinfo)
+		Host2Mac_memcpy(fxinfo, host_fxinfo, SIZEOF_FXInfo);
+}
+
 // Set emulated Finder info into metada (Tiger+)
 static bool set_finfo_to_xattr(const char *path, const uint8 *finfo, const uint8 *fxinfo)
 {
@@ -1229,6 +1229,11 @@ void SDL_monitor_desc::video_close(void)
 
 void VideoExit(void)
 {
+#ifdef SHEEPSHAVER
+	// Stop NQD worker thread, it may still redraw the screen
+	VideoExitAccel();
+#endif
+
 	// Close displays
 	vector<monitor_desc *>::iterator i, end = VideoMonitors.end();
 	for (i = VideoMonitors.begin(); i != end; ++i)
@@ -1443,6 +1448,9 @@ int16 video_mode_change(VidLocals *csSave, uint32 ParamPtr)
 			csSave->saveData = ReadMacInt32(ParamPtr + csData);
 			csSave->savePage = ReadMacInt16(ParamPtr + csPage);
 
+			// Complete pending NQD operations into the old frame buffer
+			VideoSyncAccel();
+
 			// Disable interrupts and pause redraw thread
 			DisableInterrupt();
 			thread_stop_ack = false;
@@ -0,0 +1,222 @@
+/*
+ *  disk_mmap.cpp - Memory-mapped disk image access
+ *
+ *  Basilisk II (C) Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  The whole image file is mapped, and requests are served by copying
+ *  from/to the mapping, so data is moved only once between the page
+ *  cache and Mac memory. The kernel is told how the image is accessed:
+ *  sequential streams get MADV_SEQUENTIAL and the next window is
+ *  prefetched with MADV_WILLNEED, while scattered accesses switch the
+ *  mapping to MADV_RANDOM to avoid useless readahead.
+ *
+ *  The mapping is shared, so an I/O error or the image file being
+ *  truncated by another process raises SIGBUS on access. Copies from/to
+ *  the mapping are guarded and fail like a read()/write() error instead.
+ */
+
+#include "disk_unix.h"
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <pthread.h>
+
+#define DEBUG 0
+#include "debug.h"
+
+#ifndef MAP_FAILED
+#define MAP_FAILED ((void *)-1)
+#endif
+
+const size_t MMAP_PREFETCH_SIZE = 1024 * 1024;	// Prefetch window for sequential streams
+const int MMAP_SEQUENTIAL_THRESHOLD = 4;		// Sequential requests before prefetching starts
+const int MMAP_RANDOM_THRESHOLD = 16;			// Non-sequential requests before readahead is disabled
+
+
+/*
+ *  SIGBUS guard for copies from/to mappings
+ */
+
+static bool mmap_sigbus_installed = false;
+static struct sigaction mmap_old_sigbus;		// Handler installed before ours
+static __thread sigjmp_buf *mmap_fault_env = NULL;	// Non-NULL while copying
+
+static void mmap_sigbus_handler(int sig, siginfo_t *sip, void *scp)
+{
+	if (mmap_fault_env) {
+		// The signal mask is not saved by the guard, unblock SIGBUS ourselves
+		sigset_t set;
+		sigemptyset(&set);
+		sigaddset(&set, SIGBUS);
+		pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+		siglongjmp(*mmap_fault_env, 1);
+	}
+
+	// Not a fault on a mapping, chain to the previous handler
+	if (mmap_old_sigbus.sa_flags & SA_SIGINFO)
+		mmap_old_sigbus.sa_sigaction(sig, sip, scp);
+	else if (mmap_old_sigbus.sa_handler != SIG_DFL && mmap_old_sigbus.sa_handler != SIG_IGN)
+		mmap_old_sigbus.sa_handler(sig);
+	else
+		signal(SIGBUS, SIG_DFL);	// The faulting access is restarted and kills us
+}
+
+static void mmap_install_sigbus_handler(void)
+{
+	if (mmap_sigbus_installed)
+		return;
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_sigaction = mmap_sigbus_handler;
+	sa.sa_flags = SA_SIGINFO | SA_RESTART;
+	mmap_sigbus_installed = (sigaction(SIGBUS, &sa, &mmap_old_sigbus) == 0);
+}
+
+// Copy "length" bytes, returns false if the mapping faulted
+static bool mmap_copy(void *dest, const void *src, size_t length)
+{
+	sigjmp_buf env;
+	if (sigsetjmp(env, 0)) {
+		mmap_fault_env = NULL;
+		D(bug("disk_mmap: SIGBUS while copying %lu bytes\n", (unsigned long)length));
+		return false;
+	}
+	mmap_fault_env = &env;
+	memcpy(dest, src, length);
+	mmap_fault_env = NULL;
+	return true;
+}
+
+
+struct disk_mmap : disk_generic {
+	disk_mmap(uint8 *map, size_t map_size, loff_t start, loff_t size, bool read_only)
+	: map(map), map_size(map_size), data(map + start), total_size(size), read_only(read_only),
+	  next_offset(-1), prefetched(0), sequential(0), scattered(0), advice(MADV_NORMAL) { }
+
+	virtual ~disk_mmap() {
+		if (!read_only)
+			msync(map, map_size, MS_SYNC);
+		munmap(map, map_size);
+	}
+
+	virtual bool is_read_only() { return read_only; }
+	virtual loff_t size() { return total_size; }
+
+	virtual size_t read(void *buf, loff_t offset, size_t length) {
+		if (offset >= total_size)
+			return 0;
+		if (length > total_size - offset)
+			length = total_size - offset;
+		access(offset, length);
+		return mmap_copy(buf, data + offset, length) ? length : 0;
+	}
+
+	virtual size_t write(void *buf, loff_t offset, size_t length) {
+		if (read_only || offset >= total_size)
+			return 0;
+		if (length > total_size - offset)
+			length = total_size - offset;
+		access(offset, length);
+		return mmap_copy(data + offset, buf, length) ? length : 0;
+	}
+
+protected:
+	uint8 *map;				// start of mapping (page aligned)
+	size_t map_size;
+	uint8 *data;			// start of image data in mapping
+	loff_t total_size;
+	bool read_only;
+
+	// Access pattern tracking
+	loff_t next_offset;		// end of last request
+	loff_t prefetched;		// end of data already prefetched
+	int sequential;			// number of consecutive sequential requests
+	int scattered;			// number of consecutive non-sequential requests
+	int advice;				// current advice for the whole mapping
+
+	void advise(loff_t offset, size_t length, int how) {
+		uintptr page_mask = getpagesize() - 1;
+		uintptr start = (uintptr)(data + offset) & ~page_mask;
+		uintptr end = (uintptr)(data + offset + length);
+		if (end > (uintptr)(map + map_size))
+			end = (uintptr)(map + map_size);
+		if (end > start)
+			madvise((void *)start, end - start, how);
+	}
+
+	void set_advice(int how) {
+		if (advice != how) {
+			D(bug("disk_mmap: advice %d -> %d\n", advice, how));
+			madvise(map, map_size, how);
+			advice = how;
+		}
+	}
+
+	void access(loff_t offset, size_t length) {
+		if (offset == next_offset) {
+			scattered = 0;
+			if (++sequential >= MMAP_SEQUENTIAL_THRESHOLD) {
+				set_advice(MADV_SEQUENTIAL);
+
+				// Keep one window ahead of the stream
+				loff_t end = offset + length;
+				if (prefetched < end)
+					prefetched = end;
+				if (prefetched - end < (loff_t)MMAP_PREFETCH_SIZE / 2 && prefetched < total_size) {
+					advise(prefetched, MMAP_PREFETCH_SIZE, MADV_WILLNEED);
+					prefetched += MMAP_PREFETCH_SIZE;
+				}
+			}
+		} else {
+			sequential = 0;
+			prefetched = 0;
+			if (++scattered >= MMAP_RANDOM_THRESHOLD)
+				set_advice(MADV_RANDOM);
+			else if (advice == MADV_SEQUENTIAL)
+				set_advice(MADV_NORMAL);
+		}
+		next_offset = offset + length;
+	}
+};
+
+
+/*
+ *  Map image data of "size" bytes starting at "start" in file, returns NULL on error
+ */
+
+disk_generic *disk_mmap_create(int fd, loff_t start, loff_t size, bool read_only)
+{
+	loff_t map_size = start + size;
+	if (size <= 0 || (loff_t)(size_t)map_size != map_size)
+		return NULL;	// Doesn't fit in address space
+	if (sizeof(void *) < 8 && map_size > 256 * 1024 * 1024)
+		return NULL;	// Leave address space for Mac memory on 32-bit hosts
+
+	int prot = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+	void *map = mmap(NULL, map_size, prot, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		D(bug("disk_mmap: mmap failed: %s\n", strerror(errno)));
+		return NULL;
+	}
+	mmap_install_sigbus_handler();
+	return new disk_mmap((uint8 *)map, map_size, start, size, read_only);
+}
@@ -0,0 +1,307 @@
+/*
+ *  disk_overlay.cpp - Copy-on-write disk overlay
+ *
+ *  Basilisk II (C) Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  The overlay keeps all sectors written by the Mac in memory and never
+ *  writes to the underlying disk. Its contents can be saved to and
+ *  restored from a savestate, so loading a state also rewinds the disk,
+ *  at the cost of only the changed sectors.
+ *
+ *  Every save or load freezes the overlay's generation number, and the
+ *  first write afterwards allocates a new, never reused one. Two overlays
+ *  with the same generation therefore hold the same sectors, and loading
+ *  a state that was saved since the last write doesn't touch the disk.
+ */
+
+#include "disk_unix.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <map>
+#include <algorithm>
+
+#define DEBUG 0
+#include "debug.h"
+
+const uint32 OVERLAY_SECTOR_SIZE = 512;
+
+// Generation numbers start at a random value, so that they are unique across sessions
+static uint64 overlay_generation_counter = 0;
+
+
+// Read-only access to a plain file or device, starting at "start"
+struct disk_plain : disk_generic {
+	disk_plain(int fd, loff_t start, loff_t size, bool read_only)
+	: fd(fd), start(start), total_size(size), read_only(read_only) { }
+
+	virtual bool is_read_only() { return read_only; }
+	virtual loff_t size() { return total_size; }
+
+	virtual size_t read(void *buf, loff_t offset, size_t length) {
+		ssize_t actual = pread(fd, buf, length, offset + start);
+		return actual < 0 ? 0 : actual;
+	}
+
+	virtual size_t write(void *buf, loff_t offset, size_t length) {
+		ssize_t actual = pwrite(fd, buf, length, offset + start);
+		return actual < 0 ? 0 : actual;
+	}
+
+protected:
+	int fd;					// owned by the caller
+	loff_t start, total_size;
+	bool read_only;
+};
+
+
+struct disk_overlay : disk_generic {
+	disk_overlay(disk_generic *base) : base(base), frozen(false) {
+		generation = ++overlay_generation_counter;
+	}
+
+	virtual ~disk_overlay() {
+		clear();
+		delete base;
+	}
+
+	virtual bool is_read_only() { return false; }
+	virtual loff_t size() { return base->size(); }
+
+	virtual size_t read(void *buf, loff_t offset, size_t length) {
+		uint8 *b = (uint8 *)buf;
+		loff_t total_size = base->size();
+		if (offset >= total_size)
+			return 0;
+		if (length > total_size - offset)
+			length = total_size - offset;
+
+		size_t done = 0;
+		while (done < length) {
+			loff_t pos = offset + done;
+			loff_t sector = pos / OVERLAY_SECTOR_SIZE;
+			size_t sector_pos = pos % OVERLAY_SECTOR_SIZE;
+			sector_map::const_iterator it = sectors.lower_bound(sector);
+			if (it != sectors.end() && it->first == sector) {
+				size_t n = std::min((size_t)OVERLAY_SECTOR_SIZE - sector_pos, length - done);
+				memcpy(b + done, it->second + sector_pos, n);
+				done += n;
+			} else {
+				// Read everything up to the next overlay sector at once
+				size_t n = length - done;
+				if (it != sectors.end() && it->first * OVERLAY_SECTOR_SIZE - pos < n)
+					n = it->first * OVERLAY_SECTOR_SIZE - pos;
+				size_t actual = base->read(b + done, pos, n);
+				done += actual;
+				if (actual < n)
+					break;
+			}
+		}
+		return done;
+	}
+
+	virtual size_t write(void *buf, loff_t offset, size_t length) {
+		const uint8 *b = (const uint8 *)buf;
+		loff_t total_size = base->size();
+		if (offset >= total_size)
+			return 0;
+		if (length > total_size - offset)
+			length = total_size - offset;
+
+		if (frozen) {
+			generation = ++overlay_generation_counter;
+			frozen = false;
+		}
+
+		size_t done = 0;
+		while (done < length) {
+			loff_t pos = offset + done;
+			loff_t sector = pos / OVERLAY_SECTOR_SIZE;
+			size_t sector_pos = pos % OVERLAY_SECTOR_SIZE;
+			size_t n = std::min((size_t)OVERLAY_SECTOR_SIZE - sector_pos, length - done);
+			uint8 *&data = sectors[sector];
+			if (data == NULL) {
+				data = new uint8[OVERLAY_SECTOR_SIZE];
+				if (n < OVERLAY_SECTOR_SIZE) {
+					memset(data, 0, OVERLAY_SECTOR_SIZE);
+					base->read(data, sector * OVERLAY_SECTOR_SIZE, OVERLAY_SECTOR_SIZE);
+				}
+			}
+			memcpy(data + sector_pos, b + done, n);
+			done += n;
+		}
+		return done;
+	}
+
+	bool save(int fd);
+	bool load(int fd);
+
+protected:
+	typedef std::map<loff_t, uint8 *> sector_map;
+
+	disk_generic *base;		// underlying disk, never written to
+	sector_map sectors;		// sectors written by the Mac
+	uint64 generation;		// identifies the contents of "sectors"
+	bool frozen;			// generation was saved or loaded, next write allocates a new one
+
+	void clear() {
+		clear(sectors);
+	}
+
+	static void clear(sector_map &map) {
+		for (sector_map::iterator it = map.begin(); it != map.end(); ++it)
+			delete[] it->second;
+		map.clear();
+	}
+};
+
+
+// Read/write exactly "length" bytes from/to savestate
+static bool read_fully(int fd, void *buf, size_t length)
+{
+	uint8 *b = (uint8 *)buf;
+	while (length) {
+		ssize_t actual = ::read(fd, b, length);
+		if (actual < 0 && errno == EINTR)
+			continue;
+		if (actual <= 0)
+			return false;
+		b += actual;
+		length -= actual;
+	}
+	return true;
+}
+
+static bool write_fully(int fd, const void *buf, size_t length)
+{
+	const uint8 *b = (const uint8 *)buf;
+	while (length) {
+		ssize_t actual = ::write(fd, b, length);
+		if (actual < 0 && errno == EINTR)
+			continue;
+		if (actual <= 0)
+			return false;
+		b += actual;
+		length -= actual;
+	}
+	return true;
+}
+
+/*
+ *  Savestate layout: generation (uint64), number of sectors (uint64),
+ *  then the sector numbers (uint64 each) followed by the sector data
+ */
+
+bool disk_overlay::save(int fd)
+{
+	uint64 header[2] = { generation, sectors.size() };
+	if (!write_fully(fd, header, sizeof(header)))
+		return false;
+	for (sector_map::const_iterator it = sectors.begin(); it != sectors.end(); ++it) {
+		uint64 sector = it->first;
+		if (!write_fully(fd, &sector, sizeof(sector)))
+			return false;
+	}
+	for (sector_map::const_iterator it = sectors.begin(); it != sectors.end(); ++it) {
+		if (!write_fully(fd, it->second, OVERLAY_SECTOR_SIZE))
+			return false;
+	}
+	frozen = true;
+	D(bug("disk overlay: saved generation %llu, %llu sectors\n", (unsigned long long)header[0], (unsigned long long)header[1]));
+	return true;
+}
+
+bool disk_overlay::load(int fd)
+{
+	uint64 header[2];
+	if (!read_fully(fd, header, sizeof(header)))
+		return false;
+	off_t data_size = header[1] * (sizeof(uint64) + OVERLAY_SECTOR_SIZE);
+
+	// Unchanged since that state was saved?
+	if (frozen && header[0] == generation) {
+		D(bug("disk overlay: generation %llu is current\n", (unsigned long long)generation));
+		return lseek(fd, data_size, SEEK_CUR) != -1;
+	}
+
+	// Replace the sectors only once they were all read
+	if (header[1] > (uint64)(base->size() + OVERLAY_SECTOR_SIZE - 1) / OVERLAY_SECTOR_SIZE)
+		return false;
+	sector_map loaded;
+	uint64 *sector_list = new uint64[header[1]];
+	bool ok = read_fully(fd, sector_list, header[1] * sizeof(uint64));
+	for (uint64 i = 0; ok && i < header[1]; i++) {
+		uint8 *data = new uint8[OVERLAY_SECTOR_SIZE];
+		ok = read_fully(fd, data, OVERLAY_SECTOR_SIZE);
+		uint8 *&old = loaded[sector_list[i]];
+		delete[] old;
+		old = data;
+	}
+	delete[] sector_list;
+	if (!ok) {
+		clear(loaded);
+		return false;
+	}
+	clear();
+	sectors.swap(loaded);
+	generation = header[0];
+	frozen = true;
+	D(bug("disk overlay: loaded generation %llu, %llu sectors\n", (unsigned long long)header[0], (unsigned long long)header[1]));
+	return true;
+}
+
+
+/*
+ *  Public interface
+ */
+
+disk_generic *disk_plain_create(int fd, loff_t start, loff_t size, bool read_only)
+{
+	return new disk_plain(fd, start, size, read_only);
+}
+
+disk_generic *disk_overlay_create(disk_generic *base)
+{
+	if (overlay_generation_counter == 0) {
+		int fd = open("/dev/urandom", O_RDONLY);
+		if (fd < 0 || !read_fully(fd, &overlay_generation_counter, sizeof(overlay_generation_counter)))
+			overlay_generation_counter = ((uint64)time(NULL) << 32) ^ ((uint64)getpid() << 16) ^ GetTicks_usec();
+		if (fd >= 0)
+			close(fd);
+	}
+	return new disk_overlay(base);
+}
+
+bool disk_overlay_save(disk_generic *disk, int fd)
+{
+	return static_cast<disk_overlay *>(disk)->save(fd);
+}
+
+// Skip the saved overlay if disk is NULL
+bool disk_overlay_load(disk_generic *disk, int fd)
+{
+	if (disk)
+		return static_cast<disk_overlay *>(disk)->load(fd);
+
+	uint64 header[2];
+	if (!read_fully(fd, header, sizeof(header)))
+		return false;
+	return lseek(fd, header[1] * (sizeof(uint64) + OVERLAY_SECTOR_SIZE), SEEK_CUR) != -1;
+}
@@ -45,4 +45,11 @@ typedef disk_generic::status (disk_factory)(const char *path, bool read_only,
 extern disk_factory disk_sparsebundle_factory;
 extern disk_factory disk_vhd_factory;
 
+// Plain file/device access, memory-mapped image file, and copy-on-write overlay over another disk
+extern disk_generic *disk_plain_create(int fd, loff_t start, loff_t size, bool read_only);
+extern disk_generic *disk_mmap_create(int fd, loff_t start, loff_t size, bool read_only);
+extern disk_generic *disk_overlay_create(disk_generic *base);
+extern bool disk_overlay_save(disk_generic *overlay, int fd);
+extern bool disk_overlay_load(disk_generic *overlay, int fd);
+
 #endif
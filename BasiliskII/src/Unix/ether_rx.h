@@ -0,0 +1,103 @@
+/*
+ *  ether_rx.h - Ethernet packet reception ring, Unix specific stuff
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ETHER_RX_H
+#define ETHER_RX_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+const int RX_RING_SIZE = 64;				// Max. number of packets delivered per interrupt
+const int RX_PACKET_SIZE = 1516;			// Max. packet size, including ethertap header
+
+// Received packet waiting for delivery to the MacOS
+struct rx_packet {
+	ssize_t length;
+	struct sockaddr_in from;				// Sender of UDP tunnel packets
+	uint8 data[RX_PACKET_SIZE];
+};
+
+/*
+ *  Read packets pending on "fd" into "ring", which holds "count" packets,
+ *  until it holds "size" (at most RX_RING_SIZE) packets or no more are
+ *  pending. Packets are read with recvmmsg() if "use_mmsg" is set (it is
+ *  cleared if the kernel doesn't support it), and their sender is recorded
+ *  if "want_from" is set. Returns the new number of packets in the ring.
+ */
+
+static inline int rx_ring_fill(int fd, rx_packet *ring, int count, int size, int read_size, bool want_from, bool &use_mmsg)
+{
+#ifdef HAVE_RECVMMSG
+	if (use_mmsg) {
+		struct mmsghdr msgs[RX_RING_SIZE];
+		struct iovec iov[RX_RING_SIZE];
+		while (count < size) {
+			int n = size - count;
+			for (int i = 0; i < n; i++) {
+				rx_packet *p = &ring[count + i];
+				iov[i].iov_base = p->data;
+				iov[i].iov_len = read_size;
+				memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				if (want_from) {
+					msgs[i].msg_hdr.msg_name = &p->from;
+					msgs[i].msg_hdr.msg_namelen = sizeof(p->from);
+				}
+			}
+			int actual = recvmmsg(fd, msgs, n, MSG_DONTWAIT, NULL);
+			if (actual < 0 && errno == ENOSYS) {
+				use_mmsg = false;	// Kernel too old, read one by one
+				break;
+			}
+			if (actual <= 0)
+				return count;
+			for (int i = 0; i < actual; i++)
+				ring[count + i].length = msgs[i].msg_len;
+			count += actual;
+			if (actual < n)
+				return count;
+		}
+		if (use_mmsg)
+			return count;
+	}
+#endif
+
+	while (count < size) {
+		rx_packet *p = &ring[count];
+		ssize_t length;
+		if (want_from) {
+			socklen_t from_len = sizeof(p->from);
+			length = recvfrom(fd, p->data, read_size, 0, (struct sockaddr *)&p->from, &from_len);
+		} else
+			length = read(fd, p->data, read_size);
+		if (length < 14)
+			break;
+		p->length = length;
+		count++;
+	}
+	return count;
+}
+
+#endif
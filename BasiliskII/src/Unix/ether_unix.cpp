@@ -76,6 +76,7 @@
 #include "user_strings.h"
 #include "ether.h"
 #include "ether_defs.h"
+#include "ether_rx.h"
 
 #ifndef NO_STD_NAMESPACE
 using std::map;
@@ -100,7 +101,6 @@ enum {
 #if ENABLE_TUNTAP
 static const char ETHERCONFIG_FILE_NAME[] = DATADIR "/tunconfig";
 #endif
-
 // Global variables
 static int fd = -1;							// fd of sheep_net device
 static pthread_t ether_thread;				// Packet reception thread
@@ -115,6 +115,11 @@ static pthread_t slirp_thread;				// Slirp reception thread
 static bool slirp_thread_active = false;	// Flag: Slirp reception threadinstalled
 static int slirp_output_fd = -1;			// fd of slirp output pipe
 static int slirp_input_fds[2] = { -1, -1 };	// fds of slirp input pipe
+static rx_packet *rx_ring = NULL;			// Packets received by the reception thread
+static int rx_count = 0;					// Number of packets in rx_ring
+static int rx_read_size = 1514;				// Size of packets to read from fd
+static bool rx_use_mmsg = false;			// Flag: fd is a socket, receive with recvmmsg()
+static int32 rx_coalesce = 0;				// Time to wait for more packets before interrupting the MacOS (usecs)
 #ifdef SHEEPSHAVER
 static bool net_open = false;				// Flag: initialization succeeded, network device open
 static uint8 ether_addr[6];					// Our Ethernet address
@@ -147,6 +152,21 @@ static bool start_thread(void)
 		return false;
 	}
 
+	// Set up receive ring
+	rx_ring = new rx_packet[RX_RING_SIZE];
+	rx_count = 0;
+	rx_read_size = 1514;
+#if defined(__linux__)
+	if (net_if_type == NET_IF_ETHERTAP && !udp_tunnel)
+		rx_read_size = 1516;
+#endif
+#ifdef HAVE_RECVMMSG
+	rx_use_mmsg = udp_tunnel || net_if_type == NET_IF_SLIRP;
+#endif
+	rx_coalesce = PrefsFindInt32("ethercoalesce");
+	if (rx_coalesce < 0)
+		rx_coalesce = 0;
+
 	Set_pthread_attr(&ether_thread_attr, 1);
 	thread_active = (pthread_create(&ether_thread, &ether_thread_attr, receive_func, NULL) == 0);
 	if (!thread_active) {
@@ -181,6 +201,9 @@ static void stop_thread(void)
 #endif
 		pthread_join(slirp_thread, NULL);
 		slirp_thread_active = false;
+#ifdef HAVE_SYS_EPOLL_H
+		slirp_epoll_exit();
+#endif
 	}
 #endif
 
@@ -192,6 +215,10 @@ static void stop_thread(void)
 		sem_destroy(&int_ack);
 		thread_active = false;
 	}
+
+	delete[] rx_ring;
+	rx_ring = NULL;
+	rx_count = 0;
 }
 
 
@@ -272,9 +299,10 @@ bool ether_init(void)
 			return false;
 		}
 
-		// Open slirp output pipe
+		// Open slirp output channel, a datagram socket pair keeps
+		// packet boundaries and lets us receive several at once
 		int fds[2];
-		if (pipe(fds) < 0)
+		if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0)
 			return false;
 		fd = fds[0];
 		slirp_output_fd = fds[1];
@@ -466,6 +494,7 @@ void ether_exit(void)
 	printf("%ld rx packets dropped because no stream found\n", num_rx_dropped);
 	printf("%ld rx packets dropped because stream not ready\n", num_rx_stream_not_ready);
 	printf("%ld rx packets dropped because no memory for unitdata_ind\n", num_rx_no_unitdata_mem);
+	printf("%ld rx message blocks recycled\n", num_rx_recycled);
 #endif
 }
 
@@ -797,10 +826,39 @@ void slirp_output(const uint8 *packet, int len)
 	write(slirp_output_fd, packet, len);
 }
 
+// Pass next packet in the input queue to slirp
+static void slirp_read_input(int slirp_input_fd)
+{
+	int len;
+	read(slirp_input_fd, &len, sizeof(len));
+	uint8 packet[1516];
+	assert(len <= sizeof(packet));
+	read(slirp_input_fd, packet, len);
+	slirp_input(packet, len);
+}
+
 void *slirp_receive_func(void *arg)
 {
 	const int slirp_input_fd = slirp_input_fds[0];
 
+#ifdef HAVE_SYS_EPOLL_H
+	// Wait for the input queue and the slirp sockets at once
+	if (slirp_epoll_init(slirp_input_fd) == 0) {
+		for (;;) {
+			int timeout = slirp_epoll_fill();
+#if ! USE_SLIRP_TIMEOUT
+			timeout = 10000;
+#endif
+			if (slirp_epoll_poll(timeout))
+				slirp_read_input(slirp_input_fd);
+
+#ifdef HAVE_PTHREAD_TESTCANCEL
+			pthread_testcancel();
+#endif
+		}
+	}
+#endif
+
 	for (;;) {
 		// Wait for packets to arrive
 		fd_set rfds, wfds, xfds;
@@ -812,14 +870,8 @@ void *slirp_receive_func(void *arg)
 		FD_SET(slirp_input_fd, &rfds);
 		tv.tv_sec = 0;
 		tv.tv_usec = 0;
-		if (select(slirp_input_fd + 1, &rfds, NULL, NULL, &tv) > 0) {
-			int len;
-			read(slirp_input_fd, &len, sizeof(len));
-			uint8 packet[1516];
-			assert(len <= sizeof(packet));
-			read(slirp_input_fd, packet, len);
-			slirp_input(packet, len);
-		}
+		if (select(slirp_input_fd + 1, &rfds, NULL, NULL, &tv) > 0)
+			slirp_read_input(slirp_input_fd);
 
 		// ... in the output queue
 		nfds = -1;
@@ -859,6 +911,22 @@ void slirp_output(const uint8 *packet, int len)
  *  Packet reception thread
  */
 
+// Read pending packets into the receive ring, as far as it has room
+static void rx_fill(void)
+{
+	rx_count = rx_ring_fill(fd, rx_ring, rx_count, RX_RING_SIZE, rx_read_size, udp_tunnel, rx_use_mmsg);
+}
+
+// Wait for packets to arrive for at most "timeout" usecs, returns > 0 if there are some
+static int rx_wait(int32 timeout)
+{
+	fd_set rfds;
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+	struct timeval tv = { timeout / 1000000, timeout % 1000000 };
+	return select(fd + 1, &rfds, NULL, NULL, &tv);
+}
+
 static void *receive_func(void *arg)
 {
 	for (;;) {
@@ -868,13 +936,9 @@ static void *receive_func(void *arg)
 		struct pollfd pf = {fd, POLLIN, 0};
 		int res = poll(&pf, 1, -1);
 #else
-		fd_set rfds;
-		FD_ZERO(&rfds);
-		FD_SET(fd, &rfds);
 		// A NULL timeout could cause select() to block indefinitely,
 		// even if it is supposed to be a cancellation point [MacOS X]
-		struct timeval tv = { 0, 20000 };
-		int res = select(fd + 1, &rfds, NULL, NULL, &tv);
+		int res = rx_wait(20000);
 #ifdef HAVE_PTHREAD_TESTCANCEL
 		pthread_testcancel();
 #endif
@@ -885,8 +949,22 @@ static void *receive_func(void *arg)
 			break;
 
 		if (ether_driver_opened) {
+			// Collect packets, waiting a bit for more if coalescing interrupts
+			rx_fill();
+			if (rx_coalesce > 0 && rx_count > 0) {
+				uint64 deadline = GetTicks_usec() + rx_coalesce;
+				while (rx_count < RX_RING_SIZE) {
+					uint64 now = GetTicks_usec();
+					if (now >= deadline || rx_wait(deadline - now) <= 0)
+						break;
+					rx_fill();
+				}
+			}
+			if (rx_count == 0)
+				continue;
+
 			// Trigger Ethernet interrupt
-			D(bug(" packet received, triggering Ethernet interrupt\n"));
+			D(bug(" %d packets received, triggering Ethernet interrupt\n", rx_count));
 			SetInterruptFlag(INTFLAG_ETHER);
 
 			// Wait for interrupt acknowledge by EtherInterrupt()
@@ -904,57 +982,52 @@ static void *receive_func(void *arg)
 
 void ether_do_interrupt(void)
 {
-	// Call protocol handler for received packets
+	// Call protocol handler for packets in the receive ring
+#ifndef SHEEPSHAVER
 	EthernetPacket ether_packet;
 	uint32 packet = ether_packet.addr();
-	ssize_t length;
-	for (;;) {
+#endif
+	for (int i = 0; i < rx_count; i++) {
+		rx_packet *rx = &rx_ring[i];
+		ssize_t length = rx->length;
+		if (length < 14)
+			continue;
 
 #ifndef SHEEPSHAVER
 		if (udp_tunnel) {
-
-			// Read packet from socket
-			struct sockaddr_in from;
-			socklen_t from_len = sizeof(from);
-			length = recvfrom(fd, Mac2HostAddr(packet), 1514, 0, (struct sockaddr *)&from, &from_len);
-			if (length < 14)
-				break;
-			ether_udp_read(packet, length, &from);
-
-		} else
-#endif
-		{
-
-			// Read packet from sheep_net device
-#if defined(__linux__)
-			length = read(fd, Mac2HostAddr(packet), net_if_type == NET_IF_ETHERTAP ? 1516 : 1514);
-#else
-			length = read(fd, Mac2HostAddr(packet), 1514);
+			Host2Mac_memcpy(packet, rx->data, length);
+			ether_udp_read(packet, length, &rx->from);
+			continue;
+		}
 #endif
-			if (length < 14)
-				break;
 
 #if MONITOR
-			bug("Receiving Ethernet packet:\n");
-			for (int i=0; i<length; i++) {
-				bug("%02x ", ReadMacInt8(packet + i));
-			}
-			bug("\n");
+		bug("Receiving Ethernet packet:\n");
+		for (int j=0; j<length; j++) {
+			bug("%02x ", rx->data[j]);
+		}
+		bug("\n");
 #endif
 
-			// Pointer to packet data (Ethernet header)
-			uint32 p = packet;
+		// Pointer to packet data (Ethernet header)
+		const uint8 *data = rx->data;
 #if defined(__linux__)
-			if (net_if_type == NET_IF_ETHERTAP) {
-				p += 2;			// Linux ethertap has two random bytes before the packet
-				length -= 2;
-			}
+		if (net_if_type == NET_IF_ETHERTAP) {
+			data += 2;		// Linux ethertap has two random bytes before the packet
+			length -= 2;
+		}
 #endif
 
-			// Dispatch packet
-			ether_dispatch_packet(p, length);
-		}
+#ifdef SHEEPSHAVER
+		// Dispatch packet, the stream module copies it straight into a message block
+		ether_packet_input(data, length);
+#else
+		// Dispatch packet
+		Host2Mac_memcpy(packet, data, length);
+		ether_dispatch_packet(packet, length);
+#endif
 	}
+	rx_count = 0;
 }
 
 // Helper function for port forwarding
@@ -218,21 +218,21 @@ static const ext2type e2t_translation[] = {
 	{NULL, 0, 0}	// End marker
 };
 
-void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
+void get_finfo_host(const char *path, uint8 *finfo, uint8 *fxinfo, bool is_dir)
 {
 	// Set default finder info
-	Mac_memset(finfo, 0, SIZEOF_FInfo);
+	memset(finfo, 0, SIZEOF_FInfo);
 	if (fxinfo)
-		Mac_memset(fxinfo, 0, SIZEOF_FXInfo);
-	WriteMacInt16(finfo + fdFlags, DEFAULT_FINDER_FLAGS);
-	WriteMacInt32(finfo + fdLocation, (uint32)-1);
+		memset(fxinfo, 0, SIZEOF_FXInfo);
+	finfo_put16(finfo + fdFlags, DEFAULT_FINDER_FLAGS);
+	finfo_put32(finfo + fdLocation, (uint32)-1);
 
 	// Read Finder info file
 	int fd = open_finf(path, O_RDONLY);
 	if (fd >= 0) {
-		ssize_t actual = read(fd, Mac2HostAddr(finfo), SIZEOF_FInfo);
+		ssize_t actual = read(fd, finfo, SIZEOF_FInfo);
 		if (fxinfo)
-			actual += read(fd, Mac2HostAddr(fxinfo), SIZEOF_FXInfo);
+			actual += read(fd, fxinfo, SIZEOF_FXInfo);
 		close(fd);
 		if (actual >= SIZEOF_FInfo)
 			return;
@@ -246,14 +246,23 @@ void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
 			if (path_len < ext_len)
 				continue;
 			if (!strcmp(path + path_len - ext_len, e2t_translation[i].ext)) {
-				WriteMacInt32(finfo + fdType, e2t_translation[i].type);
-				WriteMacInt32(finfo + fdCreator, e2t_translation[i].creator);
+				finfo_put32(finfo + fdType, e2t_translation[i].type);
+				finfo_put32(finfo + fdCreator, e2t_translation[i].creator);
 				break;
 			}
 		}
 	}
 }
 
+void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
+{
+	uint8 host_finfo[SIZEOF_FInfo], host_fxinfo[SIZEOF_FXInfo];
+	get_finfo_host(path, host_finfo, fxinfo ? host_fxinfo : NULL, is_dir);
+	Host2Mac_memcpy(finfo, host_finfo, SIZEOF_FInfo);
+	if (fxinfo)
+		Host2Mac_memcpy(fxinfo, host_fxinfo, SIZEOF_FXInfo);
+}
+
 void set_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
 {
 	// Open Finder info file
@@ -42,6 +42,10 @@ prefs_desc platform_prefs_items[] = {
 	{"ignoresegv", TYPE_BOOLEAN, false,    "ignore illegal memory accesses"},
 #endif
 	{"idlewait", TYPE_BOOLEAN, false,      "sleep when idle"},
+	{"diskcache", TYPE_INT32, false,       "size of disk image block cache in KB (0=disabled)"},
+	{"diskoverlay", TYPE_BOOLEAN, false,   "keep disk image writes in memory (saved with savestates)"},
+	{"diskmmap", TYPE_BOOLEAN, false,      "access disk image files through memory mappings"},
+	{"ethercoalesce", TYPE_INT32, false,   "time to collect received packets before interrupting the MacOS (usecs)"},
 	{NULL, TYPE_END, false, NULL} // End of list
 };
 
@@ -139,4 +143,8 @@ void AddPlatformPrefsDefaults(void)
 	PrefsAddBool("ignoresegv", false);
 #endif
 	PrefsAddBool("idlewait", true);
+	PrefsReplaceInt32("diskcache", 4096);
+	PrefsAddBool("diskoverlay", false);
+	PrefsAddBool("diskmmap", false);
+	PrefsAddInt32("ethercoalesce", 0);
 }
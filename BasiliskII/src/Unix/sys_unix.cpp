@@ -92,6 +92,12 @@ struct mac_file_handle {
 
 	bool is_media_present;		// Flag: media is inserted and available
 	disk_generic *generic_disk;
+	bool is_overlay;		// Flag: generic_disk is a copy-on-write overlay
+
+	bool use_cache;		// Flag: accesses go through the block cache
+	loff_t next_offset;	// End of last read (for readahead detection)
+	int readahead;		// Number of blocks to read ahead
+	int write_error;	// Error of the last failed write-back (0: none)
 
 #if defined(__linux__)
 	int cdrom_cap;		// CD-ROM capability flags (only valid if is_cdrom is true)
@@ -123,6 +129,461 @@ static void cdrom_close(mac_file_handle *fh);
 static bool cdrom_open(mac_file_handle *fh, const char *path = NULL);
 
 
+/*
+ *  Block cache for disk image files
+ *
+ *  The Mac issues lots of small synchronous requests. Plain image files
+ *  are accessed through a block cache shared by all open files, which
+ *  detects sequential reads to read ahead, and writes dirty blocks back
+ *  in batches of contiguous blocks. Its size is set by the "diskcache"
+ *  pref (in KB, 0 disables the cache).
+ */
+
+const uint32 DISK_CACHE_BLOCK_SIZE = 32768;		// Must be a power of two
+const int DISK_CACHE_MAX_READAHEAD = 8;			// Maximum number of blocks per I/O
+const uint64 DISK_CACHE_WRITE_BACK_DELAY = 1000000;	// Maximum age of dirty data (usecs)
+
+struct disk_cache_block {
+	mac_file_handle *fh;			// Owner (NULL: free block)
+	loff_t offset;					// Offset of block in file data
+	uint32 size;					// Number of valid bytes (less than a block at end of file)
+	bool dirty;						// Flag: block must be written back
+	disk_cache_block *hash_next;	// Next block in hash chain
+	disk_cache_block *lru_prev;		// LRU list links (most recently used first)
+	disk_cache_block *lru_next;
+	uint8 *data;
+};
+
+static disk_cache_block *disk_cache_blocks = NULL;	// All cache blocks
+static int disk_cache_num_blocks = 0;				// Number of cache blocks
+static disk_cache_block **disk_cache_hash = NULL;	// Hash table of used blocks
+static uint32 disk_cache_hash_mask;
+static disk_cache_block disk_cache_lru;				// LRU list head
+static uint8 *disk_cache_io_buffer = NULL;			// Buffer for multi-block reads
+static uint8 *disk_cache_write_buffer = NULL;		// Buffer for multi-block write-back
+static int disk_cache_num_dirty = 0;				// Number of dirty blocks
+static uint64 disk_cache_dirty_time;				// Time the oldest dirty block was written to
+
+// Statistics
+static struct {
+	uint64 reads;			// Number of blocks accessed by Sys_read()
+	uint64 read_hits;		// Number of those already in the cache
+	uint64 readahead;		// Number of blocks read ahead
+	uint64 writes;			// Number of blocks accessed by Sys_write()
+	uint64 write_hits;		// Number of those already in the cache
+	uint64 write_backs;		// Number of write system calls to write back dirty blocks
+} disk_cache_stats;
+
+#ifdef HAVE_PTHREADS
+static pthread_mutex_t disk_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t disk_cache_thread;					// Write-back thread
+static bool disk_cache_thread_active = false;		// Flag: write-back thread installed
+static volatile bool disk_cache_thread_cancel;		// Flag: cancel write-back thread
+#define LOCK_DISK_CACHE pthread_mutex_lock(&disk_cache_lock)
+#define UNLOCK_DISK_CACHE pthread_mutex_unlock(&disk_cache_lock)
+#else
+#define LOCK_DISK_CACHE
+#define UNLOCK_DISK_CACHE
+#endif
+
+static inline uint32 disk_cache_hash_index(mac_file_handle *fh, loff_t offset)
+{
+	return ((uint32)((uintptr)fh >> 4) * 2654435761U ^ (uint32)(offset / DISK_CACHE_BLOCK_SIZE)) & disk_cache_hash_mask;
+}
+
+static disk_cache_block *disk_cache_find(mac_file_handle *fh, loff_t offset)
+{
+	for (disk_cache_block *b = disk_cache_hash[disk_cache_hash_index(fh, offset)]; b; b = b->hash_next) {
+		if (b->fh == fh && b->offset == offset)
+			return b;
+	}
+	return NULL;
+}
+
+static inline void disk_cache_lru_remove(disk_cache_block *b)
+{
+	b->lru_prev->lru_next = b->lru_next;
+	b->lru_next->lru_prev = b->lru_prev;
+}
+
+static inline void disk_cache_lru_insert(disk_cache_block *b)
+{
+	b->lru_next = disk_cache_lru.lru_next;
+	b->lru_prev = &disk_cache_lru;
+	disk_cache_lru.lru_next->lru_prev = b;
+	disk_cache_lru.lru_next = b;
+}
+
+static inline void disk_cache_touch(disk_cache_block *b)
+{
+	disk_cache_lru_remove(b);
+	disk_cache_lru_insert(b);
+}
+
+static void disk_cache_unhash(disk_cache_block *b)
+{
+	disk_cache_block **bp = &disk_cache_hash[disk_cache_hash_index(b->fh, b->offset)];
+	while (*bp != b)
+		bp = &(*bp)->hash_next;
+	*bp = b->hash_next;
+	b->fh = NULL;
+}
+
+static int disk_cache_compare_blocks(const void *a, const void *b)
+{
+	const disk_cache_block *ba = *(const disk_cache_block * const *)a;
+	const disk_cache_block *bb = *(const disk_cache_block * const *)b;
+	if (ba->fh != bb->fh)
+		return (uintptr)ba->fh < (uintptr)bb->fh ? -1 : 1;
+	if (ba->offset != bb->offset)
+		return ba->offset < bb->offset ? -1 : 1;
+	return 0;
+}
+
+// Write back dirty blocks of the specified file (or all files if fh is NULL).
+// Blocks that fail to be written stay dirty to be retried later, and the
+// error is reported by the next Sys_write() on their file.
+static void disk_cache_flush(mac_file_handle *fh)
+{
+	if (disk_cache_num_dirty == 0)
+		return;
+
+	disk_cache_block **dirty = new disk_cache_block *[disk_cache_num_dirty];
+	int n = 0;
+	for (int i = 0; i < disk_cache_num_blocks; i++) {
+		disk_cache_block *b = &disk_cache_blocks[i];
+		if (b->dirty && (fh == NULL || b->fh == fh))
+			dirty[n++] = b;
+	}
+	qsort(dirty, n, sizeof(dirty[0]), disk_cache_compare_blocks);
+
+	// Coalesce runs of contiguous blocks into a single write
+	bool failed = false;
+	for (int i = 0; i < n; ) {
+		int j = i + 1;
+		while (j < n && j - i < DISK_CACHE_MAX_READAHEAD && dirty[j]->fh == dirty[i]->fh
+			   && dirty[j]->offset == dirty[j - 1]->offset + DISK_CACHE_BLOCK_SIZE
+			   && dirty[j - 1]->size == DISK_CACHE_BLOCK_SIZE)
+			j++;
+		mac_file_handle *bfh = dirty[i]->fh;
+		size_t length = 0;
+		ssize_t actual;
+		if (j - i == 1) {
+			length = dirty[i]->size;
+			actual = pwrite(bfh->fd, dirty[i]->data, length, dirty[i]->offset + bfh->start_byte);
+		} else {
+			for (int k = i; k < j; k++) {
+				memcpy(disk_cache_write_buffer + length, dirty[k]->data, dirty[k]->size);
+				length += dirty[k]->size;
+			}
+			actual = pwrite(bfh->fd, disk_cache_write_buffer, length, dirty[i]->offset + bfh->start_byte);
+		}
+		disk_cache_stats.write_backs++;
+		if (actual != (ssize_t)length) {
+			bfh->write_error = actual < 0 ? errno : EIO;
+			D(bug("disk cache: write-back failed: %s\n", strerror(bfh->write_error)));
+			failed = true;
+		} else {
+			for (int k = i; k < j; k++)
+				dirty[k]->dirty = false;
+			disk_cache_num_dirty -= j - i;
+		}
+		i = j;
+	}
+	delete[] dirty;
+
+	// Retry failed blocks after the write-back delay
+	if (failed)
+		disk_cache_dirty_time = GetTicks_usec();
+}
+
+// Drop all blocks of the specified file, after writing back dirty ones
+static void disk_cache_invalidate(mac_file_handle *fh)
+{
+	disk_cache_flush(fh);
+	for (int i = 0; i < disk_cache_num_blocks; i++) {
+		disk_cache_block *b = &disk_cache_blocks[i];
+		if (b->fh == fh) {
+			if (b->dirty) {
+				D(bug("disk cache: dropping block at %lld after failed write-back\n", (long long)b->offset));
+				b->dirty = false;
+				disk_cache_num_dirty--;
+			}
+			disk_cache_unhash(b);
+			disk_cache_lru_remove(b);	// Reuse it first
+			b->lru_prev = disk_cache_lru.lru_prev;
+			b->lru_next = &disk_cache_lru;
+			disk_cache_lru.lru_prev->lru_next = b;
+			disk_cache_lru.lru_prev = b;
+		}
+	}
+}
+
+// Allocate a block for the specified file data, evicting the least recently used one
+static disk_cache_block *disk_cache_alloc(mac_file_handle *fh, loff_t offset, uint32 size)
+{
+	disk_cache_block *b = disk_cache_lru.lru_prev;
+	if (b->dirty)
+		disk_cache_flush(b->fh);
+
+	// Blocks that could not be written back must not be evicted
+	while (b != &disk_cache_lru && b->dirty)
+		b = b->lru_prev;
+	if (b == &disk_cache_lru)
+		return NULL;
+	if (b->fh)
+		disk_cache_unhash(b);
+	b->fh = fh;
+	b->offset = offset;
+	b->size = size;
+	uint32 h = disk_cache_hash_index(fh, offset);
+	b->hash_next = disk_cache_hash[h];
+	disk_cache_hash[h] = b;
+	disk_cache_touch(b);
+	return b;
+}
+
+// Read "count" blocks starting at "offset" into the cache, skipping blocks already cached
+static bool disk_cache_fill(mac_file_handle *fh, loff_t offset, int count)
+{
+	loff_t end = offset + (loff_t)count * DISK_CACHE_BLOCK_SIZE;
+	if (end > fh->file_size)
+		end = fh->file_size;
+	if (offset >= end)
+		return false;
+	ssize_t actual = pread(fh->fd, disk_cache_io_buffer, end - offset, offset + fh->start_byte);
+	if (actual <= 0)
+		return false;
+	for (loff_t pos = 0; pos < actual; pos += DISK_CACHE_BLOCK_SIZE) {
+		if (disk_cache_find(fh, offset + pos))
+			continue;
+		uint32 size = actual - pos < DISK_CACHE_BLOCK_SIZE ? actual - pos : DISK_CACHE_BLOCK_SIZE;
+		disk_cache_block *b = disk_cache_alloc(fh, offset + pos, size);
+		if (b == NULL)
+			break;
+		memcpy(b->data, disk_cache_io_buffer + pos, size);
+	}
+	return true;
+}
+
+static void disk_cache_mark_dirty(disk_cache_block *b)
+{
+	if (!b->dirty) {
+		if (disk_cache_num_dirty == 0)
+			disk_cache_dirty_time = GetTicks_usec();
+		b->dirty = true;
+		disk_cache_num_dirty++;
+	}
+}
+
+static size_t disk_cache_read(mac_file_handle *fh, uint8 *buffer, loff_t offset, size_t length)
+{
+	if (offset >= fh->file_size)
+		return 0;
+	if (length > fh->file_size - offset)
+		length = fh->file_size - offset;
+
+	// Detect sequential reads
+	if (offset == fh->next_offset) {
+		if (fh->readahead < DISK_CACHE_MAX_READAHEAD)
+			fh->readahead = fh->readahead ? fh->readahead * 2 : 1;
+	} else
+		fh->readahead = 0;
+	fh->next_offset = offset + length;
+
+	// Large requests bypass the cache but must see dirty blocks
+	if (length > (size_t)DISK_CACHE_MAX_READAHEAD * DISK_CACHE_BLOCK_SIZE) {
+		ssize_t actual = pread(fh->fd, buffer, length, offset + fh->start_byte);
+		if (actual <= 0)
+			return 0;
+		for (loff_t pos = offset & ~(loff_t)(DISK_CACHE_BLOCK_SIZE - 1); pos < offset + actual; pos += DISK_CACHE_BLOCK_SIZE) {
+			disk_cache_block *b = disk_cache_find(fh, pos);
+			if (b && b->dirty) {
+				loff_t start = pos < offset ? offset : pos;
+				loff_t end = pos + b->size < offset + actual ? pos + b->size : offset + actual;
+				memcpy(buffer + (start - offset), b->data + (start - pos), end - start);
+			}
+		}
+		return actual;
+	}
+
+	size_t done = 0;
+	while (done < length) {
+		loff_t pos = offset + done;
+		loff_t block_offset = pos & ~(loff_t)(DISK_CACHE_BLOCK_SIZE - 1);
+		disk_cache_block *b = disk_cache_find(fh, block_offset);
+		disk_cache_stats.reads++;
+		if (b)
+			disk_cache_stats.read_hits++;
+		else {
+			// Read all missing blocks of the request at once, plus readahead
+			int count = 1;
+			loff_t last = (offset + length - 1) & ~(loff_t)(DISK_CACHE_BLOCK_SIZE - 1);
+			while (block_offset + (loff_t)count * DISK_CACHE_BLOCK_SIZE <= last && count < DISK_CACHE_MAX_READAHEAD
+				   && disk_cache_find(fh, block_offset + (loff_t)count * DISK_CACHE_BLOCK_SIZE) == NULL)
+				count++;
+			if (block_offset + (loff_t)count * DISK_CACHE_BLOCK_SIZE > last) {
+				int readahead = fh->readahead;
+				if (count + readahead > DISK_CACHE_MAX_READAHEAD)
+					readahead = DISK_CACHE_MAX_READAHEAD - count;
+				count += readahead;
+				disk_cache_stats.readahead += readahead;
+			}
+			if (!disk_cache_fill(fh, block_offset, count) || (b = disk_cache_find(fh, block_offset)) == NULL)
+				break;
+		}
+		disk_cache_touch(b);
+		uint32 block_pos = pos - block_offset;
+		if (block_pos >= b->size)
+			break;
+		size_t n = b->size - block_pos;
+		if (n > length - done)
+			n = length - done;
+		memcpy(buffer + done, b->data + block_pos, n);
+		done += n;
+	}
+	return done;
+}
+
+static size_t disk_cache_write(mac_file_handle *fh, const uint8 *buffer, loff_t offset, size_t length)
+{
+	if (offset >= fh->file_size)
+		return 0;
+	if (length > fh->file_size - offset)
+		length = fh->file_size - offset;
+	fh->readahead = 0;
+
+	// Large requests bypass the cache, cached blocks are updated
+	if (length > (size_t)DISK_CACHE_MAX_READAHEAD * DISK_CACHE_BLOCK_SIZE) {
+		ssize_t actual = pwrite(fh->fd, buffer, length, offset + fh->start_byte);
+		if (actual <= 0)
+			return 0;
+		for (loff_t pos = offset & ~(loff_t)(DISK_CACHE_BLOCK_SIZE - 1); pos < offset + actual; pos += DISK_CACHE_BLOCK_SIZE) {
+			disk_cache_block *b = disk_cache_find(fh, pos);
+			if (b) {
+				loff_t start = pos < offset ? offset : pos;
+				loff_t end = pos + b->size < offset + actual ? pos + b->size : offset + actual;
+				memcpy(b->data + (start - pos), buffer + (start - offset), end - start);
+			}
+		}
+		return actual;
+	}
+
+	size_t done = 0;
+	while (done < length) {
+		loff_t pos = offset + done;
+		loff_t block_offset = pos & ~(loff_t)(DISK_CACHE_BLOCK_SIZE - 1);
+		uint32 block_pos = pos - block_offset;
+		uint32 block_size = fh->file_size - block_offset < DISK_CACHE_BLOCK_SIZE ? fh->file_size - block_offset : DISK_CACHE_BLOCK_SIZE;
+		size_t n = block_size - block_pos;
+		if (n > length - done)
+			n = length - done;
+		disk_cache_block *b = disk_cache_find(fh, block_offset);
+		disk_cache_stats.writes++;
+		if (b)
+			disk_cache_stats.write_hits++;
+		else if (block_pos == 0 && n == block_size)
+			b = disk_cache_alloc(fh, block_offset, block_size);	// Overwritten entirely, no need to read it
+		else if (!disk_cache_fill(fh, block_offset, 1))
+			break;
+		else
+			b = disk_cache_find(fh, block_offset);
+		if (b == NULL)
+			break;
+		disk_cache_touch(b);
+		memcpy(b->data + block_pos, buffer + done, n);
+		disk_cache_mark_dirty(b);
+		done += n;
+	}
+
+	// Don't let dirty blocks accumulate
+	if (disk_cache_num_dirty > disk_cache_num_blocks / 2)
+		disk_cache_flush(NULL);
+	return done;
+}
+
+#ifdef HAVE_PTHREADS
+// Write-back thread, dirty blocks are not kept around for too long
+static void *disk_cache_func(void *arg)
+{
+	while (!disk_cache_thread_cancel) {
+		Delay_usec(100000);
+		LOCK_DISK_CACHE;
+		if (disk_cache_num_dirty && GetTicks_usec() - disk_cache_dirty_time >= DISK_CACHE_WRITE_BACK_DELAY)
+			disk_cache_flush(NULL);
+		UNLOCK_DISK_CACHE;
+	}
+	return NULL;
+}
+#endif
+
+static void disk_cache_init(void)
+{
+	int32 size = PrefsFindInt32("diskcache");
+	disk_cache_num_blocks = size > 0 ? (size * 1024) / DISK_CACHE_BLOCK_SIZE : 0;
+	if (disk_cache_num_blocks < DISK_CACHE_MAX_READAHEAD) {
+		disk_cache_num_blocks = 0;
+		return;
+	}
+
+	disk_cache_blocks = new disk_cache_block[disk_cache_num_blocks];
+	uint8 *data = new uint8[(size_t)disk_cache_num_blocks * DISK_CACHE_BLOCK_SIZE];
+	disk_cache_io_buffer = new uint8[DISK_CACHE_MAX_READAHEAD * DISK_CACHE_BLOCK_SIZE];
+	disk_cache_write_buffer = new uint8[DISK_CACHE_MAX_READAHEAD * DISK_CACHE_BLOCK_SIZE];
+	uint32 hash_size = 1;
+	while (hash_size < (uint32)disk_cache_num_blocks)
+		hash_size <<= 1;
+	disk_cache_hash = new disk_cache_block *[hash_size];
+	memset(disk_cache_hash, 0, hash_size * sizeof(disk_cache_hash[0]));
+	disk_cache_hash_mask = hash_size - 1;
+
+	disk_cache_lru.lru_next = disk_cache_lru.lru_prev = &disk_cache_lru;
+	for (int i = 0; i < disk_cache_num_blocks; i++) {
+		disk_cache_block *b = &disk_cache_blocks[i];
+		b->fh = NULL;
+		b->dirty = false;
+		b->data = data + (size_t)i * DISK_CACHE_BLOCK_SIZE;
+		disk_cache_lru_insert(b);
+	}
+	memset(&disk_cache_stats, 0, sizeof(disk_cache_stats));
+	D(bug("Disk cache: %d blocks of %d bytes\n", disk_cache_num_blocks, DISK_CACHE_BLOCK_SIZE));
+
+#ifdef HAVE_PTHREADS
+	disk_cache_thread_cancel = false;
+	disk_cache_thread_active = (pthread_create(&disk_cache_thread, NULL, disk_cache_func, NULL) == 0);
+#endif
+}
+
+static void disk_cache_exit(void)
+{
+	if (disk_cache_num_blocks == 0)
+		return;
+
+#ifdef HAVE_PTHREADS
+	if (disk_cache_thread_active) {
+		disk_cache_thread_cancel = true;
+		pthread_join(disk_cache_thread, NULL);
+		disk_cache_thread_active = false;
+	}
+#endif
+
+	disk_cache_flush(NULL);
+	D(bug("Disk cache: %llu/%llu read hits, %llu blocks read ahead, %llu/%llu write hits, %llu writes\n",
+		  (unsigned long long)disk_cache_stats.read_hits, (unsigned long long)disk_cache_stats.reads,
+		  (unsigned long long)disk_cache_stats.readahead,
+		  (unsigned long long)disk_cache_stats.write_hits, (unsigned long long)disk_cache_stats.writes,
+		  (unsigned long long)disk_cache_stats.write_backs));
+
+	delete[] disk_cache_blocks[0].data;
+	delete[] disk_cache_blocks;
+	delete[] disk_cache_hash;
+	delete[] disk_cache_io_buffer;
+	delete[] disk_cache_write_buffer;
+	disk_cache_blocks = NULL;
+	disk_cache_num_blocks = 0;
+}
+
+
 /*
  *  Initialization
  */
@@ -133,6 +594,7 @@ void SysInit(void)
 	extern void DarwinSysInit(void);
 	DarwinSysInit();
 #endif
+	disk_cache_init();
 }
 
 
@@ -142,6 +604,7 @@ void SysInit(void)
 
 void SysExit(void)
 {
+	disk_cache_exit();
 #if defined __MACOSX__
 	extern void DarwinSysExit(void);
 	DarwinSysExit();
@@ -617,6 +1080,10 @@ void *Sys_open(const char *name, bool read_only)
 			fh->file_size = generic->size();
 			fh->read_only = generic->is_read_only();
 			fh->is_media_present = true;
+			if (!fh->read_only && PrefsFindBool("diskoverlay")) {
+				fh->generic_disk = disk_overlay_create(generic);
+				fh->is_overlay = true;
+			}
 			sys_add_mac_file_handle(fh);
 			return fh;
 		}
@@ -664,6 +1131,20 @@ void *Sys_open(const char *name, bool read_only)
 			lseek(fd, 0, SEEK_SET);
 			read(fd, data, 256);
 			FileDiskLayout(size, data, fh->start_byte, fh->file_size);
+			bool use_mmap = PrefsFindBool("diskmmap");
+			if (!read_only && PrefsFindBool("diskoverlay")) {
+				// Writes go to the overlay, the image file is left untouched
+				disk_generic *base = NULL;
+				if (use_mmap)
+					base = disk_mmap_create(fd, fh->start_byte, fh->file_size, true);
+				if (base == NULL)
+					base = disk_plain_create(fd, fh->start_byte, fh->file_size, true);
+				fh->generic_disk = disk_overlay_create(base);
+				fh->is_overlay = true;
+			} else if (use_mmap)
+				fh->generic_disk = disk_mmap_create(fd, fh->start_byte, fh->file_size, read_only);
+			fh->use_cache = (disk_cache_num_blocks != 0) && fh->generic_disk == NULL;
+			fh->next_offset = -1;
 		} else {
 			struct stat st;
 			if (fstat(fd, &st) == 0) {
@@ -712,6 +1193,106 @@ void *Sys_open(const char *name, bool read_only)
 }
 
 
+/*
+ *  Save/restore contents of disk overlays with a savestate (returns false on error)
+ *
+ *  The section starts with a magic number, a version and the size of the
+ *  data that follows, so that a section that can't be restored is skipped
+ *  as a whole, and savestates without it are still accepted.
+ */
+
+const uint32 DISK_STATE_MAGIC = 0x444f564c;	// 'DOVL'
+const uint32 DISK_STATE_VERSION = 1;
+
+struct disk_state_header {
+	uint32 magic;
+	uint32 version;
+	uint64 length;		// Size of section data following the header
+};
+
+bool SysSaveDiskState(int fd)
+{
+	off_t start = lseek(fd, 0, SEEK_CUR);
+	if (start == -1)
+		return false;
+	disk_state_header header = { DISK_STATE_MAGIC, DISK_STATE_VERSION, 0 };
+	if (write(fd, &header, sizeof(header)) != sizeof(header))
+		return false;
+
+	uint32 count = 0;
+	for (open_mac_file_handle *p = open_mac_file_handles; p; p = p->next) {
+		if (p->fh->is_overlay)
+			count++;
+	}
+	if (write(fd, &count, sizeof(count)) != sizeof(count))
+		return false;
+
+	for (open_mac_file_handle *p = open_mac_file_handles; p; p = p->next) {
+		mac_file_handle *fh = p->fh;
+		if (!fh->is_overlay)
+			continue;
+		uint32 name_length = strlen(fh->name);
+		if (write(fd, &name_length, sizeof(name_length)) != sizeof(name_length)
+		 || write(fd, fh->name, name_length) != (ssize_t)name_length
+		 || !disk_overlay_save(fh->generic_disk, fd))
+			return false;
+	}
+
+	// Fill in the section size
+	off_t end = lseek(fd, 0, SEEK_CUR);
+	if (end == -1)
+		return false;
+	header.length = end - start - sizeof(header);
+	return pwrite(fd, &header, sizeof(header), start) == sizeof(header);
+}
+
+static bool load_disk_overlays(int fd)
+{
+	uint32 count;
+	if (read(fd, &count, sizeof(count)) != sizeof(count))
+		return false;
+
+	while (count--) {
+		uint32 name_length;
+		if (read(fd, &name_length, sizeof(name_length)) != sizeof(name_length) || name_length >= PATH_MAX)
+			return false;
+		char name[PATH_MAX];
+		if (read(fd, name, name_length) != (ssize_t)name_length)
+			return false;
+		name[name_length] = 0;
+
+		// Disks that are not open any more are skipped
+		disk_generic *overlay = NULL;
+		for (open_mac_file_handle *p = open_mac_file_handles; p; p = p->next) {
+			if (p->fh->is_overlay && strcmp(p->fh->name, name) == 0)
+				overlay = p->fh->generic_disk;
+		}
+		if (!disk_overlay_load(overlay, fd))
+			return false;
+	}
+	return true;
+}
+
+bool SysLoadDiskState(int fd)
+{
+	off_t start = lseek(fd, 0, SEEK_CUR);
+	if (start == -1)
+		return false;
+	disk_state_header header;
+	if (read(fd, &header, sizeof(header)) != sizeof(header) || header.magic != DISK_STATE_MAGIC) {
+		// Savestate from a version without disk overlays
+		D(bug("No disk overlays in savestate\n"));
+		return lseek(fd, start, SEEK_SET) != -1;
+	}
+
+	// Overlays that failed to load are left untouched, skip the rest of the section
+	bool ok = header.version == DISK_STATE_VERSION && load_disk_overlays(fd);
+	if (lseek(fd, start + sizeof(header) + header.length, SEEK_SET) == -1)
+		return false;
+	return ok;
+}
+
+
 /*
  *  Close file/device, delete file handle
  */
@@ -731,6 +1312,12 @@ void Sys_close(void *arg)
 	if (fh->generic_disk)
 		delete fh->generic_disk;
 
+	if (fh->use_cache) {
+		LOCK_DISK_CACHE;
+		disk_cache_invalidate(fh);
+		UNLOCK_DISK_CACHE;
+	}
+
 	if (fh->is_cdrom)
 		cdrom_close(fh);
 	if (fh->fd >= 0)
@@ -759,13 +1346,17 @@ size_t Sys_read(void *arg, void *buffer, loff_t offset, size_t length)
 
 	if (fh->generic_disk)
 		return fh->generic_disk->read(buffer, offset, length);
-	
-	// Seek to position
-	if (lseek(fh->fd, offset + fh->start_byte, SEEK_SET) < 0)
-		return 0;
+
+	if (fh->use_cache) {
+		LOCK_DISK_CACHE;
+		size_t actual = disk_cache_read(fh, (uint8 *)buffer, offset, length);
+		UNLOCK_DISK_CACHE;
+		return actual;
+	}
 
 	// Read data
-	return read(fh->fd, buffer, length);
+	ssize_t actual = pread(fh->fd, buffer, length, offset + fh->start_byte);
+	return actual < 0 ? 0 : actual;
 }
 
 
@@ -783,12 +1374,20 @@ size_t Sys_write(void *arg, void *buffer, loff_t offset, size_t length)
 	if (fh->generic_disk)
 		return fh->generic_disk->write(buffer, offset, length);
 
-	// Seek to position
-	if (lseek(fh->fd, offset + fh->start_byte, SEEK_SET) < 0)
-		return 0;
+	if (fh->use_cache) {
+		LOCK_DISK_CACHE;
+		size_t actual = 0;
+		if (fh->write_error)
+			fh->write_error = 0;	// Report the failed write-back of earlier data
+		else
+			actual = disk_cache_write(fh, (const uint8 *)buffer, offset, length);
+		UNLOCK_DISK_CACHE;
+		return actual;
+	}
 
 	// Write data
-	return write(fh->fd, buffer, length);
+	ssize_t actual = pwrite(fh->fd, buffer, length, offset + fh->start_byte);
+	return actual < 0 ? 0 : actual;
 }
 
 
@@ -42,12 +42,17 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 
 #ifndef WIN32
 #include <unistd.h>
 #include <dirent.h>
 #endif
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #if defined __APPLE__ && defined __MACH__
 #include <sys/attr.h>
 #endif
@@ -152,9 +157,14 @@ const uint8 ExtFSIcon[256] = {
 };
 
 
+struct dir_cache;
+
 // These objects are used to map CNIDs to path names
 struct FSItem {
 	FSItem *next;			// Pointer to next FSItem in list
+	FSItem *id_next;		// Next FSItem in CNID hash chain
+	FSItem *name_next;		// Next FSItem in (parent, name) hash chain
+	FSItem *guest_next;		// Next FSItem in (parent, guest_name) hash chain
 	uint32 id;				// CNID of this file/dir
 	uint32 parent_id;		// CNID of parent file/dir
 	FSItem *parent;			// Pointer to parent
@@ -162,12 +172,22 @@ struct FSItem {
 	char guest_name[32];	// Object name (C string) - Guest OS
 	time_t mtime;			// Modification time for get_cat_info caching
 	int cache_dircount;		// Cached number of files in directory
+	dir_cache *enumeration;	// Cached directory contents for indexed lookups
 };
 
 static FSItem *first_fs_item, *last_fs_item;
 
 static uint32 next_cnid = fsUsrCNID;	// Next available CNID
 
+// Hash tables for FSItem lookups. All tables have the same size, which
+// grows with the number of FSItems. FSItems are never deleted (the Mac
+// may hold on to any CNID it has seen), so entries don't go stale.
+const uint32 FSITEM_HASH_INITIAL_SIZE = 1024;
+
+static FSItem **fsitem_id_hash, **fsitem_name_hash, **fsitem_guest_hash;
+static uint32 fsitem_hash_size;		// Number of buckets per table (power of two)
+static uint32 num_fs_items;			// Number of FSItems
+
 
 /*
  *  Get object creation time
@@ -207,17 +227,118 @@ static uint32 get_creation_time(const char *path)
 #endif
 
 
+/*
+ *  FSItem hash tables
+ */
+
+static inline uint32 fsitem_id_hash_index(uint32 cnid)
+{
+	return (cnid * 2654435761U) & (fsitem_hash_size - 1);
+}
+
+static inline uint32 fsitem_name_hash_index(const FSItem *parent, const char *name)
+{
+	uint32 h = 2166136261U ^ (uint32)((uintptr)parent >> 3);
+	while (*name)
+		h = (h ^ (uint8)*name++) * 16777619U;
+	return h & (fsitem_hash_size - 1);
+}
+
+static FSItem *find_fsitem_by_name(const char *name, FSItem *parent)
+{
+	for (FSItem *p = fsitem_name_hash[fsitem_name_hash_index(parent, name)]; p; p = p->name_next) {
+		if (p->parent == parent && !strcmp(p->name, name))
+			return p;
+	}
+	return NULL;
+}
+
+static FSItem *find_fsitem_by_guest_name(const char *guest_name, FSItem *parent)
+{
+	for (FSItem *p = fsitem_guest_hash[fsitem_name_hash_index(parent, guest_name)]; p; p = p->guest_next) {
+		if (p->parent == parent && !strcmp(p->guest_name, guest_name))
+			return p;
+	}
+	return NULL;
+}
+
+static void hash_fsitem_id(FSItem *p)
+{
+	uint32 i = fsitem_id_hash_index(p->id);
+	p->id_next = fsitem_id_hash[i];
+	fsitem_id_hash[i] = p;
+}
+
+static void unhash_fsitem_id(FSItem *p)
+{
+	FSItem **q = &fsitem_id_hash[fsitem_id_hash_index(p->id)];
+	while (*q != p)
+		q = &(*q)->id_next;
+	*q = p->id_next;
+}
+
+// Add FSItem to hash tables (names and parents of FSItems never change)
+static void hash_fsitem(FSItem *p)
+{
+	hash_fsitem_id(p);
+
+	// If names are duplicated, lookups return the oldest FSItem
+	p->name_next = p->guest_next = NULL;
+	if (p->parent && find_fsitem_by_name(p->name, p->parent) == NULL) {
+		uint32 i = fsitem_name_hash_index(p->parent, p->name);
+		p->name_next = fsitem_name_hash[i];
+		fsitem_name_hash[i] = p;
+	}
+	if (p->parent && find_fsitem_by_guest_name(p->guest_name, p->parent) == NULL) {
+		uint32 i = fsitem_name_hash_index(p->parent, p->guest_name);
+		p->guest_next = fsitem_guest_hash[i];
+		fsitem_guest_hash[i] = p;
+	}
+}
+
+static void alloc_fsitem_hash(uint32 size)
+{
+	delete[] fsitem_id_hash;
+	delete[] fsitem_name_hash;
+	delete[] fsitem_guest_hash;
+	fsitem_hash_size = size;
+	fsitem_id_hash = new FSItem *[size];
+	fsitem_name_hash = new FSItem *[size];
+	fsitem_guest_hash = new FSItem *[size];
+	memset(fsitem_id_hash, 0, size * sizeof(FSItem *));
+	memset(fsitem_name_hash, 0, size * sizeof(FSItem *));
+	memset(fsitem_guest_hash, 0, size * sizeof(FSItem *));
+}
+
+// Add new FSItem to list and hash tables
+static void add_fsitem(FSItem *p)
+{
+	p->next = NULL;
+	if (last_fs_item)
+		last_fs_item->next = p;
+	else
+		first_fs_item = p;
+	last_fs_item = p;
+
+	if (++num_fs_items > fsitem_hash_size) {
+		// Grow hash tables, rehash in list order so the oldest duplicates stay visible
+		alloc_fsitem_hash(fsitem_hash_size * 2);
+		for (FSItem *q = first_fs_item; q; q = q->next)
+			hash_fsitem(q);
+	} else
+		hash_fsitem(p);
+}
+
+
 /*
  *  Find FSItem for given CNID
  */
 
 static FSItem *find_fsitem_by_id(uint32 cnid)
 {
-	FSItem *p = first_fs_item;
-	while (p) {
+	for (FSItem *p = fsitem_id_hash[fsitem_id_hash_index(cnid)]; p; p = p->id_next) {
 		if (p->id == cnid)
 			return p;
-		p = p->next;
 	}
 	return NULL;
 }
@@ -229,9 +350,6 @@ static FSItem *find_fsitem_by_id(uint32 cnid)
 static FSItem *create_fsitem(const char *name, const char *guest_name, FSItem *parent)
 {
 	FSItem *p = new FSItem;
-	last_fs_item->next = p;
-	p->next = NULL;
-	last_fs_item = p;
 	p->id = next_cnid++;
 	p->parent_id = parent->id;
 	p->parent = parent;
@@ -240,6 +358,8 @@ static FSItem *create_fsitem(const char *name, const char *guest_name, FSItem *p
 	strncpy(p->guest_name, guest_name, 31);
 	p->guest_name[31] = 0;
 	p->mtime = 0;
+	p->enumeration = NULL;
+	add_fsitem(p);
 	return p;
 }
 
@@ -249,12 +369,9 @@ static FSItem *create_fsitem(const char *name, const char *guest_name, FSItem *p
 
 static FSItem *find_fsitem(const char *name, FSItem *parent)
 {
-	FSItem *p = first_fs_item;
-	while (p) {
-		if (p->parent == parent && !strcmp(p->name, name))
-			return p;
-		p = p->next;
-	}
+	FSItem *p = find_fsitem_by_name(name, parent);
+	if (p)
+		return p;
 
 	// Not found, construct new FSItem
 	return create_fsitem(name, host_encoding_to_macroman(name), parent);
@@ -266,12 +383,9 @@ static FSItem *find_fsitem(const char *name, FSItem *parent)
 
 static FSItem *find_fsitem_guest(const char *guest_name, FSItem *parent)
 {
-	FSItem *p = first_fs_item;
-	while (p) {
-		if (p->parent == parent && !strcmp(p->guest_name, guest_name))
-			return p;
-		p = p->next;
-	}
+	FSItem *p = find_fsitem_by_guest_name(guest_name, parent);
+	if (p)
+		return p;
 
 	// Not found, construct new FSItem
 	return create_fsitem(macroman_to_host_encoding(guest_name), guest_name, parent);
@@ -303,11 +417,12 @@ static void get_path_for_fsitem(FSItem *p)
 
 
 /*
- *  Exchange parent CNIDs in all FSItems
+ *  Exchange CNIDs of two FSItems (and parent CNIDs in all FSItems)
  */
 
-static void swap_parent_ids(uint32 parent1, uint32 parent2)
+static void swap_fsitem_ids(FSItem *item1, FSItem *item2)
 {
+	uint32 parent1 = item1->id, parent2 = item2->id;
 	FSItem *p = first_fs_item;
 	while (p) {
 		if (p->parent_id == parent1)
@@ -316,6 +431,542 @@ static void swap_parent_ids(uint32 parent1, uint32 parent2)
 			p->parent_id = parent1;
 		p = p->next;
 	}
+
+	unhash_fsitem_id(item1);
+	unhash_fsitem_id(item2);
+	item1->id = parent2;
+	item2->id = parent1;
+	hash_fsitem_id(item1);
+	hash_fsitem_id(item2);
+}
+
+
+/*
+ *  Directory enumeration cache
+ *
+ *  Indexed GetCatInfo/GetFileInfo calls used to read the directory up to
+ *  the requested index, so enumerating a directory took O(n^2) readdir()
+ *  calls. The first indexed call now takes a sorted snapshot of the
+ *  directory, and the stat(), Finder info and resource fork size of each
+ *  entry are kept once they have been looked up.
+ *
+ *  A snapshot is dropped when the directory's mtime changes, when ExtFS
+ *  modifies the volume, or after DIR_CACHE_LIFETIME seconds (changes of
+ *  file contents by the host don't change the directory's mtime).
+ *
+ *  The metadata of larger snapshots is prefetched by a pool of threads,
+ *  so host filesystem latency (e.g. of network shares) is overlapped.
+ *  An entry being prefetched is not touched by the emulation thread
+ *  until the prefetch thread is done with it, and entries the emulation
+ *  thread gets to first are skipped by the prefetch threads.
+ */
+
+const int DIR_CACHE_LIFETIME = 3;		// Maximum age of a snapshot (seconds)
+const int DIR_CACHE_MAX_DIRS = 16;		// Maximum number of cached directories
+const int DIR_PREFETCH_THREADS = 4;		// Number of metadata prefetch threads
+const int DIR_PREFETCH_MIN_ENTRIES = 16;	// Smaller directories are not prefetched
+
+// Prefetch state of directory entries
+enum {
+	ENTRY_PENDING,				// Not looked at yet
+	ENTRY_PREFETCHING,			// Being filled in by a prefetch thread
+	ENTRY_READY					// Owned by the emulation thread
+};
+
+struct dir_entry {
+	char *name;					// Host name
+	FSItem *item;				// FSItem, or NULL if not looked up yet
+	int state;					// Prefetch state
+	bool have_stat;				// Flag: st is valid
+	bool have_finfo;			// Flag: finfo is valid
+	bool have_fxinfo;			// Flag: fxinfo is valid
+	bool have_rfork_size;		// Flag: rfork_size is valid
+	bool have_access;			// Flag: writable is valid
+	bool writable;				// Result of access(W_OK)
+	uint32 rfork_size;
+	struct stat st;
+	uint8 finfo[SIZEOF_FInfo];
+	uint8 fxinfo[SIZEOF_FXInfo];
+};
+
+struct dir_cache {
+	time_t dir_mtime;			// Modification time of directory at snapshot time
+	time_t snapshot_time;		// Time snapshot was taken
+	uint32 generation;			// Value of dir_cache_generation at snapshot time
+	int num_entries;
+	dir_entry *entries;
+	char *path;					// Host path of directory (for prefetching)
+	int next_prefetch;			// Index of next entry to prefetch
+	int prefetching;			// Number of entries being prefetched
+	dir_cache *next_queued;		// Next cache in prefetch queue
+};
+
+static uint32 dir_cache_generation = 0;		// Incremented by all operations that modify the volume
+static FSItem *cached_dirs[DIR_CACHE_MAX_DIRS];	// Directories with an enumeration cache
+static int next_cached_dir = 0;
+
+#ifdef HAVE_PTHREADS
+static pthread_t prefetch_threads[DIR_PREFETCH_THREADS];	// Metadata prefetch threads
+static int num_prefetch_threads = 0;						// Number of prefetch threads running
+static bool prefetch_thread_cancel = false;					// Flag: cancel prefetch threads
+static pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetch_queued_cond = PTHREAD_COND_INITIALIZER;	// Signaled when a directory is queued
+static pthread_cond_t prefetch_done_cond = PTHREAD_COND_INITIALIZER;	// Signaled when an entry is prefetched
+static dir_cache *prefetch_queue = NULL;					// Directories with entries left to prefetch
+
+// Remove directory from prefetch queue (prefetch_lock must be held)
+static void dequeue_prefetch(dir_cache *c)
+{
+	for (dir_cache **q = &prefetch_queue; *q; q = &(*q)->next_queued) {
+		if (*q == c) {
+			*q = c->next_queued;
+			break;
+		}
+	}
+}
+
+// Fill in all metadata of an entry, Finder info is only copied to Mac memory by the emulation thread
+static void prefetch_dir_entry(const char *dir_path, dir_entry *e)
+{
+	char path[MAX_PATH_LENGTH];
+	strncpy(path, dir_path, MAX_PATH_LENGTH - 1);
+	path[MAX_PATH_LENGTH - 1] = 0;
+	add_path_component(path, e->name);
+
+	if (stat(path, &e->st) < 0)
+		return;
+	e->have_stat = true;
+	e->writable = access(path, W_OK) == 0;
+	e->have_access = true;
+	get_finfo_host(path, e->finfo, e->fxinfo, S_ISDIR(e->st.st_mode));
+	e->have_finfo = e->have_fxinfo = true;
+	if (!S_ISDIR(e->st.st_mode)) {
+		e->rfork_size = get_rfork_size(path);
+		e->have_rfork_size = true;
+	}
+}
+
+static void *prefetch_func(void *arg)
+{
+	pthread_mutex_lock(&prefetch_lock);
+	for (;;) {
+		while (prefetch_queue == NULL && !prefetch_thread_cancel)
+			pthread_cond_wait(&prefetch_queued_cond, &prefetch_lock);
+		if (prefetch_thread_cancel)
+			break;
+
+		// Claim next pending entry
+		dir_cache *c = prefetch_queue;
+		while (c->next_prefetch < c->num_entries && c->entries[c->next_prefetch].state != ENTRY_PENDING)
+			c->next_prefetch++;
+		if (c->next_prefetch == c->num_entries) {
+			dequeue_prefetch(c);
+			continue;
+		}
+		dir_entry *e = &c->entries[c->next_prefetch++];
+		e->state = ENTRY_PREFETCHING;
+		c->prefetching++;
+		pthread_mutex_unlock(&prefetch_lock);
+
+		prefetch_dir_entry(c->path, e);
+
+		pthread_mutex_lock(&prefetch_lock);
+		e->state = ENTRY_READY;
+		c->prefetching--;
+		pthread_cond_broadcast(&prefetch_done_cond);
+	}
+	pthread_mutex_unlock(&prefetch_lock);
+	return NULL;
+}
+
+static void start_prefetch_threads(void)
+{
+	prefetch_thread_cancel = false;
+	for (num_prefetch_threads = 0; num_prefetch_threads < DIR_PREFETCH_THREADS; num_prefetch_threads++) {
+		if (pthread_create(&prefetch_threads[num_prefetch_threads], NULL, prefetch_func, NULL) != 0)
+			break;
+	}
+	D(bug("ExtFS: %d metadata prefetch threads\n", num_prefetch_threads));
+}
+
+static void stop_prefetch_threads(void)
+{
+	if (num_prefetch_threads == 0)
+		return;
+	pthread_mutex_lock(&prefetch_lock);
+	prefetch_thread_cancel = true;
+	pthread_cond_broadcast(&prefetch_queued_cond);
+	pthread_mutex_unlock(&prefetch_lock);
+	for (int i = 0; i < num_prefetch_threads; i++)
+		pthread_join(prefetch_threads[i], NULL);
+	num_prefetch_threads = 0;
+	prefetch_queue = NULL;
+}
+#endif
+
+// Get entry for use by the emulation thread, waiting for a prefetch thread if necessary
+static void claim_dir_entry(dir_entry *e)
+{
+#ifdef HAVE_PTHREADS
+	if (num_prefetch_threads == 0)
+		return;
+	pthread_mutex_lock(&prefetch_lock);
+	while (e->state == ENTRY_PREFETCHING)
+		pthread_cond_wait(&prefetch_done_cond, &prefetch_lock);
+	e->state = ENTRY_READY;
+	pthread_mutex_unlock(&prefetch_lock);
+#endif
+}
+
+static void free_dir_cache(FSItem *dir)
+{
+	dir_cache *c = dir->enumeration;
+	if (c == NULL)
+		return;
+#ifdef HAVE_PTHREADS
+	if (num_prefetch_threads) {
+		pthread_mutex_lock(&prefetch_lock);
+		dequeue_prefetch(c);
+		while (c->prefetching)
+			pthread_cond_wait(&prefetch_done_cond, &prefetch_lock);
+		pthread_mutex_unlock(&prefetch_lock);
+	}
+#endif
+	free(c->path);
+	for (int i = 0; i < c->num_entries; i++)
+		free(c->entries[i].name);
+	free(c->entries);
+	delete c;
+	dir->enumeration = NULL;
+}
+
+static int compare_dir_entries(const void *a, const void *b)
+{
+	return strcmp(((const dir_entry *)a)->name, ((const dir_entry *)b)->name);
+}
+
+// Read directory (path in full_path), returns NULL on error
+static dir_cache *read_dir_cache(time_t dir_mtime)
+{
+	DIR *d = opendir(full_path);
+	if (d == NULL)
+		return NULL;
+
+	dir_cache *c = new dir_cache;
+	c->dir_mtime = dir_mtime;
+	c->snapshot_time = time(NULL);
+	c->generation = dir_cache_generation;
+	c->num_entries = 0;
+	c->entries = NULL;
+	c->path = strdup(full_path);
+	c->next_prefetch = 0;
+	c->prefetching = 0;
+	c->next_queued = NULL;
+	int max_entries = 0;
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;	// Suppress names beginning with '.' (MacOS could interpret these as driver names)
+		if (c->num_entries == max_entries) {
+			max_entries = max_entries ? max_entries * 2 : 64;
+			c->entries = (dir_entry *)realloc(c->entries, max_entries * sizeof(dir_entry));
+		}
+		dir_entry *e = &c->entries[c->num_entries++];
+		memset(e, 0, sizeof(dir_entry));
+		e->name = strdup(de->d_name);
+		e->state = ENTRY_PENDING;
+	}
+	closedir(d);
+	qsort(c->entries, c->num_entries, sizeof(dir_entry), compare_dir_entries);
+
+#ifdef HAVE_PTHREADS
+	// Hand metadata lookups to the prefetch threads
+	if (num_prefetch_threads && c->num_entries >= DIR_PREFETCH_MIN_ENTRIES) {
+		pthread_mutex_lock(&prefetch_lock);
+		c->next_queued = prefetch_queue;
+		prefetch_queue = c;
+		pthread_cond_broadcast(&prefetch_queued_cond);
+		pthread_mutex_unlock(&prefetch_lock);
+	}
+#endif
+	return c;
+}
+
+// Find nth entry of directory (path in full_path), add its name to full_path
+static dir_entry *find_dir_entry(FSItem *dir, int index)
+{
+	struct stat st;
+	if (stat(full_path, &st) < 0)
+		return NULL;
+
+	// A snapshot taken in the same second as the last change of the directory
+	// may miss later changes within that second, it is retaken once that second
+	// is over. Directories with an mtime in the future rely on the mtime check.
+	dir_cache *c = dir->enumeration;
+	time_t now = time(NULL);
+	if (c && (c->generation != dir_cache_generation || c->dir_mtime != st.st_mtime
+	 || (c->dir_mtime == c->snapshot_time && now > c->snapshot_time)
+	 || now - c->snapshot_time > DIR_CACHE_LIFETIME)) {
+		free_dir_cache(dir);
+		c = NULL;
+	}
+	if (c == NULL) {
+		if ((c = read_dir_cache(st.st_mtime)) == NULL)
+			return NULL;
+		dir->enumeration = c;
+
+		// Limit number of cached directories
+		int i;
+		for (i = 0; i < DIR_CACHE_MAX_DIRS; i++) {
+			if (cached_dirs[i] == dir)
+				break;
+		}
+		if (i == DIR_CACHE_MAX_DIRS) {
+			FSItem *&slot = cached_dirs[next_cached_dir];
+			if (slot)
+				free_dir_cache(slot);
+			slot = dir;
+			next_cached_dir = (next_cached_dir + 1) % DIR_CACHE_MAX_DIRS;
+		}
+	}
+
+	if (index < 1 || index > c->num_entries)
+		return NULL;
+	dir_entry *e = &c->entries[index - 1];
+	claim_dir_entry(e);
+	add_path_comp(e->name);
+	if (e->item == NULL)
+		e->item = find_fsitem(e->name, dir);
+	return e;
+}
+
+// Get stats/Finder info/resource fork size/write access for path in full_path, cached in entry (if not NULL)
+static int get_entry_stat(dir_entry *e, struct stat *st)
+{
+	if (e && e->have_stat) {
+		*st = e->st;
+		return 0;
+	}
+	int result = stat(full_path, st);
+	if (e && result == 0) {
+		e->st = *st;
+		e->have_stat = true;
+	}
+	return result;
+}
+
+static void get_entry_finfo(dir_entry *e, uint32 finfo, uint32 fxinfo, bool is_dir)
+{
+	if (e && e->have_finfo && (fxinfo == 0 || e->have_fxinfo)) {
+		Host2Mac_memcpy(finfo, e->finfo, SIZEOF_FInfo);
+		if (fxinfo)
+			Host2Mac_memcpy(fxinfo, e->fxinfo, SIZEOF_FXInfo);
+		return;
+	}
+	get_finfo(full_path, finfo, fxinfo, is_dir);
+	if (e) {
+		Mac2Host_memcpy(e->finfo, finfo, SIZEOF_FInfo);
+		e->have_finfo = true;
+		if (fxinfo) {
+			Mac2Host_memcpy(e->fxinfo, fxinfo, SIZEOF_FXInfo);
+			e->have_fxinfo = true;
+		}
+	}
+}
+
+static uint32 get_entry_rfork_size(dir_entry *e)
+{
+	if (e && e->have_rfork_size)
+		return e->rfork_size;
+	uint32 size = get_rfork_size(full_path);
+	if (e) {
+		e->rfork_size = size;
+		e->have_rfork_size = true;
+	}
+	return size;
+}
+
+static bool get_entry_writable(dir_entry *e)
+{
+	if (e && e->have_access)
+		return e->writable;
+	bool writable = access(full_path, W_OK) == 0;
+	if (e) {
+		e->writable = writable;
+		e->have_access = true;
+	}
+	return writable;
+}
+
+
+/*
+ *  Host file I/O
+ *
+ *  The mark of an open fork is kept in its FCB, and reads and writes use
+ *  pread()/pwrite() at that position, going straight between the file
+ *  and Mac memory without separate lseek() calls.
+ *
+ *  Closing a data fork parks its descriptor instead of closing it, and
+ *  the next open of the same file with the same access mode takes it
+ *  back, so applications that keep opening and closing the same files
+ *  don't pay for open() each time. A parked descriptor is only reused if
+ *  the path still refers to the same file.
+ *
+ *  Other systems (which may not allow renaming or deleting open files, or
+ *  need special handling in extfs_read()/extfs_write()) seek and use the
+ *  system specific functions, and don't park descriptors.
+ */
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define USE_POSITIONED_IO 1
+#else
+#define USE_POSITIONED_IO 0
+#endif
+
+#if USE_POSITIONED_IO
+const int FD_CACHE_SIZE = 16;			// Maximum number of parked descriptors
+
+struct fd_cache_entry {
+	int fd;								// -1 = unused
+	int flag;							// access mode the file was opened with
+	dev_t dev;							// identifies the file
+	ino_t ino;
+	uint32 last_use;
+	char path[MAX_PATH_LENGTH];
+};
+
+static fd_cache_entry fd_cache[FD_CACHE_SIZE];
+static uint32 fd_cache_clock = 0;
+#endif
+
+static void init_fd_cache(void)
+{
+#if USE_POSITIONED_IO
+	for (int i = 0; i < FD_CACHE_SIZE; i++)
+		fd_cache[i].fd = -1;
+#endif
+}
+
+// Close parked descriptors of given file/dir (and everything below it), or of all files if path is NULL
+static void forget_data_forks(const char *path)
+{
+#if USE_POSITIONED_IO
+	size_t len = path ? strlen(path) : 0;
+	for (int i = 0; i < FD_CACHE_SIZE; i++) {
+		fd_cache_entry &e = fd_cache[i];
+		if (e.fd < 0)
+			continue;
+		if (path == NULL || (strncmp(e.path, path, len) == 0 && (e.path[len] == 0 || e.path[len] == '/'))) {
+			close(e.fd);
+			e.fd = -1;
+		}
+	}
+#endif
+}
+
+// Open data fork, returns fd and file information (or -1 on error, and sets errno)
+static int open_data_fork(const char *path, int flag, struct stat *st)
+{
+#if USE_POSITIONED_IO
+	if (stat(path, st) == 0) {
+		for (int i = 0; i < FD_CACHE_SIZE; i++) {
+			fd_cache_entry &e = fd_cache[i];
+			if (e.fd >= 0 && e.flag == flag && e.dev == st->st_dev && e.ino == st->st_ino && strcmp(e.path, path) == 0) {
+				int fd = e.fd;
+				e.fd = -1;
+				D(bug("  reusing fd %d\n", fd));
+				return fd;
+			}
+		}
+	}
+#endif
+	int fd = open(path, flag);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, st) < 0) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+// Close data fork, path may be NULL if unknown
+static void close_data_fork(const char *path, int fd)
+{
+#if USE_POSITIONED_IO
+	struct stat st;
+	if (path && strlen(path) < MAX_PATH_LENGTH && fstat(fd, &st) == 0 && st.st_nlink > 0) {
+
+		// Replace unused or least recently parked entry
+		int victim = 0;
+		for (int i = 0; i < FD_CACHE_SIZE; i++) {
+			if (fd_cache[i].fd < 0) {
+				victim = i;
+				break;
+			}
+			if (fd_cache[i].last_use < fd_cache[victim].last_use)
+				victim = i;
+		}
+		fd_cache_entry &e = fd_cache[victim];
+		if (e.fd >= 0)
+			close(e.fd);
+		e.fd = fd;
+		e.flag = fcntl(fd, F_GETFL) & O_ACCMODE;
+		e.dev = st.st_dev;
+		e.ino = st.st_ino;
+		e.last_use = ++fd_cache_clock;
+		strcpy(e.path, path);
+		return;
+	}
+#endif
+	close(fd);
+}
+
+// Read/write "length" bytes at position "pos", returns number of bytes transferred (or -1 on error)
+static ssize_t read_at(int fd, void *buffer, size_t length, int64 pos)
+{
+#if USE_POSITIONED_IO
+	uint8 *b = (uint8 *)buffer;
+	size_t done = 0;
+	while (done < length) {
+		ssize_t actual = pread(fd, b + done, length - done, pos + done);
+		if (actual < 0 && errno == EINTR)
+			continue;
+		if (actual < 0)
+			return done ? (ssize_t)done : -1;
+		if (actual == 0)
+			break;
+		done += actual;
+	}
+	return done;
+#else
+	if (lseek(fd, pos, SEEK_SET) < 0)
+		return -1;
+	return extfs_read(fd, buffer, length);
+#endif
+}
+
+static ssize_t write_at(int fd, void *buffer, size_t length, int64 pos)
+{
+#if USE_POSITIONED_IO
+	uint8 *b = (uint8 *)buffer;
+	size_t done = 0;
+	while (done < length) {
+		ssize_t actual = pwrite(fd, b + done, length - done, pos + done);
+		if (actual < 0 && errno == EINTR)
+			continue;
+		if (actual <= 0)
+			return done ? (ssize_t)done : -1;
+		done += actual;
+	}
+	return done;
+#else
+	if (lseek(fd, pos, SEEK_SET) < 0)
+		return -1;
+	return extfs_write(fd, buffer, length);
+#endif
 }
 
 
@@ -404,27 +1055,26 @@ void ExtFSInit(void)
 {
 	// System specific initialization
 	extfs_init();
+	init_fd_cache();
 
 	// Get file system and volume name
 	cstr2pstr(FS_NAME, GetString(STR_EXTFS_NAME));
 	cstr2pstr(VOLUME_NAME, GetString(STR_EXTFS_VOLUME_NAME));
 
 	// Create root's parent FSItem
+	alloc_fsitem_hash(FSITEM_HASH_INITIAL_SIZE);
 	FSItem *p = new FSItem;
-	first_fs_item = last_fs_item = p;
-	p->next = NULL;
 	p->id = ROOT_PARENT_ID;
 	p->parent_id = 0;
 	p->parent = NULL;
 	p->name = new char[1];
 	p->name[0] = 0;
 	p->guest_name[0] = 0;
+	p->enumeration = NULL;
+	add_fsitem(p);
 
 	// Create root FSItem
 	p = new FSItem;
-	last_fs_item->next = p;
-	p->next = NULL;
-	last_fs_item = p;
 	p->id = ROOT_ID;
 	p->parent_id = ROOT_PARENT_ID;
 	p->parent = first_fs_item;
@@ -433,6 +1083,8 @@ void ExtFSInit(void)
 	strcpy(p->name, volume_name);
 	strncpy(p->guest_name, host_encoding_to_macroman(p->name), 32);
 	p->guest_name[31] = 0;
+	p->enumeration = NULL;
+	add_fsitem(p);
 
 	// Find path for root
 	if ((RootPath = PrefsFindString("extfs")) != NULL) {
@@ -451,15 +1103,30 @@ void ExtFSInit(void)
 
 void ExtFSExit(void)
 {
+#ifdef HAVE_PTHREADS
+	// Stop metadata prefetch threads
+	stop_prefetch_threads();
+#endif
+
+	// Close parked descriptors
+	forget_data_forks(NULL);
+
 	// Delete all FSItems
 	FSItem *p = first_fs_item, *next;
 	while (p) {
 		next = p->next;
+		free_dir_cache(p);
 		delete[] p->name;
 		delete p;
 		p = next;
 	}
 	first_fs_item = last_fs_item = NULL;
+	num_fs_items = 0;
+	memset(cached_dirs, 0, sizeof(cached_dirs));
+	delete[] fsitem_id_hash;
+	delete[] fsitem_name_hash;
+	delete[] fsitem_guest_hash;
+	fsitem_id_hash = fsitem_name_hash = fsitem_guest_hash = NULL;
 
 	// System specific deinitialization
 	extfs_exit();
@@ -729,6 +1396,11 @@ void InstallExtFS(void)
 	r.d[0] = 0x41;				// PBVolumeMount
 	Execute68kTrap(0xa260, &r);	// HFSDispatch()
 	D(bug(" PBVolumeMount() returned %d\n", r.d[0]));
+
+#ifdef HAVE_PTHREADS
+	// Start metadata prefetch threads
+	start_prefetch_threads();
+#endif
 	return;
 
 fsdat_error:
@@ -1251,6 +1923,7 @@ static int16 fs_get_file_info(uint32 pb, bool hfs, uint32 dirID)
 	D(bug(" fs_get_file_info(%08lx), vRefNum %d, name %.31s, idx %d, dirID %d\n", pb, ReadMacInt16(pb + ioVRefNum), Mac2HostAddr(ReadMacInt32(pb + ioNamePtr) + 1), ReadMacInt16(pb + ioFDirIndex), dirID));
 
 	FSItem *fs_item;
+	dir_entry *entry = NULL;
 	int16 dir_index = ReadMacInt16(pb + ioFDirIndex);
 	if (dir_index <= 0) {		// Query item specified by ioDirID and ioNamePtr
 
@@ -1272,31 +1945,15 @@ static int16 fs_get_file_info(uint32 pb, bool hfs, uint32 dirID)
 		get_path_for_fsitem(p);
 
 		// Look for nth item in directory and add name to path
-		DIR *d = opendir(full_path);
-		if (d == NULL)
-			return dirNFErr;
-		struct dirent *de = NULL;
-		for (int i=0; i<dir_index; i++) {
-read_next_de:
-			de = readdir(d);
-			if (de == NULL) {
-				closedir(d);
-				return fnfErr;
-			}
-			if (de->d_name[0] == '.')
-				goto read_next_de;	// Suppress names beginning with '.' (MacOS could interpret these as driver names)
-			//!! suppress directories
-		}
-		add_path_comp(de->d_name);
-
-		// Get FSItem for queried item
-		fs_item = find_fsitem(de->d_name, p);
-		closedir(d);
+		//!! suppress directories
+		if ((entry = find_dir_entry(p, dir_index)) == NULL)
+			return fnfErr;
+		fs_item = entry->item;
 	}
 
 	// Get stats
 	struct stat st;
-	if (stat(full_path, &st))
+	if (get_entry_stat(entry, &st))
 		return fnfErr;
 	if (S_ISDIR(st.st_mode))
 		return fnfErr;
@@ -1305,7 +1962,7 @@ read_next_de:
 	if (ReadMacInt32(pb + ioNamePtr))
 		cstr2pstr((char *)Mac2HostAddr(ReadMacInt32(pb + ioNamePtr)), fs_item->guest_name);
 	WriteMacInt16(pb + ioFRefNum, 0);
-	WriteMacInt8(pb + ioFlAttrib, access(full_path, W_OK) == 0 ? 0 : faLocked);
+	WriteMacInt8(pb + ioFlAttrib, get_entry_writable(entry) ? 0 : faLocked);
 	WriteMacInt32(pb + ioDirID, fs_item->id);
 
 #if defined(__BEOS__) || defined(WIN32)
@@ -1317,13 +1974,13 @@ read_next_de:
 #endif
 	WriteMacInt32(pb + ioFlMdDat, TimeToMacTime(st.st_mtime));
 
-	get_finfo(full_path, pb + ioFlFndrInfo, hfs ? pb + ioFlXFndrInfo : 0, false);
+	get_entry_finfo(entry, pb + ioFlFndrInfo, hfs ? pb + ioFlXFndrInfo : 0, false);
 
 	WriteMacInt16(pb + ioFlStBlk, 0);
 	WriteMacInt32(pb + ioFlLgLen, st.st_size);
 	WriteMacInt32(pb + ioFlPyLen, (st.st_size | (AL_BLK_SIZE - 1)) + 1);
 	WriteMacInt16(pb + ioFlRStBlk, 0);
-	uint32 rf_size = get_rfork_size(full_path);
+	uint32 rf_size = get_entry_rfork_size(entry);
 	WriteMacInt32(pb + ioFlRLgLen, rf_size);
 	WriteMacInt32(pb + ioFlRPyLen, (rf_size | (AL_BLK_SIZE - 1)) + 1);
 
@@ -1366,6 +2023,7 @@ static int16 fs_get_cat_info(uint32 pb)
 	D(bug(" fs_get_cat_info(%08lx), vRefNum %d, name %.31s, idx %d, dirID %d\n", pb, ReadMacInt16(pb + ioVRefNum), Mac2HostAddr(ReadMacInt32(pb + ioNamePtr) + 1), ReadMacInt16(pb + ioFDirIndex), ReadMacInt32(pb + ioDirID)));
 
 	FSItem *fs_item;
+	dir_entry *entry = NULL;
 	int16 dir_index = ReadMacInt16(pb + ioFDirIndex);
 	if (dir_index < 0) {			// Query directory specified by ioDirID
 
@@ -1395,31 +2053,15 @@ static int16 fs_get_cat_info(uint32 pb)
 		get_path_for_fsitem(p);
 
 		// Look for nth item in directory and add name to path
-		DIR *d = opendir(full_path);
-		if (d == NULL)
-			return dirNFErr;
-		struct dirent *de = NULL;
-		for (int i=0; i<dir_index; i++) {
-read_next_de:
-			de = readdir(d);
-			if (de == NULL) {
-				closedir(d);
-				return fnfErr;
-			}
-			if (de->d_name[0] == '.')
-				goto read_next_de;	// Suppress names beginning with '.' (MacOS could interpret these as driver names)
-		}
-		add_path_comp(de->d_name);
-
-		// Get FSItem for queried item
-		fs_item = find_fsitem(de->d_name, p);
-		closedir(d);
+		if ((entry = find_dir_entry(p, dir_index)) == NULL)
+			return fnfErr;
+		fs_item = entry->item;
 	}
 	D(bug("  path %s\n", full_path));
 
 	// Get stats
 	struct stat st;
-	if (stat(full_path, &st) < 0)
+	if (get_entry_stat(entry, &st) < 0)
 		return errno2oserr();
 	if (dir_index == -1 && !S_ISDIR(st.st_mode))
 		return dirNFErr;
@@ -1428,7 +2070,7 @@ read_next_de:
 	if (ReadMacInt32(pb + ioNamePtr))
 		cstr2pstr((char *)Mac2HostAddr(ReadMacInt32(pb + ioNamePtr)), fs_item->guest_name);
 	WriteMacInt16(pb + ioFRefNum, 0);
-	WriteMacInt8(pb + ioFlAttrib, (S_ISDIR(st.st_mode) ? faIsDir : 0) | (access(full_path, W_OK) == 0 ? 0 : faLocked));
+	WriteMacInt8(pb + ioFlAttrib, (S_ISDIR(st.st_mode) ? faIsDir : 0) | (get_entry_writable(entry) ? 0 : faLocked));
 	WriteMacInt8(pb + ioACUser, 0);
 	WriteMacInt32(pb + ioDirID, fs_item->id);
 	WriteMacInt32(pb + ioFlParID, fs_item->parent_id);
@@ -1448,7 +2090,7 @@ read_next_de:
 	WriteMacInt32(pb + ioFlMdDat, TimeToMacTime(mtime));
 	WriteMacInt32(pb + ioFlBkDat, 0);
 
-	get_finfo(full_path, pb + ioFlFndrInfo, pb + ioFlXFndrInfo, S_ISDIR(st.st_mode));
+	get_entry_finfo(entry, pb + ioFlFndrInfo, pb + ioFlXFndrInfo, S_ISDIR(st.st_mode));
 
 	if (S_ISDIR(st.st_mode)) {
 
@@ -1479,7 +2121,7 @@ read_next_de:
 		WriteMacInt32(pb + ioFlLgLen, st.st_size);
 		WriteMacInt32(pb + ioFlPyLen, (st.st_size | (AL_BLK_SIZE - 1)) + 1);
 		WriteMacInt16(pb + ioFlRStBlk, 0);
-		uint32 rf_size = get_rfork_size(full_path);
+		uint32 rf_size = get_entry_rfork_size(entry);
 		WriteMacInt32(pb + ioFlRLgLen, rf_size);
 		WriteMacInt32(pb + ioFlRPyLen, (rf_size | (AL_BLK_SIZE - 1)) + 1);
 		WriteMacInt32(pb + ioFlClpSiz, 0);
@@ -1562,13 +2204,9 @@ static int16 fs_open(uint32 pb, uint32 dirID, uint32 vcb, bool resource_fork)
 			st.st_mode = 0;
 		}
 	} else {
-		fd = open(full_path, flag);
+		fd = open_data_fork(full_path, flag, &st);
 		if (fd < 0)
 			return errno2oserr();
-		if (fstat(fd, &st) < 0) {
-			close(fd);
-			return errno2oserr();
-		}
 	}
 
 	// File open, allocate FCB
@@ -1622,8 +2260,12 @@ static int16 fs_close(uint32 pb)
 			get_path_for_fsitem(item);
 			close_rfork(full_path, fd);
 		}
-	} else
-		close(fd);
+	} else {
+		FSItem *item = find_fsitem_by_id(ReadMacInt32(fcb + fcbFlNm));
+		if (item)
+			get_path_for_fsitem(item);
+		close_data_fork(item ? full_path : NULL, fd);
+	}
 	WriteMacInt32(fcb + fcbCatPos, (uint32)-1);
 
 	// Release FCB
@@ -1752,6 +2394,31 @@ static int16 fs_set_eof(uint32 pb)
 	return noErr;
 }
 
+// Compute new mark from ioPosMode/ioPosOffset, returns false on error
+static bool get_new_mark(uint32 pb, uint32 fcb, int fd, int64 &pos)
+{
+	int32 offset = ReadMacInt32(pb + ioPosOffset);
+	switch (ReadMacInt16(pb + ioPosMode) & 3) {
+		case fsFromStart:
+			pos = (uint32)offset;
+			break;
+		case fsFromLEOF: {
+			struct stat st;
+			if (fstat(fd, &st) < 0)
+				return false;
+			pos = st.st_size + offset;
+			break;
+		}
+		case fsFromMark:
+			pos = (int64)ReadMacInt32(fcb + fcbCrPs) + offset;
+			break;
+		default:
+			pos = ReadMacInt32(fcb + fcbCrPs);
+			break;
+	}
+	return pos >= 0 && pos <= 0xffffffff;
+}
+
 // Query current file position
 static int16 fs_get_fpos(uint32 pb)
 {
@@ -1777,9 +2444,7 @@ static int16 fs_get_fpos(uint32 pb)
 	}
 
 	// Get file position
-	uint32 pos = lseek(fd, 0, SEEK_CUR);
-	WriteMacInt32(fcb + fcbCrPs, pos);
-	WriteMacInt32(pb + ioPosOffset, pos);
+	WriteMacInt32(pb + ioPosOffset, ReadMacInt32(fcb + fcbCrPs));
 	return noErr;
 }
 
@@ -1804,23 +2469,9 @@ static int16 fs_set_fpos(uint32 pb)
 	}
 
 	// Set file position
-	switch (ReadMacInt16(pb + ioPosMode) & 3) {
-		case fsFromStart:
-			if (lseek(fd, ReadMacInt32(pb + ioPosOffset), SEEK_SET) < 0)
-				return posErr;
-			break;
-		case fsFromLEOF:
-			if (lseek(fd, (int32)ReadMacInt32(pb + ioPosOffset), SEEK_END) < 0)
-				return posErr;
-			break;
-		case fsFromMark:
-			if (lseek(fd, (int32)ReadMacInt32(pb + ioPosOffset), SEEK_CUR) < 0)
-				return posErr;
-			break;
-		default:
-			break;
-	}
-	uint32 pos = lseek(fd, 0, SEEK_CUR);
+	int64 pos;
+	if (!get_new_mark(pb, fcb, fd, pos))
+		return posErr;
 	WriteMacInt32(fcb + fcbCrPs, pos);
 	WriteMacInt32(pb + ioPosOffset, pos);
 	return noErr;
@@ -1851,27 +2502,17 @@ static int16 fs_read(uint32 pb)
 	}
 
 	// Seek
-	switch (ReadMacInt16(pb + ioPosMode) & 3) {
-		case fsFromStart:
-			if (lseek(fd, ReadMacInt32(pb + ioPosOffset), SEEK_SET) < 0)
-				return posErr;
-			break;
-		case fsFromLEOF:
-			if (lseek(fd, (int32)ReadMacInt32(pb + ioPosOffset), SEEK_END) < 0)
-				return posErr;
-			break;
-		case fsFromMark:
-			if (lseek(fd, (int32)ReadMacInt32(pb + ioPosOffset), SEEK_CUR) < 0)
-				return posErr;
-			break;
-	}
+	int64 pos;
+	if (!get_new_mark(pb, fcb, fd, pos))
+		return posErr;
 
 	// Read
-	ssize_t actual = extfs_read(fd, Mac2HostAddr(ReadMacInt32(pb + ioBuffer)), ReadMacInt32(pb + ioReqCount));
+	ssize_t actual = read_at(fd, Mac2HostAddr(ReadMacInt32(pb + ioBuffer)), ReadMacInt32(pb + ioReqCount), pos);
 	int16 read_err = errno2oserr();
 	D(bug("  actual %d\n", actual));
 	WriteMacInt32(pb + ioActCount, actual >= 0 ? actual : 0);
-	uint32 pos = lseek(fd, 0, SEEK_CUR);
+	if (actual > 0)
+		pos += actual;
 	WriteMacInt32(fcb + fcbCrPs, pos);
 	WriteMacInt32(pb + ioPosOffset, pos);
 	if (actual != (ssize_t)ReadMacInt32(pb + ioReqCount))
@@ -1905,27 +2546,17 @@ static int16 fs_write(uint32 pb)
 	}
 
 	// Seek
-	switch (ReadMacInt16(pb + ioPosMode) & 3) {
-		case fsFromStart:
-			if (lseek(fd, ReadMacInt32(pb + ioPosOffset), SEEK_SET) < 0)
-				return posErr;
-			break;
-		case fsFromLEOF:
-			if (lseek(fd, (int32)ReadMacInt32(pb + ioPosOffset), SEEK_END) < 0)
-				return posErr;
-			break;
-		case fsFromMark:
-			if (lseek(fd, (int32)ReadMacInt32(pb + ioPosOffset), SEEK_CUR) < 0)
-				return posErr;
-			break;
-	}
+	int64 pos;
+	if (!get_new_mark(pb, fcb, fd, pos))
+		return posErr;
 
 	// Write
-	ssize_t actual = extfs_write(fd, Mac2HostAddr(ReadMacInt32(pb + ioBuffer)), ReadMacInt32(pb + ioReqCount));
+	ssize_t actual = write_at(fd, Mac2HostAddr(ReadMacInt32(pb + ioBuffer)), ReadMacInt32(pb + ioReqCount), pos);
 	int16 write_err = errno2oserr();
 	D(bug("  actual %d\n", actual));
 	WriteMacInt32(pb + ioActCount, actual >= 0 ? actual : 0);
-	uint32 pos = lseek(fd, 0, SEEK_CUR);
+	if (actual > 0)
+		pos += actual;
 	WriteMacInt32(fcb + fcbCrPs, pos);
 	WriteMacInt32(pb + ioPosOffset, pos);
 	if (actual != (ssize_t)ReadMacInt32(pb + ioReqCount))
@@ -1995,6 +2626,7 @@ static int16 fs_delete(uint32 pb, uint32 dirID)
 		return result;
 
 	// Delete file
+	forget_data_forks(full_path);
 	if (!extfs_remove(full_path))
 		return errno2oserr();
 	else
@@ -2030,14 +2662,12 @@ static int16 fs_rename(uint32 pb, uint32 dirID)
 
 	// Rename item
 	D(bug("  renaming %s -> %s\n", old_path, full_path));
+	forget_data_forks(old_path);
 	if (!extfs_rename(old_path, full_path))
 		return errno2oserr();
 	else {
 		// The ID of the old file/dir has to stay the same, so we swap the IDs of the FSItems
-		swap_parent_ids(fs_item->id, new_item->id);
-		uint32 t = fs_item->id;
-		fs_item->id = new_item->id;
-		new_item->id = t;
+		swap_fsitem_ids(fs_item, new_item);
 		return noErr;
 	}
 }
@@ -2074,17 +2704,14 @@ static int16 fs_cat_move(uint32 pb)
 
 	// Move item
 	D(bug("  moving %s -> %s\n", old_path, full_path));
+	forget_data_forks(old_path);
 	if (!extfs_rename(old_path, full_path))
 		return errno2oserr();
 	else {
 		// The ID of the old file/dir has to stay the same, so we swap the IDs of the FSItems
 		FSItem *new_item = find_fsitem(fs_item->name, new_dir_item);
-		if (new_item) {
-			swap_parent_ids(fs_item->id, new_item->id);
-			uint32 t = fs_item->id;
-			fs_item->id = new_item->id;
-			new_item->id = t;
-		}
+		if (new_item)
+			swap_fsitem_ids(fs_item, new_item);
 		return noErr;
 	}
 }
@@ -2159,6 +2786,22 @@ int16 ExtFSHFS(uint32 vcb, uint16 selectCode, uint32 paramBlock, uint32 globalsP
 {
 	uint16 trapWord = selectCode & 0xf0ff;
 	bool hfs = selectCode & kHFSMask;
+
+	// Cached directory contents are invalid after the volume has been modified
+	switch (trapWord) {
+		case kFSMWrite:
+		case kFSMCreate:
+		case kFSMDelete:
+		case kFSMRename:
+		case kFSMSetFileInfo:
+		case kFSMSetEOF:
+		case kFSMCatMove:
+		case kFSMDirCreate:
+		case kFSMSetCatInfo:
+			dir_cache_generation++;
+			break;
+	}
+
 	switch (trapWord) {
 		case kFSMOpen:
 			return fs_open(paramBlock, hfs ? ReadMacInt32(paramBlock + ioDirID) : 0, vcb, false);
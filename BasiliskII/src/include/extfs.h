@@ -34,6 +34,7 @@ extern void extfs_init(void);
 extern void extfs_exit(void);
 extern void add_path_component(char *path, const char *component);
 extern void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir);
+extern void get_finfo_host(const char *path, uint8 *finfo, uint8 *fxinfo, bool is_dir);	// Into host memory, thread-safe (Unix and Mac OS X only)
 extern void set_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir);
 extern uint32 get_rfork_size(const char *path);
 extern int open_rfork(const char *path, int flag);
@@ -335,6 +335,26 @@ enum {	// FXInfo struct
 	SIZEOF_FXInfo = 16
 };
 
+// Big-endian FInfo/FXInfo fields in host memory (not necessarily aligned)
+static inline uint32 finfo_get32(const uint8 *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline void finfo_put16(uint8 *p, uint16 v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static inline void finfo_put32(uint8 *p, uint32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
 enum {	// HFileParam/HFileInfo struct
 	ioFRefNum = 24,
 	ioFVersNum = 26,
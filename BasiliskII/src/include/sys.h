@@ -73,4 +73,8 @@ extern bool SysCDScan(void *fh, uint8 start_m, uint8 start_s, uint8 start_f, boo
 extern void SysCDSetVolume(void *fh, uint8 left, uint8 right);
 extern void SysCDGetVolume(void *fh, uint8 &left, uint8 &right);
 
+// Save/restore contents of disk overlays with a savestate
+extern bool SysSaveDiskState(int fd);
+extern bool SysLoadDiskState(int fd);
+
 #endif
@@ -0,0 +1,161 @@
+/*
+ * Ones complement sum kernels for the Internet checksum (RFC 1071),
+ * and incremental checksum update (RFC 1624).
+ *
+ * Please read the file COPYRIGHT for the
+ * terms and conditions of the copyright.
+ */
+
+#ifndef _CKSUM_H_
+#define _CKSUM_H_
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CKSUM_USE_SSE2 1
+#else
+#define CKSUM_USE_SSE2 0
+#endif
+
+/* AVX2 kernel is compiled separately and selected at run-time */
+#if CKSUM_USE_SSE2 && (defined(__i386__) || defined(__x86_64__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define CKSUM_USE_AVX2 1
+#define CKSUM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CKSUM_USE_AVX2 0
+#endif
+
+/*
+ * The checksum doesn't depend on byte order, so the kernels add native
+ * 16-bit words, as cksum() always did. Words are loaded 32 bits at a
+ * time into a 64-bit accumulator and the carries are folded back in by
+ * cksum_fold() at the end. The buffer needs no particular alignment,
+ * words pair up from its first byte.
+ */
+
+/* Add the last len < 4 bytes, an odd byte is padded with a zero byte */
+static inline u_int64_t cksum_add_tail(const u_int8_t *p, int len, u_int64_t sum)
+{
+	u_int8_t b[2];
+	u_int16_t w;
+
+	if (len >= 2) {
+		memcpy(&w, p, 2);
+		sum += w;
+		p += 2;
+		len -= 2;
+	}
+	if (len) {
+		b[0] = *p;
+		b[1] = 0;
+		memcpy(&w, b, 2);
+		sum += w;
+	}
+	return sum;
+}
+
+static inline u_int64_t cksum_add_scalar(const u_int8_t *p, int len, u_int64_t sum)
+{
+	u_int32_t w[4];
+
+	while (len >= 16) {
+		memcpy(w, p, 16);
+		sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
+		p += 16;
+		len -= 16;
+	}
+	while (len >= 4) {
+		memcpy(w, p, 4);
+		sum += w[0];
+		p += 4;
+		len -= 4;
+	}
+	return cksum_add_tail(p, len, sum);
+}
+
+#if CKSUM_USE_SSE2
+static inline u_int64_t cksum_add_sse2(const u_int8_t *p, int len, u_int64_t sum)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc0 = zero, acc1 = zero;
+	u_int64_t s[2];
+
+	while (len >= 32) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)p);
+		__m128i v1 = _mm_loadu_si128((const __m128i *)(p + 16));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v1, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v1, zero));
+		p += 32;
+		len -= 32;
+	}
+	if (len >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, zero));
+		p += 16;
+		len -= 16;
+	}
+	_mm_storeu_si128((__m128i *)s, _mm_add_epi64(acc0, acc1));
+	sum += s[0];
+	sum += s[1];
+	return cksum_add_scalar(p, len, sum);
+}
+#endif
+
+#if CKSUM_USE_AVX2
+CKSUM_TARGET_AVX2
+static inline u_int64_t cksum_add_avx2(const u_int8_t *p, int len, u_int64_t sum)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i acc0 = zero, acc1 = zero;
+	u_int64_t s[4];
+
+	while (len >= 64) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+		__m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+		acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+		acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v1, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v1, zero));
+		p += 64;
+		len -= 64;
+	}
+	_mm256_storeu_si256((__m256i *)s, _mm256_add_epi64(acc0, acc1));
+	sum += s[0];
+	sum += s[1];
+	sum += s[2];
+	sum += s[3];
+	return cksum_add_sse2(p, len, sum);
+}
+#endif
+
+/* Fold a sum into 16 bits, adding back the carries */
+static inline u_int16_t cksum_fold(u_int64_t sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return (u_int16_t)sum;
+}
+
+/*
+ * Update checksum "ck" for a 16-bit word of the covered data changing
+ * from "old_w" to "new_w", without summing the data again (RFC 1624,
+ * eqn. 3). The words are in the same byte order as the checksum, i.e.
+ * as loaded from the packet.
+ */
+static inline u_int16_t cksum_adjust(u_int16_t ck, u_int16_t old_w, u_int16_t new_w)
+{
+	u_int64_t sum = (u_int16_t)~ck;
+	sum += (u_int16_t)~old_w;
+	sum += new_w;
+	return (u_int16_t)~cksum_fold(sum);
+}
+
+#endif
@@ -108,7 +108,14 @@ icmp_input(m, hlen)
   DEBUG_ARG("icmp_type = %d", icp->icmp_type);
   switch (icp->icmp_type) {
   case ICMP_ECHO:
-    icp->icmp_type = ICMP_ECHOREPLY;
+    {
+      /* The checksum was just verified, adjust it for the new type */
+      u_int16_t old_w, new_w;
+      memcpy(&old_w, &icp->icmp_type, 2);
+      icp->icmp_type = ICMP_ECHOREPLY;
+      memcpy(&new_w, &icp->icmp_type, 2);
+      icp->icmp_cksum = cksum_adjust(icp->icmp_cksum, old_w, new_w);
+    }
     ip->ip_len += hlen;	             /* since ip_input subtracts this */
     if (ip->ip_dst.s_addr == alias_addr.s_addr) {
       icmp_reflect(m);
@@ -327,21 +334,12 @@ icmp_reflect(m)
   register struct ip *ip = mtod(m, struct ip *);
   int hlen = ip->ip_hl << 2;
   int optlen = hlen - sizeof(struct ip );
-  register struct icmp *icp;
 
   /*
-   * Send an icmp packet back to the ip level,
-   * after supplying a checksum.
+   * Send an icmp packet back to the ip level. The ICMP
+   * message is an echo reply, its checksum was already
+   * adjusted by icmp_input().
    */
-  m->m_data += hlen;
-  m->m_len -= hlen;
-  icp = mtod(m, struct icmp *);
-
-  icp->icmp_cksum = 0;
-  icp->icmp_cksum = cksum(m, ip->ip_len - hlen);
-
-  m->m_data -= hlen;
-  m->m_len += hlen;
 
   /* fill in ip */
   if (optlen > 0) {
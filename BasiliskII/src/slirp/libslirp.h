@@ -20,6 +20,12 @@ int slirp_select_fill(int *pnfds,
 
 void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds);
 
+/* epoll() interface, available if HAVE_SYS_EPOLL_H is defined */
+int slirp_epoll_init(int input_fd);
+void slirp_epoll_exit(void);
+int slirp_epoll_fill(void);
+int slirp_epoll_poll(int timeout);
+
 void slirp_input(const uint8 *pkt, int pkt_len);
 
 /* you must provide the following functions: */
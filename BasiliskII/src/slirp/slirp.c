@@ -24,9 +24,6 @@ struct timeval tt;
 FILE *lfd;
 struct ex_list *exec_list;
 
-/* XXX: suppress those select globals */
-fd_set *global_readfds, *global_writefds, *global_xfds;
-
 char slirp_hostname[33];
 
 #ifdef _WIN32
@@ -161,7 +158,6 @@ int slirp_init(void)
 
 #define CONN_CANFSEND(so) (((so)->so_state & (SS_FCANTSENDMORE|SS_ISFCONNECTED)) == SS_ISFCONNECTED)
 #define CONN_CANFRCV(so) (((so)->so_state & (SS_FCANTRCVMORE|SS_ISFCONNECTED)) == SS_ISFCONNECTED)
-#define UPD_NFDS(x) if (nfds < (x)) nfds = (x)
 
 /*
  * curtime kept to an accuracy of 1ms
@@ -188,19 +184,16 @@ static void updtime(void)
 }
 #endif
 
-int slirp_select_fill(int *pnfds, 
-					  fd_set *readfds, fd_set *writefds, fd_set *xfds)
+/*
+ * Walk the socket lists, expire UDP sockets, and tell "watch" which
+ * events each socket is interested in. Returns the timeout in us.
+ */
+static int slirp_fill(void (*watch)(struct socket *, int))
 {
     struct socket *so, *so_next;
-    int nfds;
+    int events;
     int timeout, tmp_time;
 
-    /* fail safe */
-    global_readfds = NULL;
-    global_writefds = NULL;
-    global_xfds = NULL;
-    
-    nfds = *pnfds;
 	/*
 	 * First, TCP sockets
 	 */
@@ -226,15 +219,16 @@ int slirp_select_fill(int *pnfds,
 			 * NOFDREF can include still connecting to local-host,
 			 * newly socreated() sockets etc. Don't want to select these.
 	 		 */
-			if (so->so_state & SS_NOFDREF || so->s == -1)
+			if (so->so_state & SS_NOFDREF || so->s == -1) {
+			   watch(so, 0);
 			   continue;
+			}
 			
 			/*
 			 * Set for reading sockets which are accepting
 			 */
 			if (so->so_state & SS_FACCEPTCONN) {
-                                FD_SET(so->s, readfds);
-				UPD_NFDS(so->s);
+				watch(so, SO_EVENT_READ);
 				continue;
 			}
 			
@@ -242,29 +236,27 @@ int slirp_select_fill(int *pnfds,
 			 * Set for writing sockets which are connecting
 			 */
 			if (so->so_state & SS_ISFCONNECTING) {
-				FD_SET(so->s, writefds);
-				UPD_NFDS(so->s);
+				watch(so, SO_EVENT_WRITE);
 				continue;
 			}
 			
+			events = 0;
+
 			/*
 			 * Set for writing if we are connected, can send more, and
 			 * we have something to send
 			 */
-			if (CONN_CANFSEND(so) && so->so_rcv.sb_cc) {
-				FD_SET(so->s, writefds);
-				UPD_NFDS(so->s);
-			}
+			if (CONN_CANFSEND(so) && so->so_rcv.sb_cc)
+				events |= SO_EVENT_WRITE;
 			
 			/*
 			 * Set for reading (and urgent data) if we are connected, can
 			 * receive more, and we have room for it XXX /2 ?
 			 */
-			if (CONN_CANFRCV(so) && (so->so_snd.sb_cc < (so->so_snd.sb_datalen/2))) {
-				FD_SET(so->s, readfds);
-				FD_SET(so->s, xfds);
-				UPD_NFDS(so->s);
-			}
+			if (CONN_CANFRCV(so) && (so->so_snd.sb_cc < (so->so_snd.sb_datalen/2)))
+				events |= SO_EVENT_READ | SO_EVENT_URGENT;
+
+			watch(so, events);
 		}
 		
 		/*
@@ -294,10 +286,10 @@ int slirp_select_fill(int *pnfds,
 			 * if the packets needed to be fragmented
 			 * (XXX <= 4 ?)
 			 */
-			if ((so->so_state & SS_ISFCONNECTED) && so->so_queued <= 4) {
-				FD_SET(so->s, readfds);
-				UPD_NFDS(so->s);
-			}
+			if ((so->so_state & SS_ISFCONNECTED) && so->so_queued <= 4)
+				watch(so, SO_EVENT_READ);
+			else
+				watch(so, 0);
 		}
 	}
 	
@@ -332,7 +324,6 @@ int slirp_select_fill(int *pnfds,
 			   timeout = tmp_time;
 		}
 	}
-	*pnfds = nfds;
 
 	/*
 	 * Adjust the timeout to make the minimum timeout
@@ -344,15 +335,11 @@ int slirp_select_fill(int *pnfds,
 	return timeout;
 }	
 
-void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds)
+/*
+ * Run the TCP and IP timers
+ */
+static void slirp_timers(void)
 {
-    struct socket *so, *so_next;
-    int ret;
-
-    global_readfds = readfds;
-    global_writefds = writefds;
-    global_xfds = xfds;
-
 	/* Update time */
 	updtime();
 	
@@ -370,6 +357,155 @@ void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds)
 			last_slowtimo = curtime;
 		}
 	}
+}
+
+/*
+ * Handle the events in so->so_revents of a TCP socket. Events are
+ * cleared by sofcantrcvmore()/sofcantsendmore() once they no longer apply.
+ */
+static void tcp_dispatch(struct socket *so)
+{
+    int ret;
+
+	/*
+	 * Check for URG data
+	 * This will soread as well, so no need to
+	 * test for readfds below if this succeeds
+	 */
+	if (so->so_revents & SO_EVENT_URGENT)
+	   sorecvoob(so);
+	/*
+	 * Check sockets for reading
+	 */
+	else if (so->so_revents & SO_EVENT_READ) {
+		/*
+		 * Check for incoming connections
+		 */
+		if (so->so_state & SS_FACCEPTCONN) {
+			tcp_connect(so);
+			return;
+		} /* else */
+		ret = soread(so);
+		
+		/* Output it if we read something */
+		if (ret > 0)
+		   tcp_output(sototcpcb(so));
+	}
+	
+	/*
+	 * Check sockets for writing
+	 */
+	if (so->so_revents & SO_EVENT_WRITE) {
+	  /*
+	   * Check for non-blocking, still-connecting sockets
+	   */
+	  if (so->so_state & SS_ISFCONNECTING) {
+	    /* Connected */
+	    so->so_state &= ~SS_ISFCONNECTING;
+	    
+	    ret = send(so->s, &ret, 0, 0);
+	    if (ret < 0) {
+	      /* XXXXX Must fix, zero bytes is a NOP */
+	      if (errno == EAGAIN || errno == EWOULDBLOCK ||
+		  errno == EINPROGRESS || errno == ENOTCONN)
+		return;
+	      
+	      /* else failed */
+	      so->so_state = SS_NOFDREF;
+	    }
+	    /* else so->so_state &= ~SS_ISFCONNECTING; */
+	    
+	    /*
+	     * Continue tcp_input
+	     */
+	    tcp_input((struct mbuf *)NULL, sizeof(struct ip), so);
+	    /* continue; */
+	  } else {
+	    ret = sowrite(so);
+	    /*
+	     * If we wrote something, there could be a need for a
+	     * window update. tcp_output() sends one if the window
+	     * opened far enough, otherwise the remote would wait
+	     * for its persist timer to probe the window.
+	     */
+	    if (ret > 0)
+	      tcp_output(sototcpcb(so));
+	  }
+	}
+	
+	/*
+	 * Probe a still-connecting, non-blocking socket
+	 * to check if it's still alive
+	 	 	 */
+#ifdef PROBE_CONN
+	if (so->so_state & SS_ISFCONNECTING) {
+	  ret = recv(so->s, (char *)&ret, 0,0);
+	  
+	  if (ret < 0) {
+	    /* XXX */
+	    if (errno == EAGAIN || errno == EWOULDBLOCK ||
+		errno == EINPROGRESS || errno == ENOTCONN)
+	      return; /* Still connecting, continue */
+	    
+	    /* else failed */
+	    so->so_state = SS_NOFDREF;
+	    
+	    /* tcp_input will take care of it */
+	  } else {
+	    ret = send(so->s, &ret, 0,0);
+	    if (ret < 0) {
+	      /* XXX */
+	      if (errno == EAGAIN || errno == EWOULDBLOCK ||
+		  errno == EINPROGRESS || errno == ENOTCONN)
+		return;
+	      /* else failed */
+	      so->so_state = SS_NOFDREF;
+	    } else
+	      so->so_state &= ~SS_ISFCONNECTING;
+	    
+	  }
+	  tcp_input((struct mbuf *)NULL, sizeof(struct ip),so);
+	} /* SS_ISFCONNECTING */
+#endif
+}
+
+/*
+ * select() interface
+ */
+static fd_set *select_readfds, *select_writefds, *select_xfds;
+static int select_nfds;
+
+static void select_watch(struct socket *so, int events)
+{
+	if (events & SO_EVENT_READ)
+		FD_SET(so->s, select_readfds);
+	if (events & SO_EVENT_WRITE)
+		FD_SET(so->s, select_writefds);
+	if (events & SO_EVENT_URGENT)
+		FD_SET(so->s, select_xfds);
+	if (events && select_nfds < so->s)
+		select_nfds = so->s;
+}
+
+int slirp_select_fill(int *pnfds, 
+					  fd_set *readfds, fd_set *writefds, fd_set *xfds)
+{
+    int timeout;
+
+    select_readfds = readfds;
+    select_writefds = writefds;
+    select_xfds = xfds;
+    select_nfds = *pnfds;
+    timeout = slirp_fill(select_watch);
+    *pnfds = select_nfds;
+    return timeout;
+}
+
+void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds)
+{
+    struct socket *so, *so_next;
+
+	slirp_timers();
 	
 	/*
 	 * Check sockets
@@ -388,103 +524,14 @@ void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds)
 			if (so->so_state & SS_NOFDREF || so->s == -1)
 			   continue;
 			
-			/*
-			 * Check for URG data
-			 * This will soread as well, so no need to
-			 * test for readfds below if this succeeds
-			 */
+			so->so_revents = 0;
+			if (FD_ISSET(so->s, readfds))
+				so->so_revents |= SO_EVENT_READ;
+			if (FD_ISSET(so->s, writefds))
+				so->so_revents |= SO_EVENT_WRITE;
 			if (FD_ISSET(so->s, xfds))
-			   sorecvoob(so);
-			/*
-			 * Check sockets for reading
-			 */
-			else if (FD_ISSET(so->s, readfds)) {
-				/*
-				 * Check for incoming connections
-				 */
-				if (so->so_state & SS_FACCEPTCONN) {
-					tcp_connect(so);
-					continue;
-				} /* else */
-				ret = soread(so);
-				
-				/* Output it if we read something */
-				if (ret > 0)
-				   tcp_output(sototcpcb(so));
-			}
-			
-			/*
-			 * Check sockets for writing
-			 */
-			if (FD_ISSET(so->s, writefds)) {
-			  /*
-			   * Check for non-blocking, still-connecting sockets
-			   */
-			  if (so->so_state & SS_ISFCONNECTING) {
-			    /* Connected */
-			    so->so_state &= ~SS_ISFCONNECTING;
-			    
-			    ret = send(so->s, &ret, 0, 0);
-			    if (ret < 0) {
-			      /* XXXXX Must fix, zero bytes is a NOP */
-			      if (errno == EAGAIN || errno == EWOULDBLOCK ||
-				  errno == EINPROGRESS || errno == ENOTCONN)
-				continue;
-			      
-			      /* else failed */
-			      so->so_state = SS_NOFDREF;
-			    }
-			    /* else so->so_state &= ~SS_ISFCONNECTING; */
-			    
-			    /*
-			     * Continue tcp_input
-			     */
-			    tcp_input((struct mbuf *)NULL, sizeof(struct ip), so);
-			    /* continue; */
-			  } else
-			    ret = sowrite(so);
-			  /*
-			   * XXXXX If we wrote something (a lot), there 
-			   * could be a need for a window update.
-			   * In the worst case, the remote will send
-			   * a window probe to get things going again
-			   */
-			}
-			
-			/*
-			 * Probe a still-connecting, non-blocking socket
-			 * to check if it's still alive
-	 	 	 */
-#ifdef PROBE_CONN
-			if (so->so_state & SS_ISFCONNECTING) {
-			  ret = recv(so->s, (char *)&ret, 0,0);
-			  
-			  if (ret < 0) {
-			    /* XXX */
-			    if (errno == EAGAIN || errno == EWOULDBLOCK ||
-				errno == EINPROGRESS || errno == ENOTCONN)
-			      continue; /* Still connecting, continue */
-			    
-			    /* else failed */
-			    so->so_state = SS_NOFDREF;
-			    
-			    /* tcp_input will take care of it */
-			  } else {
-			    ret = send(so->s, &ret, 0,0);
-			    if (ret < 0) {
-			      /* XXX */
-			      if (errno == EAGAIN || errno == EWOULDBLOCK ||
-				  errno == EINPROGRESS || errno == ENOTCONN)
-				continue;
-			      /* else failed */
-			      so->so_state = SS_NOFDREF;
-			    } else
-			      so->so_state &= ~SS_ISFCONNECTING;
-			    
-			  }
-			  tcp_input((struct mbuf *)NULL, sizeof(struct ip),so);
-			} /* SS_ISFCONNECTING */
-#endif
+				so->so_revents |= SO_EVENT_URGENT;
+			tcp_dispatch(so);
 		}
 		
 		/*
@@ -506,15 +553,186 @@ void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds)
 	 */
 	if (if_queued && link_up)
 	   if_start();
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ * epoll() interface
+ *
+ * Sockets stay registered between calls, and the interest set of a
+ * socket is only changed when the events it waits for change, so the
+ * kernel and the dispatch loop only deal with sockets that are ready.
+ */
+#define EPOLL_MAX_EVENTS 64
+
+static int epoll_fd = -1;
+static int epoll_input;		/* marks events of the caller's input fd */
+static struct epoll_event epoll_events[EPOLL_MAX_EVENTS];
+static int epoll_nevents;
+
+int slirp_epoll_init(int input_fd)
+{
+	struct epoll_event ev;
+
+	if (epoll_fd >= 0)
+		return 0;
+	epoll_fd = epoll_create(EPOLL_MAX_EVENTS);
+	if (epoll_fd < 0)
+		return -1;
+	fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+
+	if (input_fd >= 0) {
+		ev.events = EPOLLIN;
+		ev.data.ptr = &epoll_input;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, input_fd, &ev) < 0) {
+			close(epoll_fd);
+			epoll_fd = -1;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void slirp_epoll_exit(void)
+{
+	struct socket *so;
+
+	if (epoll_fd < 0)
+		return;
+	close(epoll_fd);
+	epoll_fd = -1;
+	for (so = tcb.so_next; so != &tcb; so = so->so_next)
+		so->so_events = 0;
+	for (so = udb.so_next; so != &udb; so = so->so_next)
+		so->so_events = 0;
+}
+
+static void epoll_watch(struct socket *so, int events)
+{
+	struct epoll_event ev;
+	int op;
+
+	if (so->s == -1) {
+		/* Closed sockets were removed from the set by slirp_socket_closing() */
+		so->so_events = 0;
+		return;
+	}
+	if (so->so_events == events)
+		return;
+
+	ev.events = 0;
+	if (events & SO_EVENT_READ)
+		ev.events |= EPOLLIN;
+	if (events & SO_EVENT_WRITE)
+		ev.events |= EPOLLOUT;
+	if (events & SO_EVENT_URGENT)
+		ev.events |= EPOLLPRI;
+	ev.data.ptr = so;
+
+	if (so->so_events == 0)
+		op = EPOLL_CTL_ADD;
+	else if (events == 0)
+		op = EPOLL_CTL_DEL;
+	else
+		op = EPOLL_CTL_MOD;
+	if (epoll_ctl(epoll_fd, op, so->s, &ev) < 0) {
+		/* so->s may have been replaced, e.g. by tcp_connect() */
+		if (errno == EEXIST)
+			epoll_ctl(epoll_fd, EPOLL_CTL_MOD, so->s, &ev);
+		else if (errno == ENOENT && events)
+			epoll_ctl(epoll_fd, EPOLL_CTL_ADD, so->s, &ev);
+	}
+	so->so_events = events;
+}
+
+int slirp_epoll_fill(void)
+{
+	return slirp_fill(epoll_watch);
+}
+
+/*
+ * Wait up to "timeout" us and handle ready sockets,
+ * returns 1 if the input fd is readable
+ */
+int slirp_epoll_poll(int timeout)
+{
+	struct socket *so;
+	int i, n, input_ready = 0;
 
-	/* clear global file descriptor sets.
-	 * these reside on the stack in vl.c
-	 * so they're unusable if we're not in
-	 * slirp_select_fill or slirp_select_poll.
+	n = epoll_wait(epoll_fd, epoll_events, EPOLL_MAX_EVENTS, (timeout + 999) / 1000);
+	epoll_nevents = n > 0 ? n : 0;
+
+	slirp_timers();
+
+	/* Errors and hangups are reported as the events the socket waits for */
+	for (i = 0; i < epoll_nevents; i++) {
+		if (epoll_events[i].data.ptr == &epoll_input) {
+			input_ready = 1;
+			epoll_events[i].data.ptr = NULL;
+			continue;
+		}
+		so = (struct socket *)epoll_events[i].data.ptr;
+		so->so_revents = 0;
+		if (epoll_events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			so->so_revents |= SO_EVENT_READ;
+		if (epoll_events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+			so->so_revents |= SO_EVENT_WRITE;
+		if (epoll_events[i].events & EPOLLPRI)
+			so->so_revents |= SO_EVENT_URGENT;
+		so->so_revents &= so->so_events;
+	}
+
+	/* Sockets freed while handling earlier events are cleared by slirp_socket_freed() */
+	for (i = 0; link_up && i < epoll_nevents; i++) {
+		so = (struct socket *)epoll_events[i].data.ptr;
+		if (so == NULL || so->so_state & SS_NOFDREF || so->s == -1)
+			continue;
+		if (so->so_tcpcb)
+			tcp_dispatch(so);
+		else if (so->so_revents & SO_EVENT_READ)
+			sorecvfrom(so);
+	}
+	epoll_nevents = 0;
+
+	/*
+	 * See if we can start outputting
 	 */
-	 global_readfds = NULL;
-	 global_writefds = NULL;
-	 global_xfds = NULL;
+	if (if_queued && link_up)
+	   if_start();
+
+	return input_ready;
+}
+#endif
+
+/*
+ * Called before so->s is closed. The kernel only drops a descriptor from
+ * the epoll set once all its duplicates are closed, e.g. the copy inherited
+ * by a child process, and would keep reporting events for a freed socket.
+ */
+void slirp_socket_closing(struct socket *so)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event ev;
+
+	if (epoll_fd >= 0 && so->so_events && so->s != -1)
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, so->s, &ev);
+	so->so_events = 0;
+#endif
+}
+
+/*
+ * Called by sofree(), the socket must not be touched by pending events
+ */
+void slirp_socket_freed(struct socket *so)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	int i;
+
+	for (i = 0; i < epoll_nevents; i++) {
+		if (epoll_events[i].data.ptr == so)
+			epoll_events[i].data.ptr = NULL;
+	}
+#endif
 }
 
 #define ETH_ALEN 6
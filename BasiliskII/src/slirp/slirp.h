@@ -179,6 +179,10 @@ int inet_aton _P((const char *cp, struct in_addr *ia));
 # include <sys/select.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+
 #ifdef HAVE_SYS_WAIT_H
 # include <sys/wait.h>
 #endif
@@ -227,6 +231,7 @@ int inet_aton _P((const char *cp, struct in_addr *ia));
 #include "udp.h"
 #include "icmp_var.h"
 #include "mbuf.h"
+#include "cksum.h"
 #include "sbuf.h"
 #include "socket.h"
 #include "if.h"
@@ -298,6 +303,10 @@ extern int do_echo;
 
 #define DEFAULT_BAUD 115200
 
+/* slirp.c */
+void slirp_socket_closing _P((struct socket *));
+void slirp_socket_freed _P((struct socket *));
+
 /* cksum.c */
 int cksum(struct mbuf *m, int len);
 
@@ -322,6 +331,8 @@ int ip_output _P((struct socket *, struct mbuf *));
 int tcp_reass _P((register struct tcpcb *, register struct tcpiphdr *, struct mbuf *));
 void tcp_input _P((register struct mbuf *, int, struct socket *));
 void tcp_dooptions _P((struct tcpcb *, u_char *, int, struct tcpiphdr *));
+void tcp_sack_update _P((struct tcpcb *, u_char *, int));
+int tcp_sack_rexmt _P((struct tcpcb *));
 void tcp_xmit_timer _P((register struct tcpcb *, int));
 int tcp_mss _P((register struct tcpcb *, u_int));
 
@@ -340,6 +351,7 @@ void tcp_sockclosed _P((struct tcpcb *));
 int tcp_fconnect _P((struct socket *));
 void tcp_connect _P((struct socket *));
 int tcp_attach _P((struct socket *));
+void tcp_setsockbufs _P((int));
 u_int8_t tcp_tos _P((struct socket *));
 int tcp_emu _P((struct socket *, struct mbuf *));
 int tcp_ctl _P((struct socket *));
@@ -85,6 +85,7 @@ sofree(so)
   if(so->so_next && so->so_prev) 
     remque(so);  /* crashes if so is not in a queue */
 
+  slirp_socket_freed(so);
   free(so);
 }
 
@@ -583,7 +584,7 @@ solisten(port, laddr, lport, flags)
 	if (((s = socket(AF_INET,SOCK_STREAM,0)) < 0) ||
 	    (setsockopt(s,SOL_SOCKET,SO_REUSEADDR,(char *)&opt,sizeof(int)) < 0) ||
 	    (bind(s,(struct sockaddr *)&addr, sizeof(addr)) < 0) ||
-	    (listen(s,1) < 0)) {
+	    (tcp_setsockbufs(s), listen(s,1) < 0)) {
 		int tmperrno = errno; /* Don't clobber the real reason we failed */
 		
 		close(s);
@@ -663,9 +664,7 @@ sofcantrcvmore(so)
 {
 	if ((so->so_state & SS_NOFDREF) == 0) {
 		shutdown(so->s,0);
-		if(global_writefds) {
-		  FD_CLR(so->s,global_writefds);
-		}
+		so->so_revents &= ~SO_EVENT_WRITE;
 	}
 	so->so_state &= ~(SS_ISFCONNECTING);
 	if (so->so_state & SS_FCANTSENDMORE)
@@ -680,12 +679,7 @@ sofcantsendmore(so)
 {
 	if ((so->so_state & SS_NOFDREF) == 0) {
             shutdown(so->s,1);           /* send FIN to fhost */
-            if (global_readfds) {
-                FD_CLR(so->s,global_readfds);
-            }
-            if (global_xfds) {
-                FD_CLR(so->s,global_xfds);
-            }
+            so->so_revents &= ~(SO_EVENT_READ|SO_EVENT_URGENT);
 	}
 	so->so_state &= ~(SS_ISFCONNECTING);
 	if (so->so_state & SS_FCANTRCVMORE)
@@ -51,8 +51,18 @@ struct socket {
   struct sbuf so_rcv;		/* Receive buffer */
   struct sbuf so_snd;		/* Send buffer */
   void * extra;			/* Extra pointer */
+
+  int	so_events;		/* Events registered with epoll, SO_EVENT_*, below */
+  int	so_revents;		/* Events being handled */
 };
 
+/*
+ * Socket events
+ */
+#define SO_EVENT_READ		0x1
+#define SO_EVENT_WRITE		0x2
+#define SO_EVENT_URGENT		0x4
+
 
 /*
  * Socket state bits. (peer means the host on the Internet,
@@ -42,8 +42,12 @@ extern int tcp_rcvspace;
 extern int tcp_sndspace;
 extern struct socket *tcp_last_so;
 
-#define TCP_SNDSPACE 8192
-#define TCP_RCVSPACE 8192
+/* Large enough for a scaled window to cover a fast host connection */
+#define TCP_SNDSPACE 131072
+#define TCP_RCVSPACE 131072
+
+#define TCP_MAX_SACK	4	/* SACK blocks kept of the peer's receive queue */
+#define TCP_MAX_SACK_SENT	3	/* SACK blocks sent per segment */
 
 /*
  * TCP header.
@@ -92,6 +96,7 @@ struct tcphdr {
 #define TCPOPT_SACK_PERMITTED	4		/* Experimental */
 #define    TCPOLEN_SACK_PERMITTED	2
 #define TCPOPT_SACK		5		/* Experimental */
+#define    TCPOLEN_SACK			8	/* length of one SACK block */
 #define TCPOPT_TIMESTAMP	8
 #define    TCPOLEN_TIMESTAMP		10
 #define    TCPOLEN_TSTAMP_APPA		(TCPOLEN_TIMESTAMP+2) /* appendix A */
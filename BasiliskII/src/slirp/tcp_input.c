@@ -167,6 +167,7 @@ tcp_reass(tp, ti, m)
 	tcpstat.tcps_rcvoopack++;
 	tcpstat.tcps_rcvoobyte += ti->ti_len;
 	REASS_MBUF(ti) = (mbufp_32) m;		/* XXX */
+	tp->rcv_lastsack = ti->ti_seq;		/* reported first in SACK option */
 
 	/*
 	 * While we overlap succeeding segments trim them or,
@@ -267,6 +268,13 @@ tcp_input(m, iphlen, inso)
 		ti = so->so_ti;
 		tiwin = ti->ti_win;
 		tiflags = ti->ti_flags;
+
+		/* The SYN's options are still in front of its data */
+		off = ti->ti_off << 2;
+		if (off > sizeof (struct tcphdr)) {
+			optlen = off - sizeof (struct tcphdr);
+			optp = (caddr_t)(ti + 1);
+		}
 		
 		goto cont_conn;
 	}
@@ -434,10 +442,9 @@ findso:
 		goto drop;
 	
 	/* Unscale the window into a 32-bit value. */
-/*	if ((tiflags & TH_SYN) == 0)
- *		tiwin = ti->ti_win << tp->snd_scale;
- *	else
- */
+	if ((tiflags & TH_SYN) == 0)
+		tiwin = ti->ti_win << tp->snd_scale;
+	else
 		tiwin = ti->ti_win;
 
 	/*
@@ -711,6 +718,11 @@ findso:
 	    tcp_dooptions(tp, (u_char *)optp, optlen, ti);
 	  /* , */
 	  /*				&ts_present, &ts_val, &ts_ecr); */
+
+	  /* Compute window scaling to request.  */
+	  while (tp->request_r_scale < TCP_MAX_WINSHIFT &&
+		 (TCP_MAXWIN << tp->request_r_scale) < so->so_rcv.sb_datalen)
+	    tp->request_r_scale++;
 	  
 	  if (iss)
 	    tp->iss = iss;
@@ -769,12 +781,11 @@ findso:
 			tp->t_state = TCPS_ESTABLISHED;
 			
 			/* Do window scaling on this connection? */
-/*			if ((tp->t_flags & (TF_RCVD_SCALE|TF_REQ_SCALE)) ==
- *				(TF_RCVD_SCALE|TF_REQ_SCALE)) {
- * 				tp->snd_scale = tp->requested_s_scale;
- *				tp->rcv_scale = tp->request_r_scale;
- *			}
- */
+			if ((tp->t_flags & (TF_RCVD_SCALE|TF_REQ_SCALE)) ==
+				(TF_RCVD_SCALE|TF_REQ_SCALE)) {
+				tp->snd_scale = tp->requested_s_scale;
+				tp->rcv_scale = tp->request_r_scale;
+			}
 			(void) tcp_reass(tp, (struct tcpiphdr *)0,
 				(struct mbuf *)0);
 			/*
@@ -1039,12 +1050,11 @@ trimthenstep6:
 		}
 		
 		/* Do window scaling? */
-/*		if ((tp->t_flags & (TF_RCVD_SCALE|TF_REQ_SCALE)) ==
- *			(TF_RCVD_SCALE|TF_REQ_SCALE)) {
- *			tp->snd_scale = tp->requested_s_scale;
- *			tp->rcv_scale = tp->request_r_scale;
- *		}
- */
+		if ((tp->t_flags & (TF_RCVD_SCALE|TF_REQ_SCALE)) ==
+			(TF_RCVD_SCALE|TF_REQ_SCALE)) {
+			tp->snd_scale = tp->requested_s_scale;
+			tp->rcv_scale = tp->request_r_scale;
+		}
 		(void) tcp_reass(tp, (struct tcpiphdr *)0, (struct mbuf *)0);
 		tp->snd_wl1 = ti->ti_seq - 1;
 		/* Avoid ack processing; snd_una==ti_ack  =>  dup ack */
@@ -1117,10 +1127,16 @@ trimthenstep6:
 					       tp->t_maxseg * tp->t_dupacks;
 					if (SEQ_GT(onxt, tp->snd_nxt))
 						tp->snd_nxt = onxt;
+					tp->snd_sack_rxmt = ti->ti_ack + tp->t_maxseg;
 					goto drop;
 				} else if (tp->t_dupacks > tcprexmtthresh) {
 					tp->snd_cwnd += tp->t_maxseg;
-					(void) tcp_output(tp);
+					/*
+					 * With SACK, fill the next hole the
+					 * peer reported before sending new data
+					 */
+					if (!tcp_sack_rexmt(tp))
+						(void) tcp_output(tp);
 					goto drop;
 				}
 			} else
@@ -1508,7 +1524,7 @@ tcp_dooptions(tp, cp, cnt, ti)
 			optlen = 1;
 		else {
 			optlen = cp[1];
-			if (optlen <= 0)
+			if (optlen <= 0 || optlen > cnt)
 				break;
 		}
 		switch (opt) {
@@ -1526,15 +1542,33 @@ tcp_dooptions(tp, cp, cnt, ti)
 			(void) tcp_mss(tp, mss);	/* sets t_maxseg */
 			break;
 
-/*		case TCPOPT_WINDOW:
- *			if (optlen != TCPOLEN_WINDOW)
- *				continue;
- *			if (!(ti->ti_flags & TH_SYN))
- *				continue;
- *			tp->t_flags |= TF_RCVD_SCALE;
- *			tp->requested_s_scale = min(cp[2], TCP_MAX_WINSHIFT);
- *			break;
- */
+		case TCPOPT_WINDOW:
+			if (optlen != TCPOLEN_WINDOW)
+				continue;
+			if (!(ti->ti_flags & TH_SYN))
+				continue;
+			tp->t_flags |= TF_RCVD_SCALE;
+			tp->requested_s_scale = min(cp[2], TCP_MAX_WINSHIFT);
+			break;
+
+		case TCPOPT_SACK_PERMITTED:
+			if (optlen != TCPOLEN_SACK_PERMITTED)
+				continue;
+			if (!(ti->ti_flags & TH_SYN))
+				continue;
+			if (tp->t_flags & TF_REQ_SACK)
+				tp->t_flags |= TF_SACK_PERMIT;
+			break;
+
+		case TCPOPT_SACK:
+			if (optlen < 2 + TCPOLEN_SACK || (optlen - 2) % TCPOLEN_SACK)
+				continue;
+			if ((ti->ti_flags & (TH_SYN|TH_ACK)) != TH_ACK)
+				continue;
+			if (tp->t_flags & TF_SACK_PERMIT)
+				tcp_sack_update(tp, cp + 2, (optlen - 2) / TCPOLEN_SACK);
+			break;
+
 /*		case TCPOPT_TIMESTAMP:
  *			if (optlen != TCPOLEN_TIMESTAMP)
  *				continue;
@@ -1559,6 +1593,115 @@ tcp_dooptions(tp, cp, cnt, ti)
 }
 
 
+/*
+ * Add SACK blocks reported by the peer to the scoreboard (RFC 2018).
+ * The scoreboard keeps the lowest TCP_MAX_SACK disjoint blocks above
+ * snd_una, which are the ones that matter for retransmission.
+ */
+void
+tcp_sack_update(tp, cp, nblocks)
+	struct tcpcb *tp;
+	u_char *cp;
+	int nblocks;
+{
+	struct sackblk blk;
+	int i;
+
+	/* Forget blocks that have been acknowledged since */
+	for (i = 0; i < tp->snd_numsack; ) {
+		if (SEQ_LEQ(tp->snd_sack[i].end, tp->snd_una)) {
+			tp->snd_numsack--;
+			memmove(&tp->snd_sack[i], &tp->snd_sack[i + 1],
+				(tp->snd_numsack - i) * sizeof(struct sackblk));
+		} else
+			i++;
+	}
+
+	for (; nblocks > 0; nblocks--, cp += TCPOLEN_SACK) {
+		memcpy((char *) &blk.start, (char *) cp, sizeof(blk.start));
+		memcpy((char *) &blk.end, (char *) cp + 4, sizeof(blk.end));
+		NTOHL(blk.start);
+		NTOHL(blk.end);
+		if (SEQ_GEQ(blk.start, blk.end) || SEQ_LEQ(blk.end, tp->snd_una) ||
+		    SEQ_GT(blk.end, tp->snd_max))
+			continue;
+		if (SEQ_LT(blk.start, tp->snd_una))
+			blk.start = tp->snd_una;
+
+		/* Merge with overlapping or adjacent blocks */
+		for (i = 0; i < tp->snd_numsack; ) {
+			struct sackblk *b = &tp->snd_sack[i];
+			if (SEQ_LEQ(b->start, blk.end) && SEQ_GEQ(b->end, blk.start)) {
+				if (SEQ_LT(b->start, blk.start))
+					blk.start = b->start;
+				if (SEQ_GT(b->end, blk.end))
+					blk.end = b->end;
+				tp->snd_numsack--;
+				memmove(b, b + 1, (tp->snd_numsack - i) * sizeof(struct sackblk));
+			} else
+				i++;
+		}
+
+		/* Insert in order, dropping the highest block if full */
+		for (i = 0; i < tp->snd_numsack; i++)
+			if (SEQ_LT(blk.start, tp->snd_sack[i].start))
+				break;
+		if (i == TCP_MAX_SACK)
+			continue;
+		if (tp->snd_numsack == TCP_MAX_SACK)
+			tp->snd_numsack--;
+		memmove(&tp->snd_sack[i + 1], &tp->snd_sack[i],
+			(tp->snd_numsack - i) * sizeof(struct sackblk));
+		tp->snd_sack[i] = blk;
+		tp->snd_numsack++;
+	}
+}
+
+/*
+ * During fast recovery, retransmit one segment at the next hole below
+ * data the peer has SACKed. Returns 0 if there is no such hole.
+ */
+int
+tcp_sack_rexmt(tp)
+	struct tcpcb *tp;
+{
+	tcp_seq start, onxt;
+	u_int32_t ocwnd;
+	int i;
+
+	if ((tp->t_flags & TF_SACK_PERMIT) == 0)
+		return 0;
+
+	start = tp->snd_sack_rxmt;
+	if (SEQ_LT(start, tp->snd_una))
+		start = tp->snd_una;
+	for (i = 0; i < tp->snd_numsack; i++) {
+		if (SEQ_LEQ(tp->snd_sack[i].end, start))
+			continue;
+		if (SEQ_LT(start, tp->snd_sack[i].start))
+			break;
+		start = tp->snd_sack[i].end;
+	}
+	if (i == tp->snd_numsack)
+		return 0;
+
+	/*
+	 * Kludge snd_nxt & the congestion window like
+	 * the fast retransmit does, so only this one
+	 * segment is sent.
+	 */
+	onxt = tp->snd_nxt;
+	ocwnd = tp->snd_cwnd;
+	tp->snd_nxt = start;
+	tp->snd_cwnd = (start - tp->snd_una) + tp->t_maxseg;
+	(void) tcp_output(tp);
+	tp->snd_cwnd = ocwnd;
+	if (SEQ_GT(onxt, tp->snd_nxt))
+		tp->snd_nxt = onxt;
+	tp->snd_sack_rxmt = start + min(tp->t_maxseg, tp->snd_sack[i].start - start);
+	return 1;
+}
+
 /*
  * Pull out of band byte out of a segment so
  * it doesn't appear in the user's data queue.
@@ -60,6 +60,68 @@ u_char  tcp_outflags[TCP_NSTATES] = {
 
 #define MAX_TCPOPTLEN	32	/* max # bytes that go in options */
 
+/*
+ * Build a SACK option describing the reassembly queue (RFC 2018),
+ * returns its length. The block with the most recently queued
+ * segment comes first, followed by the lowest other blocks.
+ */
+static unsigned
+tcp_sack_option(tp, opt)
+	struct tcpcb *tp;
+	u_char *opt;
+{
+	struct tcpiphdr *q;
+	struct sackblk blk[TCP_MAX_SACK_SENT];
+	tcp_seq start, end;
+	int i, n = 1, have_last = 0;
+	unsigned optlen;
+
+	q = (struct tcpiphdr *)tp->seg_next;
+	while (q != (struct tcpiphdr *)tp) {
+		/* Collect a run of contiguous segments */
+		start = q->ti_seq;
+		end = q->ti_seq + q->ti_len;
+		q = (struct tcpiphdr *)q->ti_next;
+		while (q != (struct tcpiphdr *)tp && SEQ_LEQ(q->ti_seq, end)) {
+			if (SEQ_GT(q->ti_seq + q->ti_len, end))
+				end = q->ti_seq + q->ti_len;
+			q = (struct tcpiphdr *)q->ti_next;
+		}
+
+		if (!have_last && SEQ_LEQ(start, tp->rcv_lastsack) && SEQ_LT(tp->rcv_lastsack, end)) {
+			blk[0].start = start;
+			blk[0].end = end;
+			have_last = 1;
+		} else if (n < TCP_MAX_SACK_SENT) {
+			blk[n].start = start;
+			blk[n].end = end;
+			n++;
+		}
+	}
+	if (!have_last) {
+		/* Shouldn't happen, but don't send an empty block */
+		for (i = 1; i < n; i++)
+			blk[i - 1] = blk[i];
+		n--;
+	}
+	if (n == 0)
+		return 0;
+
+	opt[0] = TCPOPT_NOP;
+	opt[1] = TCPOPT_NOP;
+	opt[2] = TCPOPT_SACK;
+	opt[3] = 2 + n * TCPOLEN_SACK;
+	optlen = 4;
+	for (i = 0; i < n; i++) {
+		start = htonl(blk[i].start);
+		end = htonl(blk[i].end);
+		memcpy((caddr_t)(opt + optlen), (caddr_t)&start, sizeof(start));
+		memcpy((caddr_t)(opt + optlen + 4), (caddr_t)&end, sizeof(end));
+		optlen += TCPOLEN_SACK;
+	}
+	return optlen;
+}
+
 /*
  * Tcp output routine: figure out what should be sent and send it.
  */
@@ -285,19 +347,30 @@ send:
 			memcpy((caddr_t)(opt + 2), (caddr_t)&mss, sizeof(mss));
 			optlen = 4;
 
-/*			if ((tp->t_flags & TF_REQ_SCALE) &&
- *			    ((flags & TH_ACK) == 0 ||
- *			    (tp->t_flags & TF_RCVD_SCALE))) {
- *				*((u_int32_t *) (opt + optlen)) = htonl(
- *					TCPOPT_NOP << 24 |
- *					TCPOPT_WINDOW << 16 |
- *					TCPOLEN_WINDOW << 8 |
- *					tp->request_r_scale);
- *				optlen += 4;
- *			}
- */
+			if ((tp->t_flags & TF_REQ_SCALE) &&
+			    ((flags & TH_ACK) == 0 ||
+			    (tp->t_flags & TF_RCVD_SCALE))) {
+				u_int32_t ws = htonl(
+					TCPOPT_NOP << 24 |
+					TCPOPT_WINDOW << 16 |
+					TCPOLEN_WINDOW << 8 |
+					tp->request_r_scale);
+				memcpy((caddr_t)(opt + optlen), (caddr_t)&ws, sizeof(ws));
+				optlen += 4;
+			}
+
+			if ((tp->t_flags & TF_REQ_SACK) &&
+			    ((flags & TH_ACK) == 0 ||
+			    (tp->t_flags & TF_SACK_PERMIT))) {
+				opt[optlen++] = TCPOPT_NOP;
+				opt[optlen++] = TCPOPT_NOP;
+				opt[optlen++] = TCPOPT_SACK_PERMITTED;
+				opt[optlen++] = TCPOLEN_SACK_PERMITTED;
+			}
 		}
- 	}
+ 	} else if ((tp->t_flags & TF_SACK_PERMIT) &&
+		   tp->seg_next != (tcpiphdrp_32)tp)
+		optlen = tcp_sack_option(tp, opt);
  
  	/*
 	 * Send a timestamp and echo-reply if this is a SYN and our side 
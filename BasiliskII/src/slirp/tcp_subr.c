@@ -45,7 +45,8 @@
 /* patchable/settable parameters for tcp */
 int 	tcp_mssdflt = TCP_MSS;
 int 	tcp_rttdflt = TCPTV_SRTTDFLT / PR_SLOWHZ;
-int	tcp_do_rfc1323 = 0;	/* Don't do rfc1323 performance enhancements */
+int	tcp_do_rfc1323 = 1;	/* Do rfc1323 window scaling (timestamps aren't implemented) */
+int	tcp_do_sack = 1;	/* Do rfc2018 selective acknowledgements */
 int	tcp_rcvspace;	/* You may want to change this */
 int	tcp_sndspace;	/* Keep small if you have an error prone link */
 
@@ -207,7 +208,9 @@ tcp_newtcpcb(so)
 	tp->seg_next = tp->seg_prev = (tcpiphdrp_32)tp;
 	tp->t_maxseg = tcp_mssdflt;
 	
-	tp->t_flags = tcp_do_rfc1323 ? (TF_REQ_SCALE|TF_REQ_TSTMP) : 0;
+	tp->t_flags = tcp_do_rfc1323 ? TF_REQ_SCALE : 0;
+	if (tcp_do_sack)
+		tp->t_flags |= TF_REQ_SACK;
 	tp->t_socket = so;
 	
 	/*
@@ -298,6 +301,7 @@ tcp_close(tp)
 	/* clobber input socket cache if we're closing the cached connection */
 	if (so == tcp_last_so)
 		tcp_last_so = &tcb;
+	slirp_socket_closing(so);
 	closesocket(so->s);
 	sbfree(&so->so_rcv);
 	sbfree(&so->so_snd);
@@ -407,6 +411,7 @@ int tcp_fconnect(so)
     setsockopt(s,SOL_SOCKET,SO_REUSEADDR,(char *)&opt,sizeof(opt ));
     opt = 1;
     setsockopt(s,SOL_SOCKET,SO_OOBINLINE,(char *)&opt,sizeof(opt ));
+    tcp_setsockbufs(s);
     
     addr.sin_family = AF_INET;
     if ((so->so_faddr.s_addr & htonl(0xffffff00)) == special_addr.s_addr) {
@@ -508,6 +513,7 @@ tcp_connect(inso)
 	
 	/* Close the accept() socket, set right state */
 	if (inso->so_state & SS_FACCEPTONCE) {
+		slirp_socket_closing(so);
 		closesocket(so->s); /* If we only accept once, close the accept() socket */
 		so->so_state = SS_NOFDREF; /* Don't select it yet, even though we have an FD */
 					   /* if it's not FACCEPTONCE, it's already NOFDREF */
@@ -520,10 +526,9 @@ tcp_connect(inso)
 	tcp_template(tp);
 	
 	/* Compute window scaling to request.  */
-/*	while (tp->request_r_scale < TCP_MAX_WINSHIFT &&
- *		(TCP_MAXWIN << tp->request_r_scale) < so->so_rcv.sb_hiwat)
- *		tp->request_r_scale++;
- */
+	while (tp->request_r_scale < TCP_MAX_WINSHIFT &&
+		(TCP_MAXWIN << tp->request_r_scale) < so->so_rcv.sb_datalen)
+		tp->request_r_scale++;
 
 /*	soisconnecting(so); */ /* NOFDREF used instead */
 	tcpstat.tcps_connattempt++;
@@ -536,6 +541,37 @@ tcp_connect(inso)
 	tcp_output(tp);
 }
 
+/*
+ * Make the host socket buffers at least as large as ours, so the host
+ * can offer the peer a window of the same size. Buffers are never
+ * shrunk. Must be called before connect() or listen(), the host chooses
+ * its window scale from the buffer size.
+ *
+ * Not done on Linux: setting a buffer size there locks it and turns off
+ * the kernel's automatic tuning, which grows the buffers far beyond ours
+ * anyway (and getsockopt() reports twice the size that was set).
+ */
+void
+tcp_setsockbufs(s)
+	int s;
+{
+#ifndef __linux__
+	int opt;
+	socklen_t optlen;
+
+	optlen = sizeof(opt);
+	if (getsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&opt, &optlen) == 0 && opt < tcp_sndspace) {
+		opt = tcp_sndspace;
+		setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&opt, sizeof(opt));
+	}
+	optlen = sizeof(opt);
+	if (getsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&opt, &optlen) == 0 && opt < tcp_rcvspace) {
+		opt = tcp_rcvspace;
+		setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&opt, sizeof(opt));
+	}
+#endif
+}
+
 /*
  * Attach a TCPCB to a socket.
  */
@@ -848,10 +884,9 @@ tcp_emu(so, m)
 				tcp_template(tp);
                 
 				/* Compute window scaling to request.  */
-				/*	while (tp->request_r_scale < TCP_MAX_WINSHIFT &&
-				 *		(TCP_MAXWIN << tp->request_r_scale) < so->so_rcv.sb_hiwat)
-				 *		tp->request_r_scale++;
-				 */
+				while (tp->request_r_scale < TCP_MAX_WINSHIFT &&
+					(TCP_MAXWIN << tp->request_r_scale) < ns->so_rcv.sb_datalen)
+					tp->request_r_scale++;
 
                 /*soisfconnecting(ns);*/
 
@@ -219,6 +219,11 @@ tcp_timers(tp, timer)
 			tp->t_srtt = 0;
 		}
 		tp->snd_nxt = tp->snd_una;
+		/*
+		 * The receiver may have dropped data it SACKed (RFC 2018),
+		 * so forget the scoreboard and resend everything.
+		 */
+		tp->snd_numsack = 0;
 		/*
 		 * If timing a segment in this window, stop the timer.
 		 */
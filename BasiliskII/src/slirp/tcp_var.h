@@ -66,6 +66,7 @@ struct tcpcb {
 #define	TF_REQ_TSTMP	0x0080		/* have/will request timestamps */
 #define	TF_RCVD_TSTMP	0x0100		/* a timestamp was received in SYN */
 #define	TF_SACK_PERMIT	0x0200		/* other side said I could SACK */
+#define	TF_REQ_SACK	0x0400		/* have/will request SACK */
 
 	/* Make it static  for now */
 /*	struct	tcpiphdr *t_template;	/ * skeletal packet for transmit */
@@ -132,6 +133,14 @@ struct tcpcb {
 	u_int32_t	ts_recent_age;		/* when last updated */
 	tcp_seq	last_ack_sent;
 
+/* RFC 2018 variables */
+	struct sackblk {
+		tcp_seq	start, end;
+	} snd_sack[TCP_MAX_SACK];	/* data the peer has received out of order, sorted */
+	int	snd_numsack;
+	tcp_seq	snd_sack_rxmt;		/* next hole to retransmit during fast recovery */
+	tcp_seq	rcv_lastsack;		/* most recently queued out of order segment */
+
 };
 
 #define	sototcpcb(so)	((so)->so_tcpcb)
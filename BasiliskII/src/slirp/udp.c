@@ -359,6 +359,7 @@ void
 udp_detach(so)
 	struct socket *so;
 {
+	slirp_socket_closing(so);
 	closesocket(so->s);
 	/* if (so->so_m) m_free(so->so_m);    done by sofree */
 
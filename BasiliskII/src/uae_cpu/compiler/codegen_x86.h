@@ -2049,8 +2049,33 @@ enum {
   X86_SSE_PUNPCKLWD	= 0x61,
   X86_SSE_PXOR		= 0xef,
   X86_SSSE3_PSHUFB	= 0x00,
+  X86_SSE4_PACKUSDW	= 0x2b,
+  X86_SSE4_PMAXSB	= 0x3c,
+  X86_SSE4_PMAXSD	= 0x3d,
+  X86_SSE4_PMAXUD	= 0x3f,
+  X86_SSE4_PMAXUW	= 0x3e,
+  X86_SSE4_PMINSB	= 0x38,
+  X86_SSE4_PMINSD	= 0x39,
+  X86_SSE4_PMINUD	= 0x3b,
+  X86_SSE4_PMINUW	= 0x3a,
+  X86_SSE4_PMULLD	= 0x40,
 };
 
+/* AVX2 instructions with a 3-byte VEX prefix, 128-bit forms only (VEX.L = 0) */
+
+enum {
+  X86_AVX2_VPSLLVD	= 0x47,
+  X86_AVX2_VPSRAVD	= 0x46,
+  X86_AVX2_VPSRLVD	= 0x45,
+};
+
+#define _VEX3(R,B,MAP,W,V,L,PP)		(_B(0xc4), _B((!(R) << 7) | (1 << 6) | (!(B) << 5) | (MAP)), _B(((W) << 7) | ((~_rR(V) & 0x0f) << 3) | ((L) << 2) | (PP)))
+#define _VEX38Lrrr(OP,RS,RV,RD)		(_VEX3(_rXP(RD), _rXP(RS), 0x02, 0, RV, 0, 0x01), _O_Mrm	(OP	,_b11,_rX(RD),_rX(RS)				))
+
+#define VPSLLVDrrr(RS, RV, RD)		_VEX38Lrrr(X86_AVX2_VPSLLVD, RS, RV, RD)
+#define VPSRAVDrrr(RS, RV, RD)		_VEX38Lrrr(X86_AVX2_VPSRAVD, RS, RV, RD)
+#define VPSRLVDrrr(RS, RV, RD)		_VEX38Lrrr(X86_AVX2_VPSRLVD, RS, RV, RD)
+
 /*									_format		Opcd		,Mod ,r	     ,m		,mem=dsp+sib	,imm... */
 
 #define _SSSE3Lrr(OP1,OP2,RS,RSA,RD,RDA)	(_B(0x66), _REXLrr(RD,RD),	_B(0x0f), _OO_Mrm	(((OP1)<<8)|(OP2)	,_b11,RDA(RD),RSA(RS)				))
@@ -2234,6 +2259,14 @@ enum {
 #define MOVAPDmr(MD, MB, MI, MS, RD)	_SSEPDmr(0x28, MD, MB, MI, MS, RD)
 #define MOVAPDrm(RS, MD, MB, MI, MS)	_SSEPDrm(0x29, RS, MD, MB, MI, MS)
 
+#define MOVSSrr(RS, RD)			_SSESSrr(0x10, RS, RD)
+#define MOVSSmr(MD, MB, MI, MS, RD)	_SSESSmr(0x10, MD, MB, MI, MS, RD)
+#define MOVSSrm(RS, MD, MB, MI, MS)	_SSESSrm(0x11, RS, MD, MB, MI, MS)
+
+#define MOVSDrr(RS, RD)			_SSESDrr(0x10, RS, RD)
+#define MOVSDmr(MD, MB, MI, MS, RD)	_SSESDmr(0x10, MD, MB, MI, MS, RD)
+#define MOVSDrm(RS, MD, MB, MI, MS)	_SSESDrm(0x11, RS, MD, MB, MI, MS)
+
 #define CVTDQ2PDrr(RS, RD)		 _SSELrr(0xf3, X86_SSE_CVTDQ2PD, RS,_rX, RD,_rX)
 #define CVTDQ2PDmr(MD, MB, MI, MS, RD)	 _SSELmr(0xf3, X86_SSE_CVTDQ2PD, MD, MB, MI, MS, RD,_rX)
 #define CVTDQ2PSrr(RS, RD)		__SSELrr(      X86_SSE_CVTDQ2PS, RS,_rX, RD,_rX)
@@ -0,0 +1 @@
+../../../BasiliskII/src/Unix/disk_mmap.cpp
\ No newline at end of file
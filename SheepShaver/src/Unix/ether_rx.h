@@ -0,0 +1 @@
+../../../BasiliskII/src/Unix/ether_rx.h
\ No newline at end of file
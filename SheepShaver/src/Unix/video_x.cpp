@@ -1682,6 +1682,9 @@ bool VideoInit(void)
 
 void VideoExit(void)
 {
+	// Stop NQD worker thread, it may still redraw the screen
+	VideoExitAccel();
+
 	// Stop redraw thread
 	if (redraw_thread_active) {
 		redraw_thread_cancel = true;
@@ -2165,6 +2168,9 @@ int16 video_mode_change(VidLocals *csSave, uint32 ParamPtr)
 			csSave->saveData = ReadMacInt32(ParamPtr + csData);
 			csSave->savePage = ReadMacInt16(ParamPtr + csPage);
 
+			// Complete pending NQD operations into the old frame buffer
+			VideoSyncAccel();
+
 			// Disable interrupts and pause redraw thread
 			thread_stop_req = true;
 			sem_wait(&thread_stop_ack);
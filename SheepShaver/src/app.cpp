@@ -5,6 +5,7 @@
 #include <dirent.h>
 #include "sysdeps.h"
 #include "adb.h"
+#include "sys.h"
 #include "app.hpp"
 
 #define DEBUG 1
@@ -106,6 +107,7 @@ void sheepshaver_state::do_save_load(void)
 			perror("do_save_load: open");
 			return;
 		}
+		VideoSyncAccel();
 		VideoSaveBuffer();
 		if (RAMBase) {
 			write_exactly(Mac2HostAddr(0), fd, 0x3000);
@@ -126,6 +128,8 @@ void sheepshaver_state::do_save_load(void)
 		write_exactly(&video_state, fd, sizeof video_state);
 		save_descs(fd);
 		ppc_cpu->save_to(fd);
+		if (!SysSaveDiskState(fd))
+			fprintf(stderr, "do_save_load: could not save disk overlays\n");
 		uint8 recording_types = 0;
 		if (record_recording) recording_types |= HAS_RECORD_RECORDING;
 		write_exactly(&recording_types, fd, sizeof recording_types);
@@ -134,6 +138,7 @@ void sheepshaver_state::do_save_load(void)
 			record_recording->save_to(fd);
 		}
 	} else if (save_op == OP_LOAD_STATE) {
+		VideoSyncAccel();	// Queued NQD operations still write to Mac RAM and the frame buffer
 		if ((fd = open(filename, O_RDONLY)) < 0) {
 			perror("do_save_load: open");
 			return;
@@ -161,6 +166,8 @@ void sheepshaver_state::do_save_load(void)
 		read_exactly(&video_state, fd, sizeof video_state);
 		load_descs(fd);
 		ppc_cpu->load_from(fd);
+		if (!SysLoadDiskState(fd))
+			fprintf(stderr, "do_save_load: could not restore disk overlays, disks keep their current contents\n");
 		uint8 recording_types = 0;
 		read_exactly(&recording_types, fd, sizeof recording_types);
 		if (recording_types & HAS_RECORD_RECORDING) {
@@ -215,6 +222,11 @@ void sheepshaver_state::kill_playback_recording(void)
 void sheepshaver_state::advance_microseconds(uint64 delta)
 {
 	time_state.microseconds += delta;
+
+	// Keep the frame buffer reproducible across recordings
+	if (record_recording || play_recording)
+		VideoSyncAccel();
+
 	if (play_recording) {
 		play_recording->play_through(time_state.microseconds);
 		if (play_recording->done) {
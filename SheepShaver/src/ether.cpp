@@ -170,6 +170,15 @@ int32 num_rx_no_mem = 0;
 int32 num_rx_dropped = 0;
 int32 num_rx_stream_not_ready = 0;
 int32 num_rx_no_unitdata_mem = 0;
+int32 num_rx_recycled = 0;
+
+#ifndef USE_ETHER_FULL_DRIVER
+// Pool of message blocks for received packets, blocks that no stream takes are recycled
+static const int RX_POOL_SIZE = 32;
+static const uint32 RX_BLOCK_SIZE = 1516;
+static mblk_t *rx_pool[RX_POOL_SIZE];
+static int rx_pool_count = 0;
+#endif
 
 
 // Function pointers of imported functions
@@ -291,6 +300,11 @@ static void ether_ioctl(DLPIStream *the_stream, queue_t* q, mblk_t* mp);
 static void ether_flush(queue_t* q, mblk_t* mp);
 static mblk_t *build_tx_packet_header(DLPIStream *the_stream, mblk_t *mp, bool fast_path);
 static void transmit_packet(mblk_t *mp);
+static bool deliver_packet(mblk_t *mp);
+#ifndef USE_ETHER_FULL_DRIVER
+static void rx_pool_fill(void);
+static void rx_pool_flush(void);
+#endif
 static void DLPI_error_ack(DLPIStream *the_stream, queue_t *q, mblk_t *ack_mp, uint32 prim, uint32 err, uint32 uerr);
 static void DLPI_ok_ack(DLPIStream *the_stream, queue_t *q, mblk_t *ack_mp, uint32 prim);
 static void DLPI_info(DLPIStream *the_stream, queue_t *q, mblk_t *mp);
@@ -440,6 +454,7 @@ static void TerminateStreamModuleImpl(void)
 	// This happens sometimes. I don't know why.
 	if (dlpi_stream_list != NULL)
 		printf("FATAL: TerminateStreamModule() called, but streams still open\n");
+	rx_pool_flush();
 #endif
 
 	// Sorry, we're closed
@@ -488,6 +503,11 @@ int ether_open(queue_t *rdq, void *dev, int flag, int sflag, void *creds)
 	the_stream->dlsap = 0;
 	the_stream->framing_8022 = false;
 	the_stream->multicast_list = NULL;
+
+#ifndef USE_ETHER_FULL_DRIVER
+	// Set up receive blocks now, rather than at interrupt time
+	rx_pool_fill();
+#endif
 	return 0;
 }
 
@@ -521,7 +541,14 @@ int ether_close(queue_t *rdq, int flag, void *creds)
 	the_stream->multicast_list = NULL;
 
 	// Delete the DLPIStream
-	return mi_close_comm((DLPIStream **)&dlpi_stream_list, rdq);
+	int err = mi_close_comm((DLPIStream **)&dlpi_stream_list, rdq);
+
+#ifndef USE_ETHER_FULL_DRIVER
+	// Give the receive blocks back when the last stream is gone
+	if (dlpi_stream_list == NULL)
+		rx_pool_flush();
+#endif
+	return err;
 }
 
 
@@ -1059,6 +1086,15 @@ static void handle_received_packet(DLPIStream *the_stream, mblk_t *mp, uint16 pa
  */
 
 void ether_packet_received(mblk_t *mp)
+{
+	if (!deliver_packet(mp)) {
+		freemsg(mp);	// Nobody wants it *snief*
+		num_rx_dropped++;
+	}
+}
+
+// Returns false and leaves the message alone if no stream wants it
+static bool deliver_packet(mblk_t *mp)
 {
 	// Extract address and types
 	EnetPacketHeader *pkt = (EnetPacketHeader *)(void *)mp->b_rptr;
@@ -1129,13 +1165,63 @@ type_found:
 	}
 
 	// Send original message to last found stream
-	if (found_stream)
-		handle_received_packet(found_stream, mp, found_packetType, found_destAddressType);
-	else {
-		freemsg(mp);	// Nobody wants it *snief*
+	if (found_stream == NULL)
+		return false;
+	handle_received_packet(found_stream, mp, found_packetType, found_destAddressType);
+	return true;
+}
+
+
+/*
+ *  Receive block pool
+ */
+
+#ifndef USE_ETHER_FULL_DRIVER
+static void rx_pool_fill(void)
+{
+	mblk_t *mp;
+	while (rx_pool_count < RX_POOL_SIZE && (mp = allocb(RX_BLOCK_SIZE, 0)) != NULL)
+		rx_pool[rx_pool_count++] = mp;
+}
+
+static void rx_pool_flush(void)
+{
+	while (rx_pool_count > 0)
+		freeb(rx_pool[--rx_pool_count]);
+}
+
+// Get an empty message block for a received packet
+static mblk_t *rx_block_alloc(uint32 size)
+{
+	if (size <= RX_BLOCK_SIZE && rx_pool_count > 0)
+		return rx_pool[--rx_pool_count];
+	return allocb(size < RX_BLOCK_SIZE ? RX_BLOCK_SIZE : size, 0);
+}
+
+// Put back a block that no stream took, instead of freeing it and allocating a new one for the next packet
+static void rx_block_recycle(mblk_t *mp)
+{
+	datab *dp = mp->b_datap;
+	if (rx_pool_count < RX_POOL_SIZE && mp->b_cont == NULL && dp->db_ref == 1
+	 && (uint8 *)dp->db_lim - (uint8 *)dp->db_base >= (int)RX_BLOCK_SIZE) {
+		mp->b_rptr = dp->db_base;
+		mp->b_wptr = dp->db_base;
+		rx_pool[rx_pool_count++] = mp;
+		num_rx_recycled++;
+	} else
+		freemsg(mp);
+}
+
+// Wrap packet in message block and pass it to the streams
+static void rx_block_received(mblk_t *mp, uint32 size)
+{
+	mp->b_wptr += size;
+	if (!deliver_packet(mp)) {
+		rx_block_recycle(mp);
 		num_rx_dropped++;
 	}
 }
+#endif
 
 void ether_dispatch_packet(uint32 p, uint32 size)
 {
@@ -1145,14 +1231,34 @@ void ether_dispatch_packet(uint32 p, uint32 size)
 	D(bug(" packet data at %p, %d bytes\n", p, size));
 	CallMacOS2(ether_dispatch_packet_ptr, ether_dispatch_packet_tvect, p, size);
 #else
-	// Wrap packet in message block
 	num_rx_packets++;
 	mblk_t *mp;
-	if ((mp = allocb(size, 0)) != NULL) {
+	if ((mp = rx_block_alloc(size)) != NULL) {
 		D(bug(" packet data at %p\n", (void *)mp->b_rptr));
 		Mac2Host_memcpy(mp->b_rptr, p, size);
-		mp->b_wptr += size;
-		ether_packet_received(mp);
+		rx_block_received(mp, size);
+	} else {
+		D(bug("WARNING: Cannot allocate mblk for received packet\n"));
+		num_rx_no_mem++;
+	}
+#endif
+}
+
+// Same for a packet in host memory, copied straight into the message block
+void ether_packet_input(const uint8 *data, uint32 size)
+{
+#ifdef USE_ETHER_FULL_DRIVER
+	EthernetPacket ether_packet;
+	uint32 p = ether_packet.addr();
+	Host2Mac_memcpy(p, data, size);
+	ether_dispatch_packet(p, size);
+#else
+	num_rx_packets++;
+	mblk_t *mp;
+	if ((mp = rx_block_alloc(size)) != NULL) {
+		D(bug(" packet data at %p\n", (void *)mp->b_rptr));
+		memcpy(mp->b_rptr, data, size);
+		rx_block_received(mp, size);
 	} else {
 		D(bug("WARNING: Cannot allocate mblk for received packet\n"));
 		num_rx_no_mem++;
@@ -28,6 +28,14 @@
 #include "debug.h"
 
 #include "app.hpp"
+#include "gfxaccel_ops.h"
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#define NQD_ASYNC 1
+#else
+#define NQD_ASYNC 0
+#endif
 
 
 /*
@@ -67,116 +75,196 @@ static inline void NQD_set_dirty_area(uint32 p)
 }
 
 
+// Row kernels selected for this host
+static nqd_fill_row_func NQD_fill_row = nqd_fill_row_scalar;
+static nqd_invert_row_func NQD_invert_row = nqd_invert_row_scalar;
+
+
 /*
- *	Rectangle inversion
+ *	Deferred operations
+ *
+ *	Blits and fills are captured into an NQD_op with host addresses
+ *	resolved on the CPU thread, so that they can run on the NQD worker
+ *	thread while the PowerPC goes on. Only operations entirely within
+ *	the screen frame buffer, and large enough to be worth it, are
+ *	queued; anything else first waits for the queue to drain.
  */
 
-template< int bpp >
-static inline void do_invrect(uint8 *dest, uint32 length)
+enum {
+	NQD_OP_FILL,
+	NQD_OP_INVERT,
+	NQD_OP_BITBLT
+};
+
+struct NQD_op {
+	int type;
+	uint8 *dst;
+	int dst_row_bytes;
+	const uint8 *src;
+	int src_row_bytes;
+	int width;				// in pixels
+	int height;
+	int bpp;
+	int mode;				// transfer mode (bitblt)
+	uint32 color;			// fill pattern, or background color (bitblt)
+	bool on_screen;			// operation only touches the frame buffer
+	int16 dirty_x, dirty_y;	// screen area to redraw once completed
+};
+
+// Perform operation on the calling thread
+static void NQD_execute(const NQD_op &op)
 {
-#define INVERT_1(PTR, OFS) ((uint8  *)(PTR))[OFS] = ~((uint8  *)(PTR))[OFS]
-#define INVERT_2(PTR, OFS) ((uint16 *)(PTR))[OFS] = ~((uint16 *)(PTR))[OFS]
-#define INVERT_4(PTR, OFS) ((uint32 *)(PTR))[OFS] = ~((uint32 *)(PTR))[OFS]
-#define INVERT_8(PTR, OFS) ((uint64 *)(PTR))[OFS] = ~((uint64 *)(PTR))[OFS]
-
-#ifndef UNALIGNED_PROFITABLE
-	// Align on 16-bit boundaries
-	if (bpp < 16 && (((uintptr)dest) & 1)) {
-		INVERT_1(dest, 0);
-		dest += 1; length -= 1;
+	uint8 *dst = op.dst;
+	const int width = op.width * op.bpp;
+	switch (op.type) {
+	case NQD_OP_FILL:
+		if (op.width == 1) {
+			// Vertical line
+			nqd_fill_column(dst, op.dst_row_bytes, op.height, op.bpp, op.color);
+			break;
+		}
+		for (int i = 0; i < op.height; i++) {
+			NQD_fill_row(dst, width, op.color);
+			dst += op.dst_row_bytes;
+		}
+		break;
+	case NQD_OP_INVERT:
+		if (op.width == 1) {
+			// Vertical line
+			nqd_invert_column(dst, op.dst_row_bytes, op.height, op.bpp);
+			break;
+		}
+		for (int i = 0; i < op.height; i++) {
+			NQD_invert_row(dst, width);
+			dst += op.dst_row_bytes;
+		}
+		break;
+	case NQD_OP_BITBLT:
+		nqd_do_bitblt(op.mode, op.bpp, dst, op.dst_row_bytes, op.src, op.src_row_bytes, width, op.height, op.color);
+		break;
 	}
+}
+
+#if NQD_ASYNC
+// Smallest operation, in bytes, worth handing over to the worker thread
+static const int NQD_ASYNC_MIN_BYTES = 16384;
+
+// Queue of pending operations, the head one being processed
+static const int NQD_QUEUE_SIZE = 64;
+static NQD_op nqd_queue[NQD_QUEUE_SIZE];
+static int nqd_queue_head = 0;
+static int nqd_queue_count = 0;
+
+static pthread_t nqd_thread;						// NQD worker thread
+static bool nqd_thread_active = false;				// Flag: NQD worker thread installed
+static bool nqd_thread_cancel = false;				// Flag: cancel NQD worker thread
+static pthread_mutex_t nqd_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t nqd_queued_cond = PTHREAD_COND_INITIALIZER;	// Signaled when an operation is queued
+static pthread_cond_t nqd_done_cond = PTHREAD_COND_INITIALIZER;		// Signaled when an operation completes
 
-	// Align on 32-bit boundaries
-	if (bpp < 32 && (((uintptr)dest) & 2)) {
-		INVERT_2(dest, 0);
-		dest += 2; length -= 2;
+static void *nqd_func(void *arg)
+{
+	pthread_mutex_lock(&nqd_lock);
+	for (;;) {
+		while (nqd_queue_count == 0 && !nqd_thread_cancel)
+			pthread_cond_wait(&nqd_queued_cond, &nqd_lock);
+		if (nqd_queue_count == 0)
+			break;
+		const NQD_op &op = nqd_queue[nqd_queue_head];
+		pthread_mutex_unlock(&nqd_lock);
+
+		NQD_execute(op);
+
+		// The redraw thread may have caught the area before completion
+		video_set_dirty_area(op.dirty_x, op.dirty_y, op.width, op.height);
+
+		pthread_mutex_lock(&nqd_lock);
+		nqd_queue_head = (nqd_queue_head + 1) % NQD_QUEUE_SIZE;
+		nqd_queue_count--;
+		pthread_cond_broadcast(&nqd_done_cond);
 	}
+	pthread_mutex_unlock(&nqd_lock);
+	return NULL;
+}
+
+static void NQD_start_thread(void)
+{
+	if (nqd_thread_active || !PrefsFindBool("gfxaccelasync"))
+		return;
+	nqd_thread_cancel = false;
+	nqd_thread_active = (pthread_create(&nqd_thread, NULL, nqd_func, NULL) == 0);
+	D(bug("Video: NQD worker thread %s\n", nqd_thread_active ? "started" : "not available"));
+}
 #endif
 
-	// Invert 8-byte words
-	if (length >= 8) {
-		const int r = (length / 8) % 8;
-		dest += r * 8;
-
-		int n = ((length / 8) + 7) / 8;
-		switch (r) {
-		case 0: do {
-				dest += 64;
-				INVERT_8(dest, -8);
-		case 7: INVERT_8(dest, -7);
-		case 6: INVERT_8(dest, -6);
-		case 5: INVERT_8(dest, -5);
-		case 4: INVERT_8(dest, -4);
-		case 3: INVERT_8(dest, -3);
-		case 2: INVERT_8(dest, -2);
-		case 1: INVERT_8(dest, -1);
-				} while (--n > 0);
-		}
-	}
+// Wait for all pending operations to complete
+static void NQD_wait(void)
+{
+#if NQD_ASYNC
+	if (!nqd_thread_active)
+		return;
+	pthread_mutex_lock(&nqd_lock);
+	while (nqd_queue_count > 0)
+		pthread_cond_wait(&nqd_done_cond, &nqd_lock);
+	pthread_mutex_unlock(&nqd_lock);
+#endif
+}
 
-	// 32-bit cell to invert?
-	if (length & 4) {
-		INVERT_4(dest, 0);
-		if (bpp <= 16)
-			dest += 4;
+// Run operation now, or queue it for the worker thread
+static void NQD_submit(const NQD_op &op)
+{
+#if NQD_ASYNC
+	// While recording or playing back, the frame buffer must not change
+	// behind the guest's back, or replay would depend on timing
+	const bool deterministic = the_app->record_recording || the_app->play_recording;
+	if (nqd_thread_active && !deterministic && op.on_screen && op.width * op.bpp * op.height >= NQD_ASYNC_MIN_BYTES) {
+		pthread_mutex_lock(&nqd_lock);
+		while (nqd_queue_count == NQD_QUEUE_SIZE)
+			pthread_cond_wait(&nqd_done_cond, &nqd_lock);
+		nqd_queue[(nqd_queue_head + nqd_queue_count) % NQD_QUEUE_SIZE] = op;
+		nqd_queue_count++;
+		pthread_cond_signal(&nqd_queued_cond);
+		pthread_mutex_unlock(&nqd_lock);
+		return;
 	}
+#endif
+	NQD_wait();
+	NQD_execute(op);
+}
 
-	// 16-bit cell to invert?
-	if (bpp <= 16 && (length & 2)) {
-		INVERT_2(dest, 0);
-		if (bpp <= 8)
-			dest += 2;
-	}
+// Fill in destination of an operation
+static void NQD_get_dest(uint32 p, NQD_op &op)
+{
+	op.dirty_x = (int16)ReadMacInt16(p + acclDestRect + 2) - (int16)ReadMacInt16(p + acclDestBoundsRect + 2);
+	op.dirty_y = (int16)ReadMacInt16(p + acclDestRect + 0) - (int16)ReadMacInt16(p + acclDestBoundsRect + 0);
+	op.width  = (int16)ReadMacInt16(p + acclDestRect + 6) - (int16)ReadMacInt16(p + acclDestRect + 2);
+	op.height = (int16)ReadMacInt16(p + acclDestRect + 4) - (int16)ReadMacInt16(p + acclDestRect + 0);
+	op.bpp = bytes_per_pixel(ReadMacInt32(p + acclDestPixelSize));
+	op.dst_row_bytes = (int32)ReadMacInt32(p + acclDestRowBytes);
+	op.dst = Mac2HostAddr(ReadMacInt32(p + acclDestBaseAddr) + (op.dirty_y * op.dst_row_bytes) + (op.dirty_x * op.bpp));
+	op.on_screen = ReadMacInt32(p + acclDestBaseAddr) == the_app->video_state.screen_base;
+}
 
-	// 8-bit cell to invert?
-	if (bpp <= 8 && (length & 1))
-		INVERT_1(dest, 0);
 
-#undef INVERT_1
-#undef INVERT_2
-#undef INVERT_4
-#undef INVERT_8
-}
+/*
+ *	Rectangle inversion
+ */
 
 void NQD_invrect(uint32 p)
 {
 	D(bug("accl_invrect %08x\n", p));
 
 	// Get inversion parameters
-	int16 dest_X = (int16)ReadMacInt16(p + acclDestRect + 2) - (int16)ReadMacInt16(p + acclDestBoundsRect + 2);
-	int16 dest_Y = (int16)ReadMacInt16(p + acclDestRect + 0) - (int16)ReadMacInt16(p + acclDestBoundsRect + 0);
-	int16 width  = (int16)ReadMacInt16(p + acclDestRect + 6) - (int16)ReadMacInt16(p + acclDestRect + 2);
-	int16 height = (int16)ReadMacInt16(p + acclDestRect + 4) - (int16)ReadMacInt16(p + acclDestRect + 0);
-	D(bug(" dest X %d, dest Y %d\n", dest_X, dest_Y));
-	D(bug(" width %d, height %d, bytes_per_row %d\n", width, height, (int32)ReadMacInt32(p + acclDestRowBytes)));
+	NQD_op op;
+	op.type = NQD_OP_INVERT;
+	NQD_get_dest(p, op);
+	D(bug(" dest X %d, dest Y %d\n", op.dirty_x, op.dirty_y));
+	D(bug(" width %d, height %d, bytes_per_row %d\n", op.width, op.height, op.dst_row_bytes));
 
 	//!!?? pen_mode == 14
 
 	// And perform the inversion
-	const int bpp = bytes_per_pixel(ReadMacInt32(p + acclDestPixelSize));
-	const int dest_row_bytes = (int32)ReadMacInt32(p + acclDestRowBytes);
-	uint8 *dest = Mac2HostAddr(ReadMacInt32(p + acclDestBaseAddr) + (dest_Y * dest_row_bytes) + (dest_X * bpp));
-	width *= bpp;
-	switch (bpp) {
-	case 1:
-		for (int i = 0; i < height; i++) {
-			do_invrect<8>(dest, width);
-			dest += dest_row_bytes;
-		}
-		break;
-	case 2:
-		for (int i = 0; i < height; i++) {
-			do_invrect<16>(dest, width);
-			dest += dest_row_bytes;
-		}
-		break;
-	case 4:
-		for (int i = 0; i < height; i++) {
-			do_invrect<32>(dest, width);
-			dest += dest_row_bytes;
-		}
-		break;
-	}
+	NQD_submit(op);
 }
 
 
@@ -184,113 +272,21 @@ void NQD_invrect(uint32 p)
  *	Rectangle filling
  */
 
-template< int bpp >
-static inline void do_fillrect(uint8 *dest, uint32 color, uint32 length)
-{
-#define FILL_1(PTR, OFS, VAL) ((uint8  *)(PTR))[OFS] = (VAL)
-#define FILL_2(PTR, OFS, VAL) ((uint16 *)(PTR))[OFS] = (VAL)
-#define FILL_4(PTR, OFS, VAL) ((uint32 *)(PTR))[OFS] = (VAL)
-#define FILL_8(PTR, OFS, VAL) ((uint64 *)(PTR))[OFS] = (VAL)
-
-#ifndef UNALIGNED_PROFITABLE
-	// Align on 16-bit boundaries
-	if (bpp < 16 && (((uintptr)dest) & 1)) {
-		FILL_1(dest, 0, color);
-		dest += 1; length -= 1;
-	}
-
-	// Align on 32-bit boundaries
-	if (bpp < 32 && (((uintptr)dest) & 2)) {
-		FILL_2(dest, 0, color);
-		dest += 2; length -= 2;
-	}
-#endif
-
-	// Fill 8-byte words
-	if (length >= 8) {
-		const uint64 c = (((uint64)color) << 32) | color;
-		const int r = (length / 8) % 8;
-		dest += r * 8;
-
-		int n = ((length / 8) + 7) / 8;
-		switch (r) {
-		case 0: do {
-				dest += 64;
-				FILL_8(dest, -8, c);
-		case 7: FILL_8(dest, -7, c);
-		case 6: FILL_8(dest, -6, c);
-		case 5: FILL_8(dest, -5, c);
-		case 4: FILL_8(dest, -4, c);
-		case 3: FILL_8(dest, -3, c);
-		case 2: FILL_8(dest, -2, c);
-		case 1: FILL_8(dest, -1, c);
-				} while (--n > 0);
-		}
-	}
-
-	// 32-bit cell to fill?
-	if (length & 4) {
-		FILL_4(dest, 0, color);
-		if (bpp <= 16)
-			dest += 4;
-	}
-
-	// 16-bit cell to fill?
-	if (bpp <= 16 && (length & 2)) {
-		FILL_2(dest, 0, color);
-		if (bpp <= 8)
-			dest += 2;
-	}
-
-	// 8-bit cell to fill?
-	if (bpp <= 8 && (length & 1))
-		FILL_1(dest, 0, color);
-
-#undef FILL_1
-#undef FILL_2
-#undef FILL_4
-#undef FILL_8
-}
-
 void NQD_fillrect(uint32 p)
 {
 	D(bug("accl_fillrect %08x\n", p));
 
 	// Get filling parameters
-	int16 dest_X = (int16)ReadMacInt16(p + acclDestRect + 2) - (int16)ReadMacInt16(p + acclDestBoundsRect + 2);
-	int16 dest_Y = (int16)ReadMacInt16(p + acclDestRect + 0) - (int16)ReadMacInt16(p + acclDestBoundsRect + 0);
-	int16 width  = (int16)ReadMacInt16(p + acclDestRect + 6) - (int16)ReadMacInt16(p + acclDestRect + 2);
-	int16 height = (int16)ReadMacInt16(p + acclDestRect + 4) - (int16)ReadMacInt16(p + acclDestRect + 0);
-	uint32 color = htonl(ReadMacInt32(p + acclPenMode) == 8 ? ReadMacInt32(p + acclForePen) : ReadMacInt32(p + acclBackPen));
-	D(bug(" dest X %d, dest Y %d\n", dest_X, dest_Y));
-	D(bug(" width %d, height %d\n", width, height));
-	D(bug(" bytes_per_row %d color %08x\n", (int32)ReadMacInt32(p + acclDestRowBytes), color));
+	NQD_op op;
+	op.type = NQD_OP_FILL;
+	NQD_get_dest(p, op);
+	op.color = htonl(ReadMacInt32(p + acclPenMode) == nqdPatCopy ? ReadMacInt32(p + acclForePen) : ReadMacInt32(p + acclBackPen));
+	D(bug(" dest X %d, dest Y %d\n", op.dirty_x, op.dirty_y));
+	D(bug(" width %d, height %d\n", op.width, op.height));
+	D(bug(" bytes_per_row %d color %08x\n", op.dst_row_bytes, op.color));
 
 	// And perform the fill
-	const int bpp = bytes_per_pixel(ReadMacInt32(p + acclDestPixelSize));
-	const int dest_row_bytes = (int32)ReadMacInt32(p + acclDestRowBytes);
-	uint8 *dest = Mac2HostAddr(ReadMacInt32(p + acclDestBaseAddr) + (dest_Y * dest_row_bytes) + (dest_X * bpp));
-	width *= bpp;
-	switch (bpp) {
-	case 1:
-		for (int i = 0; i < height; i++) {
-			memset(dest, color, width);
-			dest += dest_row_bytes;
-		}
-		break;
-	case 2:
-		for (int i = 0; i < height; i++) {
-			do_fillrect<16>(dest, color, width);
-			dest += dest_row_bytes;
-		}
-		break;
-	case 4:
-		for (int i = 0; i < height; i++) {
-			do_fillrect<32>(dest, color, width);
-			dest += dest_row_bytes;
-		}
-		break;
-	}
+	NQD_submit(op);
 }
 
 bool NQD_fillrect_hook(uint32 p)
@@ -301,17 +297,18 @@ bool NQD_fillrect_hook(uint32 p)
 	// Check if we can accelerate this fillrect
 	if (ReadMacInt32(p + 0x284) != 0 && ReadMacInt32(p + acclDestPixelSize) >= 8) {
 		const int transfer_mode = ReadMacInt32(p + acclTransferMode);
-		if (transfer_mode == 8) {
+		if (transfer_mode == nqdPatCopy) {
 			// Fill
 			WriteMacInt32(p + acclDrawProc, NativeTVECT(NATIVE_NQD_FILLRECT));
 			return true;
 		}
-		else if (transfer_mode == 10) {
+		else if (transfer_mode == nqdPatXor) {
 			// Invert
 			WriteMacInt32(p + acclDrawProc, NativeTVECT(NATIVE_NQD_INVRECT));
 			return true;
 		}
 	}
+	NQD_wait();
 	return false;
 }
 
@@ -327,61 +324,41 @@ void NQD_bitblt(uint32 p)
 	// Get blitting parameters
 	int16 src_X  = (int16)ReadMacInt16(p + acclSrcRect + 2) - (int16)ReadMacInt16(p + acclSrcBoundsRect + 2);
 	int16 src_Y  = (int16)ReadMacInt16(p + acclSrcRect + 0) - (int16)ReadMacInt16(p + acclSrcBoundsRect + 0);
-	int16 dest_X = (int16)ReadMacInt16(p + acclDestRect + 2) - (int16)ReadMacInt16(p + acclDestBoundsRect + 2);
-	int16 dest_Y = (int16)ReadMacInt16(p + acclDestRect + 0) - (int16)ReadMacInt16(p + acclDestBoundsRect + 0);
-	int16 width  = (int16)ReadMacInt16(p + acclDestRect + 6) - (int16)ReadMacInt16(p + acclDestRect + 2);
-	int16 height = (int16)ReadMacInt16(p + acclDestRect + 4) - (int16)ReadMacInt16(p + acclDestRect + 0);
+	NQD_op op;
+	op.type = NQD_OP_BITBLT;
+	NQD_get_dest(p, op);
 	D(bug(" src addr %08x, dest addr %08x\n", ReadMacInt32(p + acclSrcBaseAddr), ReadMacInt32(p + acclDestBaseAddr)));
-	D(bug(" src X %d, src Y %d, dest X %d, dest Y %d\n", src_X, src_Y, dest_X, dest_Y));
-	D(bug(" width %d, height %d\n", width, height));
+	D(bug(" src X %d, src Y %d, dest X %d, dest Y %d\n", src_X, src_Y, op.dirty_x, op.dirty_y));
+	D(bug(" width %d, height %d\n", op.width, op.height));
 
 	// And perform the blit
-	const int bpp = bytes_per_pixel(ReadMacInt32(p + acclSrcPixelSize));
-	width *= bpp;
-	if ((int32)ReadMacInt32(p + acclSrcRowBytes) > 0) {
-		const int src_row_bytes = (int32)ReadMacInt32(p + acclSrcRowBytes);
-		const int dst_row_bytes = (int32)ReadMacInt32(p + acclDestRowBytes);
-		uint8 *src = Mac2HostAddr(ReadMacInt32(p + acclSrcBaseAddr) + (src_Y * src_row_bytes) + (src_X * bpp));
-		uint8 *dst = Mac2HostAddr(ReadMacInt32(p + acclDestBaseAddr) + (dest_Y * dst_row_bytes) + (dest_X * bpp));
-		for (int i = 0; i < height; i++) {
-			memmove(dst, src, width);
-			src += src_row_bytes;
-			dst += dst_row_bytes;
-		}
-	}
+	op.mode = ReadMacInt32(p + acclTransferMode);
+	op.color = ReadMacInt32(p + acclBackPen);
+	op.on_screen = op.on_screen && ReadMacInt32(p + acclSrcBaseAddr) == the_app->video_state.screen_base;
+	op.src_row_bytes = (int32)ReadMacInt32(p + acclSrcRowBytes);
+	if (op.src_row_bytes > 0)
+		op.src = Mac2HostAddr(ReadMacInt32(p + acclSrcBaseAddr) + (src_Y * op.src_row_bytes) + (src_X * op.bpp));
 	else {
-		const int src_row_bytes = -(int32)ReadMacInt32(p + acclSrcRowBytes);
-		const int dst_row_bytes = -(int32)ReadMacInt32(p + acclDestRowBytes);
-		uint8 *src = Mac2HostAddr(ReadMacInt32(p + acclSrcBaseAddr) + ((src_Y + height - 1) * src_row_bytes) + (src_X * bpp));
-		uint8 *dst = Mac2HostAddr(ReadMacInt32(p + acclDestBaseAddr) + ((dest_Y + height - 1) * dst_row_bytes) + (dest_X * bpp));
-		for (int i = height - 1; i >= 0; i--) {
-			memmove(dst, src, width);
-			src -= src_row_bytes;
-			dst -= dst_row_bytes;
-		}
+		// Start from the bottom row, which is the lowest address
+		const int src_row_bytes = -op.src_row_bytes;
+		const int dst_row_bytes = -op.dst_row_bytes;
+		op.src = Mac2HostAddr(ReadMacInt32(p + acclSrcBaseAddr) + ((src_Y + op.height - 1) * src_row_bytes) + (src_X * op.bpp));
+		op.dst = Mac2HostAddr(ReadMacInt32(p + acclDestBaseAddr) + ((op.dirty_y + op.height - 1) * dst_row_bytes) + (op.dirty_x * op.bpp));
 	}
+	NQD_submit(op);
 }
 
-/*
-  BitBlt transfer modes:
-  0 : srcCopy
-  1 : srcOr
-  2 : srcXor
-  3 : srcBic
-  4 : notSrcCopy
-  5 : notSrcOr
-  6 : notSrcXor
-  7 : notSrcBic
-  32 : blend
-  33 : addPin
-  34 : addOver
-  35 : subPin
-  36 : transparent
-  37 : adMax
-  38 : subOver
-  39 : adMin
-  50 : hilite
-*/
+// Check whether boolean transfer modes other than srcCopy would colorize
+static inline bool NQD_is_black_and_white(uint32 p)
+{
+	const int bpp = bytes_per_pixel(ReadMacInt32(p + acclDestPixelSize));
+	const uint32 mask = nqd_pixel_mask(bpp);
+	const uint32 fore_pen = ReadMacInt32(p + acclForePen) & mask;
+	const uint32 back_pen = ReadMacInt32(p + acclBackPen) & mask;
+	if (bpp == 1)	// indexed: black is the last color table entry
+		return fore_pen == mask && back_pen == 0;
+	return fore_pen == 0 && back_pen == mask;
+}
 
 bool NQD_bitblt_hook(uint32 p)
 {
@@ -394,13 +371,19 @@ bool NQD_bitblt_hook(uint32 p)
 		ReadMacInt32(p + acclSrcPixelSize) >= 8 &&
 		ReadMacInt32(p + acclSrcPixelSize) == ReadMacInt32(p + acclDestPixelSize) &&
 		(int32)(ReadMacInt32(p + acclSrcRowBytes) ^ ReadMacInt32(p + acclDestRowBytes)) >= 0 &&	// same sign?
-		ReadMacInt32(p + acclTransferMode) == 0 &&												// srcCopy?
 		(int32)ReadMacInt32(p + 0x15c) > 0) {
 
-		// Yes, set function pointer
-		WriteMacInt32(p + acclDrawProc, NativeTVECT(NATIVE_NQD_BITBLT));
-		return true;
+		// Native transfer mode?
+		const int transfer_mode = ReadMacInt32(p + acclTransferMode);
+		if (nqd_bitblt_mode_supported(transfer_mode, bytes_per_pixel(ReadMacInt32(p + acclSrcPixelSize))) &&
+			(transfer_mode <= nqdSrcCopy || transfer_mode > nqdNotSrcBic || NQD_is_black_and_white(p))) {
+
+			// Yes, set function pointer
+			WriteMacInt32(p + acclDrawProc, NativeTVECT(NATIVE_NQD_BITBLT));
+			return true;
+		}
 	}
+	NQD_wait();
 	return false;
 }
 
@@ -410,6 +393,8 @@ bool NQD_unknown_hook(uint32 arg)
 	D(bug("accl_unknown_hook %08x\n", arg));
 	NQD_set_dirty_area(arg);
 
+	// QuickDraw is going to draw by itself
+	NQD_wait();
 	return false;
 }
 
@@ -417,9 +402,16 @@ bool NQD_unknown_hook(uint32 arg)
 bool NQD_sync_hook(uint32 arg)
 {
 	D(bug("accl_sync_hook %08x\n", arg));
+	NQD_wait();
 	return true;
 }
 
+// Complete pending operations, e.g. at tick boundaries in deterministic mode
+void VideoSyncAccel(void)
+{
+	NQD_wait();
+}
+
 
 /*
  *	Install Native QuickDraw acceleration hooks
@@ -432,6 +424,12 @@ void VideoInstallAccel(void)
 		D(bug("Video: Installing acceleration hooks\n"));
 		uint32 base;
 
+		NQD_fill_row = nqd_select_fill_row();
+		NQD_invert_row = nqd_select_invert_row();
+#if NQD_ASYNC
+		NQD_start_thread();
+#endif
+
 		SheepVar bitblt_hook_info(sizeof(accl_hook_info));
 		base = bitblt_hook_info.addr();
 		WriteMacInt32(base + 0, NativeTVECT(NATIVE_NQD_BITBLT_HOOK));
@@ -446,6 +444,10 @@ void VideoInstallAccel(void)
 		WriteMacInt32(base + 8, ACCL_FILLRECT);
 		NQDMisc(6, fillrect_hook_info.addr());
 
+		// Lines and the other pattern transfer modes are left to the unknown
+		// hook: the layout of their parameter blocks (line end points, pen
+		// pattern) is undocumented, and guessed offsets would drive fills
+		// into host memory
 		for (int op = 0; op < 8; op++) {
 			switch (op) {
 			case ACCL_BITBLT:
@@ -461,3 +463,22 @@ void VideoInstallAccel(void)
 		}
 	}
 }
+
+
+/*
+ *	Stop Native QuickDraw acceleration
+ */
+
+void VideoExitAccel(void)
+{
+#if NQD_ASYNC
+	if (nqd_thread_active) {
+		pthread_mutex_lock(&nqd_lock);
+		nqd_thread_cancel = true;
+		pthread_cond_signal(&nqd_queued_cond);
+		pthread_mutex_unlock(&nqd_lock);
+		pthread_join(nqd_thread, NULL);
+		nqd_thread_active = false;
+	}
+#endif
+}
@@ -0,0 +1,674 @@
+/*
+ *  gfxaccel_ops.h - Native QuickDraw pixel kernels
+ *
+ *  SheepShaver (C) 1997-2008 Marc Hellwig and Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GFXACCEL_OPS_H
+#define GFXACCEL_OPS_H
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define NQD_USE_SSE2 1
+#else
+#define NQD_USE_SSE2 0
+#endif
+
+// AVX2 kernels are compiled separately and selected at run-time
+#if NQD_USE_SSE2 && (defined(__i386__) || defined(__x86_64__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#include "utils/utils-cpuinfo.hpp"
+#define NQD_USE_AVX2 1
+#define NQD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NQD_USE_AVX2 0
+#endif
+
+/*
+ *	All kernels operate on pixels in frame buffer (big endian) byte
+ *	order. Row lengths are expressed in bytes and are always a
+ *	multiple of the pixel size. Blit kernels process 16-byte chunks
+ *	with SSE2 where available, the remaining pixels with scalar code.
+ */
+
+// Transfer modes
+enum {
+	nqdSrcCopy			= 0,
+	nqdSrcOr			= 1,
+	nqdSrcXor			= 2,
+	nqdSrcBic			= 3,
+	nqdNotSrcCopy		= 4,
+	nqdNotSrcOr			= 5,
+	nqdNotSrcXor		= 6,
+	nqdNotSrcBic		= 7,
+	nqdPatCopy			= 8,
+	nqdPatOr			= 9,
+	nqdPatXor			= 10,
+	nqdPatBic			= 11,
+	nqdNotPatCopy		= 12,
+	nqdNotPatOr			= 13,
+	nqdNotPatXor		= 14,
+	nqdNotPatBic		= 15,
+	nqdBlend			= 32,
+	nqdAddPin			= 33,
+	nqdAddOver			= 34,
+	nqdSubPin			= 35,
+	nqdTransparent		= 36,
+	nqdAdMax			= 37,
+	nqdSubOver			= 38,
+	nqdAdMin			= 39,
+	nqdHilite			= 50
+};
+
+// Pixel value mask for a direct or indexed pixel of the given size
+static inline uint32 nqd_pixel_mask(int bpp)
+{
+	switch (bpp) {
+	case 1: return 0xff;
+	case 2: return 0x7fff;
+	}
+	return 0xffffff;
+}
+
+// Replicate a native pixel value into a 32-bit word in frame buffer order
+static inline uint32 nqd_pixel_pattern(int bpp, uint32 value)
+{
+	switch (bpp) {
+	case 1:
+		value &= 0xff;
+		value |= value << 8;
+		value |= value << 16;
+		break;
+	case 2:
+		value &= 0xffff;
+		value |= value << 16;
+		break;
+	}
+	return htonl(value);
+}
+
+#if NQD_USE_SSE2
+static inline __m128i nqd_vec_bswap_16(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+#endif
+
+
+/*
+ *	Transfer mode operations. Each one provides the per-pixel scalar
+ *	operation and the equivalent 16-byte vector operation. Boolean
+ *	modes do not depend on pixel boundaries and are run on bytes.
+ */
+
+struct nqd_op_base {
+	uint32 key;		// Transparent color pattern
+	uint32 mask;	// Significant bits of key pattern
+	nqd_op_base(uint32 k, uint32 m) : key(k), mask(m) { }
+};
+
+#if NQD_USE_SSE2
+#define NQD_DEFINE_BOOL_OP(NAME, EXPR, VEXPR)								\
+struct NAME : public nqd_op_base {											\
+	enum { bpp = 1 };														\
+	NAME(uint32 k, uint32 m) : nqd_op_base(k, m) { }						\
+	void pixel(uint8 *dp, const uint8 *sp) const {							\
+		const uint8 s = *sp, d = *dp; (void)d; *dp = (EXPR);				\
+	}																		\
+	__m128i vec(__m128i s, __m128i d) const {								\
+		const __m128i ones = _mm_set1_epi32(-1); (void)ones;				\
+		return (VEXPR);														\
+	}																		\
+}
+#else
+#define NQD_DEFINE_BOOL_OP(NAME, EXPR, VEXPR)								\
+struct NAME : public nqd_op_base {											\
+	enum { bpp = 1 };														\
+	NAME(uint32 k, uint32 m) : nqd_op_base(k, m) { }						\
+	void pixel(uint8 *dp, const uint8 *sp) const {							\
+		const uint8 s = *sp, d = *dp; (void)d; *dp = (EXPR);				\
+	}																		\
+}
+#endif
+
+NQD_DEFINE_BOOL_OP(nqd_op_or,		s | d,			_mm_or_si128(s, d));
+NQD_DEFINE_BOOL_OP(nqd_op_xor,		s ^ d,			_mm_xor_si128(s, d));
+NQD_DEFINE_BOOL_OP(nqd_op_bic,		~s & d,			_mm_andnot_si128(s, d));
+NQD_DEFINE_BOOL_OP(nqd_op_notcopy,	~s,				_mm_xor_si128(s, ones));
+NQD_DEFINE_BOOL_OP(nqd_op_notor,	~s | d,			_mm_or_si128(_mm_xor_si128(s, ones), d));
+NQD_DEFINE_BOOL_OP(nqd_op_notxor,	~s ^ d,			_mm_xor_si128(_mm_xor_si128(s, ones), d));
+NQD_DEFINE_BOOL_OP(nqd_op_notbic,	s & d,			_mm_and_si128(s, d));
+
+#undef NQD_DEFINE_BOOL_OP
+
+// transparent: copy source pixels that are not the background color
+template< int BPP >
+struct nqd_op_transparent : public nqd_op_base {
+	enum { bpp = BPP };
+	nqd_op_transparent(uint32 k, uint32 m) : nqd_op_base(k, m) { }
+	void pixel(uint8 *dp, const uint8 *sp) const {
+		switch (BPP) {
+		case 1:
+			if ((*sp & (uint8)mask) != (uint8)key)
+				*dp = *sp;
+			break;
+		case 2:
+			if ((*(uint16 *)sp & (uint16)mask) != (uint16)key)
+				*(uint16 *)dp = *(uint16 *)sp;
+			break;
+		case 4:
+			if ((*(uint32 *)sp & mask) != key)
+				*(uint32 *)dp = *(uint32 *)sp;
+			break;
+		}
+	}
+#if NQD_USE_SSE2
+	__m128i vec(__m128i s, __m128i d) const {
+		const __m128i k = _mm_set1_epi32(key);
+		const __m128i m = _mm_and_si128(s, _mm_set1_epi32(mask));
+		__m128i t;
+		switch (BPP) {
+		case 1:  t = _mm_cmpeq_epi8(m, k);  break;
+		case 2:  t = _mm_cmpeq_epi16(m, k); break;
+		default: t = _mm_cmpeq_epi32(m, k); break;
+		}
+		return _mm_or_si128(_mm_and_si128(t, d), _mm_andnot_si128(t, s));
+	}
+#endif
+};
+
+/*
+ *	Arithmetic modes on direct pixels. 16-bit pixels are handled as
+ *	SIMD-within-a-register on the native value with H marking the
+ *	most significant bit of each 5-bit component, 32-bit pixels as
+ *	four independent bytes.
+ */
+
+enum {
+	NQD_H16 = 0x4210, NQD_L16 = 0x3def,
+	NQD_R16 = 0x7c00, NQD_G16 = 0x03e0, NQD_B16 = 0x001f
+};
+
+static inline uint16 nqd_addover_16(uint16 s, uint16 d)
+{
+	return ((s & NQD_L16) + (d & NQD_L16)) ^ ((s ^ d) & NQD_H16);
+}
+
+static inline uint16 nqd_subover_16(uint16 s, uint16 d)
+{
+	return ((d | NQD_H16) - (s & NQD_L16)) ^ ((d ^ ~s) & NQD_H16);
+}
+
+static inline uint32 nqd_addover_32(uint32 s, uint32 d)
+{
+	return ((s & 0x7f7f7f7f) + (d & 0x7f7f7f7f)) ^ ((s ^ d) & 0x80808080);
+}
+
+static inline uint32 nqd_subover_32(uint32 s, uint32 d)
+{
+	return ((d | 0x80808080) - (s & 0x7f7f7f7f)) ^ ((d ^ ~s) & 0x80808080);
+}
+
+template< bool MAX >
+static inline uint16 nqd_admaxmin_16(uint16 s, uint16 d)
+{
+	uint16 r = 0;
+	static const uint16 fields[3] = { NQD_R16, NQD_G16, NQD_B16 };
+	for (int i = 0; i < 3; i++) {
+		const uint16 a = s & fields[i], b = d & fields[i];
+		r |= MAX ? (a > b ? a : b) : (a < b ? a : b);
+	}
+	return r;
+}
+
+template< bool MAX >
+static inline uint32 nqd_admaxmin_32(uint32 s, uint32 d)
+{
+	uint32 r = 0;
+	for (int i = 0; i < 32; i += 8) {
+		const uint32 a = s & (0xffU << i), b = d & (0xffU << i);
+		r |= MAX ? (a > b ? a : b) : (a < b ? a : b);
+	}
+	return r;
+}
+
+#define NQD_DEFINE_ARITH_OP(NAME, OP16, OP32, VEXPR16, VEXPR32)				\
+template< int BPP >															\
+struct NAME : public nqd_op_base {											\
+	enum { bpp = BPP };														\
+	NAME(uint32 k, uint32 m) : nqd_op_base(k, m) { }						\
+	void pixel(uint8 *dp, const uint8 *sp) const {							\
+		if (bpp == 2)														\
+			*(uint16 *)dp = htons(OP16(ntohs(*(uint16 *)sp), ntohs(*(uint16 *)dp))); \
+		else																\
+			*(uint32 *)dp = OP32(*(uint32 *)sp, *(uint32 *)dp);				\
+	}																		\
+	NQD_ARITH_VEC(VEXPR16, VEXPR32)											\
+}
+
+#if NQD_USE_SSE2
+#define NQD_ARITH_VEC(VEXPR16, VEXPR32)										\
+	__m128i vec(__m128i s, __m128i d) const {								\
+		if (bpp == 2) {														\
+			s = nqd_vec_bswap_16(s);										\
+			d = nqd_vec_bswap_16(d);										\
+			const __m128i H = _mm_set1_epi16(NQD_H16); (void)H;				\
+			const __m128i L = _mm_set1_epi16(NQD_L16); (void)L;				\
+			return nqd_vec_bswap_16(VEXPR16);								\
+		}																	\
+		return (VEXPR32);													\
+	}
+#else
+#define NQD_ARITH_VEC(VEXPR16, VEXPR32)
+#endif
+
+#if NQD_USE_SSE2
+static inline __m128i nqd_vec_admax_16(__m128i s, __m128i d)
+{
+	const __m128i R = _mm_set1_epi16(NQD_R16);
+	const __m128i G = _mm_set1_epi16(NQD_G16);
+	const __m128i B = _mm_set1_epi16(NQD_B16);
+	return _mm_or_si128(_mm_or_si128(
+		_mm_max_epi16(_mm_and_si128(s, R), _mm_and_si128(d, R)),
+		_mm_max_epi16(_mm_and_si128(s, G), _mm_and_si128(d, G))),
+		_mm_max_epi16(_mm_and_si128(s, B), _mm_and_si128(d, B)));
+}
+
+static inline __m128i nqd_vec_admin_16(__m128i s, __m128i d)
+{
+	const __m128i R = _mm_set1_epi16(NQD_R16);
+	const __m128i G = _mm_set1_epi16(NQD_G16);
+	const __m128i B = _mm_set1_epi16(NQD_B16);
+	return _mm_or_si128(_mm_or_si128(
+		_mm_min_epi16(_mm_and_si128(s, R), _mm_and_si128(d, R)),
+		_mm_min_epi16(_mm_and_si128(s, G), _mm_and_si128(d, G))),
+		_mm_min_epi16(_mm_and_si128(s, B), _mm_and_si128(d, B)));
+}
+#endif
+
+// addOver: add components, wrapping around
+NQD_DEFINE_ARITH_OP(nqd_op_addover, nqd_addover_16, nqd_addover_32,
+	_mm_xor_si128(_mm_add_epi16(_mm_and_si128(s, L), _mm_and_si128(d, L)), _mm_and_si128(_mm_xor_si128(s, d), H)),
+	_mm_add_epi8(s, d));
+
+// subOver: subtract source components from destination, wrapping around
+NQD_DEFINE_ARITH_OP(nqd_op_subover, nqd_subover_16, nqd_subover_32,
+	_mm_xor_si128(_mm_sub_epi16(_mm_or_si128(d, H), _mm_and_si128(s, L)), _mm_andnot_si128(_mm_xor_si128(d, s), H)),
+	_mm_sub_epi8(d, s));
+
+// adMax: keep the larger of each component
+NQD_DEFINE_ARITH_OP(nqd_op_admax, nqd_admaxmin_16<true>, nqd_admaxmin_32<true>,
+	nqd_vec_admax_16(s, d),
+	_mm_max_epu8(s, d));
+
+// adMin: keep the smaller of each component
+NQD_DEFINE_ARITH_OP(nqd_op_admin, nqd_admaxmin_16<false>, nqd_admaxmin_32<false>,
+	nqd_vec_admin_16(s, d),
+	_mm_min_epu8(s, d));
+
+#undef NQD_DEFINE_ARITH_OP
+#undef NQD_ARITH_VEC
+
+
+/*
+ *	Row and rectangle drivers
+ */
+
+template< class OP >
+static inline void nqd_blit_row(uint8 *dst, const uint8 *src, uint32 length, const OP & op)
+{
+	const int bpp = OP::bpp;
+	const uint32 tail = length & 15;
+	const uint32 chunks = length - tail;
+
+	if (dst > src && dst < src + length) {
+		// Overlapping with destination above source, walk backwards
+		for (uint32 i = length; i > chunks; ) {
+			i -= bpp;
+			op.pixel(dst + i, src + i);
+		}
+		for (uint32 i = chunks; i > 0; ) {
+			i -= 16;
+#if NQD_USE_SSE2
+			const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+			const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+			_mm_storeu_si128((__m128i *)(dst + i), op.vec(s, d));
+#else
+			for (int j = 16 - bpp; j >= 0; j -= bpp)
+				op.pixel(dst + i + j, src + i + j);
+#endif
+		}
+		return;
+	}
+
+	for (uint32 i = 0; i < chunks; i += 16) {
+#if NQD_USE_SSE2
+		const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		_mm_storeu_si128((__m128i *)(dst + i), op.vec(s, d));
+#else
+		for (int j = 0; j < 16; j += bpp)
+			op.pixel(dst + i + j, src + i + j);
+#endif
+	}
+	for (uint32 i = chunks; i < length; i += bpp)
+		op.pixel(dst + i, src + i);
+}
+
+template< class OP >
+static void nqd_blit_rect(uint8 *dst, int dst_row_bytes, const uint8 *src, int src_row_bytes, uint32 width, int height, uint32 key, uint32 mask)
+{
+	const OP op(key, mask);
+	for (int i = 0; i < height; i++) {
+		nqd_blit_row(dst, src, width, op);
+		src += src_row_bytes;
+		dst += dst_row_bytes;
+	}
+}
+
+// Check whether the transfer mode can be performed natively
+static inline bool nqd_bitblt_mode_supported(int mode, int bpp)
+{
+	switch (mode) {
+	case nqdSrcCopy: case nqdSrcOr: case nqdSrcXor: case nqdSrcBic:
+	case nqdNotSrcCopy: case nqdNotSrcOr: case nqdNotSrcXor: case nqdNotSrcBic:
+	case nqdTransparent:
+		return true;
+	case nqdAddOver: case nqdSubOver: case nqdAdMax: case nqdAdMin:
+		// Arithmetic modes on indexed pixels need the inverse color table
+		return bpp > 1;
+	}
+	return false;
+}
+
+/*
+ *	Blit a rectangle of width bytes and height rows with the given
+ *	transfer mode. Rows are walked in the order given by the sign of
+ *	row bytes. back_pen is the native background pixel value used by
+ *	the transparent mode.
+ */
+
+static bool nqd_do_bitblt(int mode, int bpp, uint8 *dst, int dst_row_bytes, const uint8 *src, int src_row_bytes, uint32 width, int height, uint32 back_pen)
+{
+	// Boolean modes are defined with black as ones. Direct pixels have
+	// white as ones, so the equivalent operation is the dual one.
+	if (bpp > 1 && mode <= nqdNotSrcBic && mode != nqdSrcCopy && mode != nqdNotSrcCopy)
+		mode = nqdNotSrcBic + 1 - mode;
+
+	const uint32 mask = nqd_pixel_pattern(bpp, nqd_pixel_mask(bpp));
+	const uint32 key = nqd_pixel_pattern(bpp, back_pen) & mask;
+
+#define BLIT(OP) nqd_blit_rect< OP >(dst, dst_row_bytes, src, src_row_bytes, width, height, key, mask)
+#define BLIT_BPP(OP) do {										\
+		switch (bpp) {											\
+		case 1: BLIT(OP<1>); break;								\
+		case 2: BLIT(OP<2>); break;								\
+		case 4: BLIT(OP<4>); break;								\
+		}														\
+	} while (0)
+#define BLIT_DIRECT(OP) do {									\
+		switch (bpp) {											\
+		case 2: BLIT(OP<2>); break;								\
+		case 4: BLIT(OP<4>); break;								\
+		}														\
+	} while (0)
+
+	switch (mode) {
+	case nqdSrcCopy:
+		for (int i = 0; i < height; i++) {
+			memmove(dst, src, width);
+			src += src_row_bytes;
+			dst += dst_row_bytes;
+		}
+		break;
+	case nqdSrcOr:			BLIT(nqd_op_or);					break;
+	case nqdSrcXor:			BLIT(nqd_op_xor);					break;
+	case nqdSrcBic:			BLIT(nqd_op_bic);					break;
+	case nqdNotSrcCopy:		BLIT(nqd_op_notcopy);				break;
+	case nqdNotSrcOr:		BLIT(nqd_op_notor);					break;
+	case nqdNotSrcXor:		BLIT(nqd_op_notxor);				break;
+	case nqdNotSrcBic:		BLIT(nqd_op_notbic);				break;
+	case nqdTransparent:	BLIT_BPP(nqd_op_transparent);		break;
+	default:
+		if (bpp == 1)
+			return false;
+		switch (mode) {
+		case nqdAddOver:	BLIT_DIRECT(nqd_op_addover);		break;
+		case nqdSubOver:	BLIT_DIRECT(nqd_op_subover);		break;
+		case nqdAdMax:		BLIT_DIRECT(nqd_op_admax);			break;
+		case nqdAdMin:		BLIT_DIRECT(nqd_op_admin);			break;
+		default:
+			return false;
+		}
+		break;
+	}
+
+#undef BLIT_DIRECT
+#undef BLIT_BPP
+#undef BLIT
+	return true;
+}
+
+
+/*
+ *	Fill and invert kernels. The destination is brought to vector
+ *	alignment with byte stores so that the main loop only issues
+ *	aligned stores, the pattern is rotated accordingly.
+ */
+
+typedef void (*nqd_fill_row_func)(uint8 *dst, uint32 length, uint32 pattern);
+typedef void (*nqd_invert_row_func)(uint8 *dst, uint32 length);
+
+// Rotate a pattern in frame buffer order to start n bytes later
+static inline uint32 nqd_pattern_rotate(uint32 pattern, uint32 n)
+{
+	uint8 b[8];
+	memcpy(b + 0, &pattern, 4);
+	memcpy(b + 4, &pattern, 4);
+	memcpy(&pattern, b + (n & 3), 4);
+	return pattern;
+}
+
+static inline void nqd_fill_bytes(uint8 *dst, uint32 length, uint32 pattern)
+{
+	const uint8 *b = (const uint8 *)&pattern;
+	for (uint32 i = 0; i < length; i++)
+		dst[i] = b[i & 3];
+}
+
+static inline void nqd_invert_bytes(uint8 *dst, uint32 length)
+{
+	for (uint32 i = 0; i < length; i++)
+		dst[i] = ~dst[i];
+}
+
+// Number of leading bytes to store before dst is aligned on align bytes
+static inline uint32 nqd_head_length(const uint8 *dst, uint32 length, uint32 align)
+{
+	const uint32 head = (uint32)(-(uintptr)dst) & (align - 1);
+	return head < length ? head : length;
+}
+
+static inline void nqd_fill_row_scalar(uint8 *dst, uint32 length, uint32 pattern)
+{
+	const uint32 head = nqd_head_length(dst, length, 4);
+	nqd_fill_bytes(dst, head, pattern);
+	pattern = nqd_pattern_rotate(pattern, head);
+	dst += head;
+	length -= head;
+
+	uint32 *p = (uint32 *)dst;
+	for (uint32 n = length / 4; n > 0; n--)
+		*p++ = pattern;
+	nqd_fill_bytes((uint8 *)p, length & 3, pattern);
+}
+
+static inline void nqd_invert_row_scalar(uint8 *dst, uint32 length)
+{
+	const uint32 head = nqd_head_length(dst, length, 4);
+	nqd_invert_bytes(dst, head);
+	dst += head;
+	length -= head;
+
+	uint32 *p = (uint32 *)dst;
+	for (uint32 n = length / 4; n > 0; n--, p++)
+		*p = ~*p;
+	nqd_invert_bytes((uint8 *)p, length & 3);
+}
+
+#if NQD_USE_SSE2
+static inline void nqd_fill_row_sse2(uint8 *dst, uint32 length, uint32 pattern)
+{
+	const uint32 head = nqd_head_length(dst, length, 16);
+	nqd_fill_bytes(dst, head, pattern);
+	pattern = nqd_pattern_rotate(pattern, head);
+	dst += head;
+	length -= head;
+
+	const __m128i v = _mm_set1_epi32(pattern);
+	__m128i *p = (__m128i *)dst;
+	for (uint32 n = length / 64; n > 0; n--, p += 4) {
+		_mm_store_si128(p + 0, v);
+		_mm_store_si128(p + 1, v);
+		_mm_store_si128(p + 2, v);
+		_mm_store_si128(p + 3, v);
+	}
+	for (uint32 n = (length / 16) & 3; n > 0; n--)
+		_mm_store_si128(p++, v);
+	nqd_fill_bytes((uint8 *)p, length & 15, pattern);
+}
+
+static inline void nqd_invert_row_sse2(uint8 *dst, uint32 length)
+{
+	const uint32 head = nqd_head_length(dst, length, 16);
+	nqd_invert_bytes(dst, head);
+	dst += head;
+	length -= head;
+
+	const __m128i ones = _mm_set1_epi32(-1);
+	__m128i *p = (__m128i *)dst;
+	for (uint32 n = length / 16; n > 0; n--, p++)
+		_mm_store_si128(p, _mm_xor_si128(_mm_load_si128(p), ones));
+	nqd_invert_bytes((uint8 *)p, length & 15);
+}
+#endif
+
+#if NQD_USE_AVX2
+NQD_TARGET_AVX2
+static inline void nqd_fill_row_avx2(uint8 *dst, uint32 length, uint32 pattern)
+{
+	const uint32 head = nqd_head_length(dst, length, 32);
+	nqd_fill_bytes(dst, head, pattern);
+	pattern = nqd_pattern_rotate(pattern, head);
+	dst += head;
+	length -= head;
+
+	const __m256i v = _mm256_set1_epi32(pattern);
+	__m256i *p = (__m256i *)dst;
+	for (uint32 n = length / 128; n > 0; n--, p += 4) {
+		_mm256_store_si256(p + 0, v);
+		_mm256_store_si256(p + 1, v);
+		_mm256_store_si256(p + 2, v);
+		_mm256_store_si256(p + 3, v);
+	}
+	for (uint32 n = (length / 32) & 3; n > 0; n--)
+		_mm256_store_si256(p++, v);
+	nqd_fill_bytes((uint8 *)p, length & 31, pattern);
+}
+
+NQD_TARGET_AVX2
+static inline void nqd_invert_row_avx2(uint8 *dst, uint32 length)
+{
+	const uint32 head = nqd_head_length(dst, length, 32);
+	nqd_invert_bytes(dst, head);
+	dst += head;
+	length -= head;
+
+	const __m256i ones = _mm256_set1_epi32(-1);
+	__m256i *p = (__m256i *)dst;
+	for (uint32 n = length / 32; n > 0; n--, p++)
+		_mm256_store_si256(p, _mm256_xor_si256(_mm256_load_si256(p), ones));
+	nqd_invert_bytes((uint8 *)p, length & 31);
+}
+#endif
+
+// Select the best row kernels for this host
+static inline nqd_fill_row_func nqd_select_fill_row(void)
+{
+#if NQD_USE_AVX2
+	if (cpuinfo_check_avx2())
+		return nqd_fill_row_avx2;
+#endif
+#if NQD_USE_SSE2
+	return nqd_fill_row_sse2;
+#else
+	return nqd_fill_row_scalar;
+#endif
+}
+
+static inline nqd_invert_row_func nqd_select_invert_row(void)
+{
+#if NQD_USE_AVX2
+	if (cpuinfo_check_avx2())
+		return nqd_invert_row_avx2;
+#endif
+#if NQD_USE_SSE2
+	return nqd_invert_row_sse2;
+#else
+	return nqd_invert_row_scalar;
+#endif
+}
+
+// Fill or invert a single pixel column, i.e. a vertical line
+static inline void nqd_fill_column(uint8 *dst, int row_bytes, int height, int bpp, uint32 pattern)
+{
+	switch (bpp) {
+	case 1:
+		for (int i = 0; i < height; i++, dst += row_bytes)
+			*dst = (uint8)pattern;
+		break;
+	case 2:
+		for (int i = 0; i < height; i++, dst += row_bytes)
+			*(uint16 *)dst = (uint16)pattern;
+		break;
+	case 4:
+		for (int i = 0; i < height; i++, dst += row_bytes)
+			*(uint32 *)dst = pattern;
+		break;
+	}
+}
+
+static inline void nqd_invert_column(uint8 *dst, int row_bytes, int height, int bpp)
+{
+	switch (bpp) {
+	case 1:
+		for (int i = 0; i < height; i++, dst += row_bytes)
+			*dst = ~*dst;
+		break;
+	case 2:
+		for (int i = 0; i < height; i++, dst += row_bytes)
+			*(uint16 *)dst = ~*(uint16 *)dst;
+		break;
+	case 4:
+		for (int i = 0; i < height; i++, dst += row_bytes)
+			*(uint32 *)dst = ~*(uint32 *)dst;
+		break;
+	}
+}
+
+#endif /* GFXACCEL_OPS_H */
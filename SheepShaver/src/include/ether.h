@@ -49,6 +49,7 @@ extern void OTEnterInterrupt(void);
 extern void OTLeaveInterrupt(void);
 
 extern void ether_dispatch_packet(uint32 p, uint32 length);
+extern void ether_packet_input(const uint8 *data, uint32 length);
 extern void ether_packet_received(mblk_t *mp);
 
 extern bool ether_driver_opened;
@@ -97,5 +98,6 @@ extern int32 num_rx_no_mem;
 extern int32 num_rx_dropped;
 extern int32 num_rx_stream_not_ready;
 extern int32 num_rx_no_unitdata_mem;
+extern int32 num_rx_recycled;
 
 #endif
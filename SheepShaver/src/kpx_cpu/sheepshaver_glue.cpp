@@ -715,6 +715,12 @@ sigsegv_return_t sigsegv_handler(sigsegv_info_t *sip)
 #endif
 
 	const uintptr addr = (uintptr)sigsegv_get_fault_address(sip);
+#if PPC_SMC_WRITE_PROTECT
+	// Store to a page holding translated code
+	if ((addr - (uintptr)RAMBaseHost) < RAMSize && the_app->ppc_cpu &&
+		the_app->ppc_cpu->handle_code_write(Host2MacAddr((uint8 *)addr)))
+		return SIGSEGV_RETURN_SUCCESS;
+#endif
 #if HAVE_SIGSEGV_SKIP_INSTRUCTION
 	// Ignore writes to ROM
 	if ((addr - (uintptr)ROMBaseHost) < ROM_SIZE)
@@ -788,6 +794,10 @@ void sheepshaver_state::init_emul_ppc(void)
 
 	// Initialize main CPU emulator
 	ppc_cpu = new sheepshaver_cpu();
+#if PPC_SMC_WRITE_PROTECT
+	// Catch stores to translated code in Mac RAM
+	ppc_cpu->enable_code_protection(RAMBase, RAMSize);
+#endif
 	ppc_cpu->set_register(powerpc_registers::GPR(3), any_register((uint32)ROMBase + 0x30d000));
 	ppc_cpu->set_register(powerpc_registers::GPR(4), any_register(KernelDataAddr + 0x1000));
 	WriteMacInt32(XLM_RUN_MODE, MODE_68K);
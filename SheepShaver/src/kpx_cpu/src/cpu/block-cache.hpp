@@ -31,17 +31,56 @@ private:
 	static const uint32 HASH_SIZE = 1 << HASH_BITS;
 	static const uint32 HASH_MASK = HASH_SIZE - 1;
 
+	// Blocks are indexed by guest page, then by entry point offset
+	static const uint32 PAGE_BITS = 12;
+	static const uint32 SLOT_BITS = PAGE_BITS - 2;
+	static const uint32 SLOT_COUNT = 1 << SLOT_BITS;
+	static const uint32 TABLE_BITS = 10;
+	static const uint32 TABLE_SIZE = 1 << TABLE_BITS;
+	static const uint32 DIR_SIZE = 1 << (32 - PAGE_BITS - TABLE_BITS);
+
+	// Code bytes are tracked within a page by 32-byte granules
+	static const uint32 GRANULE_BITS = 5;
+	static const uint32 CODE_MAP_WORDS = 1 << (PAGE_BITS - GRANULE_BITS - 5);
+
+	// Ranges larger than that are flushed by walking the active list
+	static const uint32 MAX_PAGES_TO_SCAN = 256;
+
+	struct entry;
+
+	// Link of a block into the list of blocks touching a page
+	struct page_link
+	{
+		entry *					bce;
+		page_link *				next;
+		page_link **			prev_p;
+	};
+
 	struct entry
 		: public block_info
 	{
-		entry *					next_same_cl;
-		entry **				prev_same_cl_p;
+		page_link *				page_links;		// One link per page from min_pc to max_pc
+		uint32					n_page_links;
+		page_link				inline_links[2];	// Storage for blocks spanning up to two pages
 		entry *					next;
 		entry **				prev_p;
 	};
 
+	struct page
+	{
+		entry *					blocks[SLOT_COUNT];
+		page_link *				links;
+		uint32					code_map[CODE_MAP_WORDS];
+	};
+
+	struct page_table
+	{
+		page *					pages[TABLE_SIZE];
+	};
+
 	block_allocator<entry>		allocator;
 	entry *						cache_tags[HASH_SIZE];
+	page_table *				page_dir[DIR_SIZE];
 	entry *						active;
 	entry *						dormant;
 
@@ -49,6 +88,16 @@ private:
 		return (addr >> 2) & HASH_MASK;
 	}
 
+	page *find_page(uintptr addr) const;
+	page *get_page(uintptr addr);
+	void release_pages();
+	void add_page_link(entry *bce, int n, uintptr addr);
+	void remove_page_link(entry *bce, int n);
+	void release_page_links(entry *bce);
+	void clear_block(entry *bce);
+	void mark_code(page *pg, uint32 start, uint32 end);
+	bool has_code(page *pg, uint32 start, uint32 end) const;
+
 public:
 
 	block_cache();
@@ -60,6 +109,8 @@ public:
 	void initialize();
 	void clear();
 	void clear_range(uintptr start, uintptr end);
+	bool clear_page_range(uintptr start, uintptr end);
+	bool has_code(uintptr start, uintptr end) const;
 	block_info *fast_find(uintptr pc);
 	block_info *find(uintptr pc);
 
@@ -78,6 +129,8 @@ template< class block_info, template<class T> class block_allocator >
 block_cache< block_info, block_allocator >::block_cache()
 	: active(NULL), dormant(NULL)
 {
+	for (int i = 0; i < DIR_SIZE; i++)
+		page_dir[i] = NULL;
 	initialize();
 }
 
@@ -92,6 +145,21 @@ void block_cache< block_info, block_allocator >::initialize()
 {
 	for (int i = 0; i < HASH_SIZE; i++)
 		cache_tags[i] = NULL;
+	release_pages();
+}
+
+template< class block_info, template<class T> class block_allocator >
+void block_cache< block_info, block_allocator >::release_pages()
+{
+	for (int i = 0; i < DIR_SIZE; i++) {
+		page_table *pt = page_dir[i];
+		if (pt == NULL)
+			continue;
+		for (int j = 0; j < TABLE_SIZE; j++)
+			delete pt->pages[j];
+		delete pt;
+		page_dir[i] = NULL;
+	}
 }
 
 template< class block_info, template<class T> class block_allocator >
@@ -114,6 +182,133 @@ void block_cache< block_info, block_allocator >::clear()
 		delete_blockinfo(d);
 	}
 	dormant = NULL;
+
+	release_pages();
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline typename block_cache< block_info, block_allocator >::page *
+block_cache< block_info, block_allocator >::find_page(uintptr addr) const
+{
+	const uint32 pn = (uint32)addr >> PAGE_BITS;
+	page_table *pt = page_dir[pn >> TABLE_BITS];
+	return pt ? pt->pages[pn & (TABLE_SIZE - 1)] : NULL;
+}
+
+template< class block_info, template<class T> class block_allocator >
+typename block_cache< block_info, block_allocator >::page *
+block_cache< block_info, block_allocator >::get_page(uintptr addr)
+{
+	const uint32 pn = (uint32)addr >> PAGE_BITS;
+	page_table *pt = page_dir[pn >> TABLE_BITS];
+	if (pt == NULL) {
+		pt = new page_table;
+		for (int i = 0; i < TABLE_SIZE; i++)
+			pt->pages[i] = NULL;
+		page_dir[pn >> TABLE_BITS] = pt;
+	}
+	page *pg = pt->pages[pn & (TABLE_SIZE - 1)];
+	if (pg == NULL) {
+		pg = new page;
+		for (int i = 0; i < SLOT_COUNT; i++)
+			pg->blocks[i] = NULL;
+		pg->links = NULL;
+		for (int i = 0; i < CODE_MAP_WORDS; i++)
+			pg->code_map[i] = 0;
+		pt->pages[pn & (TABLE_SIZE - 1)] = pg;
+	}
+	return pg;
+}
+
+template< class block_info, template<class T> class block_allocator >
+void block_cache< block_info, block_allocator >::add_page_link(entry *bce, int n, uintptr addr)
+{
+	page *pg = get_page(addr);
+	page_link *l = &bce->page_links[n];
+	l->bce = bce;
+	if (pg->links)
+		pg->links->prev_p = &l->next;
+	l->next = pg->links;
+	pg->links = l;
+	l->prev_p = &pg->links;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void block_cache< block_info, block_allocator >::remove_page_link(entry *bce, int n)
+{
+	page_link *l = &bce->page_links[n];
+	if (l->prev_p)
+		*l->prev_p = l->next;
+	if (l->next)
+		l->next->prev_p = l->prev_p;
+	l->prev_p = NULL;
+	l->next = NULL;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void block_cache< block_info, block_allocator >::release_page_links(entry *bce)
+{
+	for (uint32 n = 0; n < bce->n_page_links; n++)
+		remove_page_link(bce, n);
+	if (bce->page_links != bce->inline_links)
+		delete[] bce->page_links;
+	bce->page_links = bce->inline_links;
+	bce->n_page_links = 0;
+}
+
+template< class block_info, template<class T> class block_allocator >
+void block_cache< block_info, block_allocator >::mark_code(page *pg, uint32 start, uint32 end)
+{
+	// Mark granules covering page offsets [START, END)
+	const uint32 last = (end - 1) >> GRANULE_BITS;
+	for (uint32 g = start >> GRANULE_BITS; g <= last; g++)
+		pg->code_map[g >> 5] |= 1 << (g & 31);
+}
+
+template< class block_info, template<class T> class block_allocator >
+bool block_cache< block_info, block_allocator >::has_code(page *pg, uint32 start, uint32 end) const
+{
+	if (pg->links == NULL)
+		return false;
+	const uint32 last = (end - 1) >> GRANULE_BITS;
+	for (uint32 g = start >> GRANULE_BITS; g <= last; g++) {
+		if (pg->code_map[g >> 5] & (1 << (g & 31)))
+			return true;
+	}
+	return false;
+}
+
+template< class block_info, template<class T> class block_allocator >
+bool block_cache< block_info, block_allocator >::has_code(uintptr start, uintptr end) const
+{
+	if (!active || start >= end)
+		return false;
+
+	const uint32 page_size = 1 << PAGE_BITS;
+	const uint32 start_pn = (uint32)start >> PAGE_BITS;
+	const uint32 end_pn = (uint32)(end - 1) >> PAGE_BITS;
+	if (end_pn - start_pn >= MAX_PAGES_TO_SCAN)
+		return true;
+
+	for (uint32 pn = start_pn; pn <= end_pn; pn++) {
+		page *pg = find_page((uintptr)pn << PAGE_BITS);
+		if (pg == NULL)
+			continue;
+		const uint32 lo = pn == start_pn ? (uint32)start & (page_size - 1) : 0;
+		const uint32 hi = pn == end_pn ? ((uint32)(end - 1) & (page_size - 1)) + 1 : page_size;
+		if (has_code(pg, lo, hi))
+			return true;
+	}
+	return false;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void block_cache< block_info, block_allocator >::clear_block(entry *q)
+{
+	q->invalidate();
+	remove_from_cl_list(q);
+	remove_from_list(q);
+	delete_blockinfo(q);
 }
 
 template< class block_info, template<class T> class block_allocator >
@@ -122,43 +317,93 @@ void block_cache< block_info, block_allocator >::clear_range(uintptr start, uint
 	if (!active)
 		return;
 
-	entry *p, *q;
-	if (cacheline(start) < cacheline(end - 1)) {
-		// Optimize for short ranges flush
-		const int end_cl = cacheline(end - 1);
-		for (int cl = cacheline(start); cl <= end_cl; cl++) {
-			p = cache_tags[cl];
-			while (p) {
-				q = p;
-				p = p->next_same_cl;
-				if (q->intersect(start, end)) {
-					q->invalidate();
-					remove_from_cl_list(q);
-					remove_from_list(q);
-					delete_blockinfo(q);
-				}
+	const uint32 start_pn = (uint32)start >> PAGE_BITS;
+	const uint32 end_pn = (uint32)(end - 1) >> PAGE_BITS;
+	if (start < end && end_pn - start_pn < MAX_PAGES_TO_SCAN) {
+		// Only look at blocks covering the affected pages, and skip
+		// pages where the range covers no translated code
+		const uint32 page_size = 1 << PAGE_BITS;
+		for (uint32 pn = start_pn; pn <= end_pn; pn++) {
+			page *pg = find_page((uintptr)pn << PAGE_BITS);
+			if (pg == NULL)
+				continue;
+			const uint32 lo = pn == start_pn ? (uint32)start & (page_size - 1) : 0;
+			const uint32 hi = pn == end_pn ? ((uint32)(end - 1) & (page_size - 1)) + 1 : page_size;
+			if (!has_code(pg, lo, hi))
+				continue;
+			page_link *l = pg->links;
+			while (l) {
+				entry *q = l->bce;
+				l = l->next;
+				if (q->intersect(start, end))
+					clear_block(q);
+			}
+			if (pg->links == NULL) {
+				for (int i = 0; i < CODE_MAP_WORDS; i++)
+					pg->code_map[i] = 0;
 			}
 		}
 	}
 	else {
+		entry *p, *q;
 		p = active;
 		while (p) {
 			q = p;
 			p = p->next;
-			if (q->intersect(start, end)) {
-				q->invalidate();
-				remove_from_cl_list(q);
-				remove_from_list(q);
-				delete_blockinfo(q);
-			}
+			if (q->intersect(start, end))
+				clear_block(q);
+		}
+	}
+}
+
+template< class block_info, template<class T> class block_allocator >
+bool block_cache< block_info, block_allocator >::clear_page_range(uintptr start, uintptr end)
+{
+	// Remove blocks intersecting [START, END), which lies within one
+	// page, without rounding to page boundaries: blocks are only chained
+	// to blocks starting in their own page, so drop the links of the
+	// blocks left in the pages of the removed ones instead
+	const uint32 page_size = 1 << PAGE_BITS;
+	page *pg = find_page(start);
+	if (pg == NULL || !has_code(pg, (uint32)start & (page_size - 1), ((uint32)(end - 1) & (page_size - 1)) + 1))
+		return false;
+
+	uintptr min_pc = start;
+	bool cleared = false;
+	page_link *l = pg->links;
+	while (l) {
+		entry *q = l->bce;
+		l = l->next;
+		if (q->intersect(start, end)) {
+			if (q->pc < min_pc)
+				min_pc = q->pc;
+			clear_block(q);
+			cleared = true;
+		}
+	}
+	if (pg->links == NULL) {
+		for (int i = 0; i < CODE_MAP_WORDS; i++)
+			pg->code_map[i] = 0;
+	}
+
+	if (cleared) {
+		for (uintptr addr = min_pc & -page_size; addr <= start; addr += page_size) {
+			page *p = find_page(addr);
+			if (p == NULL)
+				continue;
+			for (page_link *pl = p->links; pl; pl = pl->next)
+				pl->bce->invalidate();
 		}
 	}
+	return cleared;
 }
 
 template< class block_info, template<class T> class block_allocator >
 inline block_info *block_cache< block_info, block_allocator >::new_blockinfo()
 {
 	entry * bce = allocator.acquire();
+	bce->page_links = bce->inline_links;
+	bce->n_page_links = 0;
 	return bce;
 }
 
@@ -166,6 +411,8 @@ template< class block_info, template<class T> class block_allocator >
 inline void block_cache< block_info, block_allocator >::delete_blockinfo(block_info *bi)
 {
 	entry * bce = (entry *)bi;
+	if (bce->page_links != bce->inline_links)
+		delete[] bce->page_links;
 	allocator.release(bce);
 }
 
@@ -188,13 +435,11 @@ block_info *block_cache< block_info, block_allocator >::find(uintptr pc)
 	if (bce && bce->pc == pc)
 		return bce;
 
-	// Miss: perform full list search and move block to front if found
-	while (bce) {
-		bce = bce->next_same_cl;
-		if (bce && bce->pc == pc) {
-			raise_in_cl_list(bce);
-			return bce;
-		}
+	// Miss: look up the page table and refill the cache tag if found
+	page *pg = find_page(pc);
+	if (pg && (bce = pg->blocks[(pc >> 2) & (SLOT_COUNT - 1)]) != NULL && bce->pc == pc) {
+		cache_tags[cacheline(pc)] = bce;
+		return bce;
 	}
 
 	// Found none, will have to create a new block
@@ -205,30 +450,53 @@ template< class block_info, template<class T> class block_allocator >
 void block_cache< block_info, block_allocator >::remove_from_cl_list(block_info *bi)
 {
 	entry * bce = (entry *)bi;
-	if (bce->prev_same_cl_p)
-		*bce->prev_same_cl_p = bce->next_same_cl;
-	if (bce->next_same_cl)
-		bce->next_same_cl->prev_same_cl_p = bce->prev_same_cl_p;
+	const uint32 cl = cacheline(bi->pc);
+	if (cache_tags[cl] == bce)
+		cache_tags[cl] = NULL;
+
+	page *pg = find_page(bi->pc);
+	if (pg) {
+		entry **slot = &pg->blocks[(bi->pc >> 2) & (SLOT_COUNT - 1)];
+		if (*slot == bce)
+			*slot = NULL;
+	}
+
+	release_page_links(bce);
 }
 
 template< class block_info, template<class T> class block_allocator >
 void block_cache< block_info, block_allocator >::add_to_cl_list(block_info *bi)
 {
 	entry * bce = (entry *)bi;
-	const uint32 cl = cacheline(bi->pc);
-	if (cache_tags[cl])
-		cache_tags[cl]->prev_same_cl_p = &bce->next_same_cl;
-	bce->next_same_cl = cache_tags[cl];
-	
-	cache_tags[cl] = bce;
-	bce->prev_same_cl_p = &cache_tags[cl];
+	get_page(bi->pc)->blocks[(bi->pc >> 2) & (SLOT_COUNT - 1)] = bce;
+	cache_tags[cacheline(bi->pc)] = bce;
+
+	// Register the block in every page it covers, clear_range() and
+	// has_code() only look at these pages
+	const uint32 page_size = 1 << PAGE_BITS;
+	const uint32 lo = bi->min_pc;
+	const uint32 hi = bi->max_pc + 4;
+	const uint32 start_pn = lo >> PAGE_BITS;
+	const uint32 end_pn = (hi - 1) >> PAGE_BITS;
+	release_page_links(bce);
+	bce->n_page_links = end_pn - start_pn + 1;
+	if (bce->n_page_links > sizeof(bce->inline_links) / sizeof(bce->inline_links[0]))
+		bce->page_links = new page_link[bce->n_page_links];
+
+	// Record which bytes of these pages hold code
+	for (uint32 pn = start_pn; pn <= end_pn; pn++) {
+		const uintptr addr = (uintptr)pn << PAGE_BITS;
+		add_page_link(bce, pn - start_pn, addr);
+		const uint32 page_lo = pn == start_pn ? lo & (page_size - 1) : 0;
+		const uint32 page_hi = pn == end_pn ? ((hi - 1) & (page_size - 1)) + 1 : page_size;
+		mark_code(get_page(addr), page_lo, page_hi);
+	}
 }
 
 template< class block_info, template<class T> class block_allocator >
 inline void block_cache< block_info, block_allocator >::raise_in_cl_list(block_info *bi)
 {
-	remove_from_cl_list(bi);
-	add_to_cl_list(bi);
+	cache_tags[cacheline(bi->pc)] = (entry *)bi;
 }
 
 template< class block_info, template<class T> class block_allocator >
@@ -498,10 +498,22 @@ public:
 	DEFINE_OP_PS(rsqrt, RSQRT);
 	DEFINE_OP_SS(sqrt, SQRT);
 	DEFINE_OP_PS(sqrt, SQRT);
-	DEFINE_OP_SS(comi, COMI);
-	DEFINE_OP_SD(comi, COMI);
-	DEFINE_OP_SS(ucomi, UCOMI);
-	DEFINE_OP_SD(ucomi, UCOMI);
+
+	// (U)COMISS and (U)COMISD use the packed instructions encoding
+#define DEFINE_OP_C(NAME, OP)									\
+	void gen_##NAME##ss(x86_memory_operand const & mem, int d)	\
+		{ gen_sse_arith_ps(X86_SSE_##OP, mem, d); }				\
+	void gen_##NAME##ss(int s, int d)							\
+		{ gen_sse_arith_ps(X86_SSE_##OP, s, d); }				\
+	void gen_##NAME##sd(x86_memory_operand const & mem, int d)	\
+		{ gen_sse_arith_pd(X86_SSE_##OP, mem, d); }				\
+	void gen_##NAME##sd(int s, int d)							\
+		{ gen_sse_arith_pd(X86_SSE_##OP, s, d); }
+
+	DEFINE_OP_C(comi, COMI);
+	DEFINE_OP_C(ucomi, UCOMI);
+
+#undef DEFINE_OP_C
 
 #undef DEFINE_OP
 #undef DEFINE_OP_S
@@ -525,6 +537,8 @@ public:
 	DEFINE_OP(movapd, MOVAPD);
 	DEFINE_OP(movdqa, MOVDQA);
 	DEFINE_OP(movdqu, MOVDQU);
+	DEFINE_OP(movss, MOVSS);
+	DEFINE_OP(movsd, MOVSD);
 
 #undef DEFINE_OP
 
@@ -537,6 +551,10 @@ public:
 		{ GEN_CODE(OP##mr(mem.MD, mem.MB, mem.MI, mem.MS, d)); }
 
 	DEFINE_OP(movd_lx, MOVDXD);
+	DEFINE_OP(cvtsd2ss, CVTSD2SS);
+	DEFINE_OP(cvtss2sd, CVTSS2SD);
+	DEFINE_OP(cvtsd2si_32, CVTSD2SIL);
+	DEFINE_OP(cvttsd2si_32, CVTTSD2SIL);
 
 #undef DEFINE_OP
 
@@ -676,6 +694,35 @@ private:
 	void gen_ssse3_arith(int op1, int op2, x86_immediate_operand const & imm, x86_memory_operand const & mem, int d)
 		{ GEN_CODE(_SSSE3Limr(op1, op2, imm.value, mem.MD, mem.MB, mem.MI, mem.MS, d)); }
 
+public:
+
+#define DEFINE_OP(NAME, OP)								\
+	void gen_##NAME(int s, int d)						\
+		{ gen_ssse3_arith(0x38, X86_SSE4_##OP, s, d); }	\
+	void gen_##NAME(x86_memory_operand const & mem, int d)	\
+		{ gen_ssse3_arith(0x38, X86_SSE4_##OP, mem, d); }
+
+	DEFINE_OP(packusdw, PACKUSDW);
+	DEFINE_OP(pmaxsb, PMAXSB);
+	DEFINE_OP(pmaxsd, PMAXSD);
+	DEFINE_OP(pmaxud, PMAXUD);
+	DEFINE_OP(pmaxuw, PMAXUW);
+	DEFINE_OP(pminsb, PMINSB);
+	DEFINE_OP(pminsd, PMINSD);
+	DEFINE_OP(pminud, PMINUD);
+	DEFINE_OP(pminuw, PMINUW);
+	DEFINE_OP(pmulld, PMULLD);
+
+#undef DEFINE_OP
+
+	// AVX2 variable shifts, d = v shifted by the counts in s
+	void gen_vpsllvd(int s, int v, int d)
+		{ GEN_CODE(VPSLLVDrrr(s, v, d)); }
+	void gen_vpsravd(int s, int v, int d)
+		{ GEN_CODE(VPSRAVDrrr(s, v, d)); }
+	void gen_vpsrlvd(int s, int v, int d)
+		{ GEN_CODE(VPSRLVDrrr(s, v, d)); }
+
 };
 
 enum {
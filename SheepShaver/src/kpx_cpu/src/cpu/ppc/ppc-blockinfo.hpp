@@ -36,6 +36,14 @@ struct powerpc_block_info
 	{
 		execute_fn		execute;
 		uint32			opcode;
+#if PPC_THREADED_CODE
+		uint16			op;						// Threaded code operation
+		uint8			rD, rA;					// Pre-extracted operands
+		const void *	handler;				// Threaded code address
+		int32			imm;
+		uint8			rD2, rA2;				// Operands of fused instruction
+		int16			imm2;
+#endif
 	};
 
 #if PPC_DECODE_CACHE
@@ -78,7 +86,8 @@ powerpc_block_info::init(uintptr start_pc)
 inline bool
 powerpc_block_info::intersect(uintptr start, uintptr end)
 {
-	return (min_pc >= start && min_pc < end) || (max_pc >= start && max_pc < end);
+	// The block covers [min_pc, max_pc + 4), which may contain the whole range
+	return min_pc < end && max_pc + 4 > start;
 }
 
 #endif /* PPC_BLOCKINFO_H */
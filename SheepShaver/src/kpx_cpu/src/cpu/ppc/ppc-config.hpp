@@ -62,6 +62,25 @@
 #endif
 
 
+/**
+ *	PPC_THREADED_CODE
+ *
+ *		Define to 1 if the decode cache shall be run as direct threaded
+ *		code. The most common integer and load/store instructions are
+ *		then executed inline from pre-extracted operands, and a few
+ *		frequent pairs are fused into a single dispatch. This requires
+ *		the GNU C labels as values extension.
+ **/
+
+#ifndef PPC_THREADED_CODE
+#if PPC_DECODE_CACHE && defined(__GNUC__)
+#define PPC_THREADED_CODE 1
+#else
+#define PPC_THREADED_CODE 0
+#endif
+#endif
+
+
 /**
  *	PPC_ENABLE_JIT
  *
@@ -88,6 +107,41 @@
 #endif
 
 
+/**
+ *	PPC_NATIVE_CODEGEN
+ *
+ *		Define to 1 if the JIT shall emit host code directly for the
+ *		most common integer, load/store, rotate and branch
+ *		instructions. Other instructions still go through dyngen ops.
+ *		This is only supported on x86_64 hosts for now.
+ **/
+
+#ifndef PPC_NATIVE_CODEGEN
+#if PPC_ENABLE_JIT && defined(__x86_64__)
+#define PPC_NATIVE_CODEGEN 1
+#else
+#define PPC_NATIVE_CODEGEN 0
+#endif
+#endif
+
+
+/**
+ *	PPC_SMC_WRITE_PROTECT
+ *
+ *		Define to 1 to have SheepShaver write-protect the host pages
+ *		backing translated code in Mac RAM, so that stores to code bytes
+ *		invalidate the affected blocks without waiting for an explicit
+ *		cache flush. The CPU core always supports it once
+ *		enable_code_protection() is called, but this needs a SIGSEGV
+ *		handler forwarding faults to handle_code_write(), and host-side
+ *		I/O must not read() directly into protected pages.
+ **/
+
+#ifndef PPC_SMC_WRITE_PROTECT
+#define PPC_SMC_WRITE_PROTECT 0
+#endif
+
+
 /**
  *	PPC_EXECUTE_DUMP_STATE
  *
@@ -24,6 +24,8 @@
 #include "vm_alloc.h"
 #include "cpu/vm.hpp"
 #include "cpu/ppc/ppc-cpu.hpp"
+#include "cpu/ppc/ppc-operands.hpp"
+#include "cpu/ppc/ppc-operations.hpp"
 #ifndef SHEEPSHAVER
 #include "basic-kernel.hpp"
 #include "video.h"
@@ -43,7 +45,9 @@
 #define DEBUG 1
 #include "debug.h"
 
+#ifndef EMU_KHEPERIX
 #include "app.hpp"
+#endif
 
 
 #if PPC_PROFILE_GENERIC_CALLS
@@ -134,6 +138,7 @@ void powerpc_cpu::init_registers()
 		fpr(i) = 0;
 	}
 	cr().set(0);
+	fprf_pending = FPRF_NONE;
 	fpscr() = 0;
 	xer().set(0);
 	lr() = 0;
@@ -269,6 +274,7 @@ void powerpc_cpu::initialize()
 	init_registers();
 	init_decode_cache();
 	execute_depth = 0;
+	interpret_only = false;
 	execute_start_time = clock();
 	cycles = audio_period_cycles = via_period_cycles = 0;
 	next = GetTicks_usec();
@@ -281,6 +287,14 @@ void powerpc_cpu::initialize()
 	// Init cache range invalidate recorder
 	cache_range.start = cache_range.end = 0;
 
+	// Code pages are not write-protected until enable_code_protection()
+	code_protect_base = 0;
+	code_protect_pages = 0;
+	code_page_state = NULL;
+	code_page_copy = NULL;
+	code_page_scratch = NULL;
+	code_protect_lock = SPIN_LOCK_UNLOCKED;
+
 	// Init syscalls handler
 	execute_do_syscall = NULL;
 
@@ -450,6 +464,14 @@ powerpc_cpu::~powerpc_cpu()
 
 	kill_decode_cache();
 
+	if (code_page_copy) {
+		for (uint32 pn = 0; pn < code_protect_pages; pn++)
+			delete[] code_page_copy[pn];
+	}
+	delete[] code_page_copy;
+	delete[] code_page_scratch;
+	delete[] code_page_state;
+
 #if ENABLE_MON
 	mon_exit();
 #endif
@@ -514,6 +536,11 @@ void powerpc_registers::interrupt_copy(powerpc_registers &oregs, powerpc_registe
 
 spcflags_check_result_t powerpc_cpu::check_spcflags()
 {
+	// Flush first, the code returning may have stored to code pages
+	if (spcflags().test(SPCFLAG_CPU_FLUSH_CODE)) {
+		spcflags().clear(SPCFLAG_CPU_FLUSH_CODE);
+		flush_written_code();
+	}
 	if (spcflags().test(SPCFLAG_CPU_EXEC_RETURN)) {
 		spcflags().clear(SPCFLAG_CPU_EXEC_RETURN);
 		return RESULT_RETURN;
@@ -527,9 +554,11 @@ spcflags_check_result_t powerpc_cpu::check_spcflags()
 		} else {
 			processing_interrupt = true;
 			powerpc_registers r;
+			flush_fprf();
 			powerpc_registers::interrupt_copy(r, regs());
 			HandleInterrupt(&r);
 			powerpc_registers::interrupt_copy(regs(), r);
+			fprf_pending = FPRF_NONE;
 			processing_interrupt = false;
 		}
 	}
@@ -580,6 +609,8 @@ inline void powerpc_cpu::inc_cycles(void)
 {
 	++cycles;
 
+#ifndef EMU_KHEPERIX
+	// Audio and 60 Hz interrupts, the CPU tester has no Mac to deliver them to
 	if (++audio_period_cycles >= AudioStatus.period) {
 		audio_period_cycles = 0;
 		if (AudioStatus.num_sources) {
@@ -619,7 +650,132 @@ inline void powerpc_cpu::inc_cycles(void)
 	WriteMacInt32(0x20c, TimerDateTime());
 	trigger_interrupt();
 	the_app->record_video();
+#endif
+}
+
+#if PPC_THREADED_CODE
+/**
+ *		Threaded code for the decode cache
+ *
+ *		Each decode_info entry holds the address of the code to run in
+ *		execute(). Instructions with a TC_OP_GENERIC operation call the
+ *		regular execute_*() handler, the others are executed inline from
+ *		operands extracted at predecode time. A fused entry covers two
+ *		instructions; the second one is kept as is but skipped over.
+ **/
+
+enum {
+	TC_OP_GENERIC,
+	TC_OP_ADDI,					// addi, addis, li, lis
+	TC_OP_ORI,					// ori, oris
+	TC_OP_ADD,					// add, subf, and, or, xor without OE nor Rc
+	TC_OP_SUBF,
+	TC_OP_AND,
+	TC_OP_OR,
+	TC_OP_XOR,
+	TC_OP_RLWINM,				// rlwinm without Rc
+	TC_OP_LWZ,
+	TC_OP_LHZ,
+	TC_OP_LBZ,
+	TC_OP_STW,
+	TC_OP_STH,
+	TC_OP_STB,
+	TC_OP_CMPWI,
+	TC_OP_CMPLWI,
+	TC_OP_LWZ_CMPWI,			// lwz + cmpwi
+	TC_OP_LWZ_CMPLWI,			// lwz + cmplwi
+	TC_OP_ADDI_STW,				// addi + stw
+	TC_OP_END,					// end of block
+	TC_OP_MAX
+};
+
+void powerpc_cpu::threaded_decode(block_info::decode_info *di, int mnemo, uint32 opcode)
+{
+	di->op = TC_OP_GENERIC;
+	di->rD = rD_field::extract(opcode);
+	di->rA = rA_field::extract(opcode);
+	di->imm = (int16)SIMM_field::extract(opcode);
+
+	switch (mnemo) {
+	case PPC_I(ADDI):
+		di->op = TC_OP_ADDI;
+		break;
+	case PPC_I(ADDIS):
+		di->op = TC_OP_ADDI;
+		di->imm = SIMM_field::extract(opcode) << 16;
+		break;
+	case PPC_I(ORI):
+		di->op = TC_OP_ORI;
+		di->imm = UIMM_field::extract(opcode);
+		break;
+	case PPC_I(ORIS):
+		di->op = TC_OP_ORI;
+		di->imm = UIMM_field::extract(opcode) << 16;
+		break;
+	case PPC_I(ADD):
+	case PPC_I(SUBF):
+	case PPC_I(AND):
+	case PPC_I(OR):
+	case PPC_I(XOR):
+		if ((opcode & (OE_field::mask() | Rc_field::mask())) == 0) {
+			switch (mnemo) {
+			case PPC_I(ADD):	di->op = TC_OP_ADD;		break;
+			case PPC_I(SUBF):	di->op = TC_OP_SUBF;	break;
+			case PPC_I(AND):	di->op = TC_OP_AND;		break;
+			case PPC_I(OR):		di->op = TC_OP_OR;		break;
+			case PPC_I(XOR):	di->op = TC_OP_XOR;		break;
+			}
+			di->rD2 = rB_field::extract(opcode);
+		}
+		break;
+	case PPC_I(RLWINM):
+		if (!Rc_field::test(opcode)) {
+			di->op = TC_OP_RLWINM;
+			di->rD2 = SH_field::extract(opcode);
+			di->imm = mask_operand::compute(MB_field::extract(opcode), ME_field::extract(opcode));
+		}
+		break;
+	case PPC_I(LWZ):	di->op = TC_OP_LWZ;		break;
+	case PPC_I(LHZ):	di->op = TC_OP_LHZ;		break;
+	case PPC_I(LBZ):	di->op = TC_OP_LBZ;		break;
+	case PPC_I(STW):	di->op = TC_OP_STW;		break;
+	case PPC_I(STH):	di->op = TC_OP_STH;		break;
+	case PPC_I(STB):	di->op = TC_OP_STB;		break;
+	case PPC_I(CMPI):
+		di->op = TC_OP_CMPWI;
+		di->rD = crfD_field::extract(opcode);
+		break;
+	case PPC_I(CMPLI):
+		di->op = TC_OP_CMPLWI;
+		di->rD = crfD_field::extract(opcode);
+		di->imm = UIMM_field::extract(opcode);
+		break;
+	}
+}
+
+void powerpc_cpu::threaded_fuse(block_info::decode_info *di, block_info::decode_info *end)
+{
+	while (di + 1 < end) {
+		block_info::decode_info * const ni = di + 1;
+		int op = TC_OP_GENERIC;
+		if (di->op == TC_OP_LWZ && ni->op == TC_OP_CMPWI)
+			op = TC_OP_LWZ_CMPWI;
+		else if (di->op == TC_OP_LWZ && ni->op == TC_OP_CMPLWI)
+			op = TC_OP_LWZ_CMPLWI;
+		else if (di->op == TC_OP_ADDI && ni->op == TC_OP_STW)
+			op = TC_OP_ADDI_STW;
+		if (op == TC_OP_GENERIC) {
+			di++;
+			continue;
+		}
+		di->op = op;
+		di->rD2 = ni->rD;
+		di->rA2 = ni->rA;
+		di->imm2 = ni->imm;
+		di += 2;
+	}
 }
+#endif
 
 void powerpc_cpu::execute(uint32 entry)
 {
@@ -630,7 +786,7 @@ void powerpc_cpu::execute(uint32 entry)
 #endif
 	execute_depth++;
 #if PPC_DECODE_CACHE || PPC_ENABLE_JIT
-	if (execute_depth == 1 || (PPC_ENABLE_JIT && PPC_REENTRANT_JIT)) {
+	if (!interpret_only && (execute_depth == 1 || (PPC_ENABLE_JIT && PPC_REENTRANT_JIT))) {
 #if PPC_ENABLE_JIT
 		if (use_jit) {
 			block_info *bi = my_block_cache.find(pc());
@@ -675,6 +831,18 @@ void powerpc_cpu::execute(uint32 entry)
 		}
 #endif
 #if PPC_DECODE_CACHE
+#if PPC_THREADED_CODE
+		static const void * const threaded_handlers[TC_OP_MAX] = {
+			&&tc_generic,
+			&&tc_addi, &&tc_ori,
+			&&tc_add, &&tc_subf, &&tc_and, &&tc_or, &&tc_xor,
+			&&tc_rlwinm,
+			&&tc_lwz, &&tc_lhz, &&tc_lbz, &&tc_stw, &&tc_sth, &&tc_stb,
+			&&tc_cmpwi, &&tc_cmplwi,
+			&&tc_lwz_cmpwi, &&tc_lwz_cmplwi, &&tc_addi_stw,
+			&&tc_end
+		};
+#endif
 		block_info *bi = my_block_cache.find(pc());
 		if (bi != NULL)
 			goto pdi_execute;
@@ -730,12 +898,28 @@ void powerpc_cpu::execute(uint32 entry)
 				}
 			} while ((ii->cflow & CFLOW_END_BLOCK) == 0);
 			bi->end_pc = dpc;
-			bi->min_pc = dpc;
-			bi->max_pc = entry;
+			bi->min_pc = bi->pc;
+			bi->max_pc = dpc;
 			bi->size = di - bi->di;
+#if PPC_THREADED_CODE
+			// Pre-extract operands, fuse pairs and terminate the block
+			for (block_info::decode_info *tdi = bi->di; tdi < di; tdi++) {
+				const instr_info_t *tii = decode(tdi->opcode);
+				const bool is_insn = tdi->execute.ptr() == tii->execute.ptr();
+				threaded_decode(tdi, is_insn ? tii->mnemo : -1, tdi->opcode);
+			}
+			threaded_fuse(bi->di, di);
+			di->op = TC_OP_END;
+			for (block_info::decode_info *tdi = bi->di; tdi <= di; tdi++)
+				tdi->handler = threaded_handlers[tdi->op];
+#endif
 			my_block_cache.add_to_cl_list(bi);
 			my_block_cache.add_to_active_list(bi);
+			protect_code(bi->min_pc, bi->max_pc);
 			decode_cache_p += bi->size;
+#if PPC_THREADED_CODE
+			decode_cache_p++;
+#endif
 #if PPC_PROFILE_COMPILE_TIME
 			compile_time += (clock() - start_time);
 #endif
@@ -743,6 +927,100 @@ void powerpc_cpu::execute(uint32 entry)
 			// Execute all cached blocks
 		  pdi_execute:
 			for (;;) {
+#if PPC_THREADED_CODE
+#define THREADED_NEXT(N) do { di += (N); goto *di->handler; } while (0)
+#define THREADED_BASE(R) ((R) ? gpr(R) : 0)
+#define THREADED_CMP(A, B) ((A) < (B) ? -1 : ((A) > (B) ? +1 : 0))
+				di = bi->di;
+				goto *di->handler;
+			  tc_generic:
+				di->execute(this, di->opcode);
+				THREADED_NEXT(1);
+			  tc_addi:
+				gpr(di->rD) = THREADED_BASE(di->rA) + di->imm;
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_ori:
+				gpr(di->rA) = gpr(di->rD) | di->imm;
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_add:
+				gpr(di->rD) = gpr(di->rA) + gpr(di->rD2);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_subf:
+				gpr(di->rD) = gpr(di->rD2) - gpr(di->rA);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_and:
+				gpr(di->rA) = gpr(di->rD) & gpr(di->rD2);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_or:
+				gpr(di->rA) = gpr(di->rD) | gpr(di->rD2);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_xor:
+				gpr(di->rA) = gpr(di->rD) ^ gpr(di->rD2);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_rlwinm:
+				gpr(di->rA) = op_ppc_rlwinm::apply(gpr(di->rD), di->rD2, di->imm);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_lwz:
+				gpr(di->rD) = vm_read_memory_4(THREADED_BASE(di->rA) + di->imm);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_lhz:
+				gpr(di->rD) = vm_read_memory_2(THREADED_BASE(di->rA) + di->imm);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_lbz:
+				gpr(di->rD) = vm_read_memory_1(THREADED_BASE(di->rA) + di->imm);
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_stw:
+				vm_write_memory_4(THREADED_BASE(di->rA) + di->imm, gpr(di->rD));
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_sth:
+				vm_write_memory_2(THREADED_BASE(di->rA) + di->imm, gpr(di->rD));
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_stb:
+				vm_write_memory_1(THREADED_BASE(di->rA) + di->imm, gpr(di->rD));
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_cmpwi:
+				record_cr(di->rD, THREADED_CMP((int32)gpr(di->rA), di->imm));
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_cmplwi:
+				record_cr(di->rD, THREADED_CMP(gpr(di->rA), (uint32)di->imm));
+				increment_pc(4);
+				THREADED_NEXT(1);
+			  tc_lwz_cmpwi:
+				gpr(di->rD) = vm_read_memory_4(THREADED_BASE(di->rA) + di->imm);
+				record_cr(di->rD2, THREADED_CMP((int32)gpr(di->rA2), (int32)di->imm2));
+				increment_pc(8);
+				THREADED_NEXT(2);
+			  tc_lwz_cmplwi:
+				gpr(di->rD) = vm_read_memory_4(THREADED_BASE(di->rA) + di->imm);
+				record_cr(di->rD2, THREADED_CMP(gpr(di->rA2), (uint32)(uint16)di->imm2));
+				increment_pc(8);
+				THREADED_NEXT(2);
+			  tc_addi_stw:
+				gpr(di->rD) = THREADED_BASE(di->rA) + di->imm;
+				increment_pc(4);
+				vm_write_memory_4(THREADED_BASE(di->rA2) + di->imm2, gpr(di->rD2));
+				increment_pc(4);
+				THREADED_NEXT(2);
+			  tc_end:
+#undef THREADED_CMP
+#undef THREADED_BASE
+#undef THREADED_NEXT
+#else
 				const int r = bi->size % 4;
 				di = bi->di + r;
 				int n = (bi->size + 3) / 4;
@@ -755,6 +1033,7 @@ void powerpc_cpu::execute(uint32 entry)
 				case 1: di[-1].execute(this, di[-1].opcode);
 					} while (--n > 0);
 				}
+#endif
 
 				if (!spcflags().empty()) {
 					if (check_spcflags() == RESULT_RETURN)
@@ -830,6 +1109,10 @@ void powerpc_cpu::init_decode_cache()
 	// Leave enough room to last calls to dump state functions
 	decode_cache_end_p -= 2;
 #endif
+#if PPC_THREADED_CODE
+	// Leave enough room to the block terminator
+	decode_cache_end_p -= 1;
+#endif
 #endif
 }
 
@@ -879,6 +1162,10 @@ void powerpc_cpu::invalidate_cache_range(uintptr start, uintptr end)
 {
 	D(bug("Invalidate cache block [%08x - %08x]\n", start, end));
 #if PPC_DECODE_CACHE || PPC_ENABLE_JIT
+	// Nothing to do if the range covers no translated code, e.g. a
+	// store to data living in the same page as some code
+	if (!my_block_cache.has_code(start, end))
+		return;
 #if DYNGEN_DIRECT_BLOCK_CHAINING
 	if (use_jit) {
 		// Invalidate on page boundaries
@@ -892,8 +1179,176 @@ void powerpc_cpu::invalidate_cache_range(uintptr start, uintptr end)
 #endif
 }
 
+/**
+ *		Self-modifying code detection
+ *
+ *		Host pages backing translated code are write-protected and a
+ *		copy of their contents is kept. The first store to such a page
+ *		faults and the page is made writable again. Other stores,
+ *		possibly from other threads, can hit the page until the CPU
+ *		thread gets to the flush. The page is then protected again and
+ *		compared to its copy, and only blocks covering changed words are
+ *		invalidated, so that stores to data living next to code cost a
+ *		fault but no retranslation. Page states are changed by the fault
+ *		handler on any thread, hence code_protect_lock.
+ **/
+
+enum {
+	CODE_PAGE_UNPROTECTED,
+	CODE_PAGE_PROTECTED,
+	CODE_PAGE_WRITTEN,
+	CODE_PAGE_WRITTEN_RETRANSLATED		// Written, then translated from again
+};
+
+static const uint32 CODE_PAGE_BITS = 12;
+static const uint32 CODE_PAGE_SIZE = 1 << CODE_PAGE_BITS;
+
+void powerpc_cpu::enable_code_protection(uint32 start, uint32 size)
+{
+	// Host and guest pages need to match
+	if (vm_get_page_size() != CODE_PAGE_SIZE || code_page_state)
+		return;
+
+	code_protect_base = start & -CODE_PAGE_SIZE;
+	code_protect_pages = (start + size - code_protect_base) >> CODE_PAGE_BITS;
+	code_page_copy = new uint8 *[code_protect_pages];
+	for (uint32 pn = 0; pn < code_protect_pages; pn++)
+		code_page_copy[pn] = NULL;
+	code_page_scratch = new uint8[CODE_PAGE_SIZE];
+	code_page_state = new uint8[code_protect_pages];
+	memset((uint8 *)code_page_state, CODE_PAGE_UNPROTECTED, code_protect_pages);
+	D(bug("Write-protecting code in [%08x - %08x]\n", code_protect_base,
+		  code_protect_base + (code_protect_pages << CODE_PAGE_BITS)));
+}
+
+void powerpc_cpu::protect_code_page(uint32 addr)
+{
+	const uint32 pn = (addr - code_protect_base) >> CODE_PAGE_BITS;
+	if (pn >= code_protect_pages)
+		return;
+
+	uint8 *m = vm_do_get_real_address(addr & -CODE_PAGE_SIZE);
+	spin_lock(&code_protect_lock);
+	switch (code_page_state[pn]) {
+	case CODE_PAGE_UNPROTECTED:
+		// Take the copy once the page is read-only, so that it holds
+		// whatever got stored before
+		vm_protect(m, CODE_PAGE_SIZE, VM_PAGE_READ | VM_PAGE_EXECUTE);
+		if (code_page_copy[pn] == NULL)
+			code_page_copy[pn] = new uint8[CODE_PAGE_SIZE];
+		memcpy(code_page_copy[pn], m, CODE_PAGE_SIZE);
+		code_page_state[pn] = CODE_PAGE_PROTECTED;
+		break;
+	case CODE_PAGE_WRITTEN:
+		// The new block may be translated from bytes the copy doesn't
+		// have, the flush will invalidate the whole page
+		code_page_state[pn] = CODE_PAGE_WRITTEN_RETRANSLATED;
+		break;
+	}
+	spin_unlock(&code_protect_lock);
+}
+
+void powerpc_cpu::protect_code(uint32 min_pc, uint32 max_pc)
+{
+	if (code_page_state == NULL)
+		return;
+
+	for (uint32 addr = min_pc & -CODE_PAGE_SIZE; addr <= max_pc; addr += CODE_PAGE_SIZE) {
+		protect_code_page(addr);
+		if (addr + CODE_PAGE_SIZE == 0)
+			break;
+	}
+}
+
+bool powerpc_cpu::handle_code_write(uint32 addr)
+{
+	if (code_page_state == NULL)
+		return false;
+
+	const uint32 pn = (addr - code_protect_base) >> CODE_PAGE_BITS;
+	if (pn >= code_protect_pages)
+		return false;
+
+	// This may run on any thread: only let the store go through and
+	// defer block invalidation to the next spcflags check. The page may
+	// also have been made writable since the fault, then just retry.
+	uint8 *m = vm_do_get_real_address(addr & -CODE_PAGE_SIZE);
+	spin_lock(&code_protect_lock);
+	switch (code_page_state[pn]) {
+	case CODE_PAGE_PROTECTED:
+		code_page_state[pn] = CODE_PAGE_WRITTEN;
+		vm_protect(m, CODE_PAGE_SIZE, VM_PAGE_READ | VM_PAGE_WRITE | VM_PAGE_EXECUTE);
+		spcflags().set(SPCFLAG_CPU_FLUSH_CODE);
+		break;
+	case CODE_PAGE_UNPROTECTED:
+		vm_protect(m, CODE_PAGE_SIZE, VM_PAGE_READ | VM_PAGE_WRITE | VM_PAGE_EXECUTE);
+		break;
+	}
+	spin_unlock(&code_protect_lock);
+	return true;
+}
+
+void powerpc_cpu::flush_written_code()
+{
+	for (uint32 pn = 0; pn < code_protect_pages; pn++) {
+		// Only this thread moves pages out of the written states
+		const uint8 state = code_page_state[pn];
+		if (state != CODE_PAGE_WRITTEN && state != CODE_PAGE_WRITTEN_RETRANSLATED)
+			continue;
+
+		// Catch further stores from now on, the scratch copy holds all
+		// stores done before
+		const uint32 addr = code_protect_base + (pn << CODE_PAGE_BITS);
+		uint8 *m = vm_do_get_real_address(addr);
+		spin_lock(&code_protect_lock);
+		vm_protect(m, CODE_PAGE_SIZE, VM_PAGE_READ | VM_PAGE_EXECUTE);
+		memcpy(code_page_scratch, m, CODE_PAGE_SIZE);
+		code_page_state[pn] = CODE_PAGE_PROTECTED;
+		spin_unlock(&code_protect_lock);
+
+		// Invalidate blocks covering runs of changed words
+		bool invalidated = false;
+		if (state == CODE_PAGE_WRITTEN_RETRANSLATED)
+			invalidated = my_block_cache.clear_page_range(addr, addr + CODE_PAGE_SIZE);
+		else {
+			const uint32 *old_p = (const uint32 *)code_page_copy[pn];
+			const uint32 *new_p = (const uint32 *)code_page_scratch;
+			const uint32 n = CODE_PAGE_SIZE / 4;
+			for (uint32 i = 0; i < n; i++) {
+				if (old_p[i] == new_p[i])
+					continue;
+				uint32 j = i + 1;
+				while (j < n && old_p[j] != new_p[j])
+					j++;
+				D(bug("Code written in [%08x - %08x]\n", addr + i * 4, addr + j * 4));
+				if (my_block_cache.clear_page_range(addr + i * 4, addr + j * 4))
+					invalidated = true;
+				i = j;
+			}
+		}
+		if (invalidated)
+			spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
+
+		uint8 *copy = code_page_copy[pn];
+		code_page_copy[pn] = code_page_scratch;
+		code_page_scratch = copy;
+
+		// Leave pages without code writable
+		if (!my_block_cache.has_code(addr, addr + CODE_PAGE_SIZE)) {
+			spin_lock(&code_protect_lock);
+			if (code_page_state[pn] == CODE_PAGE_PROTECTED) {
+				vm_protect(m, CODE_PAGE_SIZE, VM_PAGE_READ | VM_PAGE_WRITE | VM_PAGE_EXECUTE);
+				code_page_state[pn] = CODE_PAGE_UNPROTECTED;
+			}
+			spin_unlock(&code_protect_lock);
+		}
+	}
+}
+
+#ifndef EMU_KHEPERIX
 void powerpc_cpu::save_to(int fd)
 {
+	flush_fprf();
 	write_exactly(regs_ptr(), fd, sizeof(powerpc_registers));
 	write_exactly(&cycles, fd, sizeof cycles);
 	write_exactly(&audio_period_cycles, fd, sizeof audio_period_cycles);
@@ -903,7 +1358,9 @@ void powerpc_cpu::save_to(int fd)
 void powerpc_cpu::load_from(int fd)
 {
 	read_exactly(regs_ptr(), fd, sizeof(powerpc_registers));
+	fprf_pending = FPRF_NONE;
 	read_exactly(&cycles, fd, sizeof cycles);
 	read_exactly(&audio_period_cycles, fd, sizeof audio_period_cycles);
 	read_exactly(&via_period_cycles, fd, sizeof via_period_cycles);
 }
+#endif
@@ -84,6 +84,18 @@ private:
 
 protected:
 
+	// FPSCR[FPRF] is computed lazily from the last result recorded by
+	// translated code, i.e. only when FPSCR is actually read
+	enum {
+		FPRF_NONE	= 0,
+		FPRF_DOUBLE	= 1,
+		FPRF_SINGLE	= 2
+	};
+	powerpc_fpr fprf_value;
+	uint32 fprf_pending;
+	void commit_fprf();
+	void flush_fprf()			{ if (fprf_pending) commit_fprf(); }
+
 	powerpc_spcflags & spcflags() { return regs().spcflags; }
 	powerpc_spcflags const & spcflags() const { return regs().spcflags; }
 	powerpc_cr_register & cr() { return regs().cr; }
@@ -96,7 +108,7 @@ protected:
 	uint32 vrsave() const		{ return regs().vrsave; }
 	uint32 & vrsave()			{ return regs().vrsave; }
 
-	uint32 & fpscr()			{ return regs().fpscr; }
+	uint32 & fpscr()			{ flush_fprf(); return regs().fpscr; }
 	uint32 fpscr() const		{ return regs().fpscr; }
 	uint32 & lr()				{ return regs().lr; }
 	uint32 lr() const			{ return regs().lr; }
@@ -267,8 +279,13 @@ private:
 	// Current execute() nested level
 	int execute_depth;
 
+	// Bypass the decode cache and the JIT, e.g. for reference runs
+	bool interpret_only;
+
 public:
 
+	void set_interpret_only(bool enable) { interpret_only = enable; }
+
 	// Initialization & finalization
 	void initialize();
 #ifdef SHEEPSHAVER
@@ -319,9 +336,29 @@ public:
 	// Caches invalidation
 	void invalidate_cache();
 	void invalidate_cache_range(uintptr start, uintptr end);
+
+	// Check whether code at PC is translated
+	bool is_translated(uint32 pc) { return my_block_cache.find(pc) != NULL; }
 private:
 	struct { uintptr start, end; } cache_range;
 
+public:
+	// Write-protect translated code in [START, START + SIZE)
+	void enable_code_protection(uint32 start, uint32 size);
+
+	// Handle write fault at ADDR, returns false if not a code page
+	bool handle_code_write(uint32 addr);
+private:
+	uint32 code_protect_base;
+	uint32 code_protect_pages;
+	volatile uint8 *code_page_state;	// Changed from any thread, under code_protect_lock
+	uint8 **code_page_copy;				// Page contents when last write-protected
+	uint8 *code_page_scratch;
+	spinlock_t code_protect_lock;
+	void protect_code_page(uint32 addr);
+	void protect_code(uint32 min_pc, uint32 max_pc);
+	void flush_written_code();
+
 protected:
 
 	// Init decoder with one instruction info
@@ -382,6 +419,12 @@ private:
 	block_info::decode_info * decode_cache_end_p;
 #endif
 
+#if PPC_THREADED_CODE
+	// Threaded code predecoding
+	static void threaded_decode(block_info::decode_info *di, int mnemo, uint32 opcode);
+	static void threaded_fuse(block_info::decode_info *di, block_info::decode_info *end);
+#endif
+
 #if PPC_ENABLE_JIT
 	// Dynamic translation engine
 	friend class powerpc_dyngen_helper;
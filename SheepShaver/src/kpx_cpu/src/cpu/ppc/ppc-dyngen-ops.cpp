@@ -91,8 +91,8 @@ struct powerpc_dyngen_helper {
 	static INLINE void set_ctr(uint32 value)	{ CPU->ctr() = value; }
 	static INLINE uint32 get_cr()				{ return CPU->cr().get(); }
 	static INLINE void set_cr(uint32 value)		{ CPU->cr().set(value); }
-	static INLINE uint32 get_fpscr()			{ return CPU->fpscr(); }
-	static INLINE void set_fpscr(uint32 value)	{ CPU->fpscr() = value; }
+	// NOTE: FPSCR[FPRF] may be stale, only the exception bits are used
+	static INLINE uint32 get_fpscr()			{ return CPU->regs().fpscr; }
 	static INLINE uint32 get_xer()				{ return CPU->xer().get(); }
 	static INLINE void set_xer(uint32 value)	{ CPU->xer().set(value); }
 	static INLINE uint32 get_vrsave()			{ return CPU->vrsave(); }
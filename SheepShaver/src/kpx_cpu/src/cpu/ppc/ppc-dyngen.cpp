@@ -46,6 +46,10 @@ powerpc_dyngen::powerpc_dyngen(dyngen_cpu_base cpu)
 		printf(" SSE3");
 	if (cpuinfo_check_ssse3())
 		printf(" SSSE3");
+	if (cpuinfo_check_sse4_1())
+		printf(" SSE4.1");
+	if (cpuinfo_check_avx2())
+		printf(" AVX2");
 	if (cpuinfo_check_altivec())
 		printf(" VMX");
 	printf("\n");
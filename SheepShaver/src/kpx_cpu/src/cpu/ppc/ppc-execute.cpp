@@ -908,6 +908,9 @@ void powerpc_cpu::execute_fp_int_convert(uint32 opcode)
 template< class FP >
 void powerpc_cpu::fp_classify(FP x)
 {
+	// Any pending FPSCR[FPRF] update is superseded
+	fprf_pending = FPRF_NONE;
+
 	uint32 c = fpscr() & ~FPSCR_FPRF_field::mask();
 	uint8 fc = fpclassify(x);
 	switch (fc) {
@@ -936,6 +939,19 @@ void powerpc_cpu::fp_classify(FP x)
 	fpscr() = c;
 }
 
+// Compute FPSCR[FPRF] from the last result recorded by translated code
+void powerpc_cpu::commit_fprf()
+{
+	const uint32 pending = fprf_pending;
+	fprf_pending = FPRF_NONE;
+	if (FPSCR_VE_field::test(regs().fpscr))
+		return;
+	if (pending == FPRF_SINGLE)
+		fp_classify((float)fprf_value.d);
+	else
+		fp_classify(fprf_value.d);
+}
+
 template< class Rc >
 void powerpc_cpu::execute_fp_round(uint32 opcode)
 {
@@ -1486,13 +1502,15 @@ void powerpc_cpu::execute_vector_merge(uint32 opcode)
 {
 	typename VA::type const & vA = VA::const_ref(this, opcode);
 	typename VB::type const & vB = VB::const_ref(this, opcode);
-	typename VD::type & vD = VD::ref(this, opcode);
+	typename VD::type vT;
 	const int n_elements = 16 / VD::element_size;
 
+	// vD may be aliased to vA or vB, use a temporary
 	for (int i = 0; i < n_elements; i += 2) {
-		VD::set_element(vD, i    , VA::get_element(vA, (i / 2) + LO * (n_elements / 2)));
-		VD::set_element(vD, i + 1, VB::get_element(vB, (i / 2) + LO * (n_elements / 2)));
+		VD::set_element(vT, i    , VA::get_element(vA, (i / 2) + LO * (n_elements / 2)));
+		VD::set_element(vT, i + 1, VB::get_element(vB, (i / 2) + LO * (n_elements / 2)));
 	}
+	VD::ref(this, opcode) = vT;
 
 	increment_pc(4);
 }
@@ -1513,10 +1531,11 @@ void powerpc_cpu::execute_vector_pack(uint32 opcode)
 {
 	typename VA::type const & vA = VA::const_ref(this, opcode);
 	typename VB::type const & vB = VB::const_ref(this, opcode);
-	typename VD::type & vD = VD::ref(this, opcode);
+	typename VD::type vT;
 	const int n_elements = 16 / VD::element_size;
 	const int n_pivot = n_elements / 2;
 
+	// vD may be aliased to vA or vB, use a temporary
 	for (int i = 0; i < n_elements; i++) {
 		typename VD::element_type d;
 		if (i < n_pivot)
@@ -1525,8 +1544,9 @@ void powerpc_cpu::execute_vector_pack(uint32 opcode)
 			d = VB::get_element(vB, i - n_pivot);
 		if (VD::saturate(d))
 			vscr().set_sat(1);
-		VD::set_element(vD, i, d);
+		VD::set_element(vT, i, d);
 	}
+	VD::ref(this, opcode) = vT;
 
 	increment_pc(4);
 }
@@ -1535,11 +1555,13 @@ template< int LO, class VD, class VA >
 void powerpc_cpu::execute_vector_unpack(uint32 opcode)
 {
 	typename VA::type const & vA = VA::const_ref(this, opcode);
-	typename VD::type & vD = VD::ref(this, opcode);
+	typename VD::type vT;
 	const int n_elements = 16 / VD::element_size;
 
+	// vD may be aliased to vA, use a temporary
 	for (int i = 0; i < n_elements; i++)
-		VD::set_element(vD, i, VA::get_element(vA, i + LO * n_elements));
+		VD::set_element(vT, i, VA::get_element(vA, i + LO * n_elements));
+	VD::ref(this, opcode) = vT;
 
 	increment_pc(4);
 }
@@ -1752,14 +1774,15 @@ void powerpc_cpu::execute_vector_permute(uint32 opcode)
 	powerpc_vr const & vA = vr(vA_field::extract(opcode));
 	powerpc_vr const & vB = vr(vB_field::extract(opcode));
 	powerpc_vr const & vC = vr(vC_field::extract(opcode));
-	powerpc_vr & vD = vr(vD_field::extract(opcode));
+	powerpc_vr vT;
 
 	for (int i = 0; i < 16; i++) {
 		const int ei = ev_mixed::byte_element(i);
 		const int n  = vC.b[ei] & 0x1f;
 		const int en = ev_mixed::byte_element(n & 0xf);
-		vD.b[ei] = (n & 0x10) ? vB.b[en] : vA.b[en];
+		vT.b[ei] = (n & 0x10) ? vB.b[en] : vA.b[en];
 	}
+	vr(vD_field::extract(opcode)) = vT;
 
 	increment_pc(4);
 }
@@ -196,8 +196,46 @@ bool powerpc_jit::initialize(void)
 			DEFINE_OP(VREFP,	2, PS,RCP),
 			DEFINE_OP(VRSQRTEFP,2, PS,RSQRT),
 #undef DEFINE_OP
+#define DEFINE_OP(MNEMO, SAT_OP, MOD_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_arith_sat, (X86_SSE_##SAT_OP << 8) | X86_SSE_##MOD_OP }
+			DEFINE_OP(VADDSBS,	PADDSB, PADDB),
+			DEFINE_OP(VADDSHS,	PADDSW, PADDW),
+			DEFINE_OP(VADDUBS,	PADDUSB, PADDB),
+			DEFINE_OP(VADDUHS,	PADDUSW, PADDW),
+			DEFINE_OP(VSUBSBS,	PSUBSB, PSUBB),
+			DEFINE_OP(VSUBSHS,	PSUBSW, PSUBW),
+			DEFINE_OP(VSUBUBS,	PSUBUSB, PSUBB),
+			DEFINE_OP(VSUBUHS,	PSUBUSW, PSUBW),
+#undef DEFINE_OP
+#define DEFINE_OP(MNEMO, SIZE, SSE_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_arith_cu, (SIZE << 8) | X86_SSE_##SSE_OP }
+			DEFINE_OP(VCMPGTUB,	1, PCMPGTB),
+			DEFINE_OP(VCMPGTUH,	2, PCMPGTW),
+			DEFINE_OP(VCMPGTUW,	4, PCMPGTD),
+#undef DEFINE_OP
+#define DEFINE_OP(MNEMO, GEN_OP, SSE_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_##GEN_OP, X86_SSE_##SSE_OP }
+			DEFINE_OP(VMRGHB,	vmrg, PUNPCKHBW),
+			DEFINE_OP(VMRGHH,	vmrg, PUNPCKHWD),
+			DEFINE_OP(VMRGHW,	vmrg, PUNPCKHDQ),
+			DEFINE_OP(VMRGLB,	vmrg, PUNPCKLBW),
+			DEFINE_OP(VMRGLH,	vmrg, PUNPCKLWD),
+			DEFINE_OP(VMRGLW,	vmrg, PUNPCKLDQ),
+			DEFINE_OP(VUPKHSB,	vupk, PUNPCKHBW),
+			DEFINE_OP(VUPKHSH,	vupk, PUNPCKHWD),
+			DEFINE_OP(VUPKLSB,	vupk, PUNPCKLBW),
+			DEFINE_OP(VUPKLSH,	vupk, PUNPCKLWD),
+#undef DEFINE_OP
 #define DEFINE_OP(MNEMO, GEN_OP) \
 			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_##GEN_OP, }
+			DEFINE_OP(VADDSWS,	arith_sws),
+			DEFINE_OP(VSUBSWS,	arith_sws),
+			DEFINE_OP(VCMPBFP,	vcmpbfp),
+			DEFINE_OP(VPKSHSS,	vpk),
+			DEFINE_OP(VPKSHUS,	vpk),
+			DEFINE_OP(VPKSWSS,	vpk),
+			DEFINE_OP(VPKUHUM,	vpk),
+			DEFINE_OP(VPKUWUM,	vpk),
 			DEFINE_OP(VSEL,		vsel),
 			DEFINE_OP(VSLDOI,	vsldoi),
 			DEFINE_OP(VSPLTB,	vspltb),
@@ -230,6 +268,54 @@ bool powerpc_jit::initialize(void)
 			for (int i = 0; i < sizeof(ssse3_vector) / sizeof(ssse3_vector[0]); i++)
 				jit_info[ssse3_vector[i].mnemo] = &ssse3_vector[i];
 		}
+
+		// SSE4.1 optimized handlers
+		static const jit_info_t sse41_vector[] = {
+#define DEFINE_OP(MNEMO, SSE_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_arith_2, (X86_INSN_SSE_3P << 8) | X86_SSE4_##SSE_OP }
+			DEFINE_OP(VMAXSB,	PMAXSB),
+			DEFINE_OP(VMAXSW,	PMAXSD),
+			DEFINE_OP(VMAXUH,	PMAXUW),
+			DEFINE_OP(VMAXUW,	PMAXUD),
+			DEFINE_OP(VMINSB,	PMINSB),
+			DEFINE_OP(VMINSW,	PMINSD),
+			DEFINE_OP(VMINUH,	PMINUW),
+			DEFINE_OP(VMINUW,	PMINUD),
+#undef DEFINE_OP
+#define DEFINE_OP(MNEMO, GEN_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_##GEN_OP, }
+			DEFINE_OP(VADDUWS,	sse41_arith_uws),
+			DEFINE_OP(VSUBUWS,	sse41_arith_uws),
+			DEFINE_OP(VPKSWUS,	sse2_vpk),
+			DEFINE_OP(VPKUHUS,	sse2_vpk),
+			DEFINE_OP(VPKUWUS,	sse2_vpk)
+#undef DEFINE_OP
+		};
+
+		if (cpuinfo_check_sse4_1()) {
+			for (int i = 0; i < sizeof(sse41_vector) / sizeof(sse41_vector[0]); i++)
+				jit_info[sse41_vector[i].mnemo] = &sse41_vector[i];
+		}
+
+		// AVX2 optimized handlers
+		static const jit_info_t avx2_vector[] = {
+#define DEFINE_OP(MNEMO, GEN_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_avx2_##GEN_OP, }
+			DEFINE_OP(VRLH,		vrlh),
+			DEFINE_OP(VRLW,		vrlw),
+			DEFINE_OP(VSLH,		vsh),
+			DEFINE_OP(VSLW,		vsw),
+			DEFINE_OP(VSRAH,	vsh),
+			DEFINE_OP(VSRAW,	vsw),
+			DEFINE_OP(VSRH,		vsh),
+			DEFINE_OP(VSRW,		vsw)
+#undef DEFINE_OP
+		};
+
+		if (cpuinfo_check_avx2()) {
+			for (int i = 0; i < sizeof(avx2_vector) / sizeof(avx2_vector[0]); i++)
+				jit_info[avx2_vector[i].mnemo] = &avx2_vector[i];
+		}
 #endif
 	}
 
@@ -837,6 +923,271 @@ bool powerpc_jit::gen_sse2_vspltw(int mnemo, int vD, int UIMM, int vB)
 	return true;
 }
 
+/*
+ *	Saturating arithmetic
+ *
+ *	VSCR[SAT] is sticky, so it is only ever or'ed in. An element
+ *	saturated iff the saturated result differs from the modulo one.
+ */
+
+// Set VSCR[SAT] if vR is not all ones (mask of exact elements), or not zero
+void powerpc_jit::gen_sse2_record_sat(int vR, bool is_zero)
+{
+	gen_pmovmskb(vR, X86_ECX);											// pmovmskb %vR,%ecx
+	gen_cmp_32(x86_immediate_operand(is_zero ? 0 : 0xffff), X86_ECX);	// cmp $mask,%ecx
+	gen_setcc(X86_CC_NE, X86_CL);										// setne %cl
+	gen_or_8(X86_CL, x86_memory_operand(xPPC_VSCR, REG_CPU_ID));		// or %cl,xPPC_VSCR(%cpu)
+}
+
+// vaddsbs, vaddshs, vaddubs, vadduhs, vsubsbs, vsubshs, vsububs, vsubuhs
+bool powerpc_jit::gen_sse2_arith_sat(int mnemo, int vD, int vA, int vB)
+{
+	const uint16 insn = jit_info[mnemo]->o.value;
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V1_ID);
+	gen_insn(X86_INSN_SSE_PI, insn >> 8, x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_insn(X86_INSN_SSE_PI, insn & 0xff, x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	gen_pcmpeqb(REG_V0_ID, REG_V1_ID);
+	gen_sse2_record_sat(REG_V1_ID, false);
+	return true;
+}
+
+// vaddsws, vsubsws
+bool powerpc_jit::gen_sse2_arith_sws(int mnemo, int vD, int vA, int vB)
+{
+	// NOTE: overflowed elements are replaced with (vA >> 31) ^ 0x7fffffff
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_movdqa(REG_V0_ID, REG_V2_ID);
+	if (mnemo == PPC_I(VADDSWS)) {
+		gen_paddd(REG_V1_ID, REG_V2_ID);								// r = a + b
+		gen_movdqa(REG_V2_ID, REG_V3_ID);
+		gen_pxor(REG_V0_ID, REG_V3_ID);
+		gen_pxor(REG_V2_ID, REG_V1_ID);
+		gen_pand(REG_V1_ID, REG_V3_ID);									// (r ^ a) & (r ^ b)
+	}
+	else {
+		gen_psubd(REG_V1_ID, REG_V2_ID);								// r = a - b
+		gen_movdqa(REG_V2_ID, REG_V3_ID);
+		gen_pxor(REG_V0_ID, REG_V3_ID);
+		gen_pxor(REG_V0_ID, REG_V1_ID);
+		gen_pand(REG_V1_ID, REG_V3_ID);									// (r ^ a) & (a ^ b)
+	}
+	gen_psrad(x86_immediate_operand(31), REG_V3_ID);					// overflow mask
+	gen_psrad(x86_immediate_operand(31), REG_V0_ID);
+	gen_pcmpeqd(REG_V1_ID, REG_V1_ID);
+	gen_psrld(x86_immediate_operand(1), REG_V1_ID);
+	gen_pxor(REG_V1_ID, REG_V0_ID);										// saturated values
+	gen_pxor(REG_V2_ID, REG_V0_ID);
+	gen_pand(REG_V3_ID, REG_V0_ID);
+	gen_pxor(REG_V2_ID, REG_V0_ID);										// r ^ ((r ^ sat) & ov)
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	gen_sse2_record_sat(REG_V3_ID, true);
+	return true;
+}
+
+/*
+ *	Unsigned and bounds comparisons
+ */
+
+// vcmpgtub, vcmpgtuh, vcmpgtuw
+bool powerpc_jit::gen_sse2_arith_cu(int mnemo, int vD, int vA, int vB, bool Rc)
+{
+	// Bias both operands into the signed range
+	const uint16 insn = jit_info[mnemo]->o.value;
+	switch (insn >> 8) {
+	case 1:
+		gen_pcmpeqw(REG_V2_ID, REG_V2_ID);
+		gen_psllw(x86_immediate_operand(15), REG_V2_ID);
+		gen_movdqa(REG_V2_ID, REG_V3_ID);
+		gen_psrlw(x86_immediate_operand(8), REG_V3_ID);
+		gen_por(REG_V3_ID, REG_V2_ID);
+		break;
+	case 2:
+		gen_pcmpeqw(REG_V2_ID, REG_V2_ID);
+		gen_psllw(x86_immediate_operand(15), REG_V2_ID);
+		break;
+	case 4:
+		gen_pcmpeqd(REG_V2_ID, REG_V2_ID);
+		gen_pslld(x86_immediate_operand(31), REG_V2_ID);
+		break;
+	}
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pxor(REG_V2_ID, REG_V0_ID);
+	gen_pxor(REG_V2_ID, REG_V1_ID);
+	gen_insn(X86_INSN_SSE_PI, insn & 0xff, REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	if (Rc)
+		gen_sse2_record_cr6(REG_V0_ID);
+	return true;
+}
+
+// vcmpbfp
+bool powerpc_jit::gen_sse2_vcmpbfp(int mnemo, int vD, int vA, int vB, bool Rc)
+{
+	// NOTE: vD = (~(vA <= vB) & 0x80000000) | (~(-vB <= vA) & 0x80000000) >> 1
+	gen_movaps(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movaps(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pcmpeqd(REG_V3_ID, REG_V3_ID);
+	gen_pslld(x86_immediate_operand(31), REG_V3_ID);
+	gen_movaps(REG_V0_ID, REG_V2_ID);
+	gen_cmpps(X86_SSE_CC_LE, REG_V1_ID, REG_V2_ID);
+	gen_pxor(REG_V3_ID, REG_V1_ID);
+	gen_cmpps(X86_SSE_CC_LE, REG_V0_ID, REG_V1_ID);
+	gen_pandn(REG_V3_ID, REG_V2_ID);
+	gen_pandn(REG_V3_ID, REG_V1_ID);
+	if (Rc) {
+		// pmovmskb only sees bit 31 of each result word
+		gen_movdqa(REG_V1_ID, REG_V3_ID);
+		gen_por(REG_V2_ID, REG_V3_ID);
+	}
+	gen_psrld(x86_immediate_operand(1), REG_V1_ID);
+	gen_por(REG_V1_ID, REG_V2_ID);
+	gen_movdqa(REG_V2_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	if (Rc)
+		gen_sse2_record_cr6(REG_V3_ID);
+	return true;
+}
+
+/*
+ *	Vector merge, pack and unpack instructions
+ *
+ *	These operate on reversed vectors (pshufd $0x1b) where the PowerPC
+ *	element K of an N-element vector is host element N-1-K, in native
+ *	byte order. The x86 instructions then apply as is.
+ */
+
+// vmrghb, vmrghh, vmrghw, vmrglb, vmrglh, vmrglw
+bool powerpc_jit::gen_sse2_vmrg(int mnemo, int vD, int vA, int vB)
+{
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V1_ID);
+	gen_insn(X86_INSN_SSE_PI, jit_info[mnemo]->o.value, REG_V1_ID, REG_V0_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// Set VSCR[SAT] if any element of V0, V1 does not fit into half its size
+void powerpc_jit::gen_sse2_vpk_sat(int size, bool is_signed)
+{
+	const int bits = size * 4;
+	gen_movdqa(REG_V0_ID, REG_V2_ID);
+	gen_movdqa(REG_V1_ID, REG_V3_ID);
+	if (is_signed) {
+		// the element is unchanged once sign extended from the low half
+		if (size == 2) {
+			gen_psllw(x86_immediate_operand(bits), REG_V2_ID);
+			gen_psllw(x86_immediate_operand(bits), REG_V3_ID);
+			gen_psraw(x86_immediate_operand(bits), REG_V2_ID);
+			gen_psraw(x86_immediate_operand(bits), REG_V3_ID);
+			gen_pcmpeqw(REG_V0_ID, REG_V2_ID);
+			gen_pcmpeqw(REG_V1_ID, REG_V3_ID);
+		}
+		else {
+			gen_pslld(x86_immediate_operand(bits), REG_V2_ID);
+			gen_pslld(x86_immediate_operand(bits), REG_V3_ID);
+			gen_psrad(x86_immediate_operand(bits), REG_V2_ID);
+			gen_psrad(x86_immediate_operand(bits), REG_V3_ID);
+			gen_pcmpeqd(REG_V0_ID, REG_V2_ID);
+			gen_pcmpeqd(REG_V1_ID, REG_V3_ID);
+		}
+		gen_pand(REG_V3_ID, REG_V2_ID);
+	}
+	else {
+		// the high half of the element is zero
+		if (size == 2) {
+			gen_psrlw(x86_immediate_operand(bits), REG_V2_ID);
+			gen_psrlw(x86_immediate_operand(bits), REG_V3_ID);
+		}
+		else {
+			gen_psrld(x86_immediate_operand(bits), REG_V2_ID);
+			gen_psrld(x86_immediate_operand(bits), REG_V3_ID);
+		}
+		gen_por(REG_V3_ID, REG_V2_ID);
+		gen_pxor(REG_V3_ID, REG_V3_ID);
+		gen_pcmpeqb(REG_V3_ID, REG_V2_ID);
+	}
+	gen_sse2_record_sat(REG_V2_ID, false);
+}
+
+// vpkshss, vpkshus, vpkswss, vpkswus, vpkuhum, vpkuhus, vpkuwum, vpkuwus
+bool powerpc_jit::gen_sse2_vpk(int mnemo, int vD, int vA, int vB)
+{
+	// NOTE: vB provides the low half of the reversed result
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V1_ID);
+	switch (mnemo) {
+	case PPC_I(VPKUHUM):
+		gen_psllw(x86_immediate_operand(8), REG_V0_ID);
+		gen_psllw(x86_immediate_operand(8), REG_V1_ID);
+		gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+		gen_psraw(x86_immediate_operand(8), REG_V1_ID);
+		gen_packsswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKUWUM):
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V1_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V0_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V1_ID);
+		gen_packssdw(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSHSS):
+		gen_sse2_vpk_sat(2, true);
+		gen_packsswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSHUS):
+		gen_sse2_vpk_sat(2, false);
+		gen_packuswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSWSS):
+		gen_sse2_vpk_sat(4, true);
+		gen_packssdw(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSWUS):									// SSE4.1
+		gen_sse2_vpk_sat(4, false);
+		gen_packusdw(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKUHUS):									// SSE4.1
+		gen_sse2_vpk_sat(2, false);
+		gen_pcmpeqw(REG_V3_ID, REG_V3_ID);
+		gen_psrlw(x86_immediate_operand(8), REG_V3_ID);
+		gen_pminuw(REG_V3_ID, REG_V0_ID);
+		gen_pminuw(REG_V3_ID, REG_V1_ID);
+		gen_packuswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKUWUS):									// SSE4.1
+		gen_sse2_vpk_sat(4, false);
+		gen_pcmpeqd(REG_V3_ID, REG_V3_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V3_ID);
+		gen_pminud(REG_V3_ID, REG_V0_ID);
+		gen_pminud(REG_V3_ID, REG_V1_ID);
+		gen_packusdw(REG_V1_ID, REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
+	gen_pshufd(x86_immediate_operand(0x1b), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vupkhsb, vupkhsh, vupklsb, vupklsh
+bool powerpc_jit::gen_sse2_vupk(int mnemo, int vD, int vA, int vB)
+{
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_insn(X86_INSN_SSE_PI, jit_info[mnemo]->o.value, REG_V0_ID, REG_V0_ID);
+	if (mnemo == PPC_I(VUPKHSB) || mnemo == PPC_I(VUPKLSB))
+		gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+	else
+		gen_psrad(x86_immediate_operand(16), REG_V0_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
 /*
  *	SSSE3 optimizations
  */
@@ -939,4 +1290,836 @@ bool powerpc_jit::gen_ssse3_vperm(int mnemo, int vD, int vA, int vB, int vC)
 	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
 	return true;
 }
+
+/*
+ *	SSE4.1 optimizations
+ */
+
+// vadduws, vsubuws
+bool powerpc_jit::gen_sse41_arith_uws(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	if (mnemo == PPC_I(VADDUWS)) {
+		// vD = vA + min(vB, ~vA), saturated if vB > ~vA
+		gen_pcmpeqd(REG_V2_ID, REG_V2_ID);
+		gen_pxor(REG_V0_ID, REG_V2_ID);
+		gen_pminud(REG_V1_ID, REG_V2_ID);
+		gen_paddd(REG_V2_ID, REG_V0_ID);
+		gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+		gen_pcmpeqd(REG_V1_ID, REG_V2_ID);
+	}
+	else {
+		// vD = max(vA, vB) - vB, saturated if vB > vA
+		gen_movdqa(REG_V0_ID, REG_V2_ID);
+		gen_pmaxud(REG_V1_ID, REG_V2_ID);
+		gen_movdqa(REG_V2_ID, REG_V3_ID);
+		gen_psubd(REG_V1_ID, REG_V3_ID);
+		gen_movdqa(REG_V3_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+		gen_pcmpeqd(REG_V0_ID, REG_V2_ID);
+	}
+	gen_sse2_record_sat(REG_V2_ID, false);
+	return true;
+}
+
+/*
+ *	AVX2 optimizations
+ *
+ *	Per-element shift counts map to vpsllvd, vpsrlvd and vpsravd. The
+ *	halfword variants process the low and high halves of each word
+ *	separately. Byte shifts still go through the generic handlers.
+ */
+
+// vslw, vsrw, vsraw
+bool powerpc_jit::gen_avx2_vsw(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pcmpeqd(REG_V2_ID, REG_V2_ID);
+	gen_psrld(x86_immediate_operand(27), REG_V2_ID);
+	gen_pand(REG_V2_ID, REG_V1_ID);
+	switch (mnemo) {
+	case PPC_I(VSLW):	gen_vpsllvd(REG_V1_ID, REG_V0_ID, REG_V0_ID);	break;
+	case PPC_I(VSRW):	gen_vpsrlvd(REG_V1_ID, REG_V0_ID, REG_V0_ID);	break;
+	case PPC_I(VSRAW):	gen_vpsravd(REG_V1_ID, REG_V0_ID, REG_V0_ID);	break;
+	default:			abort();
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vrlw
+bool powerpc_jit::gen_avx2_vrlw(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pcmpeqd(REG_V2_ID, REG_V2_ID);
+	gen_psrld(x86_immediate_operand(27), REG_V2_ID);
+	gen_pand(REG_V2_ID, REG_V1_ID);										// n = vB & 31
+	gen_pcmpeqd(REG_V3_ID, REG_V3_ID);
+	gen_psrld(x86_immediate_operand(31), REG_V3_ID);
+	gen_pslld(x86_immediate_operand(5), REG_V3_ID);
+	gen_psubd(REG_V1_ID, REG_V3_ID);									// 32 - n
+	gen_vpsllvd(REG_V1_ID, REG_V0_ID, REG_V2_ID);
+	gen_vpsrlvd(REG_V3_ID, REG_V0_ID, REG_V0_ID);
+	gen_por(REG_V2_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// Load vA into V0, and the shift counts of the low and high halves into V2, V1
+void powerpc_jit::gen_avx2_vsh_counts(int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pcmpeqd(REG_V3_ID, REG_V3_ID);
+	gen_psrld(x86_immediate_operand(28), REG_V3_ID);
+	gen_movdqa(REG_V1_ID, REG_V2_ID);
+	gen_pand(REG_V3_ID, REG_V2_ID);
+	gen_psrld(x86_immediate_operand(16), REG_V1_ID);
+	gen_pand(REG_V3_ID, REG_V1_ID);
+}
+
+// vslh, vsrh, vsrah
+bool powerpc_jit::gen_avx2_vsh(int mnemo, int vD, int vA, int vB)
+{
+	gen_avx2_vsh_counts(vA, vB);
+	gen_pcmpeqd(REG_V3_ID, REG_V3_ID);
+	gen_psrld(x86_immediate_operand(16), REG_V3_ID);					// 0x0000ffff
+	switch (mnemo) {
+	case PPC_I(VSLH):
+		gen_vpsllvd(REG_V2_ID, REG_V0_ID, REG_V2_ID);
+		gen_pand(REG_V3_ID, REG_V2_ID);
+		gen_pandn(REG_V0_ID, REG_V3_ID);
+		gen_vpsllvd(REG_V1_ID, REG_V3_ID, REG_V3_ID);
+		gen_por(REG_V2_ID, REG_V3_ID);
+		break;
+	case PPC_I(VSRH):
+		gen_vpsrlvd(REG_V1_ID, REG_V0_ID, REG_V1_ID);
+		gen_pand(REG_V3_ID, REG_V0_ID);
+		gen_vpsrlvd(REG_V2_ID, REG_V0_ID, REG_V0_ID);
+		gen_pandn(REG_V1_ID, REG_V3_ID);
+		gen_por(REG_V0_ID, REG_V3_ID);
+		break;
+	case PPC_I(VSRAH):
+		gen_vpsravd(REG_V1_ID, REG_V0_ID, REG_V1_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V0_ID);
+		gen_vpsravd(REG_V2_ID, REG_V0_ID, REG_V0_ID);
+		gen_pand(REG_V3_ID, REG_V0_ID);
+		gen_pandn(REG_V1_ID, REG_V3_ID);
+		gen_por(REG_V0_ID, REG_V3_ID);
+		break;
+	default:
+		abort();
+	}
+	gen_movdqa(REG_V3_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vrlh
+bool powerpc_jit::gen_avx2_vrlh(int mnemo, int vD, int vA, int vB)
+{
+	// NOTE: each half is duplicated into a word, the rotated value is
+	// then the high half of the word shifted left
+	gen_avx2_vsh_counts(vA, vB);
+	gen_pshuflhw(x86_immediate_operand(0xa0), REG_V0_ID, REG_V3_ID);
+	gen_pshufhw(x86_immediate_operand(0xa0), REG_V3_ID, REG_V3_ID);
+	gen_vpsllvd(REG_V2_ID, REG_V3_ID, REG_V3_ID);
+	gen_psrld(x86_immediate_operand(16), REG_V3_ID);
+	gen_pshuflhw(x86_immediate_operand(0xf5), REG_V0_ID, REG_V2_ID);
+	gen_pshufhw(x86_immediate_operand(0xf5), REG_V2_ID, REG_V2_ID);
+	gen_vpsllvd(REG_V1_ID, REG_V2_ID, REG_V2_ID);
+	gen_psrld(x86_immediate_operand(16), REG_V2_ID);
+	gen_pslld(x86_immediate_operand(16), REG_V2_ID);
+	gen_por(REG_V3_ID, REG_V2_ID);
+	gen_movdqa(REG_V2_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+#endif
+
+#if PPC_NATIVE_CODEGEN
+/*
+ *	Native x86-64 code generation
+ *
+ *	These handlers emit host code that operates directly on the
+ *	powerpc_registers structure, thus bypassing the dyngen ops for the
+ *	most frequently executed instructions. EAX, ECX and EDX are used
+ *	as scratch registers, T0 is preserved for branches to LR/CTR.
+ *	Anything that depends on XER[CA] or XER[OV] is left to dyngen.
+ */
+
+#define xPPC_XER		xPPC_FIELD(xer())		// XER[SO] is the first byte
+#define xPPC_CTR		xPPC_FIELD(ctr())
+#define xPPC_PC			xPPC_FIELD(pc())
+
+// Host displacement to apply to guest effective addresses
+static inline bool native_memory_access_possible(int32 & disp)
+{
+#if REAL_ADDRESSING || DIRECT_ADDRESSING
+	const intptr base = (intptr)VMBaseDiff;
+	if ((intptr)(int32)base == base) {
+		disp = (int32)base;
+		return true;
+	}
+#endif
+	return false;
+}
+
+// Set CR field crf from x86 flags, merging XER[SO]
+void powerpc_jit::gen_native_record_crf(int crf, bool is_signed)
+{
+	const int shift = 28 - 4 * crf;
+	gen_setcc(is_signed ? X86_CC_L : X86_CC_B, X86_CL);
+	gen_setcc(is_signed ? X86_CC_G : X86_CC_A, X86_DL);
+	gen_mov_zx_8_32(X86_CL, X86_ECX);
+	gen_mov_zx_8_32(X86_DL, X86_EDX);
+	gen_lea_32(x86_memory_operand(0, X86_EDX, X86_ECX, 2), X86_ECX);	// EQ:0, GT:1, LT:2
+	gen_mov_32(x86_immediate_operand(2 << shift), X86_EAX);
+	gen_shl_32(X86_CL, X86_EAX);
+	gen_mov_zx_8_32(x86_memory_operand(xPPC_XER, REG_CPU_ID), X86_EDX);
+	if (shift > 0)
+		gen_shl_32(x86_immediate_operand(shift), X86_EDX);
+	gen_or_32(X86_EDX, X86_EAX);
+	gen_mov_32(x86_memory_operand(xPPC_CR, REG_CPU_ID), X86_EDX);
+	gen_and_32(x86_immediate_operand(~(0xfU << shift)), X86_EDX);
+	gen_or_32(X86_EDX, X86_EAX);
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_CR, REG_CPU_ID));
+}
+
+void powerpc_jit::gen_native_record_cr0(int r)
+{
+	gen_test_32(r, r);
+	gen_native_record_crf(0, true);
+}
+
+// add, subf, neg, mullw, addi, addis
+bool powerpc_jit::gen_native_arith(int mnemo, uint32 opcode)
+{
+	const int rD = rD_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	const int rB = rB_field::extract(opcode);
+
+	switch (mnemo) {
+	case PPC_I(ADDI):
+	case PPC_I(ADDIS): {
+		const uint32 imm = (mnemo == PPC_I(ADDI)) ?
+			operand_SIMM::get(NULL, opcode) : operand_SIMM_shifted::get(NULL, opcode);
+		if (rA == 0)
+			gen_mov_32(x86_immediate_operand(imm), x86_memory_operand(xPPC_GPR(rD), REG_CPU_ID));
+		else if (rA == rD)
+			gen_add_32(x86_immediate_operand(imm), x86_memory_operand(xPPC_GPR(rD), REG_CPU_ID));
+		else {
+			gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_EAX);
+			gen_add_32(x86_immediate_operand(imm), X86_EAX);
+			gen_mov_32(X86_EAX, x86_memory_operand(xPPC_GPR(rD), REG_CPU_ID));
+		}
+		return true;
+	}
+	}
+
+	if (OE_field::test(opcode))
+		return false;
+
+	switch (mnemo) {
+	case PPC_I(ADD):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_EAX);
+		gen_add_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(SUBF):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		gen_sub_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(NEG):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_EAX);
+		gen_neg_32(X86_EAX);
+		break;
+	case PPC_I(MULLW):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_EAX);
+		gen_imul_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		break;
+	default:
+		return false;
+	}
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_GPR(rD), REG_CPU_ID));
+	if (Rc_field::test(opcode))
+		gen_native_record_cr0(X86_EAX);
+	return true;
+}
+
+// and, andc, or, nor, xor, extsb, extsh and their immediate forms
+bool powerpc_jit::gen_native_logical(int mnemo, uint32 opcode)
+{
+	const int rS = rS_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	const int rB = rB_field::extract(opcode);
+	bool record_cr0 = Rc_field::test(opcode);
+
+	switch (mnemo) {
+	case PPC_I(ORI):
+	case PPC_I(ORIS):
+	case PPC_I(XORI):
+	case PPC_I(XORIS): {
+		const uint32 imm = (mnemo == PPC_I(ORI) || mnemo == PPC_I(XORI)) ?
+			operand_UIMM::get(NULL, opcode) : operand_UIMM_shifted::get(NULL, opcode);
+		const bool is_or = (mnemo == PPC_I(ORI) || mnemo == PPC_I(ORIS));
+		if (rS == rA) {
+			x86_memory_operand mem(xPPC_GPR(rA), REG_CPU_ID);
+			if (imm == 0)	// Skip NOP
+				;
+			else if (is_or)
+				gen_or_32(x86_immediate_operand(imm), mem);
+			else
+				gen_xor_32(x86_immediate_operand(imm), mem);
+		}
+		else {
+			gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+			if (imm == 0)	// Register move
+				;
+			else if (is_or)
+				gen_or_32(x86_immediate_operand(imm), X86_EAX);
+			else
+				gen_xor_32(x86_immediate_operand(imm), X86_EAX);
+			gen_mov_32(X86_EAX, x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID));
+		}
+		return true;
+	}
+	case PPC_I(ANDI):
+	case PPC_I(ANDIS):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		gen_and_32(x86_immediate_operand(mnemo == PPC_I(ANDI) ?
+										 operand_UIMM::get(NULL, opcode) :
+										 operand_UIMM_shifted::get(NULL, opcode)), X86_EAX);
+		record_cr0 = true;
+		break;
+	case PPC_I(AND):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		gen_and_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(ANDC):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		gen_not_32(X86_EAX);
+		gen_and_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(OR):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		if (rS != rB)		// Not MR case
+			gen_or_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(NOR):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		gen_or_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		gen_not_32(X86_EAX);
+		break;
+	case PPC_I(XOR):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		gen_xor_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(EXTSB):
+		gen_mov_sx_8_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(EXTSH):
+		gen_mov_sx_16_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+		break;
+	default:
+		return false;
+	}
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID));
+	if (record_cr0)
+		gen_native_record_cr0(X86_EAX);
+	return true;
+}
+
+// rlwinm, rlwimi
+bool powerpc_jit::gen_native_rotate(int mnemo, uint32 opcode)
+{
+	const int rS = rS_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	const int SH = SH_field::extract(opcode);
+	const int MB = MB_field::extract(opcode);
+	const int ME = ME_field::extract(opcode);
+	const uint32 m = mask_operand::compute(MB, ME);
+
+	gen_mov_32(x86_memory_operand(xPPC_GPR(rS), REG_CPU_ID), X86_EAX);
+	if (mnemo == PPC_I(RLWINM) && MB == 0 && ME == 31 - SH) {
+		// slwi rA,rS,SH
+		if (SH > 0)
+			gen_shl_32(x86_immediate_operand(SH), X86_EAX);
+	}
+	else if (mnemo == PPC_I(RLWINM) && ME == 31 && SH == 32 - MB) {
+		// srwi rA,rS,MB
+		gen_shr_32(x86_immediate_operand(MB), X86_EAX);
+	}
+	else {
+		if (SH > 0)
+			gen_rol_32(x86_immediate_operand(SH), X86_EAX);
+		if (m != 0xffffffff)
+			gen_and_32(x86_immediate_operand(m), X86_EAX);
+	}
+	if (mnemo == PPC_I(RLWIMI)) {
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_ECX);
+		gen_and_32(x86_immediate_operand(~m), X86_ECX);
+		gen_or_32(X86_ECX, X86_EAX);
+	}
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID));
+	if (Rc_field::test(opcode))
+		gen_native_record_cr0(X86_EAX);
+	return true;
+}
+
+// cmp, cmpl, cmpi, cmpli
+bool powerpc_jit::gen_native_compare(int mnemo, uint32 opcode)
+{
+	const int crfD = crfD_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	const int rB = rB_field::extract(opcode);
+
+	switch (mnemo) {
+	case PPC_I(CMP):
+	case PPC_I(CMPL):
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_EAX);
+		gen_cmp_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), X86_EAX);
+		break;
+	case PPC_I(CMPI):
+		gen_cmp_32(x86_immediate_operand(operand_SIMM::get(NULL, opcode)),
+				   x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID));
+		break;
+	case PPC_I(CMPLI):
+		gen_cmp_32(x86_immediate_operand(operand_UIMM::get(NULL, opcode)),
+				   x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID));
+		break;
+	default:
+		return false;
+	}
+	gen_native_record_crf(crfD, mnemo == PPC_I(CMP) || mnemo == PPC_I(CMPI));
+	return true;
+}
+
+// Compute effective address into ECX
+void powerpc_jit::gen_native_ea(uint32 opcode, bool do_update, bool do_indexed)
+{
+	const int rA = rA_field::extract(opcode);
+	if (do_indexed) {
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rB_field::extract(opcode)), REG_CPU_ID), X86_ECX);
+		if (rA != 0 || do_update)
+			gen_add_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_ECX);
+	}
+	else {
+		const int32 offset = operand_D::get(NULL, opcode);
+		if (rA == 0 && !do_update)
+			gen_mov_32(x86_immediate_operand(offset), X86_ECX);
+		else {
+			gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), X86_ECX);
+			if (offset != 0)
+				gen_add_32(x86_immediate_operand(offset), X86_ECX);
+		}
+	}
+}
+
+bool powerpc_jit::gen_native_load(uint32 opcode, int size, bool sign, bool do_update, bool do_indexed)
+{
+	int32 disp;
+	if (!native_memory_access_possible(disp))
+		return false;
+
+	gen_native_ea(opcode, do_update, do_indexed);
+	switch (size) {
+	case 1:
+		gen_mov_zx_8_32(x86_memory_operand(disp, X86_ECX), X86_EAX);
+		break;
+	case 2:
+		gen_mov_zx_16_32(x86_memory_operand(disp, X86_ECX), X86_EAX);
+		gen_rol_16(x86_immediate_operand(8), X86_EAX);
+		if (sign)
+			gen_mov_sx_16_32(X86_EAX, X86_EAX);
+		break;
+	case 4:
+		gen_mov_32(x86_memory_operand(disp, X86_ECX), X86_EAX);
+		gen_bswap_32(X86_EAX);
+		break;
+	default:
+		abort();
+	}
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_GPR(rD_field::extract(opcode)), REG_CPU_ID));
+	if (do_update)
+		gen_mov_32(X86_ECX, x86_memory_operand(xPPC_GPR(rA_field::extract(opcode)), REG_CPU_ID));
+	return true;
+}
+
+bool powerpc_jit::gen_native_store(uint32 opcode, int size, bool do_update, bool do_indexed)
+{
+	int32 disp;
+	if (!native_memory_access_possible(disp))
+		return false;
+
+	gen_native_ea(opcode, do_update, do_indexed);
+	gen_mov_32(x86_memory_operand(xPPC_GPR(rS_field::extract(opcode)), REG_CPU_ID), X86_EAX);
+	switch (size) {
+	case 1:
+		gen_mov_8(X86_AL, x86_memory_operand(disp, X86_ECX));
+		break;
+	case 2:
+		gen_rol_16(x86_immediate_operand(8), X86_EAX);
+		gen_mov_16(X86_AX, x86_memory_operand(disp, X86_ECX));
+		break;
+	case 4:
+		gen_bswap_32(X86_EAX);
+		gen_mov_32(X86_EAX, x86_memory_operand(disp, X86_ECX));
+		break;
+	default:
+		abort();
+	}
+	if (do_update)
+		gen_mov_32(X86_ECX, x86_memory_operand(xPPC_GPR(rA_field::extract(opcode)), REG_CPU_ID));
+	return true;
+}
+
+#if PPC_ENABLE_FPU_EXCEPTIONS == 0
+/*
+ *	Native floating-point code generation
+ *
+ *	Arithmetic is performed with scalar SSE2 instructions, which honour
+ *	the rounding mode set from FPSCR[RN] by mtfsf and friends. FPSCR
+ *	exception bits are not maintained, as in the interpreter. FPSCR[FPRF]
+ *	is not computed here either: the result is recorded along with its
+ *	precision and only classified once FPSCR is read (commit_fprf()).
+ *	V0 and V1 are used as scratch registers.
+ */
+
+#define xPPC_FPR(N)			xPPC_FIELD(fpr(N))
+#define xPPC_FPSCR			xPPC_FIELD(regs().fpscr)
+#define xPPC_FPRF_VALUE		xPPC_FIELD(fprf_value)
+#define xPPC_FPRF_PENDING	xPPC_FIELD(fprf_pending)
+
+// Set CR1 from FPSCR[FX,FEX,VX,OX], which are not lazily computed
+void powerpc_jit::gen_native_record_cr1(void)
+{
+	gen_mov_32(x86_memory_operand(xPPC_FPSCR, REG_CPU_ID), X86_EAX);
+	gen_shr_32(x86_immediate_operand(4), X86_EAX);
+	gen_and_32(x86_immediate_operand(0x0f000000), X86_EAX);
+	gen_mov_32(x86_memory_operand(xPPC_CR, REG_CPU_ID), X86_EDX);
+	gen_and_32(x86_immediate_operand(~0x0f000000), X86_EDX);
+	gen_or_32(X86_EDX, X86_EAX);
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_CR, REG_CPU_ID));
+}
+
+// Commit V0 to frD, rounded to single-precision if needed, and defer FPSCR[FPRF]
+void powerpc_jit::gen_native_fp_result(int frD, bool is_single, bool negate)
+{
+	if (is_single) {
+		gen_cvtsd2ss(REG_V0_ID, REG_V0_ID);
+		gen_cvtss2sd(REG_V0_ID, REG_V0_ID);
+	}
+	gen_movsd(REG_V0_ID, x86_memory_operand(xPPC_FPR(frD), REG_CPU_ID));
+	gen_movsd(REG_V0_ID, x86_memory_operand(xPPC_FPRF_VALUE, REG_CPU_ID));
+	if (negate) {
+		// Negate after rounding, as -(float)x in the interpreter
+		gen_xor_32(x86_immediate_operand(0x80000000), x86_memory_operand(xPPC_FPR(frD) + 4, REG_CPU_ID));
+		gen_xor_32(x86_immediate_operand(0x80000000), x86_memory_operand(xPPC_FPRF_VALUE + 4, REG_CPU_ID));
+	}
+	const int pending = is_single ? powerpc_cpu::FPRF_SINGLE : powerpc_cpu::FPRF_DOUBLE;
+	gen_mov_32(x86_immediate_operand(pending), x86_memory_operand(xPPC_FPRF_PENDING, REG_CPU_ID));
+}
+
+// fadd, fsub, fmul, fdiv and their single-precision forms
+bool powerpc_jit::gen_native_fp_arith(int mnemo, uint32 opcode)
+{
+	const int frA = frA_field::extract(opcode);
+	const int frB = frB_field::extract(opcode);
+	const int frC = frC_field::extract(opcode);
+	bool is_single = false;
+
+	gen_movsd(x86_memory_operand(xPPC_FPR(frA), REG_CPU_ID), REG_V0_ID);
+	switch (mnemo) {
+	case PPC_I(FADDS):
+		is_single = true;
+		// fall-through
+	case PPC_I(FADD):
+		gen_addsd(x86_memory_operand(xPPC_FPR(frB), REG_CPU_ID), REG_V0_ID);
+		break;
+	case PPC_I(FSUBS):
+		is_single = true;
+		// fall-through
+	case PPC_I(FSUB):
+		gen_subsd(x86_memory_operand(xPPC_FPR(frB), REG_CPU_ID), REG_V0_ID);
+		break;
+	case PPC_I(FMULS):
+		is_single = true;
+		// fall-through
+	case PPC_I(FMUL):
+		gen_mulsd(x86_memory_operand(xPPC_FPR(frC), REG_CPU_ID), REG_V0_ID);
+		break;
+	case PPC_I(FDIVS):
+		is_single = true;
+		// fall-through
+	case PPC_I(FDIV):
+		gen_divsd(x86_memory_operand(xPPC_FPR(frB), REG_CPU_ID), REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
+	gen_native_fp_result(frD_field::extract(opcode), is_single, false);
+	if (Rc_field::test(opcode))
+		gen_native_record_cr1();
+	return true;
+}
+
+// fmadd, fmsub, fnmadd, fnmsub and their single-precision forms
+bool powerpc_jit::gen_native_fp_madd(int mnemo, uint32 opcode)
+{
+	const int frB = frB_field::extract(opcode);
+	bool is_single = false, is_sub = false, negate = false;
+	switch (mnemo) {
+	case PPC_I(FMADD):									break;
+	case PPC_I(FMSUB):	is_sub = true;					break;
+	case PPC_I(FNMADD):	negate = true;					break;
+	case PPC_I(FNMSUB):	negate = is_sub = true;			break;
+	case PPC_I(FMADDS):	is_single = true;				break;
+	case PPC_I(FMSUBS):	is_single = is_sub = true;		break;
+	case PPC_I(FNMADDS): is_single = negate = true;		break;
+	case PPC_I(FNMSUBS): is_single = negate = is_sub = true; break;
+	default:
+		abort();
+	}
+
+	// NOTE: the product is rounded to double-precision, unlike in the
+	// interpreter that may compute it with extended precision
+	gen_movsd(x86_memory_operand(xPPC_FPR(frA_field::extract(opcode)), REG_CPU_ID), REG_V0_ID);
+	gen_mulsd(x86_memory_operand(xPPC_FPR(frC_field::extract(opcode)), REG_CPU_ID), REG_V0_ID);
+	if (is_sub)
+		gen_subsd(x86_memory_operand(xPPC_FPR(frB), REG_CPU_ID), REG_V0_ID);
+	else
+		gen_addsd(x86_memory_operand(xPPC_FPR(frB), REG_CPU_ID), REG_V0_ID);
+	gen_native_fp_result(frD_field::extract(opcode), is_single, negate);
+	if (Rc_field::test(opcode))
+		gen_native_record_cr1();
+	return true;
+}
+
+// fmr, fabs, fnabs, fneg only touch the sign bit and leave FPSCR alone
+bool powerpc_jit::gen_native_fp_move(int mnemo, uint32 opcode)
+{
+	const int frD = frD_field::extract(opcode);
+	const int frB = frB_field::extract(opcode);
+
+	gen_mov_32(x86_memory_operand(xPPC_FPR(frB), REG_CPU_ID), X86_EAX);
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_FPR(frD), REG_CPU_ID));
+	gen_mov_32(x86_memory_operand(xPPC_FPR(frB) + 4, REG_CPU_ID), X86_EAX);
+	switch (mnemo) {
+	case PPC_I(FMR):
+		break;
+	case PPC_I(FABS):
+		gen_and_32(x86_immediate_operand(0x7fffffff), X86_EAX);
+		break;
+	case PPC_I(FNABS):
+		gen_or_32(x86_immediate_operand(0x80000000), X86_EAX);
+		break;
+	case PPC_I(FNEG):
+		gen_xor_32(x86_immediate_operand(0x80000000), X86_EAX);
+		break;
+	default:
+		abort();
+	}
+	gen_mov_32(X86_EAX, x86_memory_operand(xPPC_FPR(frD) + 4, REG_CPU_ID));
+	if (Rc_field::test(opcode))
+		gen_native_record_cr1();
+	return true;
+}
+
+// frsp, fctiw, fctiwz
+bool powerpc_jit::gen_native_fp_convert(int mnemo, uint32 opcode)
+{
+	const int frD = frD_field::extract(opcode);
+
+	gen_movsd(x86_memory_operand(xPPC_FPR(frB_field::extract(opcode)), REG_CPU_ID), REG_V0_ID);
+	if (mnemo == PPC_I(FRSP))
+		gen_native_fp_result(frD, true, false);
+	else {
+		static uintptr bounds = 0;
+		if (bounds == 0) {
+			static const double value[2] = { -2147483648.0, 2147483647.0 };
+			bounds = (uintptr)copy_data((const uint8 *)value, sizeof(value));
+			assert(bounds <= 0xffffffff);
+		}
+
+		if (mnemo == PPC_I(FCTIWZ))
+			gen_cvttsd2si_32(REG_V0_ID, X86_EAX);
+		else
+			gen_cvtsd2si_32(REG_V0_ID, X86_EAX);
+
+		// Out of range operands yield 0x80000000, which is only correct
+		// for NaN and negative values: turn it into 0x7fffffff otherwise
+		gen_xorpd(REG_V1_ID, REG_V1_ID);
+		gen_ucomisd(REG_V1_ID, REG_V0_ID);
+		gen_setcc(X86_CC_A, X86_CL);
+		gen_cmp_32(x86_immediate_operand(0x80000000), X86_EAX);
+		gen_setcc(X86_CC_E, X86_DL);
+		gen_and_8(X86_DL, X86_CL);
+		gen_mov_zx_8_32(X86_CL, X86_ECX);
+		gen_sub_32(X86_ECX, X86_EAX);
+
+		// The interpreter sign-extends the integer word into the upper
+		// half of frD, unless the operand was out of range (or NaN)
+		gen_ucomisd(x86_memory_operand(bounds, X86_NOREG), REG_V0_ID);
+		gen_setcc(X86_CC_AE, X86_CL);
+		gen_movsd(x86_memory_operand(bounds + 8, X86_NOREG), REG_V1_ID);
+		gen_ucomisd(REG_V0_ID, REG_V1_ID);
+		gen_setcc(X86_CC_AE, X86_DL);
+		gen_and_8(X86_DL, X86_CL);
+		gen_mov_zx_8_32(X86_CL, X86_ECX);
+		gen_neg_32(X86_ECX);
+		gen_mov_32(X86_EAX, X86_EDX);
+		gen_sar_32(x86_immediate_operand(31), X86_EDX);
+		gen_and_32(X86_ECX, X86_EDX);
+		gen_mov_32(X86_EAX, x86_memory_operand(xPPC_FPR(frD), REG_CPU_ID));
+		gen_mov_32(X86_EDX, x86_memory_operand(xPPC_FPR(frD) + 4, REG_CPU_ID));
+	}
+	if (Rc_field::test(opcode))
+		gen_native_record_cr1();
+	return true;
+}
+#endif
+
+bool powerpc_jit::gen_native(int mnemo, uint32 opcode)
+{
+	switch (mnemo) {
+	case PPC_I(ADDI):
+	case PPC_I(ADDIS):
+	case PPC_I(ADD):
+	case PPC_I(SUBF):
+	case PPC_I(NEG):
+	case PPC_I(MULLW):
+		return gen_native_arith(mnemo, opcode);
+	case PPC_I(AND):
+	case PPC_I(ANDC):
+	case PPC_I(ANDI):
+	case PPC_I(ANDIS):
+	case PPC_I(OR):
+	case PPC_I(ORI):
+	case PPC_I(ORIS):
+	case PPC_I(NOR):
+	case PPC_I(XOR):
+	case PPC_I(XORI):
+	case PPC_I(XORIS):
+	case PPC_I(EXTSB):
+	case PPC_I(EXTSH):
+		return gen_native_logical(mnemo, opcode);
+	case PPC_I(RLWINM):
+	case PPC_I(RLWIMI):
+		return gen_native_rotate(mnemo, opcode);
+	case PPC_I(CMP):
+	case PPC_I(CMPI):
+	case PPC_I(CMPL):
+	case PPC_I(CMPLI):
+		return gen_native_compare(mnemo, opcode);
+	case PPC_I(LBZ):	return gen_native_load(opcode, 1, false, false, false);
+	case PPC_I(LBZU):	return gen_native_load(opcode, 1, false, true,  false);
+	case PPC_I(LBZUX):	return gen_native_load(opcode, 1, false, true,  true);
+	case PPC_I(LBZX):	return gen_native_load(opcode, 1, false, false, true);
+	case PPC_I(LHA):	return gen_native_load(opcode, 2, true,  false, false);
+	case PPC_I(LHAU):	return gen_native_load(opcode, 2, true,  true,  false);
+	case PPC_I(LHAUX):	return gen_native_load(opcode, 2, true,  true,  true);
+	case PPC_I(LHAX):	return gen_native_load(opcode, 2, true,  false, true);
+	case PPC_I(LHZ):	return gen_native_load(opcode, 2, false, false, false);
+	case PPC_I(LHZU):	return gen_native_load(opcode, 2, false, true,  false);
+	case PPC_I(LHZUX):	return gen_native_load(opcode, 2, false, true,  true);
+	case PPC_I(LHZX):	return gen_native_load(opcode, 2, false, false, true);
+	case PPC_I(LWZ):	return gen_native_load(opcode, 4, false, false, false);
+	case PPC_I(LWZU):	return gen_native_load(opcode, 4, false, true,  false);
+	case PPC_I(LWZUX):	return gen_native_load(opcode, 4, false, true,  true);
+	case PPC_I(LWZX):	return gen_native_load(opcode, 4, false, false, true);
+	case PPC_I(STB):	return gen_native_store(opcode, 1, false, false);
+	case PPC_I(STBU):	return gen_native_store(opcode, 1, true,  false);
+	case PPC_I(STBUX):	return gen_native_store(opcode, 1, true,  true);
+	case PPC_I(STBX):	return gen_native_store(opcode, 1, false, true);
+	case PPC_I(STH):	return gen_native_store(opcode, 2, false, false);
+	case PPC_I(STHU):	return gen_native_store(opcode, 2, true,  false);
+	case PPC_I(STHUX):	return gen_native_store(opcode, 2, true,  true);
+	case PPC_I(STHX):	return gen_native_store(opcode, 2, false, true);
+	case PPC_I(STW):	return gen_native_store(opcode, 4, false, false);
+	case PPC_I(STWU):	return gen_native_store(opcode, 4, true,  false);
+	case PPC_I(STWUX):	return gen_native_store(opcode, 4, true,  true);
+	case PPC_I(STWX):	return gen_native_store(opcode, 4, false, true);
+#if PPC_ENABLE_FPU_EXCEPTIONS == 0
+	case PPC_I(FADD):
+	case PPC_I(FADDS):
+	case PPC_I(FSUB):
+	case PPC_I(FSUBS):
+	case PPC_I(FMUL):
+	case PPC_I(FMULS):
+	case PPC_I(FDIV):
+	case PPC_I(FDIVS):
+		return gen_native_fp_arith(mnemo, opcode);
+	case PPC_I(FMADD):
+	case PPC_I(FMADDS):
+	case PPC_I(FMSUB):
+	case PPC_I(FMSUBS):
+	case PPC_I(FNMADD):
+	case PPC_I(FNMADDS):
+	case PPC_I(FNMSUB):
+	case PPC_I(FNMSUBS):
+		return gen_native_fp_madd(mnemo, opcode);
+	case PPC_I(FMR):
+	case PPC_I(FABS):
+	case PPC_I(FNABS):
+	case PPC_I(FNEG):
+		return gen_native_fp_move(mnemo, opcode);
+	case PPC_I(FRSP):
+	case PPC_I(FCTIW):
+	case PPC_I(FCTIWZ):
+		return gen_native_fp_convert(mnemo, opcode);
+#endif
+	}
+	return false;
+}
+
+// Branches that need both a CR bit and CTR are left to dyngen
+void powerpc_jit::gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_chaining)
+{
+	if (BO_CONDITIONAL_BRANCH(bo) && BO_DECREMENT_CTR(bo)) {
+		powerpc_dyngen::gen_bc(bo, bi, tpc, npc, direct_chaining);
+		return;
+	}
+
+	int cc = -1;
+	if (BO_CONDITIONAL_BRANCH(bo)) {
+		gen_test_32(x86_immediate_operand(1 << (31 - bi)), x86_memory_operand(xPPC_CR, REG_CPU_ID));
+		cc = BO_BRANCH_IF_TRUE(bo) ? X86_CC_NE : X86_CC_E;
+	}
+	else if (BO_DECREMENT_CTR(bo)) {
+		gen_sub_32(x86_immediate_operand(1), x86_memory_operand(xPPC_CTR, REG_CPU_ID));
+		cc = BO_BRANCH_IF_CTR_ZERO(bo) ? X86_CC_E : X86_CC_NE;
+	}
+
+	if (cc < 0) {
+		// one-way branches
+		if (direct_chaining) {
+			jit_codegen::gen_jmp(x86_immediate_operand((uintptr)code_ptr()));
+			jmp_addr[0] = code_ptr() - 4;
+		}
+		else if (tpc != 0xffffffff)
+			gen_mov_32(x86_immediate_operand(tpc), x86_memory_operand(xPPC_PC, REG_CPU_ID));
+		else
+			gen_mov_32(REG_T0_ID, x86_memory_operand(xPPC_PC, REG_CPU_ID));
+	}
+	else {
+		// two-way branches, targets are resolved at chaining time
+		if (direct_chaining) {
+			gen_jcc_offset(cc, x86_immediate_operand(0));
+			jmp_addr[0] = code_ptr() - 4;
+			jit_codegen::gen_jmp(x86_immediate_operand((uintptr)code_ptr()));
+			jmp_addr[1] = code_ptr() - 4;
+		}
+		else {
+			gen_mov_32(x86_immediate_operand(npc), X86_EAX);
+			if (tpc != 0xffffffff) {
+				gen_mov_32(x86_immediate_operand(tpc), X86_EDX);
+				gen_cmov_32(cc, X86_EDX, X86_EAX);
+			}
+			else
+				gen_cmov_32(cc, REG_T0_ID, X86_EAX);
+			gen_mov_32(X86_EAX, x86_memory_operand(xPPC_PC, REG_CPU_ID));
+		}
+	}
+}
 #endif
@@ -38,6 +38,12 @@ struct powerpc_jit
 	bool gen_vector_3(int mnemo, int vD, int vA, int vB, int vC);
 	bool gen_vector_compare(int mnemo, int vD, int vA, int vB, bool Rc);
 
+#if PPC_NATIVE_CODEGEN
+	// Native code generation, returns false if dyngen ops are needed
+	bool gen_native(int mnemo, uint32 opcode);
+	void gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_chaining);
+#endif
+
 private:
 	// Mid-level code generator info
 	typedef bool (powerpc_jit::*gen_handler_t)(int, bool);
@@ -96,10 +102,45 @@ private:
 	bool gen_sse2_vspltb(int mnemo, int vD, int UIMM, int vB);
 	bool gen_sse2_vsplth(int mnemo, int vD, int UIMM, int vB);
 	bool gen_sse2_vspltw(int mnemo, int vD, int UIMM, int vB);
+	void gen_sse2_record_sat(int vR, bool is_zero);
+	bool gen_sse2_arith_sat(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_arith_sws(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_arith_cu(int mnemo, int vD, int vA, int vB, bool Rc);
+	bool gen_sse2_vcmpbfp(int mnemo, int vD, int vA, int vB, bool Rc);
+	bool gen_sse2_vmrg(int mnemo, int vD, int vA, int vB);
+	void gen_sse2_vpk_sat(int size, bool is_signed);
+	bool gen_sse2_vpk(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vupk(int mnemo, int vD, int vA, int vB);
 	uintptr gen_ssse3_vswap_mask(void);
 	bool gen_ssse3_lvx(int mnemo, int vD, int rA, int rB);
 	bool gen_ssse3_stvx(int mnemo, int vS, int rA, int rB);
 	bool gen_ssse3_vperm(int mnemo, int vD, int vA, int vB, int vC);
+	bool gen_sse41_arith_uws(int mnemo, int vD, int vA, int vB);
+	bool gen_avx2_vsw(int mnemo, int vD, int vA, int vB);
+	bool gen_avx2_vrlw(int mnemo, int vD, int vA, int vB);
+	void gen_avx2_vsh_counts(int vA, int vB);
+	bool gen_avx2_vsh(int mnemo, int vD, int vA, int vB);
+	bool gen_avx2_vrlh(int mnemo, int vD, int vA, int vB);
+#endif
+
+#if PPC_NATIVE_CODEGEN
+	void gen_native_record_crf(int crf, bool is_signed);
+	void gen_native_record_cr0(int r);
+	bool gen_native_arith(int mnemo, uint32 opcode);
+	bool gen_native_logical(int mnemo, uint32 opcode);
+	bool gen_native_rotate(int mnemo, uint32 opcode);
+	bool gen_native_compare(int mnemo, uint32 opcode);
+	void gen_native_ea(uint32 opcode, bool do_update, bool do_indexed);
+	bool gen_native_load(uint32 opcode, int size, bool sign, bool do_update, bool do_indexed);
+	bool gen_native_store(uint32 opcode, int size, bool do_update, bool do_indexed);
+#if PPC_ENABLE_FPU_EXCEPTIONS == 0
+	void gen_native_record_cr1(void);
+	void gen_native_fp_result(int frD, bool is_single, bool negate);
+	bool gen_native_fp_arith(int mnemo, uint32 opcode);
+	bool gen_native_fp_madd(int mnemo, uint32 opcode);
+	bool gen_native_fp_move(int mnemo, uint32 opcode);
+	bool gen_native_fp_convert(int mnemo, uint32 opcode);
+#endif
 #endif
 };
 
@@ -186,6 +186,12 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		};
 		operands_t op;
 
+#if PPC_NATIVE_CODEGEN
+		// Emit host code directly if possible
+		if (dg.gen_native(ii->mnemo, opcode))
+			goto do_next;
+#endif
+
 		switch (ii->mnemo) {
 		case PPC_I(LBZ):		// Load Byte and Zero
 			op.mem.size = 1;
@@ -1382,6 +1388,7 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			assert(vA_field::mask() == rA_field::mask());
 			assert(vB_field::mask() == rB_field::mask());
 			// fall-through
+		case PPC_I(VCMPBFP):
 		case PPC_I(VCMPEQFP):
 		case PPC_I(VCMPEQUB):
 		case PPC_I(VCMPEQUH):
@@ -1391,6 +1398,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(VCMPGTSB):
 		case PPC_I(VCMPGTSH):
 		case PPC_I(VCMPGTSW):
+		case PPC_I(VCMPGTUB):
+		case PPC_I(VCMPGTUH):
+		case PPC_I(VCMPGTUW):
 		{
 			const int vD = vD_field::extract(opcode);
 			const int vA = vA_field::extract(opcode);
@@ -1420,6 +1430,52 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(VXOR):
 		case PPC_I(VREFP):
 		case PPC_I(VRSQRTEFP):
+		case PPC_I(VADDSBS):
+		case PPC_I(VADDSHS):
+		case PPC_I(VADDSWS):
+		case PPC_I(VADDUBS):
+		case PPC_I(VADDUHS):
+		case PPC_I(VADDUWS):
+		case PPC_I(VSUBSBS):
+		case PPC_I(VSUBSHS):
+		case PPC_I(VSUBSWS):
+		case PPC_I(VSUBUBS):
+		case PPC_I(VSUBUHS):
+		case PPC_I(VSUBUWS):
+		case PPC_I(VMAXSB):
+		case PPC_I(VMAXSW):
+		case PPC_I(VMAXUH):
+		case PPC_I(VMAXUW):
+		case PPC_I(VMINSB):
+		case PPC_I(VMINSW):
+		case PPC_I(VMINUH):
+		case PPC_I(VMINUW):
+		case PPC_I(VMRGHB):
+		case PPC_I(VMRGHH):
+		case PPC_I(VMRGHW):
+		case PPC_I(VMRGLB):
+		case PPC_I(VMRGLH):
+		case PPC_I(VMRGLW):
+		case PPC_I(VPKSHSS):
+		case PPC_I(VPKSHUS):
+		case PPC_I(VPKSWSS):
+		case PPC_I(VPKSWUS):
+		case PPC_I(VPKUHUM):
+		case PPC_I(VPKUHUS):
+		case PPC_I(VPKUWUM):
+		case PPC_I(VPKUWUS):
+		case PPC_I(VUPKHSB):
+		case PPC_I(VUPKHSH):
+		case PPC_I(VUPKLSB):
+		case PPC_I(VUPKLSH):
+		case PPC_I(VRLH):
+		case PPC_I(VRLW):
+		case PPC_I(VSLH):
+		case PPC_I(VSLW):
+		case PPC_I(VSRAH):
+		case PPC_I(VSRAW):
+		case PPC_I(VSRH):
+		case PPC_I(VSRW):
 		{
 			const int vD = vD_field::extract(opcode);
 			const int vA = vA_field::extract(opcode);
@@ -1525,6 +1581,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			done_compile = cg_context.done_compile;
 		}
 		}
+#if PPC_NATIVE_CODEGEN
+	  do_next:
+#endif
 		if (dg.full_translation_cache()) {
 			// Invalidate cache and start again
 			invalidate_cache();
@@ -1581,6 +1640,7 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		my_block_cache.add_to_dormant_list(bi);
 	else
 		my_block_cache.add_to_active_list(bi);
+	protect_code(min_pc, max_pc);
 #if PPC_PROFILE_COMPILE_TIME
 	compile_time += (clock() - start_time);
 #endif
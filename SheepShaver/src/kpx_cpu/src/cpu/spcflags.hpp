@@ -32,6 +32,7 @@ enum {
 	SPCFLAG_CPU_ENTER_MON			= 1 << 3,	// Enter cxmon
 	SPCFLAG_JIT_EXEC_RETURN			= 1 << 4,	// Return from compiled code
 	SPCFLAG_HANDLE_SAVESTATE        = 1 << 5,   // Save/load state
+	SPCFLAG_CPU_FLUSH_CODE			= 1 << 6,	// Invalidate written code pages
 };
 
 class basic_spcflags
@@ -24,6 +24,7 @@
 #include <limits>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <assert.h>
 #include <netinet/in.h> // ntohl(), htonl()
 #include <setjmp.h>
@@ -210,6 +211,11 @@ uint64 GetTicks_usec(void)
 	return clock();
 }
 
+uint32 TimerDateTimeTicks(void)
+{
+	return clock();
+}
+
 void HandleInterrupt(powerpc_registers *)
 {
 }
@@ -238,6 +244,16 @@ struct powerpc_cpu_base
 	void set_lr(uint32 value)			{ lr() = value; }
 	uint32 get_gpr(int i) const			{ return gpr(i); }
 	void set_gpr(int i, uint32 value)	{ gpr(i) = value; }
+	uint32 get_ctr() const				{ return ctr(); }
+	void set_ctr(uint32 value)			{ ctr() = value; }
+	powerpc_vr const & get_vr(int i) const	{ return vr(i); }
+	void set_vr(int i, powerpc_vr const & v)	{ vr(i) = v; }
+	uint32 get_vscr() const				{ return vscr().get(); }
+	void set_vscr(uint32 value)			{ vscr().set(value); }
+	uint64 get_fpr(int i) const			{ return fpr_dw(i); }
+	void set_fpr(int i, uint64 value)	{ fpr_dw(i) = value; }
+	uint32 get_fpscr()					{ return fpscr(); }
+	void set_fpscr(uint32 value)		{ fpscr() = value; }
 };
 
 powerpc_cpu_base::powerpc_cpu_base()
@@ -2178,6 +2194,987 @@ bool powerpc_test_cpu::test(void)
 	return errors == 0;
 }
 
+#if EMU_KHEPERIX && (PPC_DECODE_CACHE || PPC_ENABLE_JIT)
+// Check that a block spanning several pages is flushed from any of them
+static bool test_block_cache_spans(void)
+{
+	typedef block_cache< powerpc_block_info, lazy_allocator > test_cache_t;
+	static test_cache_t bc;
+	bool ok = true;
+
+	for (int n_pages = 1; n_pages <= 5; n_pages++) {
+		for (int hit = 0; hit < n_pages; hit++) {
+			powerpc_block_info *bi = bc.new_blockinfo();
+			bi->init(0x20000800);
+			bi->min_pc = bi->pc;
+			bi->max_pc = bi->pc + (n_pages - 1) * 4096 + 0x200;
+			bc.add_to_cl_list(bi);
+			bc.add_to_active_list(bi);
+
+			const uint32 start = 0x20000000 + hit * 4096 + (hit ? 0x100 : 0x900);
+			if (!bc.has_code(start, start + 4)) {
+				fprintf(stderr, "ERROR: %d-page block not found in page %d\n", n_pages, hit);
+				ok = false;
+			}
+			bc.clear_range(start, start + 4);
+			if (bc.find(0x20000800) != NULL) {
+				fprintf(stderr, "ERROR: %d-page block not flushed from page %d\n", n_pages, hit);
+				ok = false;
+				bc.clear();
+			}
+			bc.initialize();
+		}
+	}
+	return ok;
+}
+
+// Block lookup microbenchmark
+static void bench_block_cache(void)
+{
+	typedef block_cache< powerpc_block_info, lazy_allocator > bench_cache_t;
+	static bench_cache_t bc;
+
+	// Spread blocks over 16 MB of guest code, 32 bytes apart. Entry
+	// points 128 KB apart alias in the cache tags, so most lookups
+	// below have to go through the full lookup path
+	const int n_blocks = 16 * 1024 * 1024 / 32;
+	std::vector<uint32> pcs;
+	for (uint32 i = 0; i < n_blocks; i++) {
+		powerpc_block_info *bi = bc.new_blockinfo();
+		bi->init(0x10000000 + i * 32);
+		bi->min_pc = bi->pc;
+		bi->max_pc = bi->pc + 28;
+		bc.add_to_cl_list(bi);
+		bc.add_to_active_list(bi);
+		pcs.push_back(bi->pc);
+	}
+	for (uint32 i = 0, j = 0; i < n_blocks; i++, j = (j + 4099) % n_blocks)
+		pcs[i] = 0x10000000 + j * 32;
+
+	const int n_lookups = 4 * 1024 * 1024;
+	uint32 found = 0;
+	clock_t start_time = clock();
+	for (int i = 0; i < n_lookups; i++) {
+		if (bc.find(pcs[i % n_blocks]))
+			found++;
+	}
+	clock_t end_time = clock();
+	double elapsed = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+	printf("Block lookups: %d in %.3f s (%.1f ns/lookup), %u hits\n",
+		   n_lookups, elapsed, elapsed * 1e9 / n_lookups, found);
+
+	const int n_flushes = 64 * 1024;
+	start_time = clock();
+	for (int i = 0; i < n_flushes; i++) {
+		const uint32 start = 0x10000000 + (i % 4096) * 4096;
+		bc.clear_range(start, start + 4096);
+	}
+	end_time = clock();
+	elapsed = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+	printf("Range flushes: %d in %.3f s (%.1f us/flush)\n",
+		   n_flushes, elapsed, elapsed * 1e6 / n_flushes);
+
+	bc.clear();
+	bc.initialize();
+}
+#endif
+
+#if EMU_KHEPERIX
+/**
+ *		Differential fuzzing and benchmarks
+ *
+ *		Random integer instruction sequences are run through the
+ *		interpreter, the decode cache and the JIT. Each mode has its own
+ *		code and data buffers. Final registers and data must match the
+ *		ones of the interpreter, which serves as reference.
+ **/
+
+enum {
+	FUZZ_MODE_INTERPRETER,
+	FUZZ_MODE_DECODE_CACHE,
+#if PPC_ENABLE_JIT
+	FUZZ_MODE_JIT,
+#endif
+	FUZZ_MODE_MAX
+};
+
+static const char *fuzz_mode_names[] = {
+	"interpreter", "decode cache", "jit"
+};
+
+enum {
+	FUZZ_CLASS_ARITH,
+	FUZZ_CLASS_LOGICAL,
+	FUZZ_CLASS_ROTATE,
+	FUZZ_CLASS_COMPARE,
+	FUZZ_CLASS_LOADSTORE,
+	FUZZ_CLASS_BRANCH,
+	FUZZ_CLASS_MAX,
+	FUZZ_CLASS_MIXED = FUZZ_CLASS_MAX
+};
+
+static const char *fuzz_class_names[] = {
+	"arith", "logical", "rotate", "compare", "load/store", "branch", "mixed"
+};
+
+// r30 and r31 hold an index and a base address into the data buffer,
+// generated code never writes to them
+const int FUZZ_RINDEX = 30;
+const int FUZZ_RBASE = 31;
+const int FUZZ_NREGS = 30;
+const int FUZZ_MAX_SEQUENCE = 32;
+const int FUZZ_CODE_SIZE = 256;
+const uint32 FUZZ_DATA_SIZE = 4096;
+
+static uint32 fuzz_code[FUZZ_MODE_MAX][FUZZ_CODE_SIZE];
+static uint32 fuzz_trampoline[FUZZ_MODE_MAX][2];
+static uint8 fuzz_data[FUZZ_MODE_MAX][FUZZ_DATA_SIZE];
+
+struct fuzz_state {
+	uint32 gpr[32];
+	uint32 cr, xer, ctr;
+	uint8 data[FUZZ_DATA_SIZE];
+};
+
+// Deterministic pseudo-random numbers (xorshift32)
+static uint32 fuzz_seed = 1;
+
+static uint32 fuzz_rand(void)
+{
+	fuzz_seed ^= fuzz_seed << 13;
+	fuzz_seed ^= fuzz_seed >> 17;
+	fuzz_seed ^= fuzz_seed << 5;
+	return fuzz_seed;
+}
+
+static inline uint32 fuzz_pick(uint32 n)
+{
+	return fuzz_rand() % n;
+}
+
+static uint32 fuzz_value(void)
+{
+	static const uint32 special_values[] = {
+		0, 1, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000, 0xffffffff
+	};
+	const int n_special_values = sizeof(special_values)/sizeof(special_values[0]);
+	if (fuzz_pick(4) == 0)
+		return special_values[fuzz_pick(n_special_values)];
+	return fuzz_rand();
+}
+
+#define FUZZ_PICK(TABLE) TABLE[fuzz_pick(sizeof(TABLE)/sizeof(TABLE[0]))]
+
+static uint32 fuzz_gen_arith(void)
+{
+	// add, addc, adde, subf, subfc, subfe, mullw, divw, divwu
+	static const int xo_ops[] = { 266, 10, 138, 40, 8, 136, 235, 491, 459 };
+	// addze, addme, subfze, subfme, neg
+	static const int xo_unary_ops[] = { 202, 234, 200, 232, 104 };
+	// mulhw, mulhwu
+	static const int xo_high_ops[] = { 75, 11 };
+	// addi, addis, addic, addic., subfic, mulli
+	static const int d_ops[] = { 14, 15, 12, 13, 8, 7 };
+
+	const int rD = fuzz_pick(FUZZ_NREGS);
+	const int rA = fuzz_pick(FUZZ_NREGS);
+	const int rB = fuzz_pick(FUZZ_NREGS);
+	switch (fuzz_pick(4)) {
+	case 0: return _XO(31, rD, rA, rB, fuzz_pick(2), FUZZ_PICK(xo_ops), fuzz_pick(2));
+	case 1: return _XO(31, rD, rA, 0, fuzz_pick(2), FUZZ_PICK(xo_unary_ops), fuzz_pick(2));
+	case 2: return _XO(31, rD, rA, rB, 0, FUZZ_PICK(xo_high_ops), fuzz_pick(2));
+	}
+	return _D(FUZZ_PICK(d_ops), rD, rA, fuzz_value());
+}
+
+static uint32 fuzz_gen_logical(void)
+{
+	// and, andc, or, orc, xor, nand, nor, eqv, slw, srw, sraw
+	static const int x_ops[] = { 28, 60, 444, 412, 316, 476, 124, 284, 24, 536, 792 };
+	// extsb, extsh, cntlzw
+	static const int x_unary_ops[] = { 954, 922, 26 };
+	// ori, oris, xori, xoris, andi., andis.
+	static const int d_ops[] = { 24, 25, 26, 27, 28, 29 };
+
+	const int rS = fuzz_pick(FUZZ_NREGS);
+	const int rA = fuzz_pick(FUZZ_NREGS);
+	const int rB = fuzz_pick(FUZZ_NREGS);
+	switch (fuzz_pick(4)) {
+	case 0: return _X(31, rS, rA, rB, FUZZ_PICK(x_ops), fuzz_pick(2));
+	case 1: return _X(31, rS, rA, 0, FUZZ_PICK(x_unary_ops), fuzz_pick(2));
+	case 2: return _X(31, rS, rA, fuzz_pick(32), 824, fuzz_pick(2)); // srawi
+	}
+	return _D(FUZZ_PICK(d_ops), rS, rA, fuzz_value());
+}
+
+static uint32 fuzz_gen_rotate(void)
+{
+	// rlwimi, rlwinm, rlwnm
+	static const int m_ops[] = { 20, 21, 23 };
+
+	const int op = FUZZ_PICK(m_ops);
+	const int rS = fuzz_pick(FUZZ_NREGS);
+	const int rA = fuzz_pick(FUZZ_NREGS);
+	const int SH = op == 23 ? fuzz_pick(FUZZ_NREGS) : fuzz_pick(32);
+	return _M(op, rS, rA, SH, fuzz_pick(32), fuzz_pick(32), fuzz_pick(2));
+}
+
+static uint32 fuzz_gen_compare(void)
+{
+	// crand, crandc, creqv, crnand, crnor, cror, crorc, crxor
+	static const int cr_ops[] = { 257, 129, 289, 225, 33, 449, 417, 193 };
+
+	const int crfD = fuzz_pick(8);
+	const int rA = fuzz_pick(FUZZ_NREGS);
+	const int rB = fuzz_pick(FUZZ_NREGS);
+	switch (fuzz_pick(9)) {
+	case 0: return _X(31, crfD << 2, rA, rB, 0, 0);			// cmp
+	case 1: return _X(31, crfD << 2, rA, rB, 32, 0);		// cmpl
+	case 2: return _D(11, crfD << 2, rA, fuzz_value());		// cmpi
+	case 3: return _D(10, crfD << 2, rA, fuzz_value());		// cmpli
+	case 4: return _X(19, fuzz_pick(32), fuzz_pick(32), fuzz_pick(32), FUZZ_PICK(cr_ops), 0);
+	case 5: return _X(19, crfD << 2, fuzz_pick(8) << 2, 0, 0, 0);	// mcrf
+	case 6: return POWERPC_MFCR(rA);
+	case 7: return _I((31 << 26) | (rA << 21) | (fuzz_pick(256) << 12) | (144 << 1)); // mtcrf
+	}
+	return fuzz_pick(2) ? POWERPC_MFSPR(rA, 1) : POWERPC_MTSPR(rA, 1); // mfxer, mtxer
+}
+
+static uint32 fuzz_gen_loadstore(void)
+{
+	// lwz, lbz, lhz, lha, stw, stb, sth
+	static const int d_ops[] = { 32, 34, 40, 42, 36, 38, 44 };
+	// lwzx, lbzx, lhzx, lhax, stwx, stbx, sthx, lwbrx, stwbrx, lhbrx, sthbrx
+	static const int x_ops[] = { 23, 87, 279, 343, 151, 215, 407, 534, 662, 790, 918 };
+
+	const int rD = fuzz_pick(FUZZ_NREGS);
+	if (fuzz_pick(2))
+		return _X(31, rD, FUZZ_RBASE, FUZZ_RINDEX, FUZZ_PICK(x_ops), 0);
+	return _D(FUZZ_PICK(d_ops), rD, FUZZ_RBASE, fuzz_pick(FUZZ_DATA_SIZE - 4));
+}
+
+static uint32 fuzz_gen_branch(bool use_ctr)
+{
+	// Branch if true, if false, always. Then variants decrementing CTR
+	static const int bo_values[] = { 12, 4, 20, 16, 18, 8, 0 };
+
+	// Forward displacement is filled in by fuzz_gen_sequence()
+	if (fuzz_pick(8) == 0)
+		return _I(18 << 26);								// b
+	const int bo = bo_values[fuzz_pick(use_ctr ? 7 : 3)];
+	return _I((16 << 26) | (bo << 21) | (fuzz_pick(32) << 16));	// bc
+}
+
+#undef FUZZ_PICK
+
+// Generate N instructions, branches only go forward up to CODE[N]. A
+// straight sequence doesn't touch CTR and always runs all instructions
+static void fuzz_gen_sequence(uint32 *code, int n, int cls, bool straight)
+{
+	for (int i = 0; i < n; i++) {
+		const int c = cls == FUZZ_CLASS_MIXED ? fuzz_pick(FUZZ_CLASS_MAX) : cls;
+		uint32 opcode;
+		switch (c) {
+		case FUZZ_CLASS_ARITH:		opcode = fuzz_gen_arith();				break;
+		case FUZZ_CLASS_LOGICAL:	opcode = fuzz_gen_logical();			break;
+		case FUZZ_CLASS_ROTATE:		opcode = fuzz_gen_rotate();				break;
+		case FUZZ_CLASS_COMPARE:	opcode = fuzz_gen_compare();			break;
+		case FUZZ_CLASS_LOADSTORE:	opcode = fuzz_gen_loadstore();			break;
+		default:					opcode = fuzz_gen_branch(!straight);	break;
+		}
+		const uint32 disp = straight ? 4 : 4 * (1 + fuzz_pick(n - i));
+		if ((opcode >> 26) == 16)
+			opcode |= disp & 0xfffc;
+		else if ((opcode >> 26) == 18)
+			opcode |= disp & 0x03fffffc;
+		code[i] = opcode;
+	}
+}
+
+static void fuzz_gen_state(fuzz_state & s)
+{
+	for (int i = 0; i < FUZZ_NREGS; i++)
+		s.gpr[i] = fuzz_value();
+	s.gpr[FUZZ_RINDEX] = fuzz_pick(FUZZ_DATA_SIZE - 4);
+	s.gpr[FUZZ_RBASE] = 0;
+	s.cr = fuzz_rand();
+	s.xer = fuzz_rand() & (SO | OV | CA);
+	s.ctr = fuzz_pick(4);
+	for (int i = 0; i < FUZZ_DATA_SIZE; i++)
+		s.data[i] = fuzz_rand();
+}
+
+static powerpc_cpu_base *fuzz_new_cpu(int mode)
+{
+	powerpc_cpu_base *cpu = new powerpc_cpu_base;
+	if (mode == FUZZ_MODE_INTERPRETER)
+		cpu->set_interpret_only(true);
+#if PPC_ENABLE_JIT
+	if (mode == FUZZ_MODE_JIT)
+		cpu->enable_jit();
+#endif
+	return cpu;
+}
+
+static void fuzz_load_code(powerpc_cpu_base *cpu, int mode, const uint32 *code, int n)
+{
+	uint32 *code_p = fuzz_code[mode];
+	for (int i = 0; i < n; i++)
+		code_p[i] = htonl(code[i]);
+	cpu->invalidate_cache_range(code_p, n * 4);
+
+	uint32 *trampoline = fuzz_trampoline[mode];
+	trampoline[0] = htonl(POWERPC_BLRL);
+	trampoline[1] = htonl(POWERPC_EMUL_OP);
+}
+
+// Run code from fuzz_code[MODE] with state S, data buffer is relocated
+static void fuzz_run(powerpc_cpu_base *cpu, int mode, fuzz_state & s)
+{
+	uint8 *data = fuzz_data[mode];
+	memcpy(data, s.data, FUZZ_DATA_SIZE);
+	assert((uintptr)data <= UINT_MAX && (uintptr)fuzz_code[mode] <= UINT_MAX);
+	s.gpr[FUZZ_RBASE] = (uintptr)data;
+	for (int i = 0; i < 32; i++)
+		cpu->set_gpr(i, s.gpr[i]);
+	cpu->emul_set_cr(s.cr);
+	cpu->emul_set_xer(s.xer);
+	cpu->set_ctr(s.ctr);
+	cpu->set_lr((uintptr)fuzz_code[mode]);
+	cpu->execute((uintptr)fuzz_trampoline[mode]);
+
+	for (int i = 0; i < 32; i++)
+		s.gpr[i] = cpu->get_gpr(i);
+	s.gpr[FUZZ_RBASE] -= (uintptr)data;
+	s.cr = cpu->emul_get_cr();
+	s.xer = cpu->emul_get_xer();
+	s.ctr = cpu->get_ctr();
+	memcpy(s.data, data, FUZZ_DATA_SIZE);
+}
+
+static bool fuzz_compare(fuzz_state const & ref, fuzz_state const & s, int mode)
+{
+	bool ok = true;
+	for (int i = 0; i < 32; i++) {
+		if (ref.gpr[i] != s.gpr[i]) {
+			printf("  %s: r%d = %08x, expected %08x\n", fuzz_mode_names[mode], i, s.gpr[i], ref.gpr[i]);
+			ok = false;
+		}
+	}
+	if (ref.cr != s.cr) {
+		printf("  %s: cr = %08x, expected %08x\n", fuzz_mode_names[mode], s.cr, ref.cr);
+		ok = false;
+	}
+	if (ref.xer != s.xer) {
+		printf("  %s: xer = %08x, expected %08x\n", fuzz_mode_names[mode], s.xer, ref.xer);
+		ok = false;
+	}
+	if (ref.ctr != s.ctr) {
+		printf("  %s: ctr = %08x, expected %08x\n", fuzz_mode_names[mode], s.ctr, ref.ctr);
+		ok = false;
+	}
+	for (int i = 0; i < FUZZ_DATA_SIZE; i++) {
+		if (ref.data[i] != s.data[i]) {
+			printf("  %s: data[%d] = %02x, expected %02x\n", fuzz_mode_names[mode], i, s.data[i], ref.data[i]);
+			ok = false;
+			break;
+		}
+	}
+	return ok;
+}
+
+static bool fuzz_powerpc(int n_sequences, uint32 seed)
+{
+	powerpc_cpu_base *cpus[FUZZ_MODE_MAX];
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		cpus[m] = fuzz_new_cpu(m);
+
+	static fuzz_state init, ref, s;
+	uint32 code[FUZZ_MAX_SEQUENCE + 1];
+	int errors = 0;
+	fuzz_seed = seed ? seed : 1;
+	for (int i = 0; i < n_sequences && errors < 10; i++) {
+		const uint32 sequence_seed = fuzz_seed;
+		const int cls = i % (FUZZ_CLASS_MAX + 1);
+		const int n = 1 + fuzz_pick(FUZZ_MAX_SEQUENCE);
+		fuzz_gen_sequence(code, n, cls, false);
+		code[n] = POWERPC_BLR;
+		fuzz_gen_state(init);
+
+		for (int m = 0; m < FUZZ_MODE_MAX; m++) {
+			fuzz_load_code(cpus[m], m, code, n + 1);
+			fuzz_state & r = m == 0 ? ref : s;
+			r = init;
+			fuzz_run(cpus[m], m, r);
+			if (m > 0 && !fuzz_compare(ref, s, m)) {
+				printf("Sequence %d (%s, seed %08x) failed:\n", i, fuzz_class_names[cls], sequence_seed);
+				for (int j = 0; j <= n; j++)
+					printf("  %08x\n", code[j]);
+				errors++;
+			}
+		}
+	}
+
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		delete cpus[m];
+	printf("%d errors out of %d sequences\n", errors, n_sequences);
+	return errors == 0;
+}
+
+// Instructions per second for each opcode class, in each mode
+static bool bench_powerpc(void)
+{
+	powerpc_cpu_base *cpus[FUZZ_MODE_MAX];
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		cpus[m] = fuzz_new_cpu(m);
+
+	printf("%-12s", "MIPS");
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		printf(" %12s", fuzz_mode_names[m]);
+	printf("\n");
+
+	static fuzz_state init, ref, s;
+	const int n = 64;
+	uint32 code[n + 2];
+	int errors = 0;
+	for (int cls = 0; cls <= FUZZ_CLASS_MIXED; cls++) {
+		// Loop over a fixed body, which doesn't touch CTR
+		fuzz_seed = 0x5eed0000 + cls;
+		fuzz_gen_sequence(code, n, cls, true);
+		code[n] = _I((16 << 26) | (16 << 21) | ((-4 * n) & 0xfffc)); // bdnz
+		code[n + 1] = POWERPC_BLR;
+		fuzz_gen_state(init);
+
+		printf("%-12s", fuzz_class_names[cls]);
+		for (int m = 0; m < FUZZ_MODE_MAX; m++) {
+			fuzz_load_code(cpus[m], m, code, n + 2);
+
+			// Find an iteration count running for at least 50 ms,
+			// then keep the best of 3 runs
+			uint32 iterations = 256;
+			double elapsed;
+			for (;;) {
+				s = init;
+				s.ctr = iterations;
+				clock_t start_time = clock();
+				fuzz_run(cpus[m], m, s);
+				elapsed = (double)(clock() - start_time) / CLOCKS_PER_SEC;
+				if (elapsed >= 0.05 || iterations >= (1U << 24))
+					break;
+				iterations *= 2;
+			}
+			for (int k = 0; k < 2; k++) {
+				s = init;
+				s.ctr = iterations;
+				clock_t start_time = clock();
+				fuzz_run(cpus[m], m, s);
+				const double t = (double)(clock() - start_time) / CLOCKS_PER_SEC;
+				if (t < elapsed)
+					elapsed = t;
+			}
+			if (elapsed <= 0)
+				elapsed = 1.0 / CLOCKS_PER_SEC;
+			printf(" %12.1f", (double)iterations * (n + 1) / elapsed / 1e6);
+			fflush(stdout);
+
+			// Results must still match the interpreter ones
+			fuzz_state & r = m == 0 ? ref : s;
+			r = init;
+			r.ctr = 16;
+			fuzz_run(cpus[m], m, r);
+			if (m > 0 && !fuzz_compare(ref, s, m))
+				errors++;
+		}
+		printf("\n");
+	}
+
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		delete cpus[m];
+	return errors == 0;
+}
+
+/**
+ *		AltiVec differential tests
+ *
+ *		Each vector instruction with a native JIT implementation is run
+ *		on random and boundary operands, possibly aliased. v1-v4, VSCR
+ *		and CR must match the interpreter results.
+ **/
+
+struct vmx_test_t {
+	const char *name;
+	char type;			// 'f' if operands are floats
+	char form;			// 'x' (VX, VXR), '1' (VX without vA) or 'a' (VA)
+	uint32 opcode;		// vD, vA, vB and vC fields are zero
+};
+
+#define VX(XO)			'w', 'x', _VX(04,00,00,00,XO)
+#define VXR(XO,RC)		'w', 'x', _VXR(04,00,00,00,XO,RC)
+#define VXRF(XO,RC)		'f', 'x', _VXR(04,00,00,00,XO,RC)
+#define VX1(XO)			'w', '1', _VX(04,00,00,00,XO)
+#define VA(XO)			'w', 'a', _VA(04,00,00,00,00,XO)
+
+static const vmx_test_t vmx_tests[] = {
+	{ "vaddsbs",	VX(768) },
+	{ "vaddshs",	VX(832) },
+	{ "vaddsws",	VX(896) },
+	{ "vaddubm",	VX(0) },
+	{ "vaddubs",	VX(512) },
+	{ "vadduhm",	VX(64) },
+	{ "vadduhs",	VX(576) },
+	{ "vadduwm",	VX(128) },
+	{ "vadduws",	VX(640) },
+	{ "vand",		VX(1028) },
+	{ "vandc",		VX(1092) },
+	{ "vavgub",		VX(1026) },
+	{ "vavguh",		VX(1090) },
+	{ "vcmpbfp",	VXRF(966,0) },
+	{ "vcmpbfp.",	VXRF(966,1) },
+	{ "vcmpeqfp.",	VXRF(198,1) },
+	{ "vcmpequb.",	VXR(6,1) },
+	{ "vcmpequh.",	VXR(70,1) },
+	{ "vcmpequw.",	VXR(134,1) },
+	{ "vcmpgefp.",	VXRF(454,1) },
+	{ "vcmpgtfp.",	VXRF(710,1) },
+	{ "vcmpgtsb.",	VXR(774,1) },
+	{ "vcmpgtsh.",	VXR(838,1) },
+	{ "vcmpgtsw.",	VXR(902,1) },
+	{ "vcmpgtub",	VXR(518,0) },
+	{ "vcmpgtub.",	VXR(518,1) },
+	{ "vcmpgtuh",	VXR(582,0) },
+	{ "vcmpgtuh.",	VXR(582,1) },
+	{ "vcmpgtuw",	VXR(646,0) },
+	{ "vcmpgtuw.",	VXR(646,1) },
+	{ "vmaxsb",		VX(258) },
+	{ "vmaxsh",		VX(322) },
+	{ "vmaxsw",		VX(386) },
+	{ "vmaxub",		VX(2) },
+	{ "vmaxuh",		VX(66) },
+	{ "vmaxuw",		VX(130) },
+	{ "vminsb",		VX(770) },
+	{ "vminsh",		VX(834) },
+	{ "vminsw",		VX(898) },
+	{ "vminub",		VX(514) },
+	{ "vminuh",		VX(578) },
+	{ "vminuw",		VX(642) },
+	{ "vmrghb",		VX(12) },
+	{ "vmrghh",		VX(76) },
+	{ "vmrghw",		VX(140) },
+	{ "vmrglb",		VX(268) },
+	{ "vmrglh",		VX(332) },
+	{ "vmrglw",		VX(396) },
+	{ "vnor",		VX(1284) },
+	{ "vor",		VX(1156) },
+	{ "vperm",		VA(43) },
+	{ "vpkshss",	VX(398) },
+	{ "vpkshus",	VX(270) },
+	{ "vpkswss",	VX(462) },
+	{ "vpkswus",	VX(334) },
+	{ "vpkuhum",	VX(14) },
+	{ "vpkuhus",	VX(142) },
+	{ "vpkuwum",	VX(78) },
+	{ "vpkuwus",	VX(206) },
+	{ "vrlh",		VX(68) },
+	{ "vrlw",		VX(132) },
+	{ "vsel",		VA(42) },
+	{ "vslh",		VX(324) },
+	{ "vslw",		VX(388) },
+	{ "vsrah",		VX(836) },
+	{ "vsraw",		VX(900) },
+	{ "vsrh",		VX(580) },
+	{ "vsrw",		VX(644) },
+	{ "vsubsbs",	VX(1792) },
+	{ "vsubshs",	VX(1856) },
+	{ "vsubsws",	VX(1920) },
+	{ "vsububm",	VX(1024) },
+	{ "vsububs",	VX(1536) },
+	{ "vsubuhm",	VX(1088) },
+	{ "vsubuhs",	VX(1600) },
+	{ "vsubuwm",	VX(1152) },
+	{ "vsubuws",	VX(1664) },
+	{ "vupkhsb",	VX1(526) },
+	{ "vupkhsh",	VX1(590) },
+	{ "vupklsb",	VX1(654) },
+	{ "vupklsh",	VX1(718) },
+	{ "vxor",		VX(1220) },
+};
+
+#undef VX
+#undef VXR
+#undef VXRF
+#undef VX1
+#undef VA
+
+static uint32 vmx_word(char type)
+{
+	static const uint32 int_values[] = {
+		0x00000000, 0x00000001, 0x0000007f, 0x00000080, 0x000000ff,
+		0x00007fff, 0x00008000, 0x0000ffff, 0x7fffffff, 0x80000000,
+		0xffffffff, 0x7f7f7f7f, 0x80808080, 0x00ff00ff, 0xff00ff00,
+		0xffff0000, 0x000f001f, 0x00100020, 0x7fff8000, 0x80007fff
+	};
+	static const uint32 float_values[] = {
+		0x00000000, 0x80000000, 0x3f800000, 0xbf800000, 0x40200000,
+		0xc0200000, 0x7f800000, 0xff800000, 0x7fc00000, 0x00000001
+	};
+	switch (fuzz_pick(4)) {
+	case 0:
+		if (type == 'f')
+			return float_values[fuzz_pick(sizeof(float_values) / sizeof(float_values[0]))];
+		return int_values[fuzz_pick(sizeof(int_values) / sizeof(int_values[0]))];
+	case 1:
+		if (type == 'f') {
+			union { float f; uint32 i; } x;
+			x.f = ((float)(int32)fuzz_pick(64) - 32.0f) / 4.0f;
+			return x.i;
+		}
+		return fuzz_rand() & 0x1f1f1f1f;	// shift counts, small elements
+	}
+	return fuzz_rand();
+}
+
+static bool test_vmx(int iterations, uint32 seed)
+{
+	powerpc_cpu_base *cpus[FUZZ_MODE_MAX];
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		cpus[m] = fuzz_new_cpu(m);
+
+	static fuzz_state init, s;
+	powerpc_vr init_vr[5], ref_vr[5];
+	uint32 ref_vscr = 0, ref_cr = 0;
+	int errors = 0, tests = 0;
+	fuzz_seed = seed ? seed : 1;
+	for (int i = 0; i < (int)(sizeof(vmx_tests) / sizeof(vmx_tests[0])); i++) {
+		const vmx_test_t & t = vmx_tests[i];
+		int op_errors = 0;
+		for (int n = 0; n < iterations && op_errors < 4; n++) {
+			// vD = v1, operands are v2-v4 unless aliased to another one
+			const int vA = t.form == '1' ? 0 : 1 + fuzz_pick(4) % 3;
+			const int vB = fuzz_pick(4) ? 3 : 1 + fuzz_pick(3);
+			uint32 opcode = t.opcode | (1 << 21) | (vA << 16) | (vB << 11);
+			if (t.form == 'a')
+				opcode |= 4 << 6;
+			uint32 code[2] = { opcode, POWERPC_BLR };
+			fuzz_gen_state(init);
+			for (int r = 1; r < 5; r++) {
+				for (int j = 0; j < 4; j++)
+					init_vr[r].w[j] = vmx_word(t.type);
+			}
+			const uint32 init_vscr = fuzz_pick(2);		// VSCR[SAT] is sticky
+
+			for (int m = 0; m < FUZZ_MODE_MAX; m++) {
+				fuzz_load_code(cpus[m], m, code, 2);
+				for (int r = 1; r < 5; r++)
+					cpus[m]->set_vr(r, init_vr[r]);
+				cpus[m]->set_vscr(init_vscr);
+				s = init;
+				fuzz_run(cpus[m], m, s);
+				if (m == 0) {
+					for (int r = 1; r < 5; r++)
+						ref_vr[r] = cpus[m]->get_vr(r);
+					ref_vscr = cpus[m]->get_vscr();
+					ref_cr = s.cr;
+					continue;
+				}
+				bool ok = s.cr == ref_cr && cpus[m]->get_vscr() == ref_vscr;
+				for (int r = 1; r < 5; r++) {
+					powerpc_vr const & v = cpus[m]->get_vr(r);
+					for (int j = 0; j < 4; j++)
+						ok = ok && v.w[j] == ref_vr[r].w[j];
+				}
+				if (!ok) {
+					printf("%s v1,v%d,v%d (%s) failed:\n", t.name, vA, vB, fuzz_mode_names[m]);
+					for (int j = 0; j < 4; j++)
+						printf("  %08x %08x %08x -> %08x, expected %08x\n",
+							   init_vr[vA ? vA : 2].w[j], init_vr[vB].w[j], init_vr[4].w[j],
+							   cpus[m]->get_vr(1).w[j], ref_vr[1].w[j]);
+					printf("  vscr %08x -> %08x, expected %08x; cr %08x, expected %08x\n",
+						   init_vscr, cpus[m]->get_vscr(), ref_vscr, s.cr, ref_cr);
+					op_errors++;
+				}
+			}
+			tests++;
+		}
+		errors += op_errors;
+	}
+
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		delete cpus[m];
+	printf("%d errors out of %d tests\n", errors, tests);
+	return errors == 0;
+}
+
+/**
+ *		FPU differential tests
+ *
+ *		Each floating-point instruction with a native JIT implementation
+ *		is run on random and boundary operands, possibly aliased. f1-f4,
+ *		FPSCR and CR must match the interpreter results. FPSCR is read
+ *		back last so that any lazy FPSCR[FPRF] update is committed.
+ **/
+
+struct fpu_test_t {
+	const char *name;
+	char form;			// 'a' (frA, frB), 'c' (frA, frC), 'm' (frA, frC, frB) or 'b' (frB)
+	uint32 opcode;		// frD, frA, frB and frC fields are zero
+};
+
+#define FA(OP,XO,RC)	'a', (((uint32)(OP) << 26) | ((XO) << 1) | (RC))
+#define FC(OP,XO,RC)	'c', (((uint32)(OP) << 26) | ((XO) << 1) | (RC))
+#define FM(OP,XO,RC)	'm', (((uint32)(OP) << 26) | ((XO) << 1) | (RC))
+#define FB(XO,RC)		'b', ((63U << 26) | ((XO) << 1) | (RC))
+
+static const fpu_test_t fpu_tests[] = {
+	{ "fabs",		FB(264,0) },
+	{ "fadd",		FA(63,21,0) },
+	{ "fadd.",		FA(63,21,1) },
+	{ "fadds",		FA(59,21,0) },
+	{ "fctiw",		FB(14,0) },
+	{ "fctiw.",		FB(14,1) },
+	{ "fctiwz",		FB(15,0) },
+	{ "fdiv",		FA(63,18,0) },
+	{ "fdivs",		FA(59,18,0) },
+	{ "fdivs.",		FA(59,18,1) },
+	{ "fmadd",		FM(63,29,0) },
+	{ "fmadds",		FM(59,29,0) },
+	{ "fmr",		FB(72,0) },
+	{ "fmr.",		FB(72,1) },
+	{ "fmsub",		FM(63,28,0) },
+	{ "fmsubs",		FM(59,28,0) },
+	{ "fmul",		FC(63,25,0) },
+	{ "fmuls",		FC(59,25,0) },
+	{ "fmuls.",		FC(59,25,1) },
+	{ "fnabs",		FB(136,0) },
+	{ "fneg",		FB(40,0) },
+	{ "fnmadd",		FM(63,31,0) },
+	{ "fnmadds",	FM(59,31,0) },
+	{ "fnmadds.",	FM(59,31,1) },
+	{ "fnmsub",		FM(63,30,0) },
+	{ "fnmsubs",	FM(59,30,0) },
+	{ "frsp",		FB(12,0) },
+	{ "frsp.",		FB(12,1) },
+	{ "fsub",		FA(63,20,0) },
+	{ "fsubs",		FA(59,20,0) },
+};
+
+#undef FA
+#undef FC
+#undef FM
+#undef FB
+
+static uint64 fpu_dword(char form)
+{
+	static const uint64 values[] = {
+		UVAL64(0x0000000000000000), UVAL64(0x8000000000000000), UVAL64(0x3ff0000000000000),
+		UVAL64(0xbff0000000000000), UVAL64(0x3fb999999999999a), UVAL64(0x7e37e43c8800759c),
+		UVAL64(0xfe37e43c8800759c), UVAL64(0x7ff0000000000000), UVAL64(0xfff0000000000000),
+		UVAL64(0x7ff8000000000000), UVAL64(0x0000000000000001), UVAL64(0x47efffffe0000000),
+		UVAL64(0x47f0000000000000), UVAL64(0x37a16c262777579c), UVAL64(0x41dfffffffe00000),
+		UVAL64(0x41dfffffffc00000), UVAL64(0xc1e0000000100000), UVAL64(0xc1e0000000000000),
+		UVAL64(0x41e0000000000000), UVAL64(0x41f0000000000000)
+	};
+	union { double d; uint64 j; } x;
+	switch (fuzz_pick(4)) {
+	case 0:
+		// The interpreter computes fmadd products with extended precision,
+		// only use operands whose products and sums are exact in double
+		if (form == 'm')	// zeroes, ones and infinities
+			return values[fuzz_pick(2) ? fuzz_pick(4) : 7 + fuzz_pick(2)];
+		return values[fuzz_pick(sizeof(values) / sizeof(values[0]))];
+	case 1:
+	case 2:
+		x.d = ((double)(int32)fuzz_pick(256) - 128.0) / 8.0;
+		return x.j;
+	}
+	if (form == 'm') {
+		x.d = (double)(int32)(fuzz_rand() & 0xfffff) - 524288.0;
+		return x.j;
+	}
+	return ((uint64)fuzz_rand() << 32) | fuzz_rand();
+}
+
+static bool test_fpu(int iterations, uint32 seed)
+{
+	powerpc_cpu_base *cpus[FUZZ_MODE_MAX];
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		cpus[m] = fuzz_new_cpu(m);
+
+	static fuzz_state init, s;
+	uint64 init_fpr[5], ref_fpr[5];
+	uint32 ref_fpscr = 0, ref_cr = 0;
+	int errors = 0, tests = 0;
+	fuzz_seed = seed ? seed : 1;
+	for (int i = 0; i < (int)(sizeof(fpu_tests) / sizeof(fpu_tests[0])); i++) {
+		const fpu_test_t & t = fpu_tests[i];
+		int op_errors = 0;
+		for (int n = 0; n < iterations && op_errors < 4; n++) {
+			// frD = f1, operands are f2-f4 unless aliased to another one
+			const int frA = t.form == 'b' ? 0 : 1 + fuzz_pick(4) % 3;
+			const int frB = fuzz_pick(4) ? 3 : 1 + fuzz_pick(3);
+			const int frC = fuzz_pick(4) ? 4 : 1 + fuzz_pick(4);
+			uint32 opcode = t.opcode | (1 << 21) | (frA << 16);
+			if (t.form != 'c')
+				opcode |= frB << 11;
+			if (t.form == 'c' || t.form == 'm')
+				opcode |= frC << 6;
+			uint32 code[2] = { opcode, POWERPC_BLR };
+			fuzz_gen_state(init);
+			for (int r = 1; r < 5; r++)
+				init_fpr[r] = fpu_dword(t.form);
+			// Random FX, FEX, VX, OX (for CR1) and FPRF, round to nearest
+			const uint32 init_fpscr = (fuzz_pick(16) << 28) | (fuzz_pick(32) << 12);
+
+			for (int m = 0; m < FUZZ_MODE_MAX; m++) {
+				fuzz_load_code(cpus[m], m, code, 2);
+				for (int r = 1; r < 5; r++)
+					cpus[m]->set_fpr(r, init_fpr[r]);
+				cpus[m]->set_fpscr(init_fpscr);
+				s = init;
+				fuzz_run(cpus[m], m, s);
+				if (m == 0) {
+					for (int r = 1; r < 5; r++)
+						ref_fpr[r] = cpus[m]->get_fpr(r);
+					ref_fpscr = cpus[m]->get_fpscr();
+					ref_cr = s.cr;
+					continue;
+				}
+				bool ok = s.cr == ref_cr && cpus[m]->get_fpscr() == ref_fpscr;
+				for (int r = 1; r < 5; r++)
+					ok = ok && cpus[m]->get_fpr(r) == ref_fpr[r];
+				if (!ok) {
+					printf("%s f1,f%d,f%d,f%d (%s) failed:\n", t.name, frA, frB, frC, fuzz_mode_names[m]);
+					printf("  %016llx %016llx %016llx -> %016llx, expected %016llx\n",
+						   (unsigned long long)init_fpr[frA ? frA : 2], (unsigned long long)init_fpr[frB],
+						   (unsigned long long)init_fpr[frC], (unsigned long long)cpus[m]->get_fpr(1),
+						   (unsigned long long)ref_fpr[1]);
+					printf("  fpscr %08x -> %08x, expected %08x; cr %08x, expected %08x\n",
+						   init_fpscr, cpus[m]->get_fpscr(), ref_fpscr, s.cr, ref_cr);
+					op_errors++;
+				}
+			}
+			tests++;
+		}
+		errors += op_errors;
+	}
+
+	for (int m = 0; m < FUZZ_MODE_MAX; m++)
+		delete cpus[m];
+	printf("%d errors out of %d tests\n", errors, tests);
+	return errors == 0;
+}
+
+/**
+ *		Self-modifying code tests
+ *
+ *		Code page write protection is enabled on a page holding two
+ *		functions and some data. Guest stores to the data must not
+ *		invalidate anything, stores changing one function must only
+ *		invalidate that one, and the page must be protected again after
+ *		each flush.
+ **/
+
+static powerpc_cpu_base *smc_cpu;
+static volatile int smc_faults;
+
+static void smc_sigsegv_handler(int sig, siginfo_t *sip, void *)
+{
+	if (smc_cpu && smc_cpu->handle_code_write((uintptr)sip->si_addr)) {
+		smc_faults++;
+		return;
+	}
+	signal(SIGSEGV, SIG_DFL);
+}
+
+// Call function at ADDR with r5 = VALUE and r6 = PTR
+static void smc_call(powerpc_cpu_base *cpu, int mode, uint32 addr, uint32 value = 0, uint32 ptr = 0)
+{
+	uint32 *trampoline = fuzz_trampoline[mode];
+	trampoline[0] = htonl(POWERPC_BLRL);
+	trampoline[1] = htonl(POWERPC_EMUL_OP);
+	cpu->set_gpr(5, value);
+	cpu->set_gpr(6, ptr);
+	cpu->set_lr(addr);
+	cpu->execute((uintptr)trampoline);
+}
+
+static bool test_smc(void)
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = smc_sigsegv_handler;
+	sa.sa_flags = SA_SIGINFO;
+	sigaction(SIGSEGV, &sa, NULL);
+
+	// f at offset 0x000: li r3,1; blr
+	// g at offset 0x800: li r4,2; blr
+	// s at offset 0xc00: stw r5,0(r6); blr
+	// data at offset 0x400
+	const uint32 F = 0x000, G = 0x800, S = 0xc00, DATA = 0x400;
+
+	int errors = 0, tests = 0;
+#define SMC_CHECK(COND) do { tests++; if (!(COND)) { printf("%s: %s failed\n", fuzz_mode_names[m], #COND); errors++; } } while (0)
+	for (int m = FUZZ_MODE_DECODE_CACHE; m < FUZZ_MODE_MAX; m++) {
+		uint32 *page = (uint32 *)vm_acquire(4096, VM_MAP_DEFAULT | VM_MAP_32BIT);
+		assert(page != VM_MAP_FAILED && (uintptr)page <= UINT_MAX);
+		const uint32 base = (uintptr)page;
+		memset(page, 0, 4096);
+		page[F / 4] = htonl(POWERPC_LI(3, 1));
+		page[F / 4 + 1] = htonl(POWERPC_BLR);
+		page[G / 4] = htonl(POWERPC_LI(4, 2));
+		page[G / 4 + 1] = htonl(POWERPC_BLR);
+		page[S / 4] = htonl(_D(36, 5, 6, 0));
+		page[S / 4 + 1] = htonl(POWERPC_BLR);
+
+		powerpc_cpu_base *cpu = fuzz_new_cpu(m);
+		cpu->enable_code_protection(base, 4096);
+		smc_cpu = cpu;
+		smc_faults = 0;
+
+		smc_call(cpu, m, base + F);
+		smc_call(cpu, m, base + G);
+		SMC_CHECK(cpu->get_gpr(3) == 1 && cpu->get_gpr(4) == 2);
+
+		// Data stores
+		smc_call(cpu, m, base + S, 0x12345678, base + DATA);
+		smc_call(cpu, m, base + S, 0x9abcdef0, base + DATA + 4);
+		SMC_CHECK(ntohl(page[DATA / 4]) == 0x12345678 && ntohl(page[DATA / 4 + 1]) == 0x9abcdef0);
+		SMC_CHECK(smc_faults == 2);
+		SMC_CHECK(cpu->is_translated(base + F) && cpu->is_translated(base + G) && cpu->is_translated(base + S));
+
+		// Code store leaving the instruction as is
+		smc_call(cpu, m, base + S, POWERPC_LI(3, 1), base + F);
+		SMC_CHECK(smc_faults == 3);
+		SMC_CHECK(cpu->is_translated(base + F));
+
+		// Code store changing g into li r4,3
+		smc_call(cpu, m, base + S, POWERPC_LI(4, 3), base + G);
+		SMC_CHECK(smc_faults == 4);
+		SMC_CHECK(!cpu->is_translated(base + G));
+		SMC_CHECK(cpu->is_translated(base + F) && cpu->is_translated(base + S));
+		smc_call(cpu, m, base + F);
+		smc_call(cpu, m, base + G);
+		SMC_CHECK(cpu->get_gpr(3) == 1 && cpu->get_gpr(4) == 3);
+
+		// Host store, e.g. from another thread
+		((volatile uint32 *)page)[F / 4] = htonl(POWERPC_LI(3, 4));
+		SMC_CHECK(smc_faults == 5);
+		smc_call(cpu, m, base + G);
+		smc_call(cpu, m, base + F);
+		SMC_CHECK(cpu->get_gpr(3) == 4 && cpu->get_gpr(4) == 3);
+
+		smc_cpu = NULL;
+		delete cpu;
+		vm_protect(page, 4096, VM_PAGE_READ | VM_PAGE_WRITE);
+		vm_release(page, 4096);
+	}
+#undef SMC_CHECK
+
+	signal(SIGSEGV, SIG_DFL);
+	printf("%d errors out of %d tests\n", errors, tests);
+	return errors == 0;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 #ifdef EMU_KHEPERIX
@@ -2188,6 +3185,38 @@ int main(int argc, char *argv[])
 	FILE *fp = NULL;
 	powerpc_test_cpu *ppc = new powerpc_test_cpu;
 
+#if EMU_KHEPERIX && (PPC_DECODE_CACHE || PPC_ENABLE_JIT)
+	if (argc > 1 && strcmp(argv[1], "--bench-block-cache") == 0) {
+		if (!test_block_cache_spans())
+			return EXIT_FAILURE;
+		bench_block_cache();
+		return EXIT_SUCCESS;
+	}
+#endif
+
+#if EMU_KHEPERIX
+	if (argc > 1 && strcmp(argv[1], "--fuzz") == 0) {
+		const int n_sequences = argc > 2 ? atoi(argv[2]) : 100000;
+		const uint32 seed = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+		return fuzz_powerpc(n_sequences, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+		return bench_powerpc() ? EXIT_SUCCESS : EXIT_FAILURE;
+	if (argc > 1 && strcmp(argv[1], "--vmx") == 0) {
+		const int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+		const uint32 seed = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+		return test_vmx(iterations, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (argc > 1 && strcmp(argv[1], "--fpu") == 0) {
+		const int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+		const uint32 seed = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+		return test_fpu(iterations, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (argc > 1 && strcmp(argv[1], "--smc") == 0)
+		return test_smc() ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif
+
+#if PPC_ENABLE_JIT
 	if (argc > 1) {
 		const char *arg = argv[1];
 		if (strcmp(arg, "--jit") == 0) {
@@ -2197,6 +3226,7 @@ int main(int argc, char *argv[])
 			ppc->enable_jit();
 		}
 	}
+#endif
 
 	if (argc > 1) {
 		const char *file = argv[1];
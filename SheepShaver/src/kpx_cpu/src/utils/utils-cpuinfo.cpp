@@ -35,7 +35,10 @@ enum {
 	HWCAP_I386_SSSE3		= 1 << 9,
 	HWCAP_I386_SSE4_1		= 1 << 19,
 	HWCAP_I386_SSE4_2		= 1 << 20,
-	HWCAP_I386_ECX_FLAGS	= (HWCAP_I386_SSE3|HWCAP_I386_SSSE3|HWCAP_I386_SSE4_1|HWCAP_I386_SSE4_2)
+	HWCAP_I386_ECX_FLAGS	= (HWCAP_I386_SSE3|HWCAP_I386_SSSE3|HWCAP_I386_SSE4_1|HWCAP_I386_SSE4_2),
+	HWCAP_I386_OSXSAVE		= 1 << 27,
+	HWCAP_I386_AVX			= 1 << 28,
+	HWCAP_I386_AVX2			= 1 << 5	// CPUID(7).EBX, not overlapping the above
 };
 
 // Determine x86 CPU features
@@ -69,6 +72,7 @@ static void init_x86_cpu_features(void)
 #endif
 	if (fl1 == 0)
 		return;
+	const unsigned int max_level = fl1;
 
 	/* Invoke CPUID(1), return %edx; caller can examine bits to
 	   determine what's supported.  */
@@ -79,6 +83,27 @@ static void init_x86_cpu_features(void)
 #endif
 
 	x86_cpu_features = (fl1 & HWCAP_I386_ECX_FLAGS) | (fl2 & HWCAP_I386_EDX_FLAGS);
+
+	/* AVX state must also be enabled by the OS, check XCR0 for saved
+	   XMM and YMM registers.  */
+	if ((fl1 & (HWCAP_I386_OSXSAVE|HWCAP_I386_AVX)) != (HWCAP_I386_OSXSAVE|HWCAP_I386_AVX))
+		return;
+	__asm__ (".byte 0x0f, 0x01, 0xd0" : "=a" (fl1), "=d" (fl2) : "c" (0)); // xgetbv
+	if ((fl1 & 6) != 6)
+		return;
+	x86_cpu_features |= HWCAP_I386_AVX;
+
+	/* Invoke CPUID(7), return %ebx for extended features.  */
+	if (max_level < 7)
+		return;
+	unsigned int level = 7, sublevel = 0;
+#ifdef __x86_64__
+	__asm__ ("push %%rbx ; cpuid ; movl %%ebx, %%esi ; pop %%rbx" : "=S" (fl1), "+a" (level), "+c" (sublevel) : : "rdx", "cc");
+#else
+	__asm__ ("push %%ebx ; cpuid ; movl %%ebx, %%esi ; pop %%ebx" : "=S" (fl1), "+a" (level), "+c" (sublevel) : : "edx", "cc");
+#endif
+	if (fl1 & (1 << 5))
+		x86_cpu_features |= HWCAP_I386_AVX2;
 #endif
 }
 
@@ -130,6 +155,18 @@ bool cpuinfo_check_sse4_2(void)
 	return x86_cpu_features & HWCAP_I386_SSE4_2;
 }
 
+// Check for x86 feature AVX
+bool cpuinfo_check_avx(void)
+{
+	return x86_cpu_features & HWCAP_I386_AVX;
+}
+
+// Check for x86 feature AVX2
+bool cpuinfo_check_avx2(void)
+{
+	return x86_cpu_features & HWCAP_I386_AVX2;
+}
+
 // PowerPC CPU features
 static uint32 ppc_cpu_features = 0;
 
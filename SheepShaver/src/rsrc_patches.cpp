@@ -94,10 +94,17 @@ static const uint8 sound_input_driver[] = {	// .AppleSoundInput driver header
 
 static uint32 find_rsrc_data(const uint8 *rsrc, uint32 max, const uint8 *search, uint32 search_len, uint32 ofs = 0)
 {
-	while (ofs < max - search_len) {
-		if (!memcmp(rsrc + ofs, search, search_len))
-			return ofs;
-		ofs++;
+	if (max <= search_len || ofs >= max - search_len)
+		return 0;
+
+	// Only compare the whole string where its first two bytes match
+	const uint8 *p = rsrc + ofs;
+	const uint8 *end = rsrc + max - search_len;
+	while ((p = (const uint8 *)memchr(p, search[0], end - p)) != NULL) {
+		if (p[1] == search[1] && !memcmp(p, search, search_len))
+			return p - rsrc;
+		if (++p >= end)
+			break;
 	}
 	return 0;
 }
@@ -110,14 +117,14 @@ static uint32 find_rsrc_data(const uint8 *rsrc, uint32 max, const uint8 *search,
 // 680x0 code pattern matching helper
 #define PM(N, V) (p[N] == htons(V))
 
-void CheckLoad(uint32 type, int16 id, uint16 *p, uint32 size)
+static void check_load(uint32 type, int16 id, uint16 *p, uint32 size)
 {
 	uint16 *p16;
 	uint32 base;
 	D(bug("vCheckLoad %c%c%c%c (%08x) ID %d, data %p, size %d\n", type >> 24, (type >> 16) & 0xff, (type >> 8) & 0xff, type & 0xff, type, id, p, size));
 
 	// Don't modify resources in ROM
-	if ((uintptr)p >= (uintptr)ROMBaseHost && (uintptr)p <= (uintptr)(ROMBaseHost + ROM_SIZE))
+	if ((uintptr)p >= (uintptr)ROMBaseHost && (uintptr)p < (uintptr)(ROMBaseHost + ROM_SIZE))
 		return;
 
 	if (type == FOURCC('b','o','o','t') && id == 3) {
@@ -611,6 +618,138 @@ void CheckLoad(uint32 type, int16 id, uint16 *p, uint32 size)
 }
 
 
+/*
+ *  Memoized resource patches
+ *
+ *  The same resources are loaded over and over again, e.g. CODE segments
+ *  and system extensions at each application launch. The patches CheckLoad()
+ *  applies only depend on the resource contents, so they are recorded per
+ *  content checksum and replayed on subsequent loads instead of scanning
+ *  the resource again. This also covers resources that need no patch.
+ */
+
+static const int RSRC_MEMO_SIZE = 32;		// Must be a power of two
+static const int RSRC_MEMO_PATCHES = 64;	// Maximum number of patched bytes per resource
+
+// Resources CheckLoad() scans for patch sites (keep in sync with check_load()).
+// Others are patched in constant time, or depend on state that may change
+// between lookups (audio sifters), and are not worth caching.
+static bool check_load_candidate(uint32 type, int16 id)
+{
+	static const struct {
+		uint32 type;
+		int16 id;
+	} candidates[] = {
+		{ FOURCC('b','o','o','t'),      3 },
+		{ FOURCC('g','n','l','d'),      0 },
+		{ FOURCC('p','t','c','h'),    156 },
+		{ FOURCC('p','t','c','h'),    420 },
+		{ FOURCC('g','p','c','h'),     16 },
+		{ FOURCC('g','p','c','h'),    650 },
+		{ FOURCC('g','p','c','h'),    655 },
+		{ FOURCC('g','p','c','h'),    750 },
+		{ FOURCC('g','p','c','h'),    999 },
+		{ FOURCC('g','p','c','h'),   3000 },
+		{ FOURCC('l','t','l','k'),      0 },
+		{ FOURCC('c','i','t','t'),     45 },
+		{ FOURCC('I','N','I','T'),      1 },
+		{ FOURCC('s','c','o','d'), -16465 },
+		{ FOURCC('N','O','b','j'),    100 },
+		{ FOURCC('C','O','D','E'),     27 },
+		{ FOURCC('i','n','f','n'),    129 },
+		{ FOURCC('i','n','f','n'),    200 },
+	};
+	for (int i = 0; i < (int)(sizeof(candidates) / sizeof(candidates[0])); i++) {
+		if (candidates[i].type == type && candidates[i].id == id)
+			return true;
+	}
+	return false;
+}
+
+// Checksum of resource data (FNV-1a over 32-bit words)
+static uint64 rsrc_checksum(const uint8 *p, uint32 size)
+{
+	const uint64 prime = UVAL64(0x00000100000001b3);
+	uint64 sum = UVAL64(0xcbf29ce484222325) ^ size;
+	while (size >= 4) {
+		uint32 v;
+		memcpy(&v, p, 4);
+		sum = (sum ^ v) * prime;
+		p += 4;
+		size -= 4;
+	}
+	while (size--)
+		sum = (sum ^ *p++) * prime;
+	return sum;
+}
+
+struct rsrc_memo_entry {
+	uint32 type;		// Resource type (0: free entry)
+	int16 id;			// Resource ID
+	uint32 size;		// Resource data size
+	uint64 sum;			// Checksum of the resource data before patching
+	uint32 n_patches;	// Number of patched bytes
+	struct {
+		uint32 offset;
+		uint8 value;
+	} patches[RSRC_MEMO_PATCHES];
+};
+
+static rsrc_memo_entry rsrc_memo[RSRC_MEMO_SIZE];
+
+void CheckLoad(uint32 type, int16 id, uint16 *p, uint32 size)
+{
+	// Don't bother for resources that are not scanned, nor for resources
+	// in ROM. The "ltlk" patches also update low-memory globals.
+	if (!check_load_candidate(type, id) || type == FOURCC('l','t','l','k')
+		|| ((uintptr)p >= (uintptr)ROMBaseHost && (uintptr)p < (uintptr)(ROMBaseHost + ROM_SIZE))) {
+		check_load(type, id, p, size);
+		return;
+	}
+
+	uint8 *data = (uint8 *)p;
+	const uint64 sum = rsrc_checksum(data, size);
+	rsrc_memo_entry *e = &rsrc_memo[sum & (RSRC_MEMO_SIZE - 1)];
+	if (e->type == type && e->id == id && e->size == size && e->sum == sum) {
+		D(bug("CheckLoad %c%c%c%c (%08x) ID %d, replaying %d patched bytes\n", type >> 24, (type >> 16) & 0xff, (type >> 8) & 0xff, type & 0xff, type, id, e->n_patches));
+		for (uint32 i = 0; i < e->n_patches; i++)
+			data[e->patches[i].offset] = e->patches[i].value;
+		return;
+	}
+
+	// Record the bytes modified by the patches
+	uint8 *orig = (uint8 *)malloc(size);
+	if (orig == NULL) {
+		check_load(type, id, p, size);
+		return;
+	}
+	memcpy(orig, data, size);
+	check_load(type, id, p, size);
+	uint32 n_patches = 0;
+	for (uint32 i = 0; i < size; i++) {
+		if (data[i] != orig[i]) {
+			if (n_patches == RSRC_MEMO_PATCHES) {
+				n_patches++;
+				break;
+			}
+			e->patches[n_patches].offset = i;
+			e->patches[n_patches].value = data[i];
+			n_patches++;
+		}
+	}
+	free(orig);
+	if (n_patches > RSRC_MEMO_PATCHES) {
+		e->type = 0;
+		return;
+	}
+	e->type = type;
+	e->id = id;
+	e->size = size;
+	e->sum = sum;
+	e->n_patches = n_patches;
+}
+
+
 /*
  *  Resource patches via GetNamedResource() and Get1NamedResource()
  */
@@ -622,7 +761,7 @@ void CheckLoad(uint32 type, const char *name, uint8 *p, uint32 size)
 	D(bug("vCheckLoad %c%c%c%c (%08x) name \"%*s\", data %p, size %d\n", type >> 24, (type >> 16) & 0xff, (type >> 8) & 0xff, type & 0xff, type, name[0], &name[1], p, size));
 
 	// Don't modify resources in ROM
-	if ((uintptr)p >= (uintptr)ROMBaseHost && (uintptr)p <= (uintptr)(ROMBaseHost + ROM_SIZE))
+	if ((uintptr)p >= (uintptr)ROMBaseHost && (uintptr)p < (uintptr)(ROMBaseHost + ROM_SIZE))
 		return;
 
 	if (type == FOURCC('D','R','V','R') && strncmp(&name[1], ".AFPTranslator", name[0]) == 0) {
@@ -643,6 +782,80 @@ void CheckLoad(uint32 type, const char *name, uint8 *p, uint32 size)
 }
 
 
+/*
+ *  Cache of resources already checked by the native Resource Manager patches
+ *
+ *  GetResource() and friends call check_load_invoc() on every lookup, and
+ *  most of them return resources that are already loaded, hence already
+ *  patched. For resources CheckLoad() may patch, remember the handle along
+ *  with a checksum of the (patched) data so that subsequent lookups skip
+ *  the patch scan. Any change to the handle, the resource data or its size,
+ *  e.g. the resource was purged and reloaded from another file in the
+ *  resource chain, invalidates the entry.
+ *
+ *  Entries are also stamped with a generation, made of the Mac Ticks and
+ *  a count of resource scans. Hits with the current generation are trusted
+ *  as is; the checksum is only verified again once the generation moved,
+ *  so a resource is checksummed at most once per tick.
+ */
+
+struct rsrc_cache_entry {
+	uint32 handle;		// Resource handle (0: free entry)
+	uint32 type;		// Resource type
+	uint32 key;			// Resource ID or name hash
+	uint32 data;		// Master pointer at the time of the check
+	uint32 size;		// Resource data size
+	uint64 sum;			// Checksum of the resource data after CheckLoad()
+	uint32 ticks;		// Generation of the last check
+	uint32 scans;
+};
+
+static const int RSRC_CACHE_SIZE = 64;	// Must be a power of two
+static rsrc_cache_entry rsrc_cache[RSRC_CACHE_SIZE];
+static uint32 rsrc_cache_scans = 0;		// Number of resources scanned by CheckLoad()
+
+// Name hash of a Pascal string
+static uint32 rsrc_name_hash(const uint8 *name)
+{
+	uint32 hash = 2166136261U;
+	for (int i = 0; i <= name[0]; i++)
+		hash = (hash ^ name[i]) * 16777619U;
+	return hash;
+}
+
+static inline rsrc_cache_entry *rsrc_cache_entry_for(uint32 h)
+{
+	return &rsrc_cache[(h >> 2) & (RSRC_CACHE_SIZE - 1)];
+}
+
+// Return true if the resource was already checked with the same contents
+static bool rsrc_cache_lookup(rsrc_cache_entry *e, uint32 h, uint32 type, uint32 key, uint32 p, uint32 size)
+{
+	if (e->handle != h || e->type != type || e->key != key || e->data != p || e->size != size)
+		return false;
+	const uint32 ticks = ReadMacInt32(0x16a);	// Ticks
+	if (e->ticks == ticks && e->scans == rsrc_cache_scans)
+		return true;
+	if (e->sum != rsrc_checksum(Mac2HostAddr(p), size))
+		return false;
+	e->ticks = ticks;
+	e->scans = rsrc_cache_scans;
+	return true;
+}
+
+static void rsrc_cache_update(rsrc_cache_entry *e, uint32 h, uint32 type, uint32 key, uint32 p, uint32 size)
+{
+	e->handle = h;
+	e->type = type;
+	e->key = key;
+	e->data = p;
+	e->size = size;
+	e->sum = rsrc_checksum(Mac2HostAddr(p), size);
+	e->ticks = ReadMacInt32(0x16a);
+	e->scans = ++rsrc_cache_scans;
+}
+
+
 /*
  *  Native Resource Manager patches
  */
@@ -661,7 +874,16 @@ void check_load_invoc(uint32 type, int16 id, uint32 h)
 		return;
 	uint32 size = ReadMacInt32(p - 2 * 4) & 0xffffff;
 
+	if (!check_load_candidate(type, id)) {
+		CheckLoad(type, id, (uint16 *)Mac2HostAddr(p), size);
+		return;
+	}
+
+	rsrc_cache_entry *e = rsrc_cache_entry_for(h);
+	if (rsrc_cache_lookup(e, h, type, (uint16)id, p, size))
+		return;
 	CheckLoad(type, id, (uint16 *)Mac2HostAddr(p), size);
+	rsrc_cache_update(e, h, type, (uint16)id, p, size);
 }
 
 #ifdef __BEOS__
@@ -678,7 +900,18 @@ void named_check_load_invoc(uint32 type, uint32 name, uint32 h)
 		return;
 	uint32 size = ReadMacInt32(p - 2 * 4) & 0xffffff;
 
+	// Only DRVR resources are patched by name
+	if (type != FOURCC('D','R','V','R')) {
+		CheckLoad(type, (char *)Mac2HostAddr(name), Mac2HostAddr(p), size);
+		return;
+	}
+
+	rsrc_cache_entry *e = rsrc_cache_entry_for(h);
+	const uint32 key = rsrc_name_hash(Mac2HostAddr(name));
+	if (rsrc_cache_lookup(e, h, type, key, p, size))
+		return;
 	CheckLoad(type, (char *)Mac2HostAddr(name), Mac2HostAddr(p), size);
+	rsrc_cache_update(e, h, type, key, p, size);
 }
 
 #ifdef __BEOS__
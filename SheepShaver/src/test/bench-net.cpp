@@ -0,0 +1,708 @@
+/*
+ *  bench-net.cpp - Loopback network throughput benchmark
+ *
+ *  SheepShaver (C) 1997-2008 Marc Hellwig and Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  Measures the host side of emulated networking without a real LAN:
+ *
+ *  - tap: the reception path of ether_unix.cpp, with a datagram socket
+ *    pair standing in for the tap device. A thread floods one end with
+ *    Ethernet frames, the reception thread collects them in batches and
+ *    hands each batch to the "emulation thread", which copies the
+ *    packets out like ether_do_interrupt() does.
+ *
+ *  - slirp: the slirp stack, run in-process against a synthetic guest
+ *    that talks TCP and UDP to 10.0.2.2, i.e. to sinks and sources on
+ *    the host's loopback interface.
+ *
+ *  CPU time is that of the whole process, so it includes the stand-in
+ *  guest and the sinks.
+ */
+
+#include "sysdeps.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libslirp.h"
+#include "../slirp/cksum.h"
+#include "ether_rx.h"
+
+static double duration = 2.0;		// Seconds per test
+static bool use_select = false;		// Use the select() interface of slirp even if epoll is available
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+// Measurement of one test
+struct measure {
+	double start, cpu_start;
+
+	void begin(void) {
+		start = now();
+		cpu_start = cpu_time();
+	}
+
+	void report(const char *name, u_int64_t packets, u_int64_t bytes) {
+		double elapsed = now() - start, cpu = cpu_time() - cpu_start;
+		if (packets == 0) {
+			printf("%-16s no packets\n", name);
+			return;
+		}
+		printf("%-16s %10.0f packets/s %9.1f Mbit/s %8.2f us CPU/packet\n", name,
+			   packets / elapsed, bytes * 8 / elapsed / 1e6, cpu * 1e6 / packets);
+	}
+};
+
+
+/*
+ *  tap path
+ */
+
+const int TAP_FRAME_SIZE = 1514;
+
+static int tap_fds[2];						// [0] read by reception thread, [1] written by "device"
+static volatile bool tap_stop;
+static volatile bool tap_rx_done;
+static sem_t tap_irq, tap_ack;
+static int tap_batch;						// Max. packets per interrupt
+static bool tap_mmsg;						// Receive with recvmmsg()
+static rx_packet tap_ring[RX_RING_SIZE];	// Filled like the receive ring of ether_unix.cpp
+static int tap_count;
+
+// Stand-in for the kernel side of the tap device, sends frames as fast as they are taken
+static void *tap_device_func(void *arg)
+{
+	u_int8_t frame[TAP_FRAME_SIZE];
+	memset(frame, 0x55, sizeof(frame));
+	while (!tap_stop) {
+		struct pollfd pf = { tap_fds[1], POLLOUT, 0 };
+		if (poll(&pf, 1, 100) > 0)
+			send(tap_fds[1], frame, sizeof(frame), MSG_DONTWAIT);
+	}
+	return NULL;
+}
+
+static void tap_fill(void)
+{
+	tap_count = rx_ring_fill(tap_fds[0], tap_ring, tap_count, tap_batch, TAP_FRAME_SIZE, false, tap_mmsg);
+}
+
+// Same structure as receive_func() in ether_unix.cpp
+static void *tap_receive_func(void *arg)
+{
+	while (!tap_stop) {
+		struct pollfd pf = { tap_fds[0], POLLIN, 0 };
+		if (poll(&pf, 1, 100) <= 0)
+			continue;
+		tap_fill();
+		if (tap_count == 0)
+			continue;
+		sem_post(&tap_irq);
+		sem_wait(&tap_ack);
+	}
+	tap_rx_done = true;
+	sem_post(&tap_irq);
+	return NULL;
+}
+
+static void bench_tap(const char *name, int batch, bool mmsg)
+{
+#ifndef HAVE_RECVMMSG
+	if (mmsg) {
+		printf("%-16s recvmmsg() not available, skipped\n", name);
+		return;
+	}
+#endif
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, tap_fds) < 0) {
+		perror("socketpair");
+		return;
+	}
+	tap_batch = batch;
+	tap_mmsg = mmsg;
+	tap_count = 0;
+	tap_stop = false;
+	tap_rx_done = false;
+	sem_init(&tap_irq, 0, 0);
+	sem_init(&tap_ack, 0, 0);
+
+	pthread_t device_thread, rx_thread;
+	pthread_create(&device_thread, NULL, tap_device_func, NULL);
+	pthread_create(&rx_thread, NULL, tap_receive_func, NULL);
+
+	// "Emulation thread", copies the packets to "Mac memory" on each interrupt
+	static u_int8_t mac_packet[1516];
+	u_int64_t packets = 0, bytes = 0;
+	u_int32_t dummy = 0;
+	measure m;
+	m.begin();
+	double end = m.start + duration;
+	for (;;) {
+		sem_wait(&tap_irq);
+		if (tap_rx_done)
+			break;
+		for (int i = 0; i < tap_count; i++) {
+			memcpy(mac_packet, tap_ring[i].data, tap_ring[i].length);
+			dummy += mac_packet[13];
+			bytes += tap_ring[i].length;
+		}
+		packets += tap_count;
+		tap_count = 0;
+		if (now() >= end)
+			tap_stop = true;
+		sem_post(&tap_ack);
+	}
+	m.report(name, packets, bytes);
+
+	pthread_join(rx_thread, NULL);
+	pthread_join(device_thread, NULL);
+	sem_destroy(&tap_irq);
+	sem_destroy(&tap_ack);
+	close(tap_fds[0]);
+	close(tap_fds[1]);
+}
+
+
+/*
+ *  Host side sinks and sources on the loopback interface
+ */
+
+static volatile bool host_stop;
+static int host_fd = -1;					// Listening TCP socket, or UDP socket
+static volatile u_int64_t host_bytes, host_packets;
+
+static int host_listen(int type, int *port)
+{
+	int s = socket(AF_INET, type, 0);
+	if (s < 0)
+		return -1;
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addr_len = sizeof(addr);
+	if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		(type == SOCK_STREAM && listen(s, 1) < 0) ||
+		getsockname(s, (struct sockaddr *)&addr, &addr_len) < 0) {
+		close(s);
+		return -1;
+	}
+	*port = ntohs(addr.sin_port);
+	return s;
+}
+
+// Wait for fd to become ready, checking for the end of the test
+static bool host_wait(int fd, int events)
+{
+	while (!host_stop) {
+		struct pollfd pf = { fd, (short)events, 0 };
+		if (poll(&pf, 1, 100) > 0)
+			return true;
+	}
+	return false;
+}
+
+static int host_accept(void)
+{
+	if (!host_wait(host_fd, POLLIN))
+		return -1;
+	return accept(host_fd, NULL, NULL);
+}
+
+static void *tcp_sink_func(void *arg)
+{
+	int s = host_accept();
+	if (s < 0)
+		return NULL;
+	static u_int8_t buf[256 * 1024];
+	while (host_wait(s, POLLIN)) {
+		ssize_t actual = read(s, buf, sizeof(buf));
+		if (actual <= 0)
+			break;
+		host_bytes += actual;
+	}
+	close(s);
+	return NULL;
+}
+
+static void *tcp_source_func(void *arg)
+{
+	int s = host_accept();
+	if (s < 0)
+		return NULL;
+	static u_int8_t buf[256 * 1024];
+	memset(buf, 0xaa, sizeof(buf));
+	while (host_wait(s, POLLOUT)) {
+		ssize_t actual = write(s, buf, sizeof(buf));
+		if (actual < 0 && errno != EAGAIN && errno != EINTR)
+			break;
+	}
+	close(s);
+	return NULL;
+}
+
+static void *udp_sink_func(void *arg)
+{
+	static u_int8_t buf[65536];
+	while (host_wait(host_fd, POLLIN)) {
+		ssize_t actual = recv(host_fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (actual > 0) {
+			host_packets++;
+			host_bytes += actual;
+		}
+	}
+	return NULL;
+}
+
+
+/*
+ *  Synthetic guest for slirp
+ */
+
+#define SEQ_LT(a, b) ((int32)((a) - (b)) < 0)
+#define SEQ_GT(a, b) ((int32)((a) - (b)) > 0)
+
+const int GUEST_MSS = 1460;
+const int GUEST_WINDOW = 65535;
+static const u_int8_t guest_mac[6] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 };
+static const u_int8_t slirp_mac[6] = { 0x52, 0x54, 0x00, 0x12, 0x35, 0x02 };
+static const u_int8_t guest_ip[4] = { 10, 0, 2, 15 };
+static const u_int8_t host_ip[4] = { 10, 0, 2, 2 };
+
+// Guest side of the TCP connection
+static struct {
+	u_int16_t port, host_port;
+	u_int32_t snd_una, snd_nxt, snd_wnd, rcv_nxt;
+	bool established, reset, need_ack;
+	u_int64_t rx_packets, rx_bytes;
+} guest;
+
+static u_int16_t ip_id;
+static u_int8_t payload[GUEST_MSS];
+
+static inline void put16(u_int8_t *p, u_int16_t v) { p[0] = v >> 8; p[1] = v; }
+static inline void put32(u_int8_t *p, u_int32_t v) { p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v; }
+static inline u_int16_t get16(const u_int8_t *p) { return (p[0] << 8) | p[1]; }
+static inline u_int32_t get32(const u_int8_t *p) { return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+static inline u_int64_t checksum_add(const u_int8_t *p, int len, u_int64_t sum)
+{
+#if CKSUM_USE_SSE2
+	return cksum_add_sse2(p, len, sum);
+#else
+	return cksum_add_scalar(p, len, sum);
+#endif
+}
+
+// Checksum in packet byte order, ready to be stored with memcpy()
+static inline u_int16_t checksum(u_int64_t sum)
+{
+	return ~cksum_fold(sum);
+}
+
+// Send an IP packet from the guest, the transport header and payload are at frame + 34
+static void guest_send(u_int8_t *frame, int proto, int l4_len)
+{
+	memcpy(frame, slirp_mac, 6);
+	memcpy(frame + 6, guest_mac, 6);
+	put16(frame + 12, 0x0800);
+
+	u_int8_t *ip = frame + 14;
+	ip[0] = 0x45;
+	ip[1] = 0;
+	put16(ip + 2, 20 + l4_len);
+	put16(ip + 4, ip_id++);
+	put16(ip + 6, 0);
+	ip[8] = 64;
+	ip[9] = proto;
+	memset(ip + 10, 0, 2);
+	memcpy(ip + 12, guest_ip, 4);
+	memcpy(ip + 16, host_ip, 4);
+	u_int16_t sum = checksum(checksum_add(ip, 20, 0));
+	memcpy(ip + 10, &sum, 2);
+
+	// Transport checksum, over pseudo header and segment
+	u_int8_t *l4 = ip + 20;
+	u_int8_t *cksum_field = l4 + (proto == IPPROTO_TCP ? 16 : 6);
+	u_int8_t pseudo[12];
+	memcpy(pseudo, guest_ip, 4);
+	memcpy(pseudo + 4, host_ip, 4);
+	pseudo[8] = 0;
+	pseudo[9] = proto;
+	put16(pseudo + 10, l4_len);
+	memset(cksum_field, 0, 2);
+	sum = checksum(checksum_add(l4, l4_len, checksum_add(pseudo, 12, 0)));
+	if (sum == 0 && proto == IPPROTO_UDP)
+		sum = 0xffff;
+	memcpy(cksum_field, &sum, 2);
+
+	slirp_input(frame, 34 + l4_len);
+}
+
+enum {
+	TH_FIN = 0x01,
+	TH_SYN = 0x02,
+	TH_RST = 0x04,
+	TH_PUSH = 0x08,
+	TH_ACK = 0x10
+};
+
+static void guest_send_tcp(int flags, int len)
+{
+	u_int8_t frame[34 + 24 + GUEST_MSS];
+	u_int8_t *th = frame + 34;
+	int hdr_len = flags & TH_SYN ? 24 : 20;
+	put16(th, guest.port);
+	put16(th + 2, guest.host_port);
+	put32(th + 4, guest.snd_nxt);
+	put32(th + 8, flags & TH_ACK ? guest.rcv_nxt : 0);
+	th[12] = (hdr_len / 4) << 4;
+	th[13] = flags;
+	put16(th + 14, GUEST_WINDOW);
+	put16(th + 18, 0);
+	if (flags & TH_SYN) {
+		th[20] = 2;			// MSS option
+		th[21] = 4;
+		put16(th + 22, GUEST_MSS);
+	}
+	memcpy(th + hdr_len, payload, len);
+
+	// slirp may answer right away, update state first
+	guest.snd_nxt += len + (flags & TH_SYN ? 1 : 0);
+	if (flags & TH_ACK)
+		guest.need_ack = false;
+	guest_send(frame, IPPROTO_TCP, hdr_len + len);
+}
+
+static void guest_send_udp(int len)
+{
+	u_int8_t frame[34 + 8 + GUEST_MSS];
+	u_int8_t *uh = frame + 34;
+	put16(uh, guest.port);
+	put16(uh + 2, guest.host_port);
+	put16(uh + 4, 8 + len);
+	memcpy(uh + 8, payload, len);
+	guest_send(frame, IPPROTO_UDP, 8 + len);
+}
+
+// Packets from slirp to the guest
+int slirp_can_output(void)
+{
+	return 1;
+}
+
+void slirp_output(const uint8 *frame, int len)
+{
+	if (len < 34 || get16(frame + 12) != 0x0800)
+		return;
+	const u_int8_t *ip = frame + 14;
+	int ip_hl = (ip[0] & 0x0f) * 4;
+	if (ip[9] != IPPROTO_TCP || len < 14 + ip_hl + 20)
+		return;
+	const u_int8_t *th = ip + ip_hl;
+	if (get16(th + 2) != guest.port)
+		return;
+
+	u_int32_t seq = get32(th + 4), ack = get32(th + 8);
+	int flags = th[13];
+	int data_len = get16(ip + 2) - ip_hl - (th[12] >> 4) * 4;
+	if (flags & TH_RST) {
+		guest.reset = true;
+		return;
+	}
+	if (flags & TH_SYN) {
+		guest.rcv_nxt = seq + 1;
+		guest.established = true;
+		guest.need_ack = true;
+	}
+	if (flags & TH_ACK) {
+		if (SEQ_GT(ack, guest.snd_una))
+			guest.snd_una = ack;
+		guest.snd_wnd = get16(th + 14);
+	}
+	if (data_len > 0) {
+		if (seq == guest.rcv_nxt) {
+			guest.rcv_nxt += data_len;
+			guest.rx_packets++;
+			guest.rx_bytes += data_len;
+		}
+		guest.need_ack = true;
+	}
+}
+
+// Run slirp for at most "timeout" usecs
+static void slirp_poll(int timeout)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (!use_select) {
+		int t = slirp_epoll_fill();
+		slirp_epoll_poll(t < timeout ? t : timeout);
+		return;
+	}
+#endif
+	fd_set rfds, wfds, xfds;
+	int nfds = -1;
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	FD_ZERO(&xfds);
+	int t = slirp_select_fill(&nfds, &rfds, &wfds, &xfds);
+	if (t > timeout)
+		t = timeout;
+	struct timeval tv = { 0, t };
+	if (select(nfds + 1, &rfds, &wfds, &xfds, &tv) >= 0)
+		slirp_select_poll(&rfds, &wfds, &xfds);
+}
+
+// Open a TCP connection from the guest to the host
+static bool guest_connect(u_int16_t port, u_int16_t host_port)
+{
+	memset(&guest, 0, sizeof(guest));
+	guest.port = port;
+	guest.host_port = host_port;
+	guest.snd_una = guest.snd_nxt = 0x10000000;
+	guest_send_tcp(TH_SYN, 0);
+	double end = now() + 1.0;
+	while (!guest.established && !guest.reset && now() < end)
+		slirp_poll(1000);
+	if (!guest.established)
+		return false;
+	guest_send_tcp(TH_ACK, 0);
+	return true;
+}
+
+static void guest_abort(void)
+{
+	guest_send_tcp(TH_RST, 0);
+	for (int i = 0; i < 10; i++)
+		slirp_poll(0);
+}
+
+static void bench_slirp_tcp_tx(const char *name)
+{
+	int port;
+	host_fd = host_listen(SOCK_STREAM, &port);
+	if (host_fd < 0) {
+		perror("listen");
+		return;
+	}
+	host_stop = false;
+	host_bytes = 0;
+	pthread_t sink_thread;
+	pthread_create(&sink_thread, NULL, tcp_sink_func, NULL);
+
+	if (guest_connect(40001, port)) {
+		u_int64_t packets = 0;
+		measure m;
+		m.begin();
+		double end = m.start + duration;
+		u_int32_t last_una = guest.snd_una;
+		double last_progress = m.start;
+		while (!guest.reset) {
+			// Send as far as the window allows
+			bool sent = false;
+			while ((int32)(guest.snd_una + guest.snd_wnd - guest.snd_nxt) >= GUEST_MSS) {
+				guest_send_tcp(TH_ACK | TH_PUSH, GUEST_MSS);
+				packets++;
+				sent = true;
+			}
+			slirp_poll(sent ? 0 : 1000);
+
+			double t = now();
+			if (t >= end)
+				break;
+			if (guest.snd_una != last_una) {
+				last_una = guest.snd_una;
+				last_progress = t;
+			} else if (t - last_progress > 1.0) {
+				printf("%-16s stalled\n", name);
+				break;
+			}
+		}
+		host_stop = true;
+		pthread_join(sink_thread, NULL);
+		m.report(name, packets, host_bytes);
+		guest_abort();
+	} else {
+		printf("%-16s connection failed\n", name);
+		host_stop = true;
+		pthread_join(sink_thread, NULL);
+	}
+	close(host_fd);
+}
+
+static void bench_slirp_tcp_rx(const char *name)
+{
+	int port;
+	host_fd = host_listen(SOCK_STREAM, &port);
+	if (host_fd < 0) {
+		perror("listen");
+		return;
+	}
+	host_stop = false;
+	pthread_t source_thread;
+	pthread_create(&source_thread, NULL, tcp_source_func, NULL);
+
+	if (guest_connect(40002, port)) {
+		measure m;
+		m.begin();
+		double end = m.start + duration;
+		while (!guest.reset && now() < end) {
+			slirp_poll(1000);
+			if (guest.need_ack)
+				guest_send_tcp(TH_ACK, 0);
+		}
+		m.report(name, guest.rx_packets, guest.rx_bytes);
+		guest_abort();
+	} else
+		printf("%-16s connection failed\n", name);
+	host_stop = true;
+	pthread_join(source_thread, NULL);
+	close(host_fd);
+}
+
+static void bench_slirp_udp(const char *name)
+{
+	int port;
+	host_fd = host_listen(SOCK_DGRAM, &port);
+	if (host_fd < 0) {
+		perror("bind");
+		return;
+	}
+	host_stop = false;
+	host_bytes = host_packets = 0;
+	pthread_t sink_thread;
+	pthread_create(&sink_thread, NULL, udp_sink_func, NULL);
+
+	memset(&guest, 0, sizeof(guest));
+	guest.port = 40003;
+	guest.host_port = port;
+	u_int64_t sent = 0;
+	measure m;
+	m.begin();
+	double end = m.start + duration;
+	while (now() < end) {
+		for (int i = 0; i < 32; i++)
+			guest_send_udp(GUEST_MSS);
+		sent += 32;
+		slirp_poll(0);
+	}
+	host_stop = true;
+	pthread_join(sink_thread, NULL);
+	m.report(name, host_packets, host_bytes);
+	printf("%-16s %llu of %llu datagrams delivered\n", "", (unsigned long long)host_packets, (unsigned long long)sent);
+	close(host_fd);
+}
+
+
+/*
+ *  Main program
+ */
+
+static void usage(const char *prg)
+{
+	fprintf(stderr, "Usage: %s [-t SECONDS] [-s] [TEST...]\n", prg);
+	fprintf(stderr, "  -t SECONDS  duration of each test (default 2)\n");
+	fprintf(stderr, "  -s          use select() instead of epoll in slirp\n");
+	fprintf(stderr, "Tests: tap tap-batch tap-mmsg slirp-tcp-tx slirp-tcp-rx slirp-udp (default all)\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *all_tests[] = {
+		"tap", "tap-batch", "tap-mmsg", "slirp-tcp-tx", "slirp-tcp-rx", "slirp-udp"
+	};
+	const char *tests[16];
+	int num_tests = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			duration = atof(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0)
+			use_select = true;
+		else if (argv[i][0] == '-' || num_tests == 16)
+			usage(argv[0]);
+		else
+			tests[num_tests++] = argv[i];
+	}
+	if (num_tests == 0) {
+		for (int i = 0; i < (int)(sizeof(all_tests) / sizeof(all_tests[0])); i++)
+			tests[num_tests++] = all_tests[i];
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	memset(payload, 0x5a, sizeof(payload));
+
+	bool slirp_ok = false, slirp_tried = false;
+	for (int i = 0; i < num_tests; i++) {
+		const char *test = tests[i];
+		if (strncmp(test, "slirp", 5) == 0 && !slirp_tried) {
+			slirp_tried = true;
+			slirp_ok = slirp_init() == 0;
+			if (!slirp_ok)
+				printf("slirp initialization failed (no DNS server found?)\n");
+#ifdef HAVE_SYS_EPOLL_H
+			if (slirp_ok && !use_select && slirp_epoll_init(-1) < 0)
+				use_select = true;
+#endif
+		}
+
+		if (strcmp(test, "tap") == 0)
+			bench_tap(test, 1, false);
+		else if (strcmp(test, "tap-batch") == 0)
+			bench_tap(test, RX_RING_SIZE, false);
+		else if (strcmp(test, "tap-mmsg") == 0)
+			bench_tap(test, RX_RING_SIZE, true);
+		else if (strcmp(test, "slirp-tcp-tx") == 0) {
+			if (slirp_ok)
+				bench_slirp_tcp_tx(test);
+		} else if (strcmp(test, "slirp-tcp-rx") == 0) {
+			if (slirp_ok)
+				bench_slirp_tcp_rx(test);
+		} else if (strcmp(test, "slirp-udp") == 0) {
+			if (slirp_ok)
+				bench_slirp_udp(test);
+		} else
+			usage(argv[0]);
+	}
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ *  test-cksum.cpp - slirp checksum kernels regression testing and benchmark
+ *
+ *  SheepShaver (C) 1997-2008 Marc Hellwig and Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../slirp/cksum.h"
+
+static int errors = 0;
+static int tests = 0;
+
+// Simple deterministic pseudo-random generator
+static u_int32_t rand_state = 1;
+
+static u_int32_t rand32(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+// Reference implementation, one native 16-bit word at a time (RFC 1071)
+static u_int16_t cksum_ref(const u_int8_t *p, int len)
+{
+	u_int32_t sum = 0;
+	u_int16_t w;
+	while (len >= 2) {
+		memcpy(&w, p, 2);
+		sum += w;
+		if (sum > 0xffff)
+			sum -= 0xffff;
+		p += 2;
+		len -= 2;
+	}
+	if (len) {
+		u_int8_t b[2] = { *p, 0 };
+		memcpy(&w, b, 2);
+		sum += w;
+		if (sum > 0xffff)
+			sum -= 0xffff;
+	}
+	return ~sum & 0xffff;
+}
+
+typedef u_int16_t (*cksum_func)(const u_int8_t *, int);
+typedef u_int64_t (*cksum_add_func)(const u_int8_t *, int, u_int64_t);
+
+// Checksum with one of the kernels from cksum.h
+template< cksum_add_func add >
+static u_int16_t cksum_kernel(const u_int8_t *p, int len)
+{
+	return ~cksum_fold(add(p, len, 0)) & 0xffff;
+}
+
+static const int MAX_LEN = 65536;
+static u_int8_t buf[MAX_LEN + 64];
+
+static void test_kernel(const char *name, cksum_func func)
+{
+	printf("Testing %s kernel\n", name);
+
+	// All lengths up to a few packets, at all alignments
+	for (int len = 0; len <= 2048; len++) {
+		for (int ofs = 0; ofs < 32; ofs++) {
+			for (int i = 0; i < len; i++)
+				buf[ofs + i] = rand32();
+			tests++;
+			u_int16_t expected = cksum_ref(buf + ofs, len);
+			u_int16_t result = func(buf + ofs, len);
+			if (result != expected) {
+				fprintf(stderr, "ERROR: %s, length %d, offset %d: %04x, expected %04x\n", name, len, ofs, result, expected);
+				errors++;
+			}
+		}
+	}
+
+	// Largest IP packet, all ones to stress the carries
+	for (int fill = 0; fill < 2; fill++) {
+		for (int i = 0; i < MAX_LEN; i++)
+			buf[i] = fill ? 0xff : rand32();
+		tests++;
+		u_int16_t expected = cksum_ref(buf + 1, MAX_LEN - 1);
+		u_int16_t result = func(buf + 1, MAX_LEN - 1);
+		if (result != expected) {
+			fprintf(stderr, "ERROR: %s, length %d: %04x, expected %04x\n", name, MAX_LEN - 1, result, expected);
+			errors++;
+		}
+	}
+}
+
+// Checksums are equivalent if they only differ in the representation of zero
+static bool cksum_equal(u_int16_t a, u_int16_t b)
+{
+	return a % 0xffff == b % 0xffff;
+}
+
+static void test_adjust(void)
+{
+	printf("Testing incremental update\n");
+	for (int n = 0; n < 100000; n++) {
+		int len = 2 * (1 + rand32() % 750);
+		for (int i = 0; i < len; i++)
+			buf[i] = rand32();
+		if (n % 10 == 0)
+			memset(buf, n % 20 ? 0xff : 0, len);	// edge cases
+		u_int16_t ck = cksum_ref(buf, len);
+
+		int ofs = 2 * (rand32() % (len / 2));
+		u_int16_t old_w, new_w;
+		memcpy(&old_w, buf + ofs, 2);
+		new_w = n % 3 ? rand32() : (n % 2 ? 0xffff : 0);
+		memcpy(buf + ofs, &new_w, 2);
+
+		tests++;
+		u_int16_t expected = cksum_ref(buf, len);
+		u_int16_t result = cksum_adjust(ck, old_w, new_w);
+		if (!cksum_equal(result, expected)) {
+			fprintf(stderr, "ERROR: adjust %04x from %04x to %04x: %04x, expected %04x\n", ck, old_w, new_w, result, expected);
+			errors++;
+		}
+	}
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void bench_kernel(const char *name, cksum_func func)
+{
+	static const int sizes[] = { 20, 40, 576, 1500, 9000, 65535 };
+	const int total = 256 * 1024 * 1024;
+	for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		const int len = sizes[i], count = total / len;
+		u_int32_t dummy = 0;
+		double start = now();
+		for (int n = 0; n < count; n++)
+			dummy += func(buf + (n & 1), len);
+		double elapsed = now() - start;
+		printf("%-9s %5d bytes: %8.1f MB/s, %6.1f ns/packet [%04x]\n", name, len,
+			   (double)count * len / elapsed / 1e6, elapsed * 1e9 / count, dummy & 0xffff);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const bool bench = argc > 1 && strcmp(argv[1], "-b") == 0;
+#if CKSUM_USE_AVX2
+	__builtin_cpu_init();
+	const bool have_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (bench) {
+		for (int i = 0; i < MAX_LEN + 64; i++)
+			buf[i] = rand32();
+		bench_kernel("reference", cksum_ref);
+		bench_kernel("scalar", cksum_kernel<cksum_add_scalar>);
+#if CKSUM_USE_SSE2
+		bench_kernel("SSE2", cksum_kernel<cksum_add_sse2>);
+#endif
+#if CKSUM_USE_AVX2
+		if (have_avx2)
+			bench_kernel("AVX2", cksum_kernel<cksum_add_avx2>);
+#endif
+		return 0;
+	}
+
+	test_kernel("scalar", cksum_kernel<cksum_add_scalar>);
+#if CKSUM_USE_SSE2
+	test_kernel("SSE2", cksum_kernel<cksum_add_sse2>);
+#endif
+#if CKSUM_USE_AVX2
+	if (have_avx2)
+		test_kernel("AVX2", cksum_kernel<cksum_add_avx2>);
+	else
+		printf("AVX2 not available, skipped\n");
+#endif
+	test_adjust();
+
+	printf("%d errors out of %d tests\n", errors, tests);
+	return errors != 0;
+}
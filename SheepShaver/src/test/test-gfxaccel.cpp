@@ -0,0 +1,289 @@
+/*
+ *  test-gfxaccel.cpp - Native QuickDraw kernels regression testing
+ *
+ *  SheepShaver (C) 1997-2008 Marc Hellwig and Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "../gfxaccel_ops.h"
+
+static int errors = 0;
+static int tests = 0;
+
+// Simple deterministic pseudo-random generator
+static uint32 rand_state = 1;
+
+static uint32 rand32(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+
+/*
+ *	Reference implementations, straight from the Color QuickDraw
+ *	definitions and operating on one native pixel value at a time
+ */
+
+static uint32 get_pixel(const uint8 *p, int bpp)
+{
+	switch (bpp) {
+	case 1: return *p;
+	case 2: return (p[0] << 8) | p[1];
+	}
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put_pixel(uint8 *p, int bpp, uint32 v)
+{
+	switch (bpp) {
+	case 1:
+		p[0] = v;
+		break;
+	case 2:
+		p[0] = v >> 8; p[1] = v;
+		break;
+	case 4:
+		p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+		break;
+	}
+}
+
+// Number and width of the components of a direct pixel
+static int cmp_count(int bpp) { return bpp == 2 ? 3 : 4; }
+static int cmp_size(int bpp) { return bpp == 2 ? 5 : 8; }
+
+static uint32 ref_pixel(int mode, int bpp, uint32 s, uint32 d, uint32 back_pen)
+{
+	const uint32 all = bpp == 4 ? 0xffffffff : (1 << (8 * bpp)) - 1;
+	if (mode <= nqdNotSrcBic) {
+		// Boolean modes, black is 1 in the "ink" domain
+		const bool direct = bpp > 1;
+		uint32 S = direct ? ~s & all : s;
+		uint32 D = direct ? ~d & all : d;
+		uint32 R;
+		switch (mode) {
+		case nqdSrcCopy:	R = S; break;
+		case nqdSrcOr:		R = S | D; break;
+		case nqdSrcXor:		R = S ^ D; break;
+		case nqdSrcBic:		R = ~S & D; break;
+		case nqdNotSrcCopy:	R = ~S; break;
+		case nqdNotSrcOr:	R = ~S | D; break;
+		case nqdNotSrcXor:	R = ~S ^ D; break;
+		default:			R = S & D; break;
+		}
+		R &= all;
+		return direct ? ~R & all : R;
+	}
+	if (mode == nqdTransparent) {
+		const uint32 mask = nqd_pixel_mask(bpp);
+		return (s & mask) == (back_pen & mask) ? d : s;
+	}
+
+	// Arithmetic modes, component by component
+	const int n = cmp_count(bpp), size = cmp_size(bpp);
+	const uint32 cmask = (1 << size) - 1;
+	uint32 r = 0;
+	for (int i = 0; i < n; i++) {
+		const int shift = i * size;
+		const uint32 a = (s >> shift) & cmask, b = (d >> shift) & cmask;
+		uint32 c;
+		switch (mode) {
+		case nqdAddOver:	c = a + b; break;
+		case nqdSubOver:	c = b - a; break;
+		case nqdAdMax:		c = a > b ? a : b; break;
+		default:			c = a < b ? a : b; break;
+		}
+		r |= (c & cmask) << shift;
+	}
+	return r;
+}
+
+// Significant bits of a kernel result
+static uint32 result_mask(int mode, int bpp)
+{
+	if (mode >= nqdAddOver && mode != nqdTransparent)
+		return nqd_pixel_mask(bpp);
+	return bpp == 4 ? 0xffffffff : (1 << (8 * bpp)) - 1;
+}
+
+
+/*
+ *	Test one rectangle against the reference implementation
+ */
+
+static const int MAX_PIXELS = 80;
+static const int MAX_ROWS = 4;
+static const int ROW_BYTES = MAX_PIXELS * 4 + 32;
+
+static void test_rect(int mode, int bpp, bool overlap)
+{
+	static uint8 src[MAX_ROWS * ROW_BYTES], dst[MAX_ROWS * ROW_BYTES];
+	static uint8 ref[MAX_ROWS * ROW_BYTES], org[MAX_ROWS * ROW_BYTES];
+	const uint32 back_pen = rand32() & nqd_pixel_mask(bpp);
+
+	// Fill in pixels, with some of them matching the background color
+	for (int i = 0; i < MAX_ROWS * ROW_BYTES; i += bpp) {
+		const bool key = (rand32() & 3) == 0;
+		put_pixel(src + i, bpp, key ? back_pen | (rand32() & ~nqd_pixel_mask(bpp)) : rand32());
+		put_pixel(dst + i, bpp, rand32());
+	}
+
+	const int width = 1 + rand32() % MAX_PIXELS;
+	const int height = overlap ? 1 : 1 + rand32() % MAX_ROWS;
+	const int src_x = rand32() % 8, dst_x = rand32() % 8;
+	const uint8 *sp = overlap ? dst : src;
+	memcpy(org, sp, sizeof(org));
+	memcpy(ref, dst, sizeof(ref));
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const int so = y * ROW_BYTES + (src_x + x) * bpp;
+			const int doff = y * ROW_BYTES + (dst_x + x) * bpp;
+			put_pixel(ref + doff, bpp, ref_pixel(mode, bpp, get_pixel(org + so, bpp), get_pixel(ref + doff, bpp), back_pen));
+		}
+	}
+
+	tests++;
+	if (!nqd_do_bitblt(mode, bpp, dst + dst_x * bpp, ROW_BYTES, sp + src_x * bpp, ROW_BYTES, width * bpp, height, back_pen)) {
+		fprintf(stderr, "ERROR: mode %d, %d bpp not handled\n", mode, bpp * 8);
+		errors++;
+		return;
+	}
+
+	const uint32 mask = result_mask(mode, bpp);
+	for (int i = 0; i < MAX_ROWS * ROW_BYTES; i += bpp) {
+		const uint32 a = get_pixel(dst + i, bpp), b = get_pixel(ref + i, bpp);
+		if ((a & mask) != (b & mask)) {
+			fprintf(stderr, "ERROR: mode %d, %d bpp, %s, width %d: got %08x, expected %08x at offset %d\n",
+					mode, bpp * 8, overlap ? "overlap" : "disjoint", width, a, b, i);
+			errors++;
+			return;
+		}
+	}
+}
+
+
+/*
+ *	Test fill and invert row kernels against byte-wise references
+ */
+
+static void test_fill_row(const char *name, nqd_fill_row_func fill_row, nqd_invert_row_func invert_row)
+{
+	static uint8 buf[ROW_BYTES + 64], ref[ROW_BYTES + 64];
+	for (int n = 0; n < 2000; n++) {
+		for (int i = 0; i < (int)sizeof(buf); i++)
+			buf[i] = rand32();
+		memcpy(ref, buf, sizeof(ref));
+
+		const int bpp = 1 << (rand32() % 3);
+		const int offset = (rand32() % 32) & ~(bpp - 1);
+		const int length = (rand32() % (ROW_BYTES / bpp)) * bpp;
+		const bool invert = rand32() & 1;
+		const uint32 color = rand32();
+		const uint32 pattern = nqd_pixel_pattern(bpp, color);
+		for (int i = 0; i < length; i += bpp) {
+			if (invert) {
+				for (int j = 0; j < bpp; j++)
+					ref[offset + i + j] = ~ref[offset + i + j];
+			}
+			else
+				put_pixel(ref + offset + i, bpp, color);
+		}
+
+		tests++;
+		if (invert)
+			invert_row(buf + offset, length);
+		else
+			fill_row(buf + offset, length, pattern);
+		if (memcmp(buf, ref, sizeof(buf)) != 0) {
+			fprintf(stderr, "ERROR: %s %s, %d bpp, offset %d, length %d\n",
+					name, invert ? "invert" : "fill", bpp * 8, offset, length);
+			errors++;
+			return;
+		}
+	}
+}
+
+static void test_fill_column(void)
+{
+	static uint8 buf[MAX_ROWS * ROW_BYTES], ref[MAX_ROWS * ROW_BYTES];
+	for (int bpp = 1; bpp <= 4; bpp *= 2) {
+		for (int i = 0; i < (int)sizeof(buf); i++)
+			buf[i] = rand32();
+		memcpy(ref, buf, sizeof(ref));
+
+		const uint32 color = rand32();
+		const int x = rand32() % MAX_PIXELS;
+		for (int y = 0; y < MAX_ROWS; y++) {
+			const int o = y * ROW_BYTES + x * bpp;
+			put_pixel(ref + o, bpp, get_pixel(ref + o, bpp) ^ (bpp == 4 ? 0xffffffff : (1 << (8 * bpp)) - 1));
+		}
+		nqd_invert_column(buf + x * bpp, ROW_BYTES, MAX_ROWS, bpp);
+		for (int y = 0; y < MAX_ROWS; y++)
+			put_pixel(ref + y * ROW_BYTES + (x + 1) * bpp, bpp, color);
+		nqd_fill_column(buf + (x + 1) * bpp, ROW_BYTES, MAX_ROWS, bpp, nqd_pixel_pattern(bpp, color));
+
+		tests++;
+		if (memcmp(buf, ref, sizeof(buf)) != 0) {
+			fprintf(stderr, "ERROR: column, %d bpp\n", bpp * 8);
+			errors++;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const int modes[] = {
+		nqdSrcCopy, nqdSrcOr, nqdSrcXor, nqdSrcBic,
+		nqdNotSrcCopy, nqdNotSrcOr, nqdNotSrcXor, nqdNotSrcBic,
+		nqdAddOver, nqdTransparent, nqdAdMax, nqdSubOver, nqdAdMin
+	};
+	static const int depths[] = { 1, 2, 4 };
+
+	const int iterations = argc > 1 ? atoi(argv[1]) : 200;
+	printf("Testing NQD bitblt kernels (%s)\n", NQD_USE_SSE2 ? "SSE2" : "scalar");
+	for (int i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); i++) {
+		for (int j = 0; j < (int)(sizeof(depths) / sizeof(depths[0])); j++) {
+			const int mode = modes[i], bpp = depths[j];
+			if (!nqd_bitblt_mode_supported(mode, bpp))
+				continue;
+			for (int n = 0; n < iterations; n++) {
+				test_rect(mode, bpp, false);
+				test_rect(mode, bpp, true);
+			}
+		}
+	}
+
+	printf("Testing NQD fill and invert kernels\n");
+	test_fill_row("scalar", nqd_fill_row_scalar, nqd_invert_row_scalar);
+#if NQD_USE_SSE2
+	test_fill_row("SSE2", nqd_fill_row_sse2, nqd_invert_row_sse2);
+#endif
+#if NQD_USE_AVX2
+	if (cpuinfo_check_avx2())
+		test_fill_row("AVX2", nqd_fill_row_avx2, nqd_invert_row_avx2);
+	else
+		printf("AVX2 not available, skipped\n");
+#endif
+	test_fill_column();
+
+	printf("%d errors out of %d tests\n", errors, tests);
+	return errors != 0;
+}